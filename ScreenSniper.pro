@@ -1,4 +1,4 @@
-QT       += core gui widgets
+QT       += core gui widgets concurrent network
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -9,13 +9,115 @@ CONFIG += c++17
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    annotationstore.cpp \
+    autotrim.cpp \
+    capturehistory.cpp \
+    captureserver.cpp \
+    commandline.cpp \
+    edgemap.cpp \
+    gifencoder.cpp \
+    globalhotkey.cpp \
+    historydialog.cpp \
+    imagediff.cpp \
+    imageeffects.cpp \
+    imageexporter.cpp \
+    inputcoalescer.cpp \
+    inputsession.cpp \
     main.cpp \
     mainwindow.cpp \
-    screenshotwidget.cpp
+    memoryusage.cpp \
+    mipmappyramid.cpp \
+    ocrengine.cpp \
+    perceptualhash.cpp \
+    pinwidget.cpp \
+    pixelhash.cpp \
+    pngstreamwriter.cpp \
+    recentcaptures.cpp \
+    recordingformat.cpp \
+    regionrecorder.cpp \
+    resampler.cpp \
+    screenmapper.cpp \
+    screenshotwidget.cpp \
+    scrollstitcher.cpp \
+    sessionreplayer.cpp \
+    startupprofiler.cpp \
+    tiledimage.cpp \
+    uploadsink.cpp \
+    windowlayout.cpp \
+    x11capture.cpp
 
 HEADERS += \
+    annotationstore.h \
+    autotrim.h \
+    capturehistory.h \
+    captureserver.h \
+    commandline.h \
+    edgemap.h \
+    gifencoder.h \
+    globalhotkey.h \
+    historydialog.h \
+    imagediff.h \
+    imageeffects.h \
+    imageexporter.h \
+    inputcoalescer.h \
+    inputsession.h \
     mainwindow.h \
-    screenshotwidget.h
+    memoryusage.h \
+    mipmappyramid.h \
+    ocrengine.h \
+    perceptualhash.h \
+    pinwidget.h \
+    pixelformat.h \
+    pixelhash.h \
+    pngstreamwriter.h \
+    recentcaptures.h \
+    recordingformat.h \
+    regionrecorder.h \
+    resampler.h \
+    screenmapper.h \
+    screenshotwidget.h \
+    scrollstitcher.h \
+    sessionreplayer.h \
+    startupprofiler.h \
+    tiledimage.h \
+    uploadsink.h \
+    windowlayout.h \
+    x11capture.h
+
+# Linux 下使用 Xlib 实现全局快捷键和原生截图
+unix:!macx {
+    DEFINES += SCREENSNIPER_X11
+    # 本地截图服务使用 POSIX 共享内存，较旧的 glibc 中 shm_open 位于 librt
+    LIBS += -lX11 -lrt
+
+    # 安装了 libxdamage 时录屏只重新截取被修改的区域，否则逐帧比较图块哈希
+    CONFIG += link_pkgconfig
+    packagesExist(xdamage) {
+        DEFINES += SCREENSNIPER_XDAMAGE
+        PKGCONFIG += xdamage
+    }
+
+    # 安装了 xcb-shm 和 x11-xcb 时本地截图服务通过 MIT-SHM 让 X 服务器直接把像素写进共享内存
+    packagesExist(xcb-shm x11-xcb) {
+        DEFINES += SCREENSNIPER_XSHM
+        PKGCONFIG += xcb-shm x11-xcb
+    }
+}
+
+# 安装了 liblz4 时最近截图环用 LZ4 压缩，否则用 zlib
+unix {
+    CONFIG += link_pkgconfig
+    packagesExist(liblz4) {
+        DEFINES += SCREENSNIPER_LZ4
+        PKGCONFIG += liblz4
+    }
+
+    # 安装了 zlib 开发包时长截图边拼接边写 PNG，否则拼出整张图后再由 Qt 编码
+    packagesExist(zlib) {
+        DEFINES += SCREENSNIPER_ZLIB
+        PKGCONFIG += zlib
+    }
+}
 
 FORMS += \
     mainwindow.ui
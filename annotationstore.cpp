@@ -0,0 +1,338 @@
+#include "annotationstore.h"
+#include <QPainter>
+#include <QPaintDevice>
+#include <QPolygonF>
+#include <cmath>
+
+namespace
+{
+    // 箭头头部的长度和张角（30 度）
+    const double ArrowHeadSize = 15.0;
+    const double ArrowHeadAngle = M_PI / 6;
+
+    // 线宽的一半再加 1 个像素的抗锯齿余量
+    inline int strokePadding(int width)
+    {
+        return width / 2 + 1;
+    }
+}
+
+void AnnotationStore::clear()
+{
+    *this = AnnotationStore();
+}
+
+int AnnotationStore::addArrow(const QPoint &start, const QPoint &end, const QColor &color, int width)
+{
+    return append(Arrow, start, end, color, width, 0, 0);
+}
+
+int AnnotationStore::addRectangle(const QRect &rect, const QColor &color, int width)
+{
+    return append(Rectangle, rect.topLeft(), rect.bottomRight(), color, width, 0, 0);
+}
+
+int AnnotationStore::addText(const QPoint &position, const QString &text, const QColor &color, const QFont &font, int wrapWidth)
+{
+    const quint16 fontId = internFont(font);
+    TextEntry entry;
+    entry.text = text;
+    entry.wrapWidth = wrapWidth;
+    layoutText(entry, fonts.at(fontId));
+    texts.append(entry);
+    return append(Text, position, position, color, 0, quint32(texts.size() - 1), fontId);
+}
+
+void AnnotationStore::setText(int index, const QString &text)
+{
+    TextEntry &entry = texts[refs.at(index)];
+    entry.text = text;
+    layoutText(entry, fonts.at(refCounts.at(index)));
+    boxes[index] = computeBounds(index);
+}
+
+int AnnotationStore::beginStroke(const QPoint &point, const QColor &color, int width)
+{
+    points.append(point);
+    return append(Pen, point, point, color, width, quint32(points.size() - 1), 1);
+}
+
+void AnnotationStore::extendStroke(const QPoint &point)
+{
+    // 只有点数组末尾的那一笔可以继续追加
+    const int index = types.size() - 1;
+    if (index < 0 || types.at(index) != Pen || refs.at(index) + refCounts.at(index) != quint32(points.size()))
+    {
+        return;
+    }
+    if (points.last() == point)
+    {
+        return;
+    }
+    points.append(point);
+    ++refCounts[index];
+    const int pad = strokePadding(widths.at(index));
+    boxes[index] = boxes.at(index).united(QRect(point - QPoint(pad, pad), point + QPoint(pad, pad)));
+}
+
+void AnnotationStore::remove(int index)
+{
+    if (index < 0 || index >= types.size())
+    {
+        return;
+    }
+    if (types.at(index) == Text)
+    {
+        texts[refs.at(index)] = TextEntry();
+        ++deadTexts;
+    }
+    else if (types.at(index) == Pen)
+    {
+        deadPoints += int(refCounts.at(index));
+    }
+
+    types.remove(index);
+    widths.remove(index);
+    colorIds.remove(index);
+    boxes.remove(index);
+    firstPoints.remove(index);
+    secondPoints.remove(index);
+    refs.remove(index);
+    refCounts.remove(index);
+
+    if (deadPoints > points.size() / 2 || deadTexts > texts.size() / 2)
+    {
+        compact();
+    }
+}
+
+void AnnotationStore::translate(int index, const QPoint &delta)
+{
+    firstPoints[index] += delta;
+    secondPoints[index] += delta;
+    boxes[index].translate(delta);
+    if (types.at(index) == Pen)
+    {
+        QPoint *stroke = points.data() + refs.at(index);
+        for (quint32 i = 0; i < refCounts.at(index); ++i)
+        {
+            stroke[i] += delta;
+        }
+    }
+}
+
+void AnnotationStore::translateAll(const QPoint &delta)
+{
+    for (int i = 0; i < types.size(); ++i)
+    {
+        firstPoints[i] += delta;
+        secondPoints[i] += delta;
+        boxes[i].translate(delta);
+    }
+    for (QPoint &point : points)
+    {
+        point += delta;
+    }
+}
+
+int AnnotationStore::topmostAt(const QPoint &pos, Type type) const
+{
+    for (int i = types.size() - 1; i >= 0; --i)
+    {
+        if (types.at(i) == type && boxes.at(i).contains(pos))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void AnnotationStore::paint(QPainter &painter, const QRect &clip) const
+{
+    for (int i = 0; i < types.size(); ++i)
+    {
+        if (!boxes.at(i).intersects(clip))
+        {
+            continue;
+        }
+        const QColor &color = colors.at(colorIds.at(i));
+        switch (types.at(i))
+        {
+        case Arrow:
+            drawArrow(painter, firstPoints.at(i), secondPoints.at(i), color, widths.at(i));
+            break;
+        case Rectangle:
+            painter.setPen(QPen(color, widths.at(i)));
+            painter.setBrush(Qt::NoBrush);
+            painter.drawRect(QRect(firstPoints.at(i), secondPoints.at(i)));
+            break;
+        case Text:
+        {
+            // 绘制的缩放比例变了（移到不同 DPR 的屏幕、按输出比例导出）才重新准备字形位置，换行保持不变
+            const TextEntry &entry = texts.at(refs.at(i));
+            const QFont &font = fonts.at(refCounts.at(i));
+            const qreal scale = painter.worldTransform().m22() * (painter.device() ? painter.device()->devicePixelRatioF() : 1.0);
+            if (entry.preparedScale != scale)
+            {
+                entry.layout.prepare(QTransform::fromScale(scale, scale), font);
+                entry.preparedScale = scale;
+            }
+            painter.setPen(color);
+            painter.setFont(font);
+            painter.drawStaticText(firstPoints.at(i), entry.layout);
+            break;
+        }
+        case Pen:
+            painter.setPen(QPen(color, widths.at(i), Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
+            if (refCounts.at(i) == 1)
+            {
+                painter.drawPoint(points.at(refs.at(i)));
+            }
+            else
+            {
+                painter.drawPolyline(points.constData() + refs.at(i), int(refCounts.at(i)));
+            }
+            break;
+        }
+    }
+}
+
+void AnnotationStore::drawArrow(QPainter &painter, const QPoint &start, const QPoint &end, const QColor &color, int width)
+{
+    painter.setPen(QPen(color, width));
+    painter.setBrush(color);
+
+    // 绘制箭头线条
+    painter.drawLine(start, end);
+
+    // 计算箭头头部
+    const double angle = std::atan2(end.y() - start.y(), end.x() - start.x());
+    const QPointF arrowP1 = end - QPointF(ArrowHeadSize * std::cos(angle - ArrowHeadAngle),
+                                          ArrowHeadSize * std::sin(angle - ArrowHeadAngle));
+    const QPointF arrowP2 = end - QPointF(ArrowHeadSize * std::cos(angle + ArrowHeadAngle),
+                                          ArrowHeadSize * std::sin(angle + ArrowHeadAngle));
+
+    // 绘制箭头头部（实心三角形）
+    QPolygonF arrowHead;
+    arrowHead << end << arrowP1 << arrowP2;
+    painter.drawPolygon(arrowHead);
+}
+
+int AnnotationStore::append(Type type, const QPoint &first, const QPoint &second, const QColor &color, int width,
+                            quint32 ref, quint32 refCount)
+{
+    types.append(type);
+    widths.append(quint8(qBound(0, width, 255)));
+    colorIds.append(internColor(color));
+    firstPoints.append(first);
+    secondPoints.append(second);
+    refs.append(ref);
+    refCounts.append(refCount);
+    boxes.append(QRect());
+    const int index = types.size() - 1;
+    boxes[index] = computeBounds(index);
+    return index;
+}
+
+quint16 AnnotationStore::internColor(const QColor &color)
+{
+    const QRgb key = color.rgba();
+    auto it = colorIndex.constFind(key);
+    if (it != colorIndex.constEnd())
+    {
+        return it.value();
+    }
+    colors.append(color);
+    const quint16 id = quint16(colors.size() - 1);
+    colorIndex.insert(key, id);
+    return id;
+}
+
+quint16 AnnotationStore::internFont(const QFont &font)
+{
+    const QString key = font.key();
+    auto it = fontIndex.constFind(key);
+    if (it != fontIndex.constEnd())
+    {
+        return it.value();
+    }
+    fonts.append(font);
+    const quint16 id = quint16(fonts.size() - 1);
+    fontIndex.insert(key, id);
+    return id;
+}
+
+QRect AnnotationStore::computeBounds(int index) const
+{
+    const int pad = strokePadding(widths.at(index));
+    const QPoint first = firstPoints.at(index);
+    switch (types.at(index))
+    {
+    case Arrow:
+    {
+        const int head = int(std::ceil(ArrowHeadSize)) + pad;
+        return QRect(first, secondPoints.at(index)).normalized().adjusted(-head, -head, head, head);
+    }
+    case Rectangle:
+        return QRect(first, secondPoints.at(index)).normalized().adjusted(-pad, -pad, pad, pad);
+    case Text:
+        return QRectF(first, texts.at(refs.at(index)).layout.size()).toAlignedRect().adjusted(-2, -2, 2, 2);
+    case Pen:
+    {
+        const QPoint *stroke = points.constData() + refs.at(index);
+        int left = stroke[0].x(), right = left, top = stroke[0].y(), bottom = top;
+        for (quint32 i = 1; i < refCounts.at(index); ++i)
+        {
+            left = qMin(left, stroke[i].x());
+            right = qMax(right, stroke[i].x());
+            top = qMin(top, stroke[i].y());
+            bottom = qMax(bottom, stroke[i].y());
+        }
+        return QRect(QPoint(left, top), QPoint(right, bottom)).adjusted(-pad, -pad, pad, pad);
+    }
+    }
+    return QRect();
+}
+
+void AnnotationStore::layoutText(TextEntry &entry, const QFont &font)
+{
+    // QStaticText 的纯文本只把 QChar::LineSeparator 当作换行
+    QString text = entry.text;
+    text.replace(QLatin1Char('\n'), QChar::LineSeparator);
+    entry.layout = QStaticText(text);
+    entry.layout.setTextFormat(Qt::PlainText);
+    entry.layout.setPerformanceHint(QStaticText::AggressiveCaching);
+    if (entry.wrapWidth > 0)
+    {
+        entry.layout.setTextWidth(entry.wrapWidth);
+    }
+    // 先按 1 倍准备，得到包围盒；第一次绘制时再按实际比例准备
+    entry.layout.prepare(QTransform(), font);
+    entry.preparedScale = 1.0;
+}
+
+void AnnotationStore::compact()
+{
+    QVector<QPoint> livePoints;
+    livePoints.reserve(points.size() - deadPoints);
+    QVector<TextEntry> liveTexts;
+    liveTexts.reserve(texts.size() - deadTexts);
+    for (int i = 0; i < types.size(); ++i)
+    {
+        if (types.at(i) == Pen)
+        {
+            const quint32 start = quint32(livePoints.size());
+            livePoints.append(points.mid(int(refs.at(i)), int(refCounts.at(i))));
+            refs[i] = start;
+        }
+        else if (types.at(i) == Text)
+        {
+            liveTexts.append(texts.at(refs.at(i)));
+            refs[i] = quint32(liveTexts.size() - 1);
+        }
+    }
+    points = livePoints;
+    texts = liveTexts;
+    deadPoints = 0;
+    deadTexts = 0;
+}
@@ -0,0 +1,108 @@
+#ifndef ANNOTATIONSTORE_H
+#define ANNOTATIONSTORE_H
+
+#include <QColor>
+#include <QFont>
+#include <QHash>
+#include <QPoint>
+#include <QRect>
+#include <QStaticText>
+#include <QString>
+#include <QVector>
+
+class QPainter;
+
+// 截图上的标注（箭头、矩形、文字、画笔）
+// 所有类型放在同一组按列存放的数组里，每个标注占各数组中的同一个下标，
+// 下标顺序就是绘制顺序（z 序），不同类型之间的前后关系也得以保留。
+// 每个标注只占几十个字节：颜色和字体放在去重后的表中，只存编号；
+// 画笔的点都放在同一个点数组里，只存起点和点数；包围盒单独一列，
+// 命中测试和按区域裁剪时只顺序扫描这一列。
+// 文字可以有多行并按宽度自动换行，排版结果（QStaticText）随文字缓存，
+// 只在文字修改或绘制的缩放比例（屏幕 DPR、导出比例）变化时重新准备，
+// 导出时按输出比例使用同一份排版，换行位置与屏幕上完全一致。
+// 坐标都是截图遮罩的窗口逻辑坐标。标注的数据都是隐式共享的容器，复制开销很小。
+class AnnotationStore
+{
+public:
+    enum Type : quint8
+    {
+        Arrow,
+        Rectangle,
+        Text,
+        Pen
+    };
+
+    int count() const { return types.size(); }
+    bool isEmpty() const { return types.isEmpty(); }
+    void clear();
+
+    int addArrow(const QPoint &start, const QPoint &end, const QColor &color, int width);
+    int addRectangle(const QRect &rect, const QColor &color, int width);
+    // position 为文字左上角，文字按 font 的字号从这里向右下排；
+    // 可以包含换行符，wrapWidth 大于 0 时超过这个宽度自动换行
+    int addText(const QPoint &position, const QString &text, const QColor &color, const QFont &font, int wrapWidth = 0);
+    // 修改文字内容，重新排版
+    void setText(int index, const QString &text);
+    QString text(int index) const { return texts.at(refs.at(index)).text; }
+    // 开始一笔画笔，之后用 extendStroke 追加点；只有最后一个标注可以追加
+    int beginStroke(const QPoint &point, const QColor &color, int width);
+    void extendStroke(const QPoint &point);
+
+    Type type(int index) const { return Type(types.at(index)); }
+    QRect bounds(int index) const { return boxes.at(index); } // 包含线宽的包围盒
+    QColor color(int index) const { return colors.at(colorIds.at(index)); }
+
+    void remove(int index);
+    void translate(int index, const QPoint &delta);
+    void translateAll(const QPoint &delta);
+
+    // pos 处最上层的 type 类型标注，没有时返回 -1
+    int topmostAt(const QPoint &pos, Type type) const;
+
+    // 按 z 序绘制与 clip 相交的标注。painter 的变换把窗口逻辑坐标映射到目标设备，
+    // 屏幕显示和导出共用这一份代码
+    void paint(QPainter &painter, const QRect &clip) const;
+
+    static void drawArrow(QPainter &painter, const QPoint &start, const QPoint &end, const QColor &color, int width);
+
+private:
+    struct TextEntry
+    {
+        QString text;
+        int wrapWidth = 0;
+        mutable QStaticText layout;     // 排版缓存
+        mutable qreal preparedScale = 0; // layout 准备时的缩放比例，0 表示还没有准备
+    };
+
+    int append(Type type, const QPoint &first, const QPoint &second, const QColor &color, int width,
+               quint32 ref, quint32 refCount);
+    quint16 internColor(const QColor &color);
+    quint16 internFont(const QFont &font);
+    QRect computeBounds(int index) const;
+    void layoutText(TextEntry &entry, const QFont &font);
+    void compact();                     // 删除的点和文字超过一半时整理
+
+    // 每个标注一列
+    QVector<quint8> types;
+    QVector<quint8> widths;
+    QVector<quint16> colorIds;
+    QVector<QRect> boxes;
+    QVector<QPoint> firstPoints;        // 箭头起点、矩形左上角、文字位置；画笔不使用
+    QVector<QPoint> secondPoints;       // 箭头终点、矩形右下角
+    QVector<quint32> refs;              // 文字：texts 的下标；画笔：points 中的起点
+    QVector<quint32> refCounts;         // 文字：fonts 的下标；画笔：点数
+
+    // 共享的表
+    QVector<QColor> colors;
+    QHash<QRgb, quint16> colorIndex;
+    QVector<QFont> fonts;
+    QHash<QString, quint16> fontIndex;  // QFont::key()
+
+    QVector<TextEntry> texts;
+    QVector<QPoint> points;             // 所有画笔的点
+    int deadPoints = 0;
+    int deadTexts = 0;
+};
+
+#endif // ANNOTATIONSTORE_H
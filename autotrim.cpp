@@ -0,0 +1,193 @@
+#include "autotrim.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+    inline bool matches(quint32 pixel, quint32 reference, int tolerance)
+    {
+        for (int shift = 0; shift < 24; shift += 8)
+        {
+            const int a = int((pixel >> shift) & 0xff);
+            const int b = int((reference >> shift) & 0xff);
+            if (qAbs(a - b) > tolerance)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+#if defined(__SSE2__) || defined(__ARM_NEON)
+    // 4 个像素中与参考色不匹配的像素，第 i 位对应第 i 个像素
+    inline int mismatchBits(const quint32 *pixels, quint32 reference, int tolerance)
+    {
+#if defined(__SSE2__)
+        const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels));
+        const __m128i r = _mm_set1_epi32(int(reference));
+        const __m128i d = _mm_and_si128(_mm_or_si128(_mm_subs_epu8(p, r), _mm_subs_epu8(r, p)),
+                                        _mm_set1_epi32(0x00ffffff));
+        // 饱和减去容差后仍不为 0 的通道就是超出容差的通道
+        const __m128i over = _mm_subs_epu8(d, _mm_set1_epi8(char(tolerance)));
+        const __m128i same = _mm_cmpeq_epi32(over, _mm_setzero_si128());
+        return ~_mm_movemask_ps(_mm_castsi128_ps(same)) & 0xf;
+#else
+        const uint8x16_t p = vreinterpretq_u8_u32(vld1q_u32(pixels));
+        const uint8x16_t r = vreinterpretq_u8_u32(vdupq_n_u32(reference));
+        const uint8x16_t d = vandq_u8(vabdq_u8(p, r), vreinterpretq_u8_u32(vdupq_n_u32(0x00ffffff)));
+        quint32 over[4];
+        vst1q_u32(over, vreinterpretq_u32_u8(vcgtq_u8(d, vdupq_n_u8(uint8_t(tolerance)))));
+        return (over[0] ? 1 : 0) | (over[1] ? 2 : 0) | (over[2] ? 4 : 0) | (over[3] ? 8 : 0);
+#endif
+    }
+#endif
+
+    // pixels[0, count) 中第一个不匹配的位置，全部匹配时返回 count
+    int firstMismatch(const quint32 *pixels, int count, quint32 reference, int tolerance)
+    {
+        int x = 0;
+#if defined(__SSE2__) || defined(__ARM_NEON)
+        for (; x + 4 <= count; x += 4)
+        {
+            const int bits = mismatchBits(pixels + x, reference, tolerance);
+            if (bits)
+            {
+                int i = 0;
+                while (!(bits & (1 << i)))
+                {
+                    ++i;
+                }
+                return x + i;
+            }
+        }
+#endif
+        for (; x < count; ++x)
+        {
+            if (!matches(pixels[x], reference, tolerance))
+            {
+                return x;
+            }
+        }
+        return count;
+    }
+
+    // pixels[0, count) 中最后一个不匹配的位置，全部匹配时返回 -1
+    int lastMismatch(const quint32 *pixels, int count, quint32 reference, int tolerance)
+    {
+        int x = count;
+#if defined(__SSE2__) || defined(__ARM_NEON)
+        for (; x >= 4; x -= 4)
+        {
+            const int bits = mismatchBits(pixels + x - 4, reference, tolerance);
+            if (bits)
+            {
+                int i = 3;
+                while (!(bits & (1 << i)))
+                {
+                    --i;
+                }
+                return x - 4 + i;
+            }
+        }
+#endif
+        for (; x > 0; --x)
+        {
+            if (!matches(pixels[x - 1], reference, tolerance))
+            {
+                return x - 1;
+            }
+        }
+        return -1;
+    }
+}
+
+namespace AutoTrim
+{
+
+QRect contentRect(const QImage &source, int tolerance)
+{
+    if (source.isNull())
+    {
+        return QRect();
+    }
+
+    // 截图合成的结果本来就是 32 位格式，只有其他格式才需要转换
+    QImage image = source;
+    if (image.format() != QImage::Format_RGB32 && image.format() != QImage::Format_ARGB32 &&
+        image.format() != QImage::Format_ARGB32_Premultiplied)
+    {
+        image = source.convertToFormat(QImage::Format_RGB32);
+    }
+    tolerance = qBound(0, tolerance, 255);
+
+    const int width = image.width();
+    const int height = image.height();
+    auto row = [&image](int y)
+    {
+        return reinterpret_cast<const quint32 *>(image.constScanLine(y));
+    };
+
+    // 每条边的参考色取自原图这条边的中点，不取角上的像素：
+    // 角同时属于两条边，两边边框颜色不同时取角会让其中一条边整行都不匹配
+    const quint32 topColor = row(0)[width / 2];
+    const quint32 bottomColor = row(height - 1)[width / 2];
+    const quint32 leftColor = row(height / 2)[0];
+    const quint32 rightColor = row(height / 2)[width - 1];
+
+    // 上下两边：整行都匹配才裁掉，遇到不匹配的像素立即停止
+    int top = 0;
+    while (top < height && firstMismatch(row(top), width, topColor, tolerance) == width)
+    {
+        ++top;
+    }
+    if (top == height)
+    {
+        return image.rect();
+    }
+
+    int bottom = height - 1;
+    while (bottom > top && firstMismatch(row(bottom), width, bottomColor, tolerance) == width)
+    {
+        --bottom;
+    }
+
+    // 左右两边：逐行只扫到当前已知的边界，已经确定是内容的列不再检查
+    int left = width;
+    for (int y = top; y <= bottom && left > 0; ++y)
+    {
+        left = firstMismatch(row(y), left, leftColor, tolerance);
+    }
+    if (left == width)
+    {
+        // 剩下的行整行都是左边的颜色，没有内容
+        return image.rect();
+    }
+
+    int right = left;
+    for (int y = top; y <= bottom && right < width - 1; ++y)
+    {
+        const int last = lastMismatch(row(y) + right + 1, width - right - 1, rightColor, tolerance);
+        if (last >= 0)
+        {
+            right += 1 + last;
+        }
+    }
+
+    return QRect(QPoint(left, top), QPoint(right, bottom));
+}
+
+QImage trim(const QImage &image, int tolerance)
+{
+    const QRect content = contentRect(image, tolerance);
+    if (content.isEmpty() || content == image.rect())
+    {
+        return image;
+    }
+    return image.copy(content);
+}
+
+}
@@ -0,0 +1,20 @@
+#ifndef AUTOTRIM_H
+#define AUTOTRIM_H
+
+#include <QImage>
+#include <QRect>
+
+// 导出前裁掉截图四周的纯色边框
+// 从四条边分别向内扫描，每条边以它中点的像素为参考色，所有颜色通道与参考色之差
+// 都不超过 tolerance 的行/列视为边框。左右两边逐行扫描时只扫到当前已知的边界为止，
+// 总开销与裁掉的面积成正比，而不是整张图。比较时 SSE2/NEON 一次处理 4 个像素。
+namespace AutoTrim
+{
+    // 去掉边框后的内容区域；找不到与边框颜色不同的内容时返回整张图
+    QRect contentRect(const QImage &image, int tolerance);
+
+    // 裁掉边框，没有边框时直接返回原图（不复制）
+    QImage trim(const QImage &image, int tolerance);
+}
+
+#endif // AUTOTRIM_H
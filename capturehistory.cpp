@@ -0,0 +1,402 @@
+#include "capturehistory.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QStandardPaths>
+#include <QDebug>
+#include <cstring>
+
+namespace
+{
+    // 索引文件格式：16 字节文件头，后面是定长记录，只在末尾追加。
+    // 记录定长，第 i 条记录的位置可以直接算出来；文件末尾预留全 0 的空间给之后的记录
+    struct IndexHeader
+    {
+        char magic[4];
+        quint32 version;
+        quint32 recordSize;
+        quint32 thumbnailSize;
+    };
+
+    struct IndexRecord
+    {
+        qint64 timestamp; // 毫秒，Unix 纪元起
+        quint32 width;
+        quint32 height;
+        quint16 thumbWidth;
+        quint16 thumbHeight;
+        quint16 pathLength;
+        quint16 reserved;
+        char path[CaptureHistory::PathCapacity];
+        quint16 thumbnail[CaptureHistory::ThumbnailSize * CaptureHistory::ThumbnailSize]; // RGB565，逐行紧密排列
+    };
+
+    static_assert(sizeof(IndexHeader) == 16, "index header must stay 16 bytes");
+    static_assert(sizeof(IndexRecord) == 5120, "index record layout changed");
+
+    // .hash 文件中的条目。哈希单独存放，启动时整体读入只需几 MB，
+    // 不必为了取哈希访问每一条带缩略图的记录
+    struct HashRecord
+    {
+        quint64 hash;
+        qint32 index;
+        quint32 reserved;
+    };
+
+    static_assert(sizeof(HashRecord) == 16, "hash record layout changed");
+
+    const char Magic[4] = {'S', 'S', 'H', 'I'};
+    const quint32 Version = 1;
+
+    // 索引文件预留的最少记录数，之后每次不够时容量翻倍
+    const int InitialCapacity = 64;
+}
+
+CaptureHistory::CaptureHistory(QObject *parent)
+    : QObject(parent),
+      mapped(nullptr),
+      mappedSize(0),
+      records(0)
+{
+    worker.setMaxThreadCount(1);
+}
+
+CaptureHistory::~CaptureHistory()
+{
+    worker.waitForDone();
+}
+
+QString CaptureHistory::defaultIndexPath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/history.idx";
+}
+
+bool CaptureHistory::open(const QString &indexPath)
+{
+    QMutexLocker locker(&mutex);
+
+    QDir().mkpath(QFileInfo(indexPath).absolutePath());
+    file.setFileName(indexPath);
+    if (!file.open(QIODevice::ReadWrite))
+    {
+        qWarning() << "CaptureHistory: cannot open" << indexPath << file.errorString();
+        return false;
+    }
+
+    if (file.size() < qint64(sizeof(IndexHeader)))
+    {
+        IndexHeader header;
+        std::memcpy(header.magic, Magic, sizeof(Magic));
+        header.version = Version;
+        header.recordSize = sizeof(IndexRecord);
+        header.thumbnailSize = ThumbnailSize;
+        file.resize(0);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.flush();
+    }
+    else
+    {
+        IndexHeader header;
+        file.seek(0);
+        file.read(reinterpret_cast<char *>(&header), sizeof(header));
+        if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version ||
+            header.recordSize != sizeof(IndexRecord) || header.thumbnailSize != quint32(ThumbnailSize))
+        {
+            qWarning() << "CaptureHistory: unsupported index file" << indexPath;
+            file.close();
+            return false;
+        }
+
+        // 上次追加到一半时退出，丢掉末尾不完整的记录
+        const qint64 complete = (file.size() - qint64(sizeof(IndexHeader))) / qint64(sizeof(IndexRecord));
+        file.resize(qint64(sizeof(IndexHeader)) + complete * qint64(sizeof(IndexRecord)));
+    }
+
+    if (!remap(qMax(file.size(), qint64(sizeof(IndexHeader)) + qint64(InitialCapacity) * qint64(sizeof(IndexRecord)))))
+    {
+        return false;
+    }
+    records = countRecords();
+
+    const QFileInfo info(indexPath);
+    hashFile.setFileName(info.absolutePath() + "/" + info.completeBaseName() + ".hash");
+    if (!hashFile.open(QIODevice::ReadWrite))
+    {
+        // 没有哈希文件只影响查重，历史记录照常使用
+        qWarning() << "CaptureHistory: cannot open" << hashFile.fileName() << hashFile.errorString();
+        return true;
+    }
+    loadHashes();
+    return true;
+}
+
+void CaptureHistory::loadHashes()
+{
+    const QByteArray data = hashFile.readAll();
+    const int entries = int(data.size() / qsizetype(sizeof(HashRecord)));
+    const HashRecord *hashes = reinterpret_cast<const HashRecord *>(data.constData());
+    hashIndex.clear();
+    for (int i = 0; i < entries; ++i)
+    {
+        if (hashes[i].index >= 0 && hashes[i].index < records)
+        {
+            hashIndex.insert(hashes[i].hash, hashes[i].index);
+        }
+    }
+    // 丢掉末尾不完整的条目
+    hashFile.resize(qint64(entries) * qint64(sizeof(HashRecord)));
+}
+
+bool CaptureHistory::remap(qint64 size)
+{
+    if (mapped)
+    {
+        file.unmap(mapped);
+        mapped = nullptr;
+        mappedSize = 0;
+    }
+
+    // 文件预先扩展到映射的大小，未使用的部分全是 0，追加记录时不必每次重新映射
+    if (file.size() < size && !file.resize(size))
+    {
+        qWarning() << "CaptureHistory: cannot grow index file" << file.errorString();
+        records = 0;
+        return false;
+    }
+    mapped = file.map(0, size);
+    if (!mapped)
+    {
+        qWarning() << "CaptureHistory: cannot map index file" << file.errorString();
+        records = 0;
+        return false;
+    }
+    mappedSize = size;
+    return true;
+}
+
+int CaptureHistory::countRecords() const
+{
+    // 记录只在末尾追加且时间戳不为 0，预留的空间全是 0，
+    // 已用的记录是开头连续的一段，二分查找第一个时间戳为 0 的位置
+    int low = 0;
+    int high = int((mappedSize - qint64(sizeof(IndexHeader))) / qint64(sizeof(IndexRecord)));
+    while (low < high)
+    {
+        const int middle = low + (high - low) / 2;
+        qint64 timestamp;
+        std::memcpy(&timestamp, record(middle), sizeof(timestamp));
+        if (timestamp != 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+const uchar *CaptureHistory::record(int index) const
+{
+    return mapped + sizeof(IndexHeader) + size_t(index) * sizeof(IndexRecord);
+}
+
+void CaptureHistory::add(const QString &fileName, const QImage &image)
+{
+    if (fileName.isEmpty())
+    {
+        return;
+    }
+
+    worker.start([this, fileName, image]()
+                 {
+        QSize size = image.size();
+        QImage thumbnail;
+        if (!image.isNull())
+        {
+            thumbnail = image.scaled(ThumbnailSize, ThumbnailSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        }
+        else
+        {
+            // 只解码到缩略图尺寸，支持的格式（JPEG 等）可以在解码时直接缩小
+            QImageReader reader(fileName);
+            size = reader.size();
+            if (size.isValid())
+            {
+                reader.setScaledSize(size.scaled(ThumbnailSize, ThumbnailSize, Qt::KeepAspectRatio).expandedTo(QSize(1, 1)));
+                thumbnail = reader.read();
+            }
+        }
+
+        const int index = append(fileName, thumbnail, size);
+        if (index < 0)
+        {
+            return;
+        }
+        // 录屏导出的 GIF 只有缩略图尺寸的第一帧，不参与查重
+        if (!image.isNull())
+        {
+            appendHash(takeHash(image), index);
+        }
+        emit entryAdded(index); });
+}
+
+quint64 CaptureHistory::imageHash(const QImage &image)
+{
+    const quint64 hash = PerceptualHash::dHash(image);
+    QMutexLocker locker(&mutex);
+    // 保存失败时不会有对应的 add()，只留最近几张
+    if (knownHashes.size() >= 8)
+    {
+        knownHashes.clear();
+    }
+    knownHashes.insert(image.cacheKey(), hash);
+    return hash;
+}
+
+quint64 CaptureHistory::takeHash(const QImage &image)
+{
+    {
+        QMutexLocker locker(&mutex);
+        const auto known = knownHashes.constFind(image.cacheKey());
+        if (known != knownHashes.constEnd())
+        {
+            const quint64 hash = known.value();
+            knownHashes.erase(known);
+            return hash;
+        }
+    }
+    return PerceptualHash::dHash(image);
+}
+
+void CaptureHistory::waitForPending()
+{
+    worker.waitForDone();
+}
+
+int CaptureHistory::append(const QString &fileName, const QImage &thumbnail, const QSize &size)
+{
+    const QByteArray path = QFileInfo(fileName).absoluteFilePath().toUtf8();
+    if (path.size() > PathCapacity)
+    {
+        qWarning() << "CaptureHistory: path too long for the index, skipped" << fileName;
+        return -1;
+    }
+
+    IndexRecord data;
+    std::memset(&data, 0, sizeof(data));
+    data.timestamp = QDateTime::currentMSecsSinceEpoch();
+    data.width = quint32(qMax(0, size.width()));
+    data.height = quint32(qMax(0, size.height()));
+    data.pathLength = quint16(path.size());
+    std::memcpy(data.path, path.constData(), size_t(path.size()));
+
+    if (!thumbnail.isNull())
+    {
+        const QImage packed = thumbnail.convertToFormat(QImage::Format_RGB16);
+        data.thumbWidth = quint16(qMin(packed.width(), int(ThumbnailSize)));
+        data.thumbHeight = quint16(qMin(packed.height(), int(ThumbnailSize)));
+        for (int y = 0; y < data.thumbHeight; ++y)
+        {
+            std::memcpy(data.thumbnail + y * data.thumbWidth, packed.constScanLine(y),
+                        size_t(data.thumbWidth) * sizeof(quint16));
+        }
+    }
+
+    QMutexLocker locker(&mutex);
+    if (!file.isOpen())
+    {
+        return -1;
+    }
+    const qint64 offset = qint64(sizeof(IndexHeader)) + qint64(records) * qint64(sizeof(IndexRecord));
+    if (offset + qint64(sizeof(IndexRecord)) > mappedSize && !remap(qMax(offset + qint64(sizeof(IndexRecord)), mappedSize * 2)))
+    {
+        return -1;
+    }
+    file.seek(offset);
+    if (file.write(reinterpret_cast<const char *>(&data), sizeof(data)) != qint64(sizeof(data)) || !file.flush())
+    {
+        qWarning() << "CaptureHistory: cannot append to index file" << file.errorString();
+        return -1;
+    }
+    return records++;
+}
+
+void CaptureHistory::appendHash(quint64 hash, int index)
+{
+    HashRecord data;
+    data.hash = hash;
+    data.index = index;
+    data.reserved = 0;
+
+    QMutexLocker locker(&mutex);
+    if (!hashFile.isOpen())
+    {
+        return;
+    }
+    hashFile.seek(hashFile.size());
+    if (hashFile.write(reinterpret_cast<const char *>(&data), sizeof(data)) == qint64(sizeof(data)))
+    {
+        hashFile.flush();
+        hashIndex.insert(hash, index);
+    }
+}
+
+QStringList CaptureHistory::findSimilar(quint64 hash, int maxDistance) const
+{
+    QMutexLocker locker(&mutex);
+    QStringList paths;
+    for (int index : hashIndex.find(hash, maxDistance))
+    {
+        const IndexRecord *r = reinterpret_cast<const IndexRecord *>(record(index));
+        paths.append(QString::fromUtf8(r->path, qMin(int(r->pathLength), int(PathCapacity))));
+    }
+    return paths;
+}
+
+int CaptureHistory::count() const
+{
+    QMutexLocker locker(&mutex);
+    return records;
+}
+
+CaptureHistory::Entry CaptureHistory::entry(int index) const
+{
+    QMutexLocker locker(&mutex);
+    Entry result;
+    if (index < 0 || index >= records)
+    {
+        return result;
+    }
+
+    const IndexRecord *r = reinterpret_cast<const IndexRecord *>(record(index));
+    result.path = QString::fromUtf8(r->path, qMin(int(r->pathLength), int(PathCapacity)));
+    result.time = QDateTime::fromMSecsSinceEpoch(r->timestamp);
+    result.size = QSize(int(r->width), int(r->height));
+    return result;
+}
+
+QImage CaptureHistory::thumbnail(int index) const
+{
+    QMutexLocker locker(&mutex);
+    if (index < 0 || index >= records)
+    {
+        return QImage();
+    }
+
+    const IndexRecord *r = reinterpret_cast<const IndexRecord *>(record(index));
+    const int width = qMin(int(r->thumbWidth), int(ThumbnailSize));
+    const int height = qMin(int(r->thumbHeight), int(ThumbnailSize));
+    if (width == 0 || height == 0)
+    {
+        return QImage();
+    }
+
+    QImage image(width, height, QImage::Format_RGB16);
+    for (int y = 0; y < height; ++y)
+    {
+        std::memcpy(image.scanLine(y), r->thumbnail + y * width, size_t(width) * sizeof(quint16));
+    }
+    return image;
+}
@@ -0,0 +1,88 @@
+#ifndef CAPTUREHISTORY_H
+#define CAPTUREHISTORY_H
+
+#include <QObject>
+#include <QImage>
+#include <QDateTime>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QThreadPool>
+#include <QStringList>
+#include "perceptualhash.h"
+
+// 截图历史索引
+// 每次保存截图都向索引文件末尾追加一条定长记录：路径、时间、尺寸和一张打包的
+// RGB565 小缩略图。索引文件映射到内存，浏览历史时按下标直接读取记录，
+// 不解码任何图片，也不扫描目录。缩略图在后台线程中生成后再追加记录。
+// 映射的大小按倍数增长，追加记录通常不需要重新映射。
+// 截图的感知哈希另存在同名的 .hash 文件中，启动时载入多索引表，用于查找近似重复的截图。
+class CaptureHistory : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int ThumbnailSize = 48;  // 缩略图最长边（像素）
+    static const int PathCapacity = 488;  // 路径 UTF-8 编码后的最大字节数
+
+    struct Entry
+    {
+        QString path;
+        QDateTime time;
+        QSize size;
+    };
+
+    explicit CaptureHistory(QObject *parent = nullptr);
+    ~CaptureHistory();
+
+    // 默认的索引文件位置
+    static QString defaultIndexPath();
+
+    // 打开（不存在时创建）索引文件并映射到内存
+    bool open(const QString &indexPath = defaultIndexPath());
+
+    // 在后台线程中生成缩略图并追加一条记录，完成后发出 entryAdded。
+    // image 为空时从文件中按缩略图尺寸解码（例如 GIF 动画的第一帧）
+    void add(const QString &fileName, const QImage &image = QImage());
+
+    // 计算 image 的感知哈希并记住，随后对同一图像（同一 cacheKey）调用 add() 时不再重新计算
+    quint64 imageHash(const QImage &image);
+
+    // 等待所有后台追加完成
+    void waitForPending();
+
+    int count() const;
+    Entry entry(int index) const;
+    QImage thumbnail(int index) const; // 没有缩略图时返回空图
+
+    // 与 hash 的汉明距离不超过 maxDistance 的历史截图路径，从近到远、同距离时新的在前。
+    // 只查索引，不检查文件是否还存在
+    QStringList findSimilar(quint64 hash, int maxDistance) const;
+
+signals:
+    // 在后台线程中发出，连接到 GUI 线程的对象时自动排队
+    void entryAdded(int index);
+
+private:
+    // 追加一条记录，返回它的下标，失败时返回 -1
+    int append(const QString &fileName, const QImage &thumbnail, const QSize &size);
+    void appendHash(quint64 hash, int index);
+    quint64 takeHash(const QImage &image);
+    void loadHashes();
+    // 把索引文件扩展到至少 size 字节并重新映射
+    bool remap(qint64 size);
+    int countRecords() const;
+    const uchar *record(int index) const;
+
+    mutable QMutex mutex;
+    QFile file;
+    uchar *mapped;
+    qint64 mappedSize;
+    int records;
+    QFile hashFile;                 // (哈希, 记录下标) 定长条目，只在末尾追加
+    PerceptualHashIndex hashIndex;
+    QHash<qint64, quint64> knownHashes; // QImage::cacheKey() -> 已算好、等待 add() 的哈希
+    QThreadPool worker; // 只有一个线程，保证记录按保存顺序追加
+};
+
+#endif // CAPTUREHISTORY_H
@@ -0,0 +1,443 @@
+#include "captureserver.h"
+#include "pixelformat.h"
+#include "x11capture.h"
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QCoreApplication>
+#include <QGuiApplication>
+#include <QScreen>
+#include <QPixmap>
+#include <QImage>
+#include <QSettings>
+#include <QRandomGenerator>
+#include <QDir>
+#include <QFileInfo>
+#include <QDebug>
+
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <cerrno>
+#endif
+
+namespace
+{
+    // 每行字节数按 64 字节对齐，客户端用 SIMD 处理时每行起点都是对齐的
+    const int RowAlignment = 64;
+    // 一行命令的最大长度，超出时认为客户端出错并断开
+    const int MaxLineLength = 256;
+
+    QByteArray errorReply(const char *message)
+    {
+        return QByteArray("error ") + message + '\n';
+    }
+
+#ifdef Q_OS_UNIX
+    // 新建一块只有当前用户能读写的共享内存，返回描述符，name 中返回它的名字。
+    // 名字带随机后缀并用 O_EXCL 创建：其他用户无法预先创建同名对象，让截图写进他们能读取的内存
+    int createSharedMemory(QString &name)
+    {
+        for (int attempt = 0; attempt < 16; ++attempt)
+        {
+            name = QString("/screensniper-%1-%2")
+                       .arg(QCoreApplication::applicationPid())
+                       .arg(QRandomGenerator::system()->generate(), 8, 16, QChar('0'));
+            const QByteArray path = name.toLocal8Bit();
+            const int fd = shm_open(path.constData(), O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+            if (fd < 0)
+            {
+                if (errno == EEXIST)
+                {
+                    continue;
+                }
+                return -1;
+            }
+
+            struct stat info;
+            if (fstat(fd, &info) != 0 || info.st_uid != geteuid() || (info.st_mode & 0077) != 0)
+            {
+                qWarning() << "Shared memory" << name << "has unexpected owner or permissions";
+                ::close(fd);
+                shm_unlink(path.constData());
+                return -1;
+            }
+            return fd;
+        }
+        return -1;
+    }
+
+    // 删除异常退出的进程没来得及 shm_unlink 的共享内存。名字中带创建者的进程号，
+    // 只删除当前用户的、创建者已经不在运行的对象
+    void removeStaleSharedMemory()
+    {
+        const QFileInfoList entries = QDir("/dev/shm").entryInfoList({"screensniper-*"}, QDir::Files | QDir::System);
+        for (const QFileInfo &entry : entries)
+        {
+            bool ok = false;
+            const qint64 pid = entry.fileName().section('-', 1, 1).toLongLong(&ok);
+            if (!ok || entry.ownerId() != geteuid() || pid == QCoreApplication::applicationPid())
+            {
+                continue;
+            }
+            if (kill(pid_t(pid), 0) != 0 && errno == ESRCH)
+            {
+                shm_unlink(("/" + entry.fileName()).toLocal8Bit().constData());
+            }
+        }
+    }
+#endif
+}
+
+CaptureServer::CaptureServer(QObject *parent)
+    : QObject(parent),
+      server(new QLocalServer(this)),
+      display(X11Capture::openDisplay()),
+      maxFrames(qMax(1, QSettings().value("captureServer/maxFrames", 8).toInt())),
+      nextId(1)
+{
+    connect(server, &QLocalServer::newConnection, this, &CaptureServer::onNewConnection);
+}
+
+CaptureServer::~CaptureServer()
+{
+    server->close();
+    for (Frame &frame : frames)
+    {
+        unmapFrame(frame);
+    }
+    X11Capture::closeDisplay(display);
+}
+
+bool CaptureServer::listen(const QString &name)
+{
+#ifdef Q_OS_UNIX
+    const QString serverName = name.isEmpty()
+                                   ? QSettings().value("captureServer/name", "screensniper-capture").toString()
+                                   : name;
+    // 只允许当前用户连接，截图内容不应被其他用户读取
+    server->setSocketOptions(QLocalServer::UserAccessOption);
+    // 上次异常退出时留下的套接字文件会导致监听失败，留下的共享内存会一直占用内存
+    QLocalServer::removeServer(serverName);
+    removeStaleSharedMemory();
+    if (!server->listen(serverName))
+    {
+        qWarning() << "Capture server cannot listen on" << serverName << ":" << server->errorString();
+        return false;
+    }
+    qDebug() << "Capture server listening on" << server->fullServerName();
+    return true;
+#else
+    Q_UNUSED(name);
+    qWarning() << "Capture server is only available on Unix";
+    return false;
+#endif
+}
+
+void CaptureServer::onNewConnection()
+{
+    while (QLocalSocket *socket = server->nextPendingConnection())
+    {
+        connect(socket, &QLocalSocket::readyRead, this, &CaptureServer::onReadyRead);
+        connect(socket, &QLocalSocket::disconnected, this, &CaptureServer::onDisconnected);
+    }
+}
+
+void CaptureServer::onReadyRead()
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket *>(sender());
+    if (!socket)
+    {
+        return;
+    }
+
+    while (socket->canReadLine())
+    {
+        const QList<QByteArray> arguments = socket->readLine().simplified().split(' ');
+        const QByteArray command = arguments.value(0);
+        QByteArray reply;
+        if (command == "capture")
+        {
+            reply = capture(socket, arguments);
+        }
+        else if (command == "release")
+        {
+            reply = release(socket, arguments);
+        }
+        else
+        {
+            reply = errorReply("unknown command");
+        }
+        socket->write(reply);
+    }
+
+    if (socket->bytesAvailable() > MaxLineLength)
+    {
+        qWarning() << "Capture client sent an overlong command, disconnecting";
+        socket->disconnectFromServer();
+    }
+}
+
+void CaptureServer::onDisconnected()
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket *>(sender());
+    if (!socket)
+    {
+        return;
+    }
+    releaseFrames(socket);
+    socket->deleteLater();
+}
+
+QByteArray CaptureServer::capture(QLocalSocket *socket, const QList<QByteArray> &arguments)
+{
+    // 屏幕可能在两次请求之间插拔或改变缩放，每次重新读取几何信息（不截图，开销很小）
+    screens.describeScreens();
+    const QRect bounds = screens.logicalBounds();
+
+    QRect logicalRect = bounds;
+    if (arguments.size() == 5)
+    {
+        bool ok[4];
+        logicalRect = QRect(arguments[1].toInt(&ok[0]), arguments[2].toInt(&ok[1]),
+                            arguments[3].toInt(&ok[2]), arguments[4].toInt(&ok[3]));
+        if (!ok[0] || !ok[1] || !ok[2] || !ok[3])
+        {
+            return errorReply("invalid rectangle");
+        }
+        logicalRect = logicalRect.intersected(bounds);
+    }
+    else if (arguments.size() != 1)
+    {
+        return errorReply("usage: capture [x y w h]");
+    }
+    if (logicalRect.isEmpty())
+    {
+        return errorReply("rectangle is outside every screen");
+    }
+
+    // 整个桌面直接截取根窗口，物理尺寸不受各屏幕缩放比例不同的影响
+    QRect physicalRect = logicalRect == bounds && display ? X11Capture::rootGeometry(display)
+                                                          : screens.toNative(logicalRect);
+    if (display)
+    {
+        physicalRect = physicalRect.intersected(X11Capture::rootGeometry(display));
+    }
+    if (physicalRect.isEmpty())
+    {
+        return errorReply("rectangle is outside the root window");
+    }
+    const int screenIndex = screens.screenFor(logicalRect);
+    if (screenIndex < 0)
+    {
+        return errorReply("rectangle is outside every screen");
+    }
+    const qreal dpr = logicalRect == bounds ? screens.maxScale(logicalRect) : screens.screens().at(screenIndex).scale;
+
+    const int stride = (physicalRect.width() * 4 + RowAlignment - 1) / RowAlignment * RowAlignment;
+    const int index = acquireFrame(qint64(stride) * physicalRect.height(), socket);
+    if (index < 0)
+    {
+        return errorReply("all frames are in use");
+    }
+
+    Frame &frame = frames[index];
+    if (!grabInto(frame, physicalRect, logicalRect, stride))
+    {
+        frame.id = 0;
+        frame.owner = nullptr;
+        return errorReply("grab failed");
+    }
+
+    return QString("frame %1 %2 %3 %4 %5 RGB32 %6\n")
+        .arg(frame.id)
+        .arg(frame.name)
+        .arg(physicalRect.width())
+        .arg(physicalRect.height())
+        .arg(stride)
+        .arg(dpr)
+        .toUtf8();
+}
+
+QByteArray CaptureServer::release(QLocalSocket *socket, const QList<QByteArray> &arguments)
+{
+    bool ok = false;
+    const quint32 id = arguments.value(1).toUInt(&ok);
+    if (arguments.size() != 2 || !ok || id == 0)
+    {
+        return errorReply("usage: release <id>");
+    }
+    for (Frame &frame : frames)
+    {
+        if (frame.id == id && frame.owner == socket)
+        {
+            frame.id = 0;
+            frame.owner = nullptr;
+            return "ok\n";
+        }
+    }
+    return errorReply("unknown frame");
+}
+
+bool CaptureServer::grabInto(Frame &frame, const QRect &physicalRect, const QRect &logicalRect, int stride)
+{
+    // 用 QImage 包装共享内存，截图直接写进去，不经过中间图像
+    QImage target(frame.data, physicalRect.width(), physicalRect.height(), stride, QImage::Format_RGB32);
+    if (display)
+    {
+        // 每行没有对齐填充时（常见的屏幕宽度都是 16 的倍数）由 X 服务器通过 MIT-SHM 直接写进共享内存，
+        // 否则取回像素后逐行拷贝
+        if (frame.segment && X11Capture::grabRootRectToSharedMemory(display, physicalRect, frame.segment, stride))
+        {
+            return true;
+        }
+        return X11Capture::grabRootRectInto(display, physicalRect, target);
+    }
+
+    // 没有 X11 时由平台截图，再逐行转换进共享内存（平台接口只能返回新分配的图像）
+    const int index = screens.screenFor(logicalRect);
+    QScreen *screen = index >= 0 ? screens.screens().at(index).screen : nullptr;
+    if (!screen)
+    {
+        return false;
+    }
+    const QRect local = logicalRect.translated(-screen->geometry().topLeft());
+    QImage grabbed = screen->grabWindow(0, local.x(), local.y(), local.width(), local.height()).toImage();
+    if (grabbed.isNull())
+    {
+        return false;
+    }
+    if (!PixelFormat::convertInto<PixelFormat::Rgb32>(grabbed, grabbed.rect(), target))
+    {
+        grabbed = grabbed.convertToFormat(QImage::Format_RGB32);
+        PixelFormat::convertInto<PixelFormat::Rgb32>(grabbed, grabbed.rect(), target);
+    }
+    return true;
+}
+
+int CaptureServer::acquireFrame(qint64 bytes, QLocalSocket *owner)
+{
+    // 优先用已经够大的空闲块中最小的一块；都不够大时扩大一块空闲的；没有空闲的才新建
+    int best = -1;
+    int anyFree = -1;
+    for (int i = 0; i < frames.size(); ++i)
+    {
+        if (frames[i].id != 0)
+        {
+            continue;
+        }
+        anyFree = i;
+        if (frames[i].capacity >= bytes && (best < 0 || frames[i].capacity < frames[best].capacity))
+        {
+            best = i;
+        }
+    }
+
+    if (best < 0)
+    {
+        if (anyFree >= 0)
+        {
+            best = anyFree;
+        }
+        else if (frames.size() < maxFrames)
+        {
+            frames.append(Frame());
+            best = frames.size() - 1;
+        }
+        else
+        {
+            return -1;
+        }
+        if (!mapFrame(frames[best], bytes))
+        {
+            return -1;
+        }
+    }
+
+    frames[best].id = nextId++;
+    if (nextId == 0)
+    {
+        nextId = 1;
+    }
+    frames[best].owner = owner;
+    return best;
+}
+
+void CaptureServer::releaseFrames(QLocalSocket *owner)
+{
+    for (Frame &frame : frames)
+    {
+        if (frame.owner == owner)
+        {
+            frame.id = 0;
+            frame.owner = nullptr;
+        }
+    }
+}
+
+bool CaptureServer::mapFrame(Frame &frame, qint64 bytes)
+{
+#ifdef Q_OS_UNIX
+    // 扩大时按 1.5 倍预留，窗口大小略有变化的连续请求不会每次都重新映射
+    const qint64 capacity = qMax(bytes, frame.capacity * 3 / 2);
+    // X 服务器按附加时的大小映射，扩大后要重新附加
+    X11Capture::detachSharedMemory(display, frame.segment);
+    frame.segment = 0;
+    if (frame.data)
+    {
+        munmap(frame.data, size_t(frame.capacity));
+        frame.data = nullptr;
+        frame.capacity = 0;
+    }
+    if (frame.fd < 0)
+    {
+        frame.fd = createSharedMemory(frame.name);
+        if (frame.fd < 0)
+        {
+            qWarning() << "Cannot create shared memory for the capture server";
+            return false;
+        }
+    }
+    if (ftruncate(frame.fd, off_t(capacity)) != 0)
+    {
+        qWarning() << "ftruncate failed for" << frame.name << capacity;
+        return false;
+    }
+    void *data = mmap(nullptr, size_t(capacity), PROT_READ | PROT_WRITE, MAP_SHARED, frame.fd, 0);
+    if (data == MAP_FAILED)
+    {
+        qWarning() << "mmap failed for" << frame.name << capacity;
+        return false;
+    }
+    frame.data = static_cast<uchar *>(data);
+    frame.capacity = capacity;
+    frame.segment = X11Capture::attachSharedMemory(display, frame.fd);
+    return true;
+#else
+    Q_UNUSED(frame);
+    Q_UNUSED(bytes);
+    return false;
+#endif
+}
+
+void CaptureServer::unmapFrame(Frame &frame)
+{
+#ifdef Q_OS_UNIX
+    X11Capture::detachSharedMemory(display, frame.segment);
+    if (frame.data)
+    {
+        munmap(frame.data, size_t(frame.capacity));
+    }
+    if (frame.fd >= 0)
+    {
+        ::close(frame.fd);
+        shm_unlink(frame.name.toLocal8Bit().constData());
+    }
+#endif
+    frame.data = nullptr;
+    frame.fd = -1;
+    frame.capacity = 0;
+    frame.segment = 0;
+}
@@ -0,0 +1,76 @@
+#ifndef CAPTURESERVER_H
+#define CAPTURESERVER_H
+
+#include <QObject>
+#include <QRect>
+#include <QString>
+#include <QVector>
+#include "screenmapper.h"
+
+class QLocalServer;
+class QLocalSocket;
+typedef struct _XDisplay Display;
+
+// 本地截图服务，供测试脚本等自动化客户端直接取原始像素
+// 通过 QLocalServer 接收按行分隔的文本命令，截图直接写入 POSIX 共享内存
+// （X11 下有 MIT-SHM 时由 X 服务器直接写入，不经过本进程），
+// 回复共享内存的名字和图像格式，不编码、不经过套接字传输像素：
+//   capture               截取整个虚拟桌面
+//   capture x y w h       截取逻辑坐标区域（Qt 虚拟桌面坐标）
+//     -> frame <帧号> <共享内存名> <宽> <高> <每行字节数> RGB32 <DPR>
+//   release <帧号>        用完后归还，该共享内存随后被下一次截图复用
+//     -> ok
+// 出错时回复 error <原因>。像素为 QImage::Format_RGB32（小端内存顺序 B G R X），尺寸为物理像素。
+// 共享内存按名字放在一个池里反复使用，客户端可以按名字缓存映射，只在
+// 每行字节数 × 高 超过已映射的长度时重新映射。连接断开时它借走的帧自动归还。
+// 共享内存的名字带随机后缀，以 O_EXCL 创建，权限为 0600；启动时删除已退出的进程留下的共享内存。
+// 目前只在 Unix 下可用。
+class CaptureServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CaptureServer(QObject *parent = nullptr);
+    ~CaptureServer();
+
+    // 开始监听，name 为空时使用设置项 captureServer/name（默认 screensniper-capture）
+    bool listen(const QString &name = QString());
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onDisconnected();
+
+private:
+    // 共享内存池中的一块
+    struct Frame
+    {
+        QString name;                   // shm_open 使用的名字，创建时生成
+        int fd = -1;
+        uchar *data = nullptr;
+        qint64 capacity = 0;            // 映射的字节数
+        quint32 segment = 0;            // 附加到 X 服务器的 MIT-SHM 段，0 表示没有附加
+        quint32 id = 0;                 // 借出时的帧号，0 表示空闲
+        QLocalSocket *owner = nullptr;
+    };
+
+    QByteArray capture(QLocalSocket *socket, const QList<QByteArray> &arguments);
+    QByteArray release(QLocalSocket *socket, const QList<QByteArray> &arguments);
+    // 把 physicalRect（物理像素）截到共享内存，logicalRect 用于没有 X11 时的退路
+    bool grabInto(Frame &frame, const QRect &physicalRect, const QRect &logicalRect, int stride);
+
+    // 借出一块不小于 bytes 的共享内存，池已满且没有空闲的块时返回 -1
+    int acquireFrame(qint64 bytes, QLocalSocket *owner);
+    void releaseFrames(QLocalSocket *owner);
+    bool mapFrame(Frame &frame, qint64 bytes);
+    void unmapFrame(Frame &frame);
+
+    QLocalServer *server;
+    Display *display;                   // X11 下常开的连接，避免每次截图重新连接
+    ScreenMapper screens;               // 只保存屏幕几何，用于坐标换算
+    QVector<Frame> frames;
+    int maxFrames;
+    quint32 nextId;
+};
+
+#endif // CAPTURESERVER_H
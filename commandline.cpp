@@ -0,0 +1,434 @@
+#include "commandline.h"
+#include "imagediff.h"
+#include "imageeffects.h"
+#include "imageexporter.h"
+#include "sessionreplayer.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QImageReader>
+#include <QTextStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
+#include <QSemaphore>
+#include <QMutex>
+#include <QAtomicInteger>
+#include <QtConcurrent>
+#include <cstring>
+
+namespace
+{
+    // 退出码：0 相同，1 有差异，2 参数或文件错误
+    enum ExitCode
+    {
+        ExitSuccess = 0,
+        ExitIdentical = 0,
+        ExitDifferent = 1,
+        ExitError = 2
+    };
+
+    int runDiff(const QCommandLineParser &parser, QTextStream &out, QTextStream &err)
+    {
+        const QStringList files = parser.positionalArguments();
+        if (files.size() != 2)
+        {
+            err << "usage: ScreenSniper --diff <before> <after> [--threshold N] [--output overlay.png]\n";
+            return ExitError;
+        }
+
+        bool ok = true;
+        const int threshold = parser.isSet("threshold") ? parser.value("threshold").toInt(&ok) : 0;
+        if (!ok || threshold < 0 || threshold > 255)
+        {
+            err << "invalid threshold: " << parser.value("threshold") << "\n";
+            return ExitError;
+        }
+
+        const QImage before(files.at(0));
+        const QImage after(files.at(1));
+        if (before.isNull() || after.isNull())
+        {
+            err << "cannot load " << (before.isNull() ? files.at(0) : files.at(1)) << "\n";
+            return ExitError;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        const ImageDiff::Result result = ImageDiff::compare(before, after, threshold);
+        const qint64 elapsedUs = timer.nsecsElapsed() / 1000;
+
+        if (result.sizeMismatch)
+        {
+            out << "size mismatch: " << before.width() << "x" << before.height() << " vs "
+                << after.width() << "x" << after.height() << " (compared overlapping area)\n";
+        }
+        out << "changed tiles: " << result.changedTiles << "/" << result.totalTiles
+            << ", changed pixels: " << result.changedPixels
+            << ", max delta: " << result.maxDelta
+            << ", time: " << elapsedUs / 1000.0 << " ms\n";
+        for (const QRect &region : result.regions)
+        {
+            out << "region " << region.x() << "," << region.y() << " " << region.width() << "x" << region.height() << "\n";
+        }
+
+        if (parser.isSet("output") && !ImageDiff::renderOverlay(after, result).save(parser.value("output")))
+        {
+            err << "cannot write " << parser.value("output") << "\n";
+            return ExitError;
+        }
+        return result.identical() ? ExitIdentical : ExitDifferent;
+    }
+
+    // 一个打码区域
+    struct Redaction
+    {
+        QRect rect;
+        bool blur;    // false 为马赛克
+        int strength; // 模糊半径或马赛克块大小（像素）
+    };
+
+    // 格式为 x,y,w,h[,blur|mosaic[,强度]]，省略的部分使用 --effect 和 --strength
+    bool parseRegion(const QString &text, bool defaultBlur, int defaultStrength, Redaction *redaction)
+    {
+        const QStringList parts = text.split(',');
+        if (parts.size() < 4 || parts.size() > 6)
+        {
+            return false;
+        }
+        int values[4];
+        for (int i = 0; i < 4; ++i)
+        {
+            bool ok = false;
+            values[i] = parts.at(i).trimmed().toInt(&ok);
+            if (!ok)
+            {
+                return false;
+            }
+        }
+        redaction->rect = QRect(values[0], values[1], values[2], values[3]);
+        redaction->blur = defaultBlur;
+        redaction->strength = defaultStrength;
+        if (parts.size() >= 5)
+        {
+            const QString effect = parts.at(4).trimmed();
+            if (effect != "blur" && effect != "mosaic")
+            {
+                return false;
+            }
+            redaction->blur = effect == "blur";
+        }
+        if (parts.size() == 6)
+        {
+            bool ok = false;
+            redaction->strength = parts.at(5).trimmed().toInt(&ok);
+            if (!ok)
+            {
+                return false;
+            }
+        }
+        return !redaction->rect.isEmpty() && redaction->strength > 0;
+    }
+
+    // 参数可以是图片文件、文件夹（其中所有图片）或带通配符的路径（如 shots/*.png）
+    QStringList expandInputs(const QStringList &inputs)
+    {
+        QStringList imageFilters;
+        for (const QByteArray &format : QImageReader::supportedImageFormats())
+        {
+            imageFilters << "*." + QString::fromLatin1(format);
+        }
+
+        QStringList files;
+        for (const QString &input : inputs)
+        {
+            const QFileInfo info(input);
+            if (info.isDir())
+            {
+                for (const QFileInfo &entry : QDir(input).entryInfoList(imageFilters, QDir::Files, QDir::Name))
+                {
+                    files << entry.filePath();
+                }
+            }
+            else if (input.contains('*') || input.contains('?') || input.contains('['))
+            {
+                const QDir dir = info.dir();
+                for (const QFileInfo &entry : dir.entryInfoList(QStringList(info.fileName()), QDir::Files, QDir::Name))
+                {
+                    files << entry.filePath();
+                }
+            }
+            else
+            {
+                files << input;
+            }
+        }
+        return files;
+    }
+
+    int runRedact(const QCommandLineParser &parser, QTextStream &out, QTextStream &err)
+    {
+        // 同一个文件可能同时由文件夹和通配符列出，只处理一次
+        QStringList files;
+        QSet<QString> listed;
+        for (const QString &file : expandInputs(parser.positionalArguments()))
+        {
+            const QString path = QFileInfo(file).absoluteFilePath();
+            if (!listed.contains(path))
+            {
+                listed.insert(path);
+                files << file;
+            }
+        }
+        const bool inPlace = parser.isSet("in-place");
+        const QString outputDir = parser.value("output-dir");
+        if (files.isEmpty() || parser.values("region").isEmpty() || (outputDir.isEmpty() && !inPlace))
+        {
+            err << "usage: ScreenSniper --redact <folder|glob|file>... --region x,y,w,h[,blur|mosaic[,N]]...\n"
+                   "                    (--output-dir <dir> | --in-place) [--effect mosaic|blur] [--strength N]\n"
+                   "                    [--jobs N] [--memory-budget MB]\n";
+            return ExitError;
+        }
+
+        const QString effect = parser.value("effect");
+        bool ok = true;
+        const int strength = parser.value("strength").toInt(&ok);
+        if ((effect != "mosaic" && effect != "blur") || !ok || strength <= 0)
+        {
+            err << "invalid --effect or --strength\n";
+            return ExitError;
+        }
+        QVector<Redaction> redactions;
+        for (const QString &text : parser.values("region"))
+        {
+            Redaction redaction;
+            if (!parseRegion(text, effect == "blur", strength, &redaction))
+            {
+                err << "invalid region: " << text << "\n";
+                return ExitError;
+            }
+            redactions.append(redaction);
+        }
+        if (!outputDir.isEmpty() && !QDir().mkpath(outputDir))
+        {
+            err << "cannot create " << outputDir << "\n";
+            return ExitError;
+        }
+
+        // 输出目录中只保留文件名，不同文件夹中的同名文件会写到同一个位置，
+        // 开始处理之前检查，有冲突时一个文件都不写
+        QStringList targets;
+        QHash<QString, QString> writers;
+        for (const QString &file : files)
+        {
+            const QString target = inPlace ? file : QDir(outputDir).filePath(QFileInfo(file).fileName());
+            const QString path = QFileInfo(target).absoluteFilePath();
+            if (writers.contains(path))
+            {
+                err << writers.value(path) << " and " << file << " would both be written to " << target << "\n";
+                return ExitError;
+            }
+            writers.insert(path, file);
+            targets << target;
+        }
+
+        const int jobs = parser.isSet("jobs") ? qMax(1, parser.value("jobs").toInt()) : QThread::idealThreadCount();
+        const int budgetKB = qMax(1, parser.value("memory-budget").toInt()) * 1024;
+
+        // 每个文件在一个线程中依次解码、打码、编码，并行只在文件之间：不是按阶段分开、
+        // 各阶段各有线程的流水线。文件数多于线程数时各线程自然处于不同阶段，效果相近，
+        // 也不需要在阶段之间传递图像。提交前按图片头中的尺寸估算内存
+        // （解码后的图像和模糊用的两份区域副本，按整图 3 倍估算），
+        // 同时在处理中的文件占用的总量不超过预算，超出时等前面的文件完成再提交
+        QThreadPool pool;
+        pool.setMaxThreadCount(jobs);
+        QSemaphore budget(budgetKB);
+        QMutex errMutex;
+        QAtomicInteger<int> failures(0);
+        QAtomicInteger<qint64> decodeNs(0), effectNs(0), encodeNs(0);
+        int inFlightKB = 0;
+        int peakKB = 0;
+        QMutex peakMutex;
+
+        QElapsedTimer total;
+        total.start();
+        for (int i = 0; i < files.size(); ++i)
+        {
+            const QString &file = files.at(i);
+            const QSize size = QImageReader(file).size();
+            const int cost = int(qBound<qint64>(1, qint64(qMax(1, size.width())) * qMax(1, size.height()) * 4 * 3 / 1024, budgetKB));
+            budget.acquire(cost);
+            {
+                QMutexLocker locker(&peakMutex);
+                inFlightKB += cost;
+                peakKB = qMax(peakKB, inFlightKB);
+            }
+
+            const QString target = targets.at(i);
+            QtConcurrent::run(&pool, [&, file, target, cost]()
+                              {
+                QString error;
+                QElapsedTimer stage;
+                stage.start();
+                QImageReader reader(file);
+                QImage image = reader.read();
+                decodeNs.fetchAndAddRelaxed(stage.nsecsElapsed());
+                if (image.isNull())
+                {
+                    error = reader.errorString();
+                }
+                else
+                {
+                    stage.restart();
+                    for (const Redaction &redaction : redactions)
+                    {
+                        if (redaction.blur)
+                        {
+                            ImageEffects::blur(image, redaction.rect, redaction.strength);
+                        }
+                        else
+                        {
+                            ImageEffects::mosaic(image, redaction.rect, redaction.strength);
+                        }
+                    }
+                    effectNs.fetchAndAddRelaxed(stage.nsecsElapsed());
+
+                    // saveImage 先写临时文件再替换，--in-place 时中途失败原图保持不变
+                    stage.restart();
+                    ImageExporter::saveImage(image, target, &error);
+                    encodeNs.fetchAndAddRelaxed(stage.nsecsElapsed());
+                }
+                image = QImage();
+
+                if (!error.isEmpty())
+                {
+                    failures.fetchAndAddRelaxed(1);
+                    QMutexLocker locker(&errMutex);
+                    err << file << ": " << error << "\n";
+                    err.flush();
+                }
+                {
+                    QMutexLocker locker(&peakMutex);
+                    inFlightKB -= cost;
+                }
+                budget.release(cost); });
+        }
+        pool.waitForDone();
+
+        const qint64 elapsedMs = qMax<qint64>(1, total.elapsed());
+        out << "redacted " << files.size() - failures.loadRelaxed() << "/" << files.size() << " files in "
+            << elapsedMs << " ms (" << files.size() * 1000.0 / elapsedMs << " files/s, " << jobs << " threads)\n"
+            << "cpu time: decode " << decodeNs.loadRelaxed() / 1000000 << " ms, effects " << effectNs.loadRelaxed() / 1000000
+            << " ms, encode " << encodeNs.loadRelaxed() / 1000000 << " ms; peak in flight " << peakKB / 1024 << " MB\n";
+        return failures.loadRelaxed() == 0 ? ExitSuccess : ExitError;
+    }
+}
+
+namespace CommandLine
+{
+    bool isCommandLineMode(int argc, char *argv[])
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            if (std::strcmp(argv[i], "--diff") == 0 || std::strcmp(argv[i], "--redact") == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool isReplayMode(int argc, char *argv[])
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            if (std::strcmp(argv[i], "--replay") == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    int runReplay()
+    {
+        QCommandLineParser parser;
+        parser.setApplicationDescription("ScreenSniper input session replay");
+        parser.addHelpOption();
+        parser.addOption(QCommandLineOption("replay", "Replay a recorded .sssn input session on the capture overlay.", "session"));
+        parser.addOption(QCommandLineOption("max-event-ms", "Exit with status 1 if any event type's p95 handling time exceeds this.", "ms"));
+        parser.addOption(QCommandLineOption("max-paint-ms", "Exit with status 1 if the p95 paint time exceeds this.", "ms"));
+        parser.process(*QCoreApplication::instance());
+
+        QTextStream out(stdout);
+        QTextStream err(stderr);
+        InputSession::Session session;
+        if (!InputSession::load(parser.value("replay"), &session) || session.screens.isEmpty())
+        {
+            err << "cannot load session " << parser.value("replay") << "\n";
+            return ExitError;
+        }
+
+        const SessionReplayer::Report report = SessionReplayer::replay(session);
+        out << SessionReplayer::format(report);
+
+        // 超过门限时按 --diff 的约定返回 1，便于在回归测试中使用
+        bool regressed = false;
+        if (parser.isSet("max-event-ms"))
+        {
+            const double limitUs = parser.value("max-event-ms").toDouble() * 1000;
+            for (auto it = report.events.constBegin(); it != report.events.constEnd(); ++it)
+            {
+                if (it.value().p95 > limitUs)
+                {
+                    out << "regression: " << it.key() << " p95 " << it.value().p95 / 1000.0 << " ms\n";
+                    regressed = true;
+                }
+            }
+        }
+        if (parser.isSet("max-paint-ms") && report.paint.p95 > parser.value("max-paint-ms").toDouble() * 1000)
+        {
+            out << "regression: paint p95 " << report.paint.p95 / 1000.0 << " ms\n";
+            regressed = true;
+        }
+        return regressed ? ExitDifferent : ExitSuccess;
+    }
+
+    int run()
+    {
+        QCommandLineParser parser;
+        parser.setApplicationDescription("ScreenSniper command line mode");
+        parser.addHelpOption();
+        parser.addOption(QCommandLineOption("diff", "Compare two images; exit status 0 = identical, 1 = different, 2 = error."));
+        parser.addOption(QCommandLineOption("threshold", "Per-channel difference to ignore (0-255).", "N", "0"));
+        parser.addOption(QCommandLineOption("output", "Write the diff overlay on <after> to <file>.", "file"));
+        parser.addOption(QCommandLineOption("redact", "Blur or pixelate the same regions in many images. Each file is decoded, redacted and encoded in turn on one worker thread; files are processed in parallel."));
+        parser.addOption(QCommandLineOption("region", "Region to redact: x,y,w,h[,blur|mosaic[,N]] (repeatable).", "rect"));
+        parser.addOption(QCommandLineOption("effect", "Default effect for regions: mosaic or blur.", "effect", "mosaic"));
+        parser.addOption(QCommandLineOption("strength", "Default mosaic block size or blur radius in pixels.", "N", "12"));
+        parser.addOption(QCommandLineOption("output-dir", "Write redacted images to <dir>.", "dir"));
+        parser.addOption(QCommandLineOption("in-place", "Overwrite the input images."));
+        parser.addOption(QCommandLineOption("jobs", "Number of worker threads (default: CPU count).", "N"));
+        parser.addOption(QCommandLineOption("memory-budget", "Decoded images kept in flight, in MB.", "MB", "512"));
+        parser.addPositionalArgument("files", "--diff: <before> <after>. --redact: image files, folders or glob patterns.",
+                                     "files...");
+        parser.process(*QCoreApplication::instance());
+
+        QTextStream out(stdout);
+        QTextStream err(stderr);
+        if (parser.isSet("diff"))
+        {
+            return runDiff(parser, out, err);
+        }
+        if (parser.isSet("redact"))
+        {
+            return runRedact(parser, out, err);
+        }
+        parser.showHelp(ExitError);
+        return ExitError;
+    }
+}
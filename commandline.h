@@ -0,0 +1,20 @@
+#ifndef COMMANDLINE_H
+#define COMMANDLINE_H
+
+// 无界面的命令行模式，不创建任何窗口，结果用退出码表示
+namespace CommandLine
+{
+    // 参数中是否包含命令行模式的命令（在创建 QApplication 之前调用）
+    bool isCommandLineMode(int argc, char *argv[]);
+
+    // 执行命令并返回退出码，调用前需要已经创建 QCoreApplication
+    int run();
+
+    // 参数中是否包含 --replay。回放要创建截图窗口，需要 QApplication（通常使用 offscreen 平台）
+    bool isReplayMode(int argc, char *argv[]);
+
+    // 回放录制的输入会话并输出耗时统计，调用前需要已经创建 QApplication
+    int runReplay();
+}
+
+#endif // COMMANDLINE_H
@@ -0,0 +1,276 @@
+#include "edgemap.h"
+#include <QtConcurrent>
+#include <cstring>
+#include <functional>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+    // 平均每个像素的梯度至少达到这个值才算明显的边缘（Sobel 梯度最大 1020）
+    const int StrongEdge = 24;
+
+    // 灰度 = (77 R + 150 G + 29 B) >> 8
+    void grayRow(const quint32 *pixels, uchar *gray, int width)
+    {
+        int x = 0;
+
+#if defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i weights = _mm_setr_epi16(29, 150, 77, 0, 29, 150, 77, 0);
+        for (; x + 4 <= width; x += 4)
+        {
+            const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + x));
+            // 每个像素得到 (29 B + 150 G) 和 (77 R) 两个 32 位部分和
+            const __m128 lo = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpacklo_epi8(p, zero), weights));
+            const __m128 hi = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpackhi_epi8(p, zero), weights));
+            const __m128i even = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+            const __m128i odd = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+            __m128i g = _mm_srli_epi32(_mm_add_epi32(even, odd), 8);
+            g = _mm_packus_epi16(_mm_packs_epi32(g, zero), zero);
+            const int packed = _mm_cvtsi128_si32(g);
+            std::memcpy(gray + x, &packed, 4);
+        }
+#elif defined(__ARM_NEON)
+        for (; x + 8 <= width; x += 8)
+        {
+            const uint8x8x4_t p = vld4_u8(reinterpret_cast<const uint8_t *>(pixels + x));
+            uint16x8_t sum = vmull_u8(p.val[0], vdup_n_u8(29));
+            sum = vmlal_u8(sum, p.val[1], vdup_n_u8(150));
+            sum = vmlal_u8(sum, p.val[2], vdup_n_u8(77));
+            vst1_u8(gray + x, vshrn_n_u16(sum, 8));
+        }
+#endif
+
+        for (; x < width; ++x)
+        {
+            const quint32 p = pixels[x];
+            gray[x] = uchar((77 * ((p >> 16) & 0xff) + 150 * ((p >> 8) & 0xff) + 29 * (p & 0xff)) >> 8);
+        }
+    }
+
+    inline void sobelAt(const uchar *r0, const uchar *r1, const uchar *r2, int x, int &gx, int &gy)
+    {
+        gx = (r0[x + 1] - r0[x - 1]) + 2 * (r1[x + 1] - r1[x - 1]) + (r2[x + 1] - r2[x - 1]);
+        gy = (r2[x - 1] + 2 * r2[x] + r2[x + 1]) - (r0[x - 1] + 2 * r0[x] + r0[x + 1]);
+    }
+
+    // 对第 r1 行求 Sobel 梯度：|gx| 累加到 columnSums[x]，|gy| 按 64 列的条带累加到 bandSums
+    void sobelRow(const uchar *r0, const uchar *r1, const uchar *r2, int width,
+                  quint16 *columnSums, quint32 *bandSums)
+    {
+        // 第一列和最后一列没有完整的邻域，梯度记为 0。
+        // 先用标量处理到 8 的倍数，之后每 8 个像素一组不会跨越 64 列的条带
+        int x = 1;
+        for (; x < width - 1 && (x & 7) != 0; ++x)
+        {
+            int gx, gy;
+            sobelAt(r0, r1, r2, x, gx, gy);
+            columnSums[x] = quint16(columnSums[x] + qAbs(gx));
+            bandSums[x / EdgeMap::BandSize] += quint32(qAbs(gy));
+        }
+
+#if defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i ones = _mm_set1_epi16(1);
+        auto load = [zero](const uchar *p)
+        {
+            return _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p)), zero);
+        };
+        for (; x + 8 <= width - 1; x += 8)
+        {
+            const __m128i a0 = load(r0 + x - 1), b0 = load(r0 + x), c0 = load(r0 + x + 1);
+            const __m128i a1 = load(r1 + x - 1), c1 = load(r1 + x + 1);
+            const __m128i a2 = load(r2 + x - 1), b2 = load(r2 + x), c2 = load(r2 + x + 1);
+
+            const __m128i d1 = _mm_sub_epi16(c1, a1);
+            __m128i gx = _mm_add_epi16(_mm_add_epi16(_mm_sub_epi16(c0, a0), _mm_sub_epi16(c2, a2)), _mm_add_epi16(d1, d1));
+            const __m128i top = _mm_add_epi16(_mm_add_epi16(a0, c0), _mm_add_epi16(b0, b0));
+            const __m128i bottom = _mm_add_epi16(_mm_add_epi16(a2, c2), _mm_add_epi16(b2, b2));
+            __m128i gy = _mm_sub_epi16(bottom, top);
+            gx = _mm_max_epi16(gx, _mm_sub_epi16(zero, gx));
+            gy = _mm_max_epi16(gy, _mm_sub_epi16(zero, gy));
+
+            __m128i *sums = reinterpret_cast<__m128i *>(columnSums + x);
+            _mm_storeu_si128(sums, _mm_add_epi16(_mm_loadu_si128(sums), gx));
+
+            __m128i s = _mm_madd_epi16(gy, ones);
+            s = _mm_add_epi32(s, _mm_srli_si128(s, 8));
+            s = _mm_add_epi32(s, _mm_srli_si128(s, 4));
+            bandSums[x / EdgeMap::BandSize] += quint32(_mm_cvtsi128_si32(s));
+        }
+#elif defined(__ARM_NEON)
+        auto load = [](const uchar *p)
+        {
+            return vreinterpretq_s16_u16(vmovl_u8(vld1_u8(p)));
+        };
+        for (; x + 8 <= width - 1; x += 8)
+        {
+            const int16x8_t a0 = load(r0 + x - 1), b0 = load(r0 + x), c0 = load(r0 + x + 1);
+            const int16x8_t a1 = load(r1 + x - 1), c1 = load(r1 + x + 1);
+            const int16x8_t a2 = load(r2 + x - 1), b2 = load(r2 + x), c2 = load(r2 + x + 1);
+
+            const int16x8_t d1 = vsubq_s16(c1, a1);
+            const int16x8_t gx = vaddq_s16(vaddq_s16(vsubq_s16(c0, a0), vsubq_s16(c2, a2)), vaddq_s16(d1, d1));
+            const int16x8_t top = vaddq_s16(vaddq_s16(a0, c0), vaddq_s16(b0, b0));
+            const int16x8_t bottom = vaddq_s16(vaddq_s16(a2, c2), vaddq_s16(b2, b2));
+            const uint16x8_t absX = vreinterpretq_u16_s16(vabsq_s16(gx));
+            const uint16x8_t absY = vreinterpretq_u16_s16(vabsq_s16(vsubq_s16(bottom, top)));
+
+            vst1q_u16(columnSums + x, vaddq_u16(vld1q_u16(columnSums + x), absX));
+
+            const uint64x2_t s = vpaddlq_u32(vpaddlq_u16(absY));
+            bandSums[x / EdgeMap::BandSize] += quint32(vgetq_lane_u64(s, 0) + vgetq_lane_u64(s, 1));
+        }
+#endif
+
+        for (; x < width - 1; ++x)
+        {
+            int gx, gy;
+            sobelAt(r0, r1, r2, x, gx, gy);
+            columnSums[x] = quint16(columnSums[x] + qAbs(gx));
+            bandSums[x / EdgeMap::BandSize] += quint32(qAbs(gy));
+        }
+    }
+
+    // 在 [center - radius, center + radius] 中找得分最高的位置，得分相同时取离 center 近的
+    int strongest(int center, int radius, int limit, int threshold, const std::function<int(int)> &score)
+    {
+        int best = -1;
+        int bestScore = threshold - 1;
+        for (int offset = 0; offset <= radius; ++offset)
+        {
+            for (int position : {center - offset, center + offset})
+            {
+                if (position < 0 || position >= limit)
+                {
+                    continue;
+                }
+                const int s = score(position);
+                if (s > bestScore)
+                {
+                    best = position;
+                    bestScore = s;
+                }
+            }
+        }
+        return best;
+    }
+}
+
+QImage EdgeMap::grayscale(const QImage &source)
+{
+    const QImage image = source.convertToFormat(QImage::Format_RGB32);
+    QImage gray(image.size(), QImage::Format_Grayscale8);
+    if (image.isNull())
+    {
+        return gray;
+    }
+
+    QVector<int> bands((image.height() + BandSize - 1) / BandSize);
+    for (int i = 0; i < bands.size(); ++i)
+    {
+        bands[i] = i;
+    }
+    // 并行前先取得可写指针，避免在线程中触发 QImage 的分离
+    uchar *grayBits = gray.bits();
+    const qsizetype grayStride = gray.bytesPerLine();
+    QtConcurrent::blockingMap(bands, [&](int &band)
+                              {
+        for (int y = band * BandSize; y < qMin(image.height(), (band + 1) * BandSize); ++y)
+        {
+            grayRow(reinterpret_cast<const quint32 *>(image.constScanLine(y)), grayBits + y * grayStride, image.width());
+        } });
+    return gray;
+}
+
+EdgeMap EdgeMap::compute(const QImage &source)
+{
+    EdgeMap map;
+    const int width = source.width();
+    const int height = source.height();
+    if (width < 3 || height < 3)
+    {
+        return map;
+    }
+
+    map.imageSize = source.size();
+    map.rowBands = (height + BandSize - 1) / BandSize;
+    map.columnBands = (width + BandSize - 1) / BandSize;
+    map.columnProjection.fill(0, map.rowBands * width);
+    map.rowProjection.fill(0, map.columnBands * height);
+
+    QVector<int> bands(map.rowBands);
+    for (int i = 0; i < bands.size(); ++i)
+    {
+        bands[i] = i;
+    }
+
+    // 先求整张灰度图，Sobel 要读相邻条带的行
+    const QImage gray = grayscale(source);
+    const uchar *grayBits = gray.constBits();
+    const qsizetype stride = gray.bytesPerLine();
+
+    quint16 *columns = map.columnProjection.data();
+    quint16 *rows = map.rowProjection.data();
+    const int columnBands = map.columnBands;
+    QtConcurrent::blockingMap(bands, [&](int &band)
+                              {
+        QVector<quint32> bandSums(columnBands);
+        for (int y = qMax(1, band * BandSize); y < qMin(height - 1, (band + 1) * BandSize); ++y)
+        {
+            bandSums.fill(0);
+            sobelRow(grayBits + (y - 1) * stride, grayBits + y * stride, grayBits + (y + 1) * stride, width,
+                     columns + band * width, bandSums.data());
+            for (int c = 0; c < columnBands; ++c)
+            {
+                rows[c * height + y] = quint16(qMin(bandSums.at(c), quint32(0xffff)));
+            }
+        } });
+
+    return map;
+}
+
+void EdgeMap::nearestBands(int position, int bandCount, int &first, int &second)
+{
+    first = qBound(0, position / BandSize, bandCount - 1);
+    second = position % BandSize < BandSize / 2 ? first - 1 : first + 1;
+    if (second < 0 || second >= bandCount)
+    {
+        second = -1;
+    }
+}
+
+int EdgeMap::snapX(int x, int y, int radius) const
+{
+    if (isNull())
+    {
+        return -1;
+    }
+    int first, second;
+    nearestBands(y, rowBands, first, second);
+    const int covered = second < 0 ? BandSize : 2 * BandSize;
+    const int width = imageSize.width();
+    return strongest(x, radius, width, StrongEdge * covered, [&](int column)
+                     { return columnProjection.at(first * width + column) +
+                              (second < 0 ? 0 : columnProjection.at(second * width + column)); });
+}
+
+int EdgeMap::snapY(int x, int y, int radius) const
+{
+    if (isNull())
+    {
+        return -1;
+    }
+    int first, second;
+    nearestBands(x, columnBands, first, second);
+    const int covered = second < 0 ? BandSize : 2 * BandSize;
+    const int height = imageSize.height();
+    return strongest(y, radius, height, StrongEdge * covered, [&](int row)
+                     { return rowProjection.at(first * height + row) +
+                              (second < 0 ? 0 : rowProjection.at(second * height + row)); });
+}
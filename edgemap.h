@@ -0,0 +1,43 @@
+#ifndef EDGEMAP_H
+#define EDGEMAP_H
+
+#include <QImage>
+#include <QSize>
+#include <QVector>
+
+// 边缘投影图，用于把选区的角吸附到按钮、面板等界面元素的边框上
+// 对截图求灰度和 Sobel 梯度（SSE2/NEON 一次 8 个像素，与标量版本结果一致），
+// 按 64 像素的条带在线程池中并行。不保存完整的梯度图，只保存两种投影：
+//   每个行条带内各列的 |gx| 之和（竖直边缘），每个列条带内各行的 |gy| 之和（水平边缘）。
+// 64 个像素的梯度之和最大 64 * 1020，正好放得进 16 位。
+class EdgeMap
+{
+public:
+    static const int BandSize = 64;
+
+    // image 为屏幕截图（物理像素）
+    static EdgeMap compute(const QImage &image);
+
+    // 灰度图 (77 R + 150 G + 29 B) >> 8，按条带并行。文字识别的预处理也用它
+    static QImage grayscale(const QImage &image);
+
+    bool isNull() const { return imageSize.isEmpty(); }
+    QSize size() const { return imageSize; }
+
+    // 在 [x - radius, x + radius] 内找 y 附近最强的竖直边缘所在的列，没有足够强的边缘时返回 -1
+    int snapX(int x, int y, int radius) const;
+    // 在 [y - radius, y + radius] 内找 x 附近最强的水平边缘所在的行，没有足够强的边缘时返回 -1
+    int snapY(int x, int y, int radius) const;
+
+private:
+    // 与 position 相邻的两个条带（包含 position 的条带和离 position 较近的那个）
+    static void nearestBands(int position, int bandCount, int &first, int &second);
+
+    QSize imageSize;
+    int rowBands = 0;
+    int columnBands = 0;
+    QVector<quint16> columnProjection; // [行条带 * 宽 + x]
+    QVector<quint16> rowProjection;    // [列条带 * 高 + y]
+};
+
+#endif // EDGEMAP_H
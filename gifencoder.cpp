@@ -0,0 +1,705 @@
+#include "gifencoder.h"
+#include "pixelformat.h"
+#include <QtConcurrent>
+#include <QThread>
+#include <QDebug>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // 颜色直方图按每通道 5 位分箱
+    const int BinBits = 5;
+    const int BinCount = 1 << (3 * BinBits);
+
+    inline int binOf(int r, int g, int b)
+    {
+        return ((r >> 3) << 10) | ((g >> 3) << 5) | (b >> 3);
+    }
+
+    // 4x4 Bayer 矩阵，抖动幅度约为一个分箱宽度
+    const int Bayer4[4][4] = {
+        {0, 8, 2, 10},
+        {12, 4, 14, 6},
+        {3, 11, 1, 9},
+        {15, 7, 13, 5},
+    };
+
+    struct Bin
+    {
+        quint32 count = 0;
+        quint64 r = 0;
+        quint64 g = 0;
+        quint64 b = 0;
+    };
+
+    // 按行把区域切成若干块，供线程池并行处理
+    QVector<QPair<int, int>> rowChunks(const QRect &rect)
+    {
+        const int chunkCount = qMax(1, qMin(QThread::idealThreadCount() * 2, rect.height() / 16));
+        QVector<QPair<int, int>> chunks;
+        const int step = (rect.height() + chunkCount - 1) / chunkCount;
+        for (int y = rect.top(); y <= rect.bottom(); y += step)
+        {
+            chunks.append(qMakePair(y, qMin(rect.bottom() + 1, y + step)));
+        }
+        return chunks;
+    }
+
+    // 第 x 个像素与上一帧是否相同；没有上一帧时总是“不同”
+    inline bool unchanged(const QRgb *line, const QRgb *previousLine, int x)
+    {
+        return previousLine && line[x] == previousLine[x];
+    }
+
+    // 并行统计直方图，每个线程块先写自己的局部直方图，最后合并
+    QVector<Bin> buildHistogram(const QImage &frame, const QImage &previous, const QRect &rect)
+    {
+        const QVector<QPair<int, int>> chunks = rowChunks(rect);
+        QVector<QVector<Bin>> partials(chunks.size());
+        QVector<int> jobs(chunks.size());
+        for (int i = 0; i < jobs.size(); ++i)
+        {
+            jobs[i] = i;
+        }
+
+        QtConcurrent::blockingMap(jobs, [&](int &job)
+                                  {
+            QVector<Bin> &bins = partials[job];
+            bins.resize(BinCount);
+            for (int y = chunks.at(job).first; y < chunks.at(job).second; ++y)
+            {
+                const QRgb *line = reinterpret_cast<const QRgb *>(frame.constScanLine(y));
+                const QRgb *previousLine = previous.isNull() ? nullptr
+                                                             : reinterpret_cast<const QRgb *>(previous.constScanLine(y));
+                for (int x = rect.left(); x <= rect.right(); ++x)
+                {
+                    if (unchanged(line, previousLine, x))
+                    {
+                        continue;
+                    }
+                    const QRgb pixel = line[x];
+                    Bin &bin = bins[binOf(qRed(pixel), qGreen(pixel), qBlue(pixel))];
+                    ++bin.count;
+                    bin.r += qRed(pixel);
+                    bin.g += qGreen(pixel);
+                    bin.b += qBlue(pixel);
+                }
+            } });
+
+        QVector<Bin> histogram(BinCount);
+        for (const QVector<Bin> &bins : partials)
+        {
+            for (int i = 0; i < BinCount; ++i)
+            {
+                histogram[i].count += bins[i].count;
+                histogram[i].r += bins[i].r;
+                histogram[i].g += bins[i].g;
+                histogram[i].b += bins[i].b;
+            }
+        }
+        return histogram;
+    }
+
+    // 八叉树量化：直方图的每个分箱按颜色位插入树中（第 5 层为叶子），
+    // 然后从最深层开始合并像素最少的节点，直到叶子数不超过 maxColors
+    QVector<QRgb> octreePalette(const QVector<Bin> &histogram, int maxColors)
+    {
+        struct Node
+        {
+            quint64 r = 0, g = 0, b = 0, count = 0;
+            int children[8] = {-1, -1, -1, -1, -1, -1, -1, -1};
+            bool leaf = false;
+        };
+
+        QVector<Node> nodes(1);
+        QVector<int> levelNodes[BinBits];
+        int leafCount = 0;
+
+        for (int index = 0; index < BinCount; ++index)
+        {
+            const Bin &bin = histogram[index];
+            if (!bin.count)
+            {
+                continue;
+            }
+            const int r5 = (index >> 10) & 31, g5 = (index >> 5) & 31, b5 = index & 31;
+            int node = 0;
+            for (int level = 0; level < BinBits; ++level)
+            {
+                const int shift = BinBits - 1 - level;
+                const int child = (((r5 >> shift) & 1) << 2) | (((g5 >> shift) & 1) << 1) | ((b5 >> shift) & 1);
+                if (nodes[node].children[child] < 0)
+                {
+                    nodes[node].children[child] = nodes.size();
+                    nodes.append(Node());
+                    if (level + 1 < BinBits)
+                    {
+                        levelNodes[level + 1].append(nodes.size() - 1);
+                    }
+                }
+                node = nodes[node].children[child];
+            }
+            Node &leaf = nodes[node];
+            leaf.leaf = true;
+            leaf.count = bin.count;
+            leaf.r = bin.r;
+            leaf.g = bin.g;
+            leaf.b = bin.b;
+            ++leafCount;
+        }
+        levelNodes[0].append(0);
+
+        for (int level = BinBits - 1; level >= 0 && leafCount > maxColors; --level)
+        {
+            // 这一层节点的子节点都已是叶子，先汇总每个节点的像素数
+            QVector<int> candidates;
+            for (int node : levelNodes[level])
+            {
+                Node &n = nodes[node];
+                n.r = n.g = n.b = n.count = 0;
+                int childLeaves = 0;
+                for (int child : n.children)
+                {
+                    if (child >= 0 && nodes[child].leaf)
+                    {
+                        n.r += nodes[child].r;
+                        n.g += nodes[child].g;
+                        n.b += nodes[child].b;
+                        n.count += nodes[child].count;
+                        ++childLeaves;
+                    }
+                }
+                if (childLeaves > 0)
+                {
+                    candidates.append(node);
+                }
+            }
+            std::sort(candidates.begin(), candidates.end(), [&nodes](int a, int b)
+                      { return nodes[a].count < nodes[b].count; });
+
+            for (int node : candidates)
+            {
+                if (leafCount <= maxColors)
+                {
+                    break;
+                }
+                Node &n = nodes[node];
+                int childLeaves = 0;
+                for (int &child : n.children)
+                {
+                    if (child >= 0)
+                    {
+                        ++childLeaves;
+                        child = -1;
+                    }
+                }
+                n.leaf = true;
+                leafCount -= childLeaves - 1;
+            }
+        }
+
+        // 遍历树收集叶子的平均颜色
+        QVector<QRgb> palette;
+        QVector<int> stack;
+        stack.append(0);
+        while (!stack.isEmpty())
+        {
+            const Node &n = nodes[stack.takeLast()];
+            if (n.leaf)
+            {
+                palette.append(qRgb(int(n.r / n.count), int(n.g / n.count), int(n.b / n.count)));
+                continue;
+            }
+            for (int child : n.children)
+            {
+                if (child >= 0)
+                {
+                    stack.append(child);
+                }
+            }
+        }
+        if (palette.isEmpty())
+        {
+            palette.append(qRgb(0, 0, 0));
+        }
+        return palette;
+    }
+
+    // 为每个分箱预先找到最近的调色板颜色，像素映射时只需查表
+    QVector<quint8> buildLookup(const QVector<QRgb> &palette)
+    {
+        QVector<quint8> lookup(BinCount);
+        const int chunkCount = QThread::idealThreadCount() * 4;
+        QVector<int> jobs(chunkCount);
+        for (int i = 0; i < chunkCount; ++i)
+        {
+            jobs[i] = i;
+        }
+        QtConcurrent::blockingMap(jobs, [&](int &job)
+                                  {
+            const int begin = BinCount * job / chunkCount;
+            const int end = BinCount * (job + 1) / chunkCount;
+            for (int index = begin; index < end; ++index)
+            {
+                // 分箱中心的颜色
+                const int r = (((index >> 10) & 31) << 3) | 4;
+                const int g = (((index >> 5) & 31) << 3) | 4;
+                const int b = ((index & 31) << 3) | 4;
+                int best = 0;
+                int bestDistance = INT_MAX;
+                for (int i = 0; i < palette.size(); ++i)
+                {
+                    const int dr = r - qRed(palette[i]);
+                    const int dg = g - qGreen(palette[i]);
+                    const int db = b - qBlue(palette[i]);
+                    const int distance = dr * dr + dg * dg + db * db;
+                    if (distance < bestDistance)
+                    {
+                        bestDistance = distance;
+                        best = i;
+                    }
+                }
+                lookup[index] = quint8(best);
+            } });
+        return lookup;
+    }
+
+    // 返回 a、b 两行中第一个不同像素的下标，全部相同返回 count
+    int firstDifference(const quint32 *a, const quint32 *b, int count)
+    {
+        int x = 0;
+#if defined(__SSE2__)
+        for (; x + 4 <= count; x += 4)
+        {
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + x));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + x));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(va, vb)) != 0xffff)
+            {
+                break;
+            }
+        }
+#endif
+        while (x < count && a[x] == b[x])
+        {
+            ++x;
+        }
+        return x;
+    }
+
+    // 返回最后一个不同像素的下标，全部相同返回 -1
+    int lastDifference(const quint32 *a, const quint32 *b, int count)
+    {
+        int x = count;
+#if defined(__SSE2__)
+        for (; x - 4 >= 0; x -= 4)
+        {
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + x - 4));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + x - 4));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(va, vb)) != 0xffff)
+            {
+                break;
+            }
+        }
+#endif
+        while (x > 0 && a[x - 1] == b[x - 1])
+        {
+            --x;
+        }
+        return x - 1;
+    }
+
+    // GIF 的 LZW 码流按 LSB 优先打包，再切成最长 255 字节的数据子块
+    class BitPacker
+    {
+    public:
+        explicit BitPacker(QByteArray &out) : out(out), buffer(0), bitCount(0) {}
+
+        void write(int code, int codeSize)
+        {
+            buffer |= quint32(code) << bitCount;
+            bitCount += codeSize;
+            while (bitCount >= 8)
+            {
+                pushByte(char(buffer & 0xff));
+                buffer >>= 8;
+                bitCount -= 8;
+            }
+        }
+
+        void finish()
+        {
+            if (bitCount > 0)
+            {
+                pushByte(char(buffer & 0xff));
+            }
+            flushBlock();
+            out.append(char(0));
+        }
+
+    private:
+        void pushByte(char byte)
+        {
+            block.append(byte);
+            if (block.size() == 255)
+            {
+                flushBlock();
+            }
+        }
+
+        void flushBlock()
+        {
+            if (!block.isEmpty())
+            {
+                out.append(char(block.size()));
+                out.append(block);
+                block.clear();
+            }
+        }
+
+        QByteArray &out;
+        QByteArray block;
+        quint32 buffer;
+        int bitCount;
+    };
+
+    void lzwEncode(const QVector<quint8> &indices, int minCodeSize, QByteArray &out)
+    {
+        const int clearCode = 1 << minCodeSize;
+        const int endCode = clearCode + 1;
+        const int MaxCode = 4096;
+        const int HashSize = 5003;
+
+        // 开放寻址的字典：键为 (前缀码 << 8) | 下一个索引
+        QVector<int> hashKeys(HashSize, -1);
+        QVector<quint16> hashCodes(HashSize);
+
+        int codeSize = minCodeSize + 1;
+        int nextCode = endCode + 1;
+
+        out.append(char(minCodeSize));
+        BitPacker packer(out);
+        packer.write(clearCode, codeSize);
+
+        int prefix = indices.isEmpty() ? 0 : indices[0];
+        for (int i = 1; i < indices.size(); ++i)
+        {
+            const int c = indices[i];
+            const int key = (prefix << 8) | c;
+            int slot = ((c << 12) ^ prefix) % HashSize;
+            bool found = false;
+            while (hashKeys[slot] != -1)
+            {
+                if (hashKeys[slot] == key)
+                {
+                    prefix = hashCodes[slot];
+                    found = true;
+                    break;
+                }
+                slot = (slot + 1) % HashSize;
+            }
+            if (found)
+            {
+                continue;
+            }
+
+            packer.write(prefix, codeSize);
+            hashKeys[slot] = key;
+            hashCodes[slot] = quint16(nextCode++);
+            if (nextCode > (1 << codeSize) && codeSize < 12)
+            {
+                ++codeSize;
+            }
+            if (nextCode == MaxCode)
+            {
+                // 字典已满，清空后重新开始
+                packer.write(clearCode, codeSize);
+                hashKeys.fill(-1);
+                codeSize = minCodeSize + 1;
+                nextCode = endCode + 1;
+            }
+            prefix = c;
+        }
+
+        packer.write(prefix, codeSize);
+        packer.write(endCode, codeSize);
+        packer.finish();
+    }
+
+    void appendLe16(QByteArray &out, int value)
+    {
+        out.append(char(value & 0xff));
+        out.append(char((value >> 8) & 0xff));
+    }
+}
+
+GifEncoder::GifEncoder()
+    : device(nullptr),
+      failed(false),
+      dithering(false),
+      lastDelayOffset(-1),
+      lastDelayCs(0)
+{
+}
+
+GifEncoder::~GifEncoder()
+{
+    // 没有 close() 的文件不完整，不能替换目标文件
+    cancel();
+}
+
+bool GifEncoder::open(const QString &fileName, const QSize &size, bool loop)
+{
+    cancel();
+
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+    device = &file;
+    return writeHeader(size, loop);
+}
+
+bool GifEncoder::open(QIODevice *output, const QSize &size, bool loop)
+{
+    cancel();
+
+    // 相同的帧要回写上一帧的延时，设备必须可以 seek
+    if (!output || !output->isWritable() || output->isSequential())
+    {
+        return false;
+    }
+    device = output;
+    return writeHeader(size, loop);
+}
+
+bool GifEncoder::writeHeader(const QSize &size, bool loop)
+{
+    failed = false;
+    canvasSize = size;
+    previousFrame = QImage();
+    lastDelayOffset = -1;
+
+    QByteArray header("GIF89a");
+    appendLe16(header, size.width());
+    appendLe16(header, size.height());
+    header.append(char(0)); // 不使用全局调色板
+    header.append(char(0)); // 背景色
+    header.append(char(0)); // 像素宽高比
+
+    if (loop)
+    {
+        // NETSCAPE2.0 扩展：无限循环
+        header.append("\x21\xff\x0b" "NETSCAPE2.0" "\x03\x01", 16);
+        appendLe16(header, 0);
+        header.append(char(0));
+    }
+    write(header);
+    return !failed;
+}
+
+bool GifEncoder::close()
+{
+    if (!device)
+    {
+        return false;
+    }
+    write(QByteArray(1, char(0x3b)));
+    previousFrame = QImage();
+    QIODevice *output = device;
+    device = nullptr;
+    if (output != &file)
+    {
+        return !failed;
+    }
+    // 写入过程中出过错时 commit() 丢弃临时文件并返回 false
+    if (failed)
+    {
+        file.cancelWriting();
+    }
+    return file.commit();
+}
+
+void GifEncoder::cancel()
+{
+    if (!device)
+    {
+        return;
+    }
+    previousFrame = QImage();
+    if (device == &file)
+    {
+        file.cancelWriting();
+        file.commit();
+    }
+    device = nullptr;
+}
+
+QString GifEncoder::errorString() const
+{
+    return device ? device->errorString() : file.errorString();
+}
+
+void GifEncoder::write(const QByteArray &data)
+{
+    if (device->write(data) != data.size())
+    {
+        failed = true;
+    }
+}
+
+bool GifEncoder::addFrame(const QImage &frame, int delayMs, const QRect &hint)
+{
+    if (!device)
+    {
+        return false;
+    }
+
+    const QImage image = PixelFormat::toRgb32(frame, canvasSize);
+    const int delayCs = qMax(2, (delayMs + 5) / 10);
+
+    if (previousFrame.isNull())
+    {
+        writeFrame(image, image.rect(), delayCs, false);
+    }
+    else
+    {
+        const QRect bounds = changedBounds(image, hint);
+        if (bounds.isEmpty())
+        {
+            // 与上一帧相同：回写上一帧的延时，不输出新帧
+            const qint64 end = device->pos();
+            lastDelayCs = qMin(0xffff, lastDelayCs + delayCs);
+            QByteArray delay;
+            appendLe16(delay, lastDelayCs);
+            failed = failed || !device->seek(lastDelayOffset);
+            write(delay);
+            failed = failed || !device->seek(end);
+            return !failed;
+        }
+        writeFrame(image, bounds, delayCs, true);
+    }
+
+    previousFrame = image;
+    return !failed;
+}
+
+QRect GifEncoder::changedBounds(const QImage &frame, const QRect &hint) const
+{
+    const QRect area = hint.isEmpty() ? frame.rect() : hint.intersected(frame.rect());
+    int top = -1, bottom = -1;
+    int left = area.right() + 1, right = area.left() - 1;
+
+    for (int y = area.top(); y <= area.bottom(); ++y)
+    {
+        const quint32 *a = reinterpret_cast<const quint32 *>(frame.constScanLine(y)) + area.left();
+        const quint32 *b = reinterpret_cast<const quint32 *>(previousFrame.constScanLine(y)) + area.left();
+        const int first = firstDifference(a, b, area.width());
+        if (first == area.width())
+        {
+            continue;
+        }
+        if (top < 0)
+        {
+            top = y;
+        }
+        bottom = y;
+        left = qMin(left, area.left() + first);
+        right = qMax(right, area.left() + lastDifference(a, b, area.width()));
+    }
+
+    if (top < 0)
+    {
+        return QRect();
+    }
+    return QRect(QPoint(left, top), QPoint(right, bottom));
+}
+
+void GifEncoder::writeFrame(const QImage &frame, const QRect &rect, int delayCs, bool transparent)
+{
+    const QImage &previous = transparent ? previousFrame : QImage();
+
+    // 有透明色时留出最后一个索引
+    QVector<Bin> histogram = buildHistogram(frame, previous, rect);
+    QVector<QRgb> palette = octreePalette(histogram, transparent ? 255 : 256);
+    const QVector<quint8> lookup = buildLookup(palette);
+    const int transparentIndex = palette.size();
+
+    int tableBits = 1;
+    while ((1 << tableBits) < palette.size() + (transparent ? 1 : 0))
+    {
+        ++tableBits;
+    }
+
+    // 并行把像素映射为调色板索引
+    QVector<quint8> indices(rect.width() * rect.height());
+    quint8 *indexData = indices.data();
+    const QVector<QPair<int, int>> chunks = rowChunks(rect);
+    QVector<int> jobs(chunks.size());
+    for (int i = 0; i < jobs.size(); ++i)
+    {
+        jobs[i] = i;
+    }
+    const bool dither = dithering;
+    QtConcurrent::blockingMap(jobs, [&](int &job)
+                              {
+        for (int y = chunks.at(job).first; y < chunks.at(job).second; ++y)
+        {
+            const QRgb *line = reinterpret_cast<const QRgb *>(frame.constScanLine(y));
+            const QRgb *previousLine = previous.isNull() ? nullptr
+                                                         : reinterpret_cast<const QRgb *>(previous.constScanLine(y));
+            quint8 *out = indexData + (y - rect.top()) * rect.width();
+            for (int x = rect.left(); x <= rect.right(); ++x)
+            {
+                if (unchanged(line, previousLine, x))
+                {
+                    out[x - rect.left()] = quint8(transparentIndex);
+                    continue;
+                }
+                int r = qRed(line[x]), g = qGreen(line[x]), b = qBlue(line[x]);
+                if (dither)
+                {
+                    const int offset = Bayer4[y & 3][x & 3] - 8;
+                    r = qBound(0, r + offset, 255);
+                    g = qBound(0, g + offset, 255);
+                    b = qBound(0, b + offset, 255);
+                }
+                out[x - rect.left()] = lookup[binOf(r, g, b)];
+            }
+        } });
+
+    QByteArray data;
+
+    // 图形控制扩展：处置方式 1（保留上一帧），可选透明色
+    data.append("\x21\xf9\x04", 3);
+    data.append(char((1 << 2) | (transparent ? 1 : 0)));
+    lastDelayOffset = device->pos() + data.size();
+    lastDelayCs = delayCs;
+    appendLe16(data, delayCs);
+    data.append(char(transparent ? transparentIndex : 0));
+    data.append(char(0));
+
+    // 图像描述符 + 局部调色板
+    data.append(char(0x2c));
+    appendLe16(data, rect.x());
+    appendLe16(data, rect.y());
+    appendLe16(data, rect.width());
+    appendLe16(data, rect.height());
+    data.append(char(0x80 | (tableBits - 1)));
+    for (int i = 0; i < (1 << tableBits); ++i)
+    {
+        const QRgb color = i < palette.size() ? palette[i] : qRgb(0, 0, 0);
+        data.append(char(qRed(color)));
+        data.append(char(qGreen(color)));
+        data.append(char(qBlue(color)));
+    }
+
+    lzwEncode(indices, qMax(2, tableBits), data);
+    write(data);
+}
@@ -0,0 +1,51 @@
+#ifndef GIFENCODER_H
+#define GIFENCODER_H
+
+#include <QImage>
+#include <QSaveFile>
+#include <QVector>
+
+// GIF 动画编码器
+// 每一帧只输出与上一帧相比发生变化的外接矩形，矩形内未变化的像素用透明色表示；
+// 调色板按帧局部生成：并行统计颜色直方图，再用八叉树归并到 255 色以内，
+// 可选 4x4 有序抖动。
+class GifEncoder
+{
+public:
+    GifEncoder();
+    ~GifEncoder();
+
+    bool open(const QString &fileName, const QSize &size, bool loop = true);
+    // 写入调用方已经以写方式打开的设备（必须可以 seek），不负责提交或关闭它
+    bool open(QIODevice *output, const QSize &size, bool loop = true);
+    // 写完文件尾；按文件名打开时随后替换目标文件。cancel() 丢弃已写的内容，目标文件保持原样。
+    // 析构时还没有 close() 的编码器按 cancel() 处理
+    bool close();
+    void cancel();
+    bool isOpen() const { return device != nullptr; }
+
+    void setDithering(bool enabled) { dithering = enabled; }
+
+    // 追加一帧并在之后显示 delayMs 毫秒。hint 为调用方已知的变化区域（如录屏图块），
+    // 为空时与上一帧整帧比较。与上一帧完全相同时只延长上一帧的显示时间
+    bool addFrame(const QImage &frame, int delayMs, const QRect &hint = QRect());
+
+    QString errorString() const;
+
+private:
+    QRect changedBounds(const QImage &frame, const QRect &hint) const;
+    bool writeHeader(const QSize &size, bool loop);
+    void writeFrame(const QImage &frame, const QRect &rect, int delayCs, bool transparent);
+    void write(const QByteArray &data);
+
+    QSaveFile file;         // 按文件名打开时使用，close() 成功时才替换目标文件
+    QIODevice *device;      // 正在写入的设备：file 或调用方的设备，没有打开时为 nullptr
+    bool failed;            // 写入出过错
+    QSize canvasSize;
+    QImage previousFrame;   // 上一帧原图，用于差分
+    bool dithering;
+    qint64 lastDelayOffset; // 上一帧图形控制扩展中延时字段的位置，用于合并相同帧
+    int lastDelayCs;
+};
+
+#endif // GIFENCODER_H
@@ -0,0 +1,202 @@
+#include "globalhotkey.h"
+#include "x11capture.h"
+#include <QElapsedTimer>
+#include <QStringList>
+
+#ifdef SCREENSNIPER_X11
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/keysym.h>
+#include <poll.h>
+#endif
+
+#ifdef SCREENSNIPER_X11
+namespace
+{
+    struct HotkeyBinding
+    {
+        KeySym keysym;
+        GlobalHotkeyThread::Action action;
+        KeyCode keycode;
+    };
+
+    // 读取 X 服务器当前的时间戳（毫秒）：在自己的窗口上追加一个空属性，
+    // 服务器产生的 PropertyNotify 带有当时的服务器时间。只取这一个事件，其他事件留在队列中
+    Time serverTime(Display *display, Window window, Atom property)
+    {
+        XChangeProperty(display, window, property, XA_STRING, 8, PropModeAppend, nullptr, 0);
+        XEvent event;
+        XWindowEvent(display, window, PropertyChangeMask, &event);
+        return event.xproperty.time;
+    }
+}
+#endif
+
+GlobalHotkeyThread::GlobalHotkeyThread(QObject *parent)
+    : QThread(parent),
+      lastLatencyUs(-1)
+{
+    qRegisterMetaType<GlobalHotkeyThread::Action>("GlobalHotkeyThread::Action");
+}
+
+GlobalHotkeyThread::~GlobalHotkeyThread()
+{
+    stop();
+}
+
+bool GlobalHotkeyThread::isSupported()
+{
+    return X11Capture::isAvailable();
+}
+
+void GlobalHotkeyThread::stop()
+{
+    if (isRunning())
+    {
+        requestInterruption();
+        wait();
+    }
+}
+
+qint64 GlobalHotkeyThread::lastGrabLatencyUs() const
+{
+    return lastLatencyUs.loadAcquire();
+}
+
+void GlobalHotkeyThread::run()
+{
+#ifdef SCREENSNIPER_X11
+    // 单独的 X 连接，只在本线程中使用
+    Display *display = XOpenDisplay(nullptr);
+    if (!display)
+    {
+        emit registrationFailed("无法连接到 X 服务器");
+        return;
+    }
+
+    Window root = DefaultRootWindow(display);
+
+    // 不映射的 1x1 窗口，只用来获取服务器时间
+    Window clockWindow = XCreateSimpleWindow(display, root, 0, 0, 1, 1, 0, 0, 0);
+    XSelectInput(display, clockWindow, PropertyChangeMask);
+    const Atom clockProperty = XInternAtom(display, "_SCREENSNIPER_CLOCK", False);
+
+    HotkeyBinding bindings[] = {
+        {XK_F, CaptureFullScreen, 0},
+        {XK_A, CaptureArea, 0},
+        {XK_W, CaptureWindow, 0},
+        {XK_R, ReopenRecent, 0},
+    };
+
+    // NumLock(Mod2) 和 CapsLock(Lock) 打开时修饰键掩码不同，需要把这些组合都注册上
+    const unsigned int modifiers = ControlMask | ShiftMask;
+    const unsigned int lockMasks[] = {0, LockMask, Mod2Mask, LockMask | Mod2Mask};
+
+    // XGrabKey 被其他程序占用时会产生 BadAccess，默认错误处理会直接退出进程，
+    // 所以在注册期间拦截错误，只记录
+    QStringList failedKeys;
+    {
+        X11Capture::ErrorTrap trap(display);
+        for (HotkeyBinding &binding : bindings)
+        {
+            binding.keycode = XKeysymToKeycode(display, binding.keysym);
+            if (!binding.keycode)
+            {
+                continue;
+            }
+
+            trap.clear();
+            for (unsigned int lockMask : lockMasks)
+            {
+                XGrabKey(display, binding.keycode, modifiers | lockMask, root, True,
+                         GrabModeAsync, GrabModeAsync);
+            }
+
+            if (trap.sync())
+            {
+                failedKeys << QString("Ctrl+Shift+%1").arg(QString::fromLatin1(XKeysymToString(binding.keysym)));
+                binding.keycode = 0;
+            }
+        }
+    }
+
+    if (!failedKeys.isEmpty())
+    {
+        emit registrationFailed(QString("快捷键已被其他程序占用：%1").arg(failedKeys.join("、")));
+    }
+
+    // 按住不放会产生自动重复的 KeyPress，短时间内的重复按键只截一次
+    QElapsedTimer sinceLastTrigger;
+    const int connectionFd = ConnectionNumber(display);
+
+    while (!isInterruptionRequested())
+    {
+        if (!XPending(display))
+        {
+            // 带超时等待，以便能响应 stop()；有事件时 poll 会立即返回，不增加按键延迟
+            pollfd fd = {connectionFd, POLLIN, 0};
+            poll(&fd, 1, 100);
+            continue;
+        }
+
+        XEvent event;
+        XNextEvent(display, &event);
+        if (event.type != KeyPress)
+        {
+            continue;
+        }
+
+        const HotkeyBinding *matched = nullptr;
+        for (const HotkeyBinding &binding : bindings)
+        {
+            if (binding.keycode && binding.keycode == event.xkey.keycode)
+            {
+                matched = &binding;
+                break;
+            }
+        }
+        if (!matched)
+        {
+            continue;
+        }
+        if (sinceLastTrigger.isValid() && sinceLastTrigger.elapsed() < 500)
+        {
+            continue;
+        }
+        sinceLastTrigger.start();
+
+        if (matched->action == ReopenRecent)
+        {
+            emit hotkeyTriggered(matched->action, QImage(), QPoint(event.xkey.x_root, event.xkey.y_root), 0);
+            continue;
+        }
+
+        // 先截图，再通知 GUI 线程去处理窗口
+        QPoint cursorPos(event.xkey.x_root, event.xkey.y_root);
+        QImage frame = X11Capture::grabRootRect(display, X11Capture::rootGeometry(display));
+
+        // 从服务器生成按键事件算起，包括事件在队列中等待的时间；时间戳为 32 位毫秒数，差值按无符号数计算以处理回绕
+        const quint32 elapsedMs = quint32(serverTime(display, clockWindow, clockProperty)) - quint32(event.xkey.time);
+        const qint64 latencyUs = qint64(elapsedMs) * 1000;
+        lastLatencyUs.storeRelease(latencyUs);
+
+        if (!frame.isNull())
+        {
+            emit hotkeyTriggered(matched->action, frame, cursorPos, latencyUs);
+        }
+    }
+
+    for (const HotkeyBinding &binding : bindings)
+    {
+        if (binding.keycode)
+        {
+            for (unsigned int lockMask : lockMasks)
+            {
+                XUngrabKey(display, binding.keycode, modifiers | lockMask, root);
+            }
+        }
+    }
+    XDestroyWindow(display, clockWindow);
+    XCloseDisplay(display);
+#endif
+}
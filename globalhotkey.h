@@ -0,0 +1,53 @@
+#ifndef GLOBALHOTKEY_H
+#define GLOBALHOTKEY_H
+
+#include <QThread>
+#include <QImage>
+#include <QPoint>
+#include <QAtomicInteger>
+
+// 全局快捷键线程
+// 在 X11 下通过 XGrabKey 注册 Ctrl+Shift+F/A/W/R，并在独立线程里等待按键。
+// 截图类的按键到达后在本线程内直接截取整个根窗口，不经过任何窗口的显示/隐藏，
+// 画面定格在按下快捷键的那一刻，然后再把截图交给 GUI 线程。
+// Ctrl+Shift+R 重新打开最近的截图，不截屏。
+class GlobalHotkeyThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    enum Action
+    {
+        CaptureFullScreen,
+        CaptureArea,
+        CaptureWindow,
+        ReopenRecent
+    };
+    Q_ENUM(Action)
+
+    explicit GlobalHotkeyThread(QObject *parent = nullptr);
+    ~GlobalHotkeyThread();
+
+    // 当前平台是否支持全局快捷键
+    static bool isSupported();
+
+    // 请求线程退出并等待结束
+    void stop();
+
+    // 最近一次从 X 服务器产生按键事件到截图完成的耗时（微秒，毫秒精度），没有截过图时为 -1
+    qint64 lastGrabLatencyUs() const;
+
+signals:
+    // frame 为整个虚拟桌面的物理像素截图（ReopenRecent 时为空），cursorPos 为按键时鼠标的物理像素位置
+    void hotkeyTriggered(GlobalHotkeyThread::Action action, const QImage &frame,
+                         const QPoint &cursorPos, qint64 latencyUs);
+    void registrationFailed(const QString &reason);
+
+protected:
+    void run() override;
+
+private:
+    QAtomicInteger<qint64> lastLatencyUs;
+};
+
+#endif // GLOBALHOTKEY_H
@@ -0,0 +1,131 @@
+#include "historydialog.h"
+#include "capturehistory.h"
+#include <QDesktopServices>
+#include <QFileInfo>
+#include <QLabel>
+#include <QListView>
+#include <QUrl>
+#include <QVBoxLayout>
+
+CaptureHistoryModel::CaptureHistoryModel(CaptureHistory *history, QObject *parent)
+    : QAbstractListModel(parent),
+      history(history),
+      rows(history->count()),
+      thumbnails(2000)
+{
+    connect(history, &CaptureHistory::entryAdded, this, &CaptureHistoryModel::onEntryAdded);
+}
+
+int CaptureHistoryModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : rows;
+}
+
+QVariant CaptureHistoryModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= rows)
+    {
+        return QVariant();
+    }
+
+    const int i = historyIndex(index.row());
+    if (role == Qt::DecorationRole)
+    {
+        if (QPixmap *cached = thumbnails.object(i))
+        {
+            return *cached;
+        }
+        const QImage thumbnail = history->thumbnail(i);
+        if (thumbnail.isNull())
+        {
+            return QVariant();
+        }
+        QPixmap *pixmap = new QPixmap(QPixmap::fromImage(thumbnail));
+        thumbnails.insert(i, pixmap);
+        return *pixmap;
+    }
+    if (role == Qt::DisplayRole)
+    {
+        return history->entry(i).time.toString("MM-dd hh:mm");
+    }
+    if (role == Qt::ToolTipRole)
+    {
+        const CaptureHistory::Entry entry = history->entry(i);
+        return QString("%1\n%2 x %3\n%4")
+            .arg(entry.path)
+            .arg(entry.size.width())
+            .arg(entry.size.height())
+            .arg(entry.time.toString("yyyy-MM-dd hh:mm:ss"));
+    }
+    return QVariant();
+}
+
+QString CaptureHistoryModel::filePath(const QModelIndex &index) const
+{
+    if (!index.isValid() || index.row() >= rows)
+    {
+        return QString();
+    }
+    return history->entry(historyIndex(index.row())).path;
+}
+
+void CaptureHistoryModel::onEntryAdded(int index)
+{
+    if (index < rows)
+    {
+        return;
+    }
+    // 新记录排在最前面
+    beginInsertRows(QModelIndex(), 0, index - rows);
+    rows = index + 1;
+    endInsertRows();
+}
+
+HistoryDialog::HistoryDialog(CaptureHistory *history, QWidget *parent)
+    : QDialog(parent),
+      model(new CaptureHistoryModel(history, this)),
+      listView(new QListView(this)),
+      summaryLabel(new QLabel(this))
+{
+    setWindowTitle("截图历史");
+    resize(640, 480);
+
+    // 统一尺寸 + 分批布局：视图不需要逐项计算尺寸，只为可见的项请求数据
+    listView->setViewMode(QListView::ListMode);
+    listView->setFlow(QListView::LeftToRight);
+    listView->setWrapping(true);
+    listView->setResizeMode(QListView::Adjust);
+    listView->setUniformItemSizes(true);
+    listView->setLayoutMode(QListView::Batched);
+    listView->setIconSize(QSize(CaptureHistory::ThumbnailSize, CaptureHistory::ThumbnailSize));
+    listView->setGridSize(QSize(CaptureHistory::ThumbnailSize + 40, CaptureHistory::ThumbnailSize + 30));
+    listView->setModel(model);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(listView);
+    layout->addWidget(summaryLabel);
+
+    connect(listView, &QListView::doubleClicked, this, &HistoryDialog::openEntry);
+    connect(model, &QAbstractItemModel::rowsInserted, this, &HistoryDialog::updateSummary);
+    updateSummary();
+}
+
+void HistoryDialog::openEntry(const QModelIndex &index)
+{
+    const QString path = model->filePath(index);
+    if (path.isEmpty())
+    {
+        return;
+    }
+    if (!QFileInfo::exists(path))
+    {
+        summaryLabel->setText(QString("文件已不存在：%1").arg(path));
+        return;
+    }
+    QDesktopServices::openUrl(QUrl::fromLocalFile(path));
+}
+
+void HistoryDialog::updateSummary()
+{
+    summaryLabel->setText(QString("共 %1 张截图，双击打开").arg(model->rowCount()));
+}
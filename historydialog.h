@@ -0,0 +1,56 @@
+#ifndef HISTORYDIALOG_H
+#define HISTORYDIALOG_H
+
+#include <QDialog>
+#include <QAbstractListModel>
+#include <QCache>
+#include <QPixmap>
+
+class QLabel;
+class QListView;
+class CaptureHistory;
+
+// 截图历史列表模型，最新的截图排在最前面。
+// 数据直接从映射到内存的索引中按行读取，视图只为可见的行请求数据
+class CaptureHistoryModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    explicit CaptureHistoryModel(CaptureHistory *history, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    QString filePath(const QModelIndex &index) const;
+
+private slots:
+    void onEntryAdded(int index);
+
+private:
+    int historyIndex(int row) const { return rows - 1 - row; }
+
+    CaptureHistory *history;
+    int rows;
+    mutable QCache<int, QPixmap> thumbnails; // 按索引下标缓存解包后的缩略图
+};
+
+// 截图历史窗口，双击打开截图文件
+class HistoryDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit HistoryDialog(CaptureHistory *history, QWidget *parent = nullptr);
+
+private slots:
+    void openEntry(const QModelIndex &index);
+    void updateSummary();
+
+private:
+    CaptureHistoryModel *model;
+    QListView *listView;
+    QLabel *summaryLabel;
+};
+
+#endif // HISTORYDIALOG_H
@@ -0,0 +1,290 @@
+#include "imagediff.h"
+#include "pixelhash.h"
+#include <QtConcurrent>
+#include <QPainter>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+    struct TileDiff
+    {
+        bool hashDiffers = false;
+        qint64 pixels = 0;
+        int maxDelta = 0;
+        QRect bounds; // 变化像素的包围盒
+    };
+
+    struct RowDiff
+    {
+        int first = -1; // 第一个变化像素在行内的位置，没有变化时为 -1
+        int last = -1;
+        int pixels = 0;
+        int maxDelta = 0;
+    };
+
+    // 热力图像素：透明度 95..254 随差值增大，颜色为纯红（预乘）
+    inline quint32 heatPixel(quint32 delta)
+    {
+        const quint32 alpha = ((delta * 160) >> 8) + 95;
+        return (alpha << 24) | (alpha << 16);
+    }
+
+    inline void markChanged(RowDiff &row, int x, quint32 delta)
+    {
+        if (row.first < 0)
+        {
+            row.first = x;
+        }
+        row.last = x;
+        ++row.pixels;
+        row.maxDelta = qMax(row.maxDelta, int(delta));
+    }
+
+    // 比较一行像素（RGB32），差值为三个颜色通道差的绝对值中最大的一个
+    RowDiff compareRow(const quint32 *a, const quint32 *b, quint32 *heat, int count, int threshold)
+    {
+        RowDiff row;
+        int x = 0;
+
+#if defined(__SSE2__)
+        const __m128i colorMask = _mm_set1_epi32(0x00ffffff);
+        const __m128i byteMask = _mm_set1_epi32(0xff);
+        const __m128i limit = _mm_set1_epi32(threshold);
+        const __m128i scale = _mm_set1_epi32(160);
+        const __m128i bias = _mm_set1_epi32(95);
+        for (; x + 4 <= count; x += 4)
+        {
+            const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + x));
+            const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + x));
+            const __m128i d = _mm_and_si128(_mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va)), colorMask);
+            // 字节最大值：移位后低字节依次对齐 G、R 通道
+            __m128i m = _mm_max_epu8(d, _mm_srli_epi32(d, 8));
+            m = _mm_and_si128(_mm_max_epu8(m, _mm_srli_epi32(d, 16)), byteMask);
+            const __m128i changed = _mm_cmpgt_epi32(m, limit);
+            const int mask = _mm_movemask_ps(_mm_castsi128_ps(changed));
+            if (mask == 0)
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(heat + x), _mm_setzero_si128());
+                continue;
+            }
+
+            // m 的高 16 位为 0，16 位乘法即可得到 m * 160
+            const __m128i alpha = _mm_and_si128(_mm_add_epi32(_mm_srli_epi32(_mm_mullo_epi16(m, scale), 8), bias), changed);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(heat + x),
+                             _mm_or_si128(_mm_slli_epi32(alpha, 24), _mm_slli_epi32(alpha, 16)));
+
+            quint32 deltas[4];
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(deltas), m);
+            for (int i = 0; i < 4; ++i)
+            {
+                if (mask & (1 << i))
+                {
+                    markChanged(row, x + i, deltas[i]);
+                }
+            }
+        }
+#elif defined(__ARM_NEON)
+        const uint32x4_t colorMask = vdupq_n_u32(0x00ffffff);
+        const uint32x4_t byteMask = vdupq_n_u32(0xff);
+        const uint32x4_t limit = vdupq_n_u32(quint32(threshold));
+        const uint32x4_t bias = vdupq_n_u32(95);
+        for (; x + 4 <= count; x += 4)
+        {
+            const uint8x16_t va = vreinterpretq_u8_u32(vld1q_u32(a + x));
+            const uint8x16_t vb = vreinterpretq_u8_u32(vld1q_u32(b + x));
+            const uint32x4_t d = vandq_u32(vreinterpretq_u32_u8(vabdq_u8(va, vb)), colorMask);
+            const uint8x16_t m8 = vmaxq_u8(vmaxq_u8(vreinterpretq_u8_u32(d), vreinterpretq_u8_u32(vshrq_n_u32(d, 8))),
+                                           vreinterpretq_u8_u32(vshrq_n_u32(d, 16)));
+            const uint32x4_t m = vandq_u32(vreinterpretq_u32_u8(m8), byteMask);
+            const uint32x4_t changed = vcgtq_u32(m, limit);
+            quint32 flags[4];
+            vst1q_u32(flags, changed);
+            if ((flags[0] | flags[1] | flags[2] | flags[3]) == 0)
+            {
+                vst1q_u32(heat + x, vdupq_n_u32(0));
+                continue;
+            }
+
+            const uint32x4_t alpha = vandq_u32(vaddq_u32(vshrq_n_u32(vmulq_n_u32(m, 160), 8), bias), changed);
+            vst1q_u32(heat + x, vorrq_u32(vshlq_n_u32(alpha, 24), vshlq_n_u32(alpha, 16)));
+
+            quint32 deltas[4];
+            vst1q_u32(deltas, m);
+            for (int i = 0; i < 4; ++i)
+            {
+                if (flags[i])
+                {
+                    markChanged(row, x + i, deltas[i]);
+                }
+            }
+        }
+#endif
+
+        for (; x < count; ++x)
+        {
+            const quint32 pa = a[x];
+            const quint32 pb = b[x];
+            quint32 delta = 0;
+            for (int shift = 0; shift < 24; shift += 8)
+            {
+                const int ca = int((pa >> shift) & 0xff);
+                const int cb = int((pb >> shift) & 0xff);
+                delta = qMax(delta, quint32(qAbs(ca - cb)));
+            }
+            if (int(delta) > threshold)
+            {
+                heat[x] = heatPixel(delta);
+                markChanged(row, x, delta);
+            }
+            else
+            {
+                heat[x] = 0;
+            }
+        }
+        return row;
+    }
+}
+
+namespace ImageDiff
+{
+
+Result compare(const QImage &before, const QImage &after, int threshold)
+{
+    Result result;
+    if (before.isNull() || after.isNull())
+    {
+        result.sizeMismatch = before.size() != after.size();
+        return result;
+    }
+
+    const QImage a = before.convertToFormat(QImage::Format_RGB32);
+    const QImage b = after.convertToFormat(QImage::Format_RGB32);
+    result.sizeMismatch = a.size() != b.size();
+    const QSize size = a.size().boundedTo(b.size());
+
+    result.heatmap = QImage(size, QImage::Format_ARGB32_Premultiplied);
+    result.heatmap.fill(Qt::transparent);
+
+    const int columns = (size.width() + TileSize - 1) / TileSize;
+    const int rows = (size.height() + TileSize - 1) / TileSize;
+    result.totalTiles = columns * rows;
+
+    QVector<int> jobs(result.totalTiles);
+    for (int i = 0; i < jobs.size(); ++i)
+    {
+        jobs[i] = i;
+    }
+    QVector<TileDiff> tiles(result.totalTiles);
+    TileDiff *tileData = tiles.data();
+
+    // 并行前先取得可写指针，避免在线程中触发 QImage 的分离
+    uchar *heatBits = result.heatmap.bits();
+    const qsizetype heatStride = result.heatmap.bytesPerLine();
+    QtConcurrent::blockingMap(jobs, [&](int &index)
+                              {
+        const QRect rect = QRect(index % columns * TileSize, index / columns * TileSize, TileSize, TileSize)
+                               .intersected(QRect(QPoint(0, 0), size));
+        // 快速路径：哈希相同的图块视为没有变化
+        if (PixelHash::hashRect(a, rect) == PixelHash::hashRect(b, rect))
+        {
+            return;
+        }
+
+        TileDiff &tile = tileData[index];
+        tile.hashDiffers = true;
+        int left = rect.right() + 1, right = -1, top = -1, bottom = -1;
+        for (int y = rect.top(); y <= rect.bottom(); ++y)
+        {
+            const quint32 *rowA = reinterpret_cast<const quint32 *>(a.constScanLine(y)) + rect.left();
+            const quint32 *rowB = reinterpret_cast<const quint32 *>(b.constScanLine(y)) + rect.left();
+            quint32 *heat = reinterpret_cast<quint32 *>(heatBits + y * heatStride) + rect.left();
+            const RowDiff row = compareRow(rowA, rowB, heat, rect.width(), threshold);
+            if (row.pixels == 0)
+            {
+                continue;
+            }
+            tile.pixels += row.pixels;
+            tile.maxDelta = qMax(tile.maxDelta, row.maxDelta);
+            left = qMin(left, rect.left() + row.first);
+            right = qMax(right, rect.left() + row.last);
+            if (top < 0)
+            {
+                top = y;
+            }
+            bottom = y;
+        }
+        if (tile.pixels > 0)
+        {
+            tile.bounds = QRect(QPoint(left, top), QPoint(right, bottom));
+        } });
+
+    for (const TileDiff &tile : tiles)
+    {
+        result.changedTiles += tile.hashDiffers ? 1 : 0;
+        result.changedPixels += tile.pixels;
+        result.maxDelta = qMax(result.maxDelta, tile.maxDelta);
+    }
+
+    // 八邻接的变化图块合并成一个区域
+    QVector<bool> visited(tiles.size(), false);
+    for (int start = 0; start < tiles.size(); ++start)
+    {
+        if (visited[start] || tiles[start].pixels == 0)
+        {
+            continue;
+        }
+        QRect region;
+        QVector<int> stack;
+        stack.append(start);
+        visited[start] = true;
+        while (!stack.isEmpty())
+        {
+            const int index = stack.takeLast();
+            region = region.united(tiles[index].bounds);
+            const int column = index % columns;
+            const int row = index / columns;
+            for (int dy = -1; dy <= 1; ++dy)
+            {
+                for (int dx = -1; dx <= 1; ++dx)
+                {
+                    const int c = column + dx;
+                    const int r = row + dy;
+                    if (c < 0 || r < 0 || c >= columns || r >= rows)
+                    {
+                        continue;
+                    }
+                    const int neighbor = r * columns + c;
+                    if (!visited[neighbor] && tiles[neighbor].pixels > 0)
+                    {
+                        visited[neighbor] = true;
+                        stack.append(neighbor);
+                    }
+                }
+            }
+        }
+        result.regions.append(region);
+    }
+    return result;
+}
+
+QImage renderOverlay(const QImage &after, const Result &result)
+{
+    QImage overlay = after.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    QPainter painter(&overlay);
+    painter.drawImage(0, 0, result.heatmap);
+    painter.setPen(QPen(QColor(255, 0, 0), 2));
+    painter.setBrush(Qt::NoBrush);
+    for (const QRect &region : result.regions)
+    {
+        painter.drawRect(region.adjusted(-1, -1, 1, 1));
+    }
+    painter.end();
+    return overlay;
+}
+
+}
@@ -0,0 +1,35 @@
+#ifndef IMAGEDIFF_H
+#define IMAGEDIFF_H
+
+#include <QImage>
+#include <QRect>
+#include <QVector>
+
+// 两张截图的差异比较，用于界面回归检查
+// 先按 64x64 图块比较哈希，只有哈希不同的图块才逐像素比较（SSE2/NEON 一次 4 个像素），
+// 图块之间在线程池中并行。相邻的变化图块合并成一个区域，用像素级的包围盒表示。
+namespace ImageDiff
+{
+    const int TileSize = 64;
+
+    struct Result
+    {
+        bool sizeMismatch = false;  // 尺寸不同时只比较左上角重叠的部分
+        int totalTiles = 0;
+        int changedTiles = 0;       // 哈希不同的图块数
+        qint64 changedPixels = 0;   // 某个通道差值超过阈值的像素数
+        int maxDelta = 0;           // 最大的单通道差值
+        QVector<QRect> regions;     // 变化区域的包围盒（像素坐标）
+        QImage heatmap;             // 预乘 ARGB，差值越大越红越不透明，没有变化处全透明
+
+        bool identical() const { return !sizeMismatch && changedPixels == 0; }
+    };
+
+    // threshold 为允许的单通道差值，用于忽略抗锯齿、压缩带来的轻微差异
+    Result compare(const QImage &before, const QImage &after, int threshold = 0);
+
+    // 把热力图和区域框画在 after 上，便于查看和保存
+    QImage renderOverlay(const QImage &after, const Result &result);
+}
+
+#endif // IMAGEDIFF_H
@@ -0,0 +1,168 @@
+#include "imageeffects.h"
+#include "pixelformat.h"
+#include <QVector>
+
+namespace
+{
+    // 盒式模糊的次数，三次之后已经很接近高斯分布
+    const int BoxPasses = 3;
+
+    // 不能直接处理的格式先转换为 32 位格式
+    void convertUnsupported(QImage &image)
+    {
+        image = image.convertToFormat(image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied
+                                                              : QImage::Format_RGB32);
+    }
+
+    // 一行（或步长为 step 的一列）像素的盒式模糊，边缘重复最外侧的像素。
+    // 滑动窗口维护四个通道的和，每个像素只加一次、减一次
+    void boxBlurLine(const QRgb *src, QRgb *dst, int count, int step, int radius)
+    {
+        const int window = 2 * radius + 1;
+        const int half = window / 2;
+        int sum[4] = {0, 0, 0, 0};
+        auto add = [&sum](QRgb pixel, int weight)
+        {
+            sum[0] += int(qAlpha(pixel)) * weight;
+            sum[1] += int(qRed(pixel)) * weight;
+            sum[2] += int(qGreen(pixel)) * weight;
+            sum[3] += int(qBlue(pixel)) * weight;
+        };
+
+        add(src[0], radius + 1);
+        for (int i = 1; i <= radius; ++i)
+        {
+            add(src[qMin(i, count - 1) * step], 1);
+        }
+        for (int i = 0; i < count; ++i)
+        {
+            dst[i * step] = qRgba((sum[1] + half) / window, (sum[2] + half) / window,
+                                  (sum[3] + half) / window, (sum[0] + half) / window);
+            add(src[qMin(i + radius + 1, count - 1) * step], 1);
+            add(src[qMax(i - radius, 0) * step], -1);
+        }
+    }
+
+    template <typename Format>
+    void blurPixels(QImage &image, const QRect &rect, int boxRadius)
+    {
+        const int width = rect.width();
+        const int height = rect.height();
+
+        // 在区域的预乘副本上来回处理，最后按原格式写回
+        QVector<QRgb> a(width * height);
+        QVector<QRgb> b(width * height);
+        for (int y = 0; y < height; ++y)
+        {
+            const uchar *line = image.constScanLine(rect.y() + y) + rect.x() * Format::bytesPerPixel;
+            QRgb *row = a.data() + y * width;
+            for (int x = 0; x < width; ++x)
+            {
+                row[x] = Format::load(line + x * Format::bytesPerPixel);
+            }
+        }
+
+        for (int pass = 0; pass < BoxPasses; ++pass)
+        {
+            for (int y = 0; y < height; ++y)
+            {
+                boxBlurLine(a.constData() + y * width, b.data() + y * width, width, 1, boxRadius);
+            }
+            for (int x = 0; x < width; ++x)
+            {
+                boxBlurLine(b.constData() + x, a.data() + x, height, width, boxRadius);
+            }
+        }
+
+        for (int y = 0; y < height; ++y)
+        {
+            uchar *line = image.scanLine(rect.y() + y) + rect.x() * Format::bytesPerPixel;
+            const QRgb *row = a.constData() + y * width;
+            for (int x = 0; x < width; ++x)
+            {
+                Format::store(line + x * Format::bytesPerPixel, row[x]);
+            }
+        }
+    }
+
+    template <typename Format>
+    void mosaicPixels(QImage &image, const QRect &rect, int blockSize)
+    {
+        for (int top = rect.top(); top <= rect.bottom(); top += blockSize)
+        {
+            const int bottom = qMin(top + blockSize - 1, rect.bottom());
+            for (int left = rect.left(); left <= rect.right(); left += blockSize)
+            {
+                const int right = qMin(left + blockSize - 1, rect.right());
+                const int count = (right - left + 1) * (bottom - top + 1);
+
+                quint32 sum[4] = {0, 0, 0, 0};
+                for (int y = top; y <= bottom; ++y)
+                {
+                    const uchar *line = image.constScanLine(y);
+                    for (int x = left; x <= right; ++x)
+                    {
+                        const QRgb pixel = Format::load(line + x * Format::bytesPerPixel);
+                        sum[0] += qAlpha(pixel);
+                        sum[1] += qRed(pixel);
+                        sum[2] += qGreen(pixel);
+                        sum[3] += qBlue(pixel);
+                    }
+                }
+                const QRgb average = qRgba((sum[1] + count / 2) / count, (sum[2] + count / 2) / count,
+                                           (sum[3] + count / 2) / count, (sum[0] + count / 2) / count);
+                for (int y = top; y <= bottom; ++y)
+                {
+                    uchar *line = image.scanLine(y);
+                    for (int x = left; x <= right; ++x)
+                    {
+                        Format::store(line + x * Format::bytesPerPixel, average);
+                    }
+                }
+            }
+        }
+    }
+}
+
+namespace ImageEffects
+{
+    void blur(QImage &image, const QRect &area, int radius)
+    {
+        const QRect rect = area.intersected(image.rect());
+        if (rect.isEmpty() || radius < 1)
+        {
+            return;
+        }
+
+        // 每次盒式模糊的半径：三次叠加后的标准差约为 r，取 radius / 2 让整体范围接近 radius
+        const int boxRadius = qMax(1, radius / 2);
+        auto run = [&](auto format)
+        {
+            blurPixels<decltype(format)>(image, rect, boxRadius);
+        };
+        if (!PixelFormat::dispatch(image.format(), run))
+        {
+            convertUnsupported(image);
+            PixelFormat::dispatch(image.format(), run);
+        }
+    }
+
+    void mosaic(QImage &image, const QRect &area, int blockSize)
+    {
+        const QRect rect = area.intersected(image.rect());
+        if (rect.isEmpty() || blockSize < 2)
+        {
+            return;
+        }
+
+        auto run = [&](auto format)
+        {
+            mosaicPixels<decltype(format)>(image, rect, blockSize);
+        };
+        if (!PixelFormat::dispatch(image.format(), run))
+        {
+            convertUnsupported(image);
+            PixelFormat::dispatch(image.format(), run);
+        }
+    }
+}
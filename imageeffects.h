@@ -0,0 +1,22 @@
+#ifndef IMAGEEFFECTS_H
+#define IMAGEEFFECTS_H
+
+#include <QImage>
+#include <QRect>
+
+// 打码效果：模糊和马赛克
+// 只处理 area 与图像相交的部分，区域外的像素既不修改也不参与计算，
+// 打码区域边缘不会混入外面的内容。RGB32、ARGB32、ARGB32_Premultiplied 和 RGB888
+// 直接在原格式上处理（见 PixelFormat），按预乘值计算，带透明度时边缘不发黑；
+// 其它格式先转换为 32 位格式。
+// 每个函数只在调用线程中运行，批量处理时由调用方按文件并行。
+namespace ImageEffects
+{
+    // 三次盒式模糊近似高斯模糊，每次的开销与半径无关。radius 大约等于高斯模糊的半径
+    void blur(QImage &image, const QRect &area, int radius);
+
+    // 以 area 左上角为起点分成 blockSize x blockSize 的块，每块填充块内的平均颜色
+    void mosaic(QImage &image, const QRect &area, int blockSize);
+}
+
+#endif // IMAGEEFFECTS_H
@@ -0,0 +1,420 @@
+#include "imageexporter.h"
+#include "gifencoder.h"
+#include "recordingformat.h"
+#include "mipmappyramid.h"
+#include "resampler.h"
+#include <QImageReader>
+#include <QImageWriter>
+#include <QFile>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QSettings>
+#include <QFuture>
+#include <QtConcurrent>
+#include <QRandomGenerator>
+#include <QSharedPointer>
+#include <QDebug>
+#include <algorithm>
+
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <cstdio>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    void setError(QString *errorMessage, const QString &message)
+    {
+        if (errorMessage)
+        {
+            *errorMessage = message;
+        }
+    }
+
+    bool isGif(const QString &fileName)
+    {
+        return QFileInfo(fileName).suffix().compare("gif", Qt::CaseInsensitive) == 0;
+    }
+
+    // 长边缩到 maxSize 时的尺寸，原图不超过时不变
+    QSize variantSize(const QSize &size, int maxSize)
+    {
+        const int longSide = qMax(size.width(), size.height());
+        if (longSide <= maxSize)
+        {
+            return size;
+        }
+        return QSize(qMax(1, int(qint64(size.width()) * maxSize / longSide)),
+                     qMax(1, int(qint64(size.height()) * maxSize / longSide)));
+    }
+
+    // 按 fileName 的扩展名选择编码器，把 image 编码写入已经打开的 file，不提交
+    bool encodeImage(const QImage &image, const QString &fileName, QSaveFile &file, QString *errorMessage)
+    {
+        if (isGif(fileName))
+        {
+            GifEncoder encoder;
+            // 静态图片只有一帧，开启抖动减轻色带
+            encoder.setDithering(true);
+            if (!encoder.open(&file, image.size(), false) || !encoder.addFrame(image, 0) || !encoder.close())
+            {
+                setError(errorMessage, "写入 GIF 失败：" + file.errorString());
+                return false;
+            }
+            return true;
+        }
+        QImageWriter writer(&file, QFileInfo(fileName).suffix().toLower().toLatin1());
+        if (!writer.write(image))
+        {
+            setError(errorMessage, writer.errorString());
+            return false;
+        }
+        return true;
+    }
+
+    // 在线程池中打开 file 并编码，返回错误信息，成功时为空。file 由调用方持有，在结果出来之前不能释放
+    QFuture<QString> encodeAsync(const QImage &image, QSaveFile *file)
+    {
+        return QtConcurrent::run([image, file]()
+        {
+            if (!file->open(QIODevice::WriteOnly))
+            {
+                return file->errorString();
+            }
+            QString error;
+            return encodeImage(image, file->fileName(), *file, &error) ? QString() : error;
+        });
+    }
+}
+
+namespace ImageExporter
+{
+    QString imageFilters()
+    {
+        return "PNG图片 (*.png);;JPEG图片 (*.jpg);;GIF图片 (*.gif);;所有文件 (*.*)";
+    }
+
+    bool saveImage(const QImage &image, const QString &fileName, QString *errorMessage)
+    {
+        if (image.isNull())
+        {
+            setError(errorMessage, "图片为空");
+            return false;
+        }
+
+        // 先写临时文件，成功后才替换目标文件，失败时原来的文件保持不变
+        QSaveFile file(fileName);
+        if (!file.open(QIODevice::WriteOnly))
+        {
+            setError(errorMessage, file.errorString());
+            return false;
+        }
+        if (!encodeImage(image, fileName, file, errorMessage))
+        {
+            return false;
+        }
+        if (!file.commit())
+        {
+            setError(errorMessage, file.errorString());
+            return false;
+        }
+        return true;
+    }
+
+    QVector<Variant> configuredVariants()
+    {
+        QVector<Variant> variants;
+        const QStringList entries = QSettings().value("export/variants").toString().split(',', Qt::SkipEmptyParts);
+        for (const QString &entry : entries)
+        {
+            const QStringList parts = entry.trimmed().split(':');
+            Variant variant;
+            variant.name = parts.value(0).trimmed();
+            variant.maxSize = parts.value(1).toInt();
+            // 名字会拼进文件名，不能带路径分隔符或 ..，否则缩小版本会写到别的目录；
+            // 同名的两个版本会写同一个文件，只保留第一个
+            const bool duplicate = std::any_of(variants.cbegin(), variants.cend(), [&variant](const Variant &other)
+                                               { return other.name == variant.name; });
+            if (variant.name.isEmpty() || variant.maxSize <= 0 || variant.name.contains('/') ||
+                variant.name.contains('\\') || variant.name.contains("..") || duplicate)
+            {
+                qWarning() << "ImageExporter: ignoring export variant" << entry;
+                continue;
+            }
+            variants.append(variant);
+        }
+        return variants;
+    }
+
+    QString variantFileName(const QString &fileName, const Variant &variant)
+    {
+        const QFileInfo info(fileName);
+        return info.dir().filePath(info.completeBaseName() + "_" + variant.name + "." + info.suffix());
+    }
+
+    bool saveImageWithVariants(const QImage &image, const QString &fileName, const QVector<Variant> &variants,
+                               bool writeFull, QString *errorMessage)
+    {
+        if (image.isNull())
+        {
+            setError(errorMessage, "图片为空");
+            return false;
+        }
+
+        // 每个文件写进自己的 QSaveFile（临时文件），全部编码成功后才一起替换目标文件
+        QVector<QSharedPointer<QSaveFile>> files;
+        QVector<QFuture<QString>> encodes;  // 与 files 一一对应
+        auto encode = [&files, &encodes](const QImage &pixels, const QString &path)
+        {
+            files.append(QSharedPointer<QSaveFile>::create(path));
+            encodes.append(encodeAsync(pixels, files.last().data()));
+        };
+        if (writeFull)
+        {
+            // 原图不需要缩小，先开始编码，与下面的缩小并行
+            encode(image, fileName);
+        }
+
+        // 2x2 平均要求 32 位格式；未预乘的 ARGB 直接平均颜色会偏，先转成预乘格式
+        QImage level = image;
+        if (level.format() != QImage::Format_RGB32 && level.format() != QImage::Format_ARGB32_Premultiplied)
+        {
+            level = image.convertToFormat(image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied
+                                                                  : QImage::Format_RGB32);
+        }
+
+        // 从大到小生成，每个版本接着上一个版本停下的级别继续减半，整个过程只读一遍原图
+        QVector<Variant> ordered = variants;
+        std::stable_sort(ordered.begin(), ordered.end(), [](const Variant &a, const Variant &b)
+                         { return a.maxSize > b.maxSize; });
+        for (const Variant &variant : ordered)
+        {
+            const QSize target = variantSize(image.size(), variant.maxSize);
+            while (level.width() / 2 >= target.width() && level.height() / 2 >= target.height())
+            {
+                level = MipmapPyramid::downsample(level);
+            }
+            const QImage scaled = level.size() == target ? level : Resampler::scaled(level, target, Resampler::Bilinear);
+            encode(target == image.size() ? image : scaled, variantFileName(fileName, variant));
+        }
+
+        // 等所有编码结束（files 在这之前不能释放），任何一个失败时全部放弃：
+        // 临时文件被删除，目标位置原有的文件都不变，不会只替换了其中一部分
+        bool ok = true;
+        for (QFuture<QString> &result : encodes)
+        {
+            const QString error = result.result();
+            if (!error.isEmpty() && ok)
+            {
+                setError(errorMessage, error);
+                ok = false;
+            }
+        }
+        for (const QSharedPointer<QSaveFile> &file : files)
+        {
+            if (ok && !file->commit())
+            {
+                setError(errorMessage, file->errorString());
+                ok = false;
+            }
+            else if (!ok)
+            {
+                // 没有提交的 QSaveFile 释放时删除临时文件
+                file->cancelWriting();
+            }
+        }
+        return ok;
+    }
+
+    QVector<Variant> linkVariants(const QString &existingFile, const QString &fileName, const QSize &size,
+                                  const QVector<Variant> &variants)
+    {
+        QVector<Variant> missing;
+        for (const Variant &variant : variants)
+        {
+            // 已有的缩小版本可能是按另一种配置生成的，尺寸相同才能共用
+            const QString existing = variantFileName(existingFile, variant);
+            if (QImageReader(existing).size() != variantSize(size, variant.maxSize) ||
+                !linkDuplicate(existing, variantFileName(fileName, variant)))
+            {
+                missing.append(variant);
+            }
+        }
+        return missing;
+    }
+
+    bool samePixels(const QString &fileName, const QImage &image)
+    {
+        QImageReader reader(fileName);
+        if (reader.size() != image.size())
+        {
+            return false;
+        }
+        const QImage existing = reader.read();
+        return !existing.isNull() && existing.convertToFormat(image.format()) == image;
+    }
+
+    bool linkDuplicate(const QString &existingFile, const QString &fileName, QString *errorMessage)
+    {
+        const QString target = QFileInfo(existingFile).canonicalFilePath();
+        if (target.isEmpty())
+        {
+            setError(errorMessage, "原截图已不存在");
+            return false;
+        }
+        // 保存到原截图本身时什么都不用做
+        const QFileInfo info(fileName);
+        if (info.absoluteFilePath() == target || info.canonicalFilePath() == target)
+        {
+            return true;
+        }
+        const QString directory = QFileInfo(info.absolutePath()).canonicalFilePath();
+        if (directory.isEmpty())
+        {
+            setError(errorMessage, "目标目录不存在");
+            return false;
+        }
+
+#ifdef Q_OS_UNIX
+        // 相对链接：截图目录整体移动或改名后仍然有效。
+        // 先在同一目录下用临时名字创建链接，再 rename 原子地替换 fileName（保存对话框已经确认过覆盖），
+        // 任何一步失败时原来的 fileName 都保持不变
+        const QByteArray linkTarget = QFile::encodeName(QDir(directory).relativeFilePath(target));
+        for (int attempt = 0; attempt < 16; ++attempt)
+        {
+            const QString temporary = QDir(directory).filePath(
+                QString(".%1.%2.link").arg(info.fileName()).arg(QRandomGenerator::global()->generate(), 8, 16, QChar('0')));
+            if (::symlink(linkTarget.constData(), QFile::encodeName(temporary).constData()) != 0)
+            {
+                if (errno == EEXIST)
+                {
+                    continue;
+                }
+                break;
+            }
+            if (::rename(QFile::encodeName(temporary).constData(), QFile::encodeName(fileName).constData()) != 0)
+            {
+                QFile::remove(temporary);
+                break;
+            }
+            return true;
+        }
+        setError(errorMessage, "无法创建链接");
+        return false;
+#else
+        // Windows 上 QFile::link 创建的是 .lnk 快捷方式，图片查看器和其他程序都不认，只能复制一份
+        QFile source(target);
+        QSaveFile copy(fileName);
+        if (!source.open(QIODevice::ReadOnly) || !copy.open(QIODevice::WriteOnly))
+        {
+            setError(errorMessage, "无法复制原截图");
+            return false;
+        }
+        while (!source.atEnd())
+        {
+            const QByteArray block = source.read(1 << 20);
+            if (block.isEmpty() || copy.write(block) != block.size())
+            {
+                copy.cancelWriting();
+                break;
+            }
+        }
+        if (!copy.commit())
+        {
+            setError(errorMessage, "无法复制原截图");
+            return false;
+        }
+        return true;
+#endif
+    }
+
+    bool exportImage(const QImage &image, const QString &fileName, const QVector<Variant> &variants,
+                     const QStringList &duplicates, QString *errorMessage)
+    {
+        // 感知哈希相近只说明看起来像，只有解码后像素完全相同才链接；
+        // 链接只能替代同一种格式的文件；原文件已被删除时照常写入
+        const QString suffix = QFileInfo(fileName).suffix();
+        for (const QString &path : duplicates)
+        {
+            if (QFileInfo(path).suffix().compare(suffix, Qt::CaseInsensitive) != 0 || !QFileInfo::exists(path) ||
+                !samePixels(path, image))
+            {
+                continue;
+            }
+            // 缩小版本同样链接到原截图的，原截图缺少的版本和链接失败的文件照常生成
+            const QVector<Variant> missing = linkVariants(path, fileName, image.size(), variants);
+            const bool linked = linkDuplicate(path, fileName);
+            if (linked && missing.isEmpty())
+            {
+                return true;
+            }
+            return saveImageWithVariants(image, fileName, missing, !linked, errorMessage);
+        }
+
+        if (variants.isEmpty())
+        {
+            return saveImage(image, fileName, errorMessage);
+        }
+        return saveImageWithVariants(image, fileName, variants, true, errorMessage);
+    }
+
+    bool exportRecordingToGif(const QString &recordingFile, const QString &gifFile,
+                              bool dithering, QString *errorMessage)
+    {
+        RecordingReader reader;
+        if (!reader.open(recordingFile))
+        {
+            setError(errorMessage, "无法读取录屏文件");
+            return false;
+        }
+
+        GifEncoder encoder;
+        if (!encoder.open(gifFile, reader.frameSize()))
+        {
+            setError(errorMessage, encoder.errorString());
+            return false;
+        }
+        encoder.setDithering(dithering);
+
+        // 一帧的显示时间要等读到下一帧才知道，所以总是滞后一帧写入
+        QImage pending;
+        QRect pendingRect;
+        qint64 pendingTimestamp = 0;
+        int frames = 0;
+
+        QImage frame;
+        QRect changed;
+        qint64 timestamp = 0;
+        while (reader.readFrame(frame, timestamp, &changed))
+        {
+            if (!pending.isNull())
+            {
+                encoder.addFrame(pending, int(timestamp - pendingTimestamp), pendingRect);
+            }
+            pending = frame;
+            pendingRect = changed;
+            pendingTimestamp = timestamp;
+            ++frames;
+        }
+        if (!pending.isNull())
+        {
+            const int fps = qMax(1, reader.fps());
+            encoder.addFrame(pending, 1000 / fps, pendingRect);
+        }
+
+        if (frames == 0)
+        {
+            encoder.cancel();
+            setError(errorMessage, "录屏中没有画面");
+            return false;
+        }
+        if (!encoder.close())
+        {
+            setError(errorMessage, "写入 GIF 失败");
+            return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef IMAGEEXPORTER_H
+#define IMAGEEXPORTER_H
+
+#include <QImage>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// 截图和录屏的导出
+// Qt 自带的图片插件不能写 GIF，.gif 交给 GifEncoder，其余格式仍由 QImageWriter 处理。
+namespace ImageExporter
+{
+    // 保存对话框使用的静态图片过滤器
+    QString imageFilters();
+
+    // 按扩展名选择编码器保存图片，失败时 errorMessage 中给出原因。
+    // 先写临时文件，成功后才替换 fileName，失败时不会留下残缺的文件，原有的文件也不变
+    bool saveImage(const QImage &image, const QString &fileName, QString *errorMessage = nullptr);
+
+    // 与原图一起输出的缩小版本（缩略图、预览图等）
+    struct Variant
+    {
+        QString name;     // 加在文件名后面：screenshot_xxx_<name>.png
+        int maxSize = 0;  // 长边的像素数，原图不超过这个尺寸时原样输出
+    };
+
+    // 设置项 export/variants 中配置的缩小版本，格式为 "thumb:256,preview:1280"，默认没有。
+    // 名字为空、重复或带路径分隔符、.. 的项被忽略
+    QVector<Variant> configuredVariants();
+
+    // 缩小版本的文件名：与原图同一目录、同一格式
+    QString variantFileName(const QString &fileName, const Variant &variant);
+
+    // 一次输出原图和各缩小版本：从合成好的图像逐级 2x2 平均减半（与钉图的多级图像同一实现，
+    // SIMD 并按条带并行），最后一步在 2 倍以内双线性缩放到目标尺寸，较小的版本接着从较大版本用过的级别往下缩。
+    // 每个文件一得到像素就在线程池中开始编码，所有文件并行编码，全部完成后返回。
+    // writeFull 为 false 时不写原图（原图已经以链接等形式存在），只输出缩小版本。
+    // 每个文件先写临时文件，全部编码成功后才替换目标文件；任何一个失败时一个都不替换，原有的文件不变
+    bool saveImageWithVariants(const QImage &image, const QString &fileName, const QVector<Variant> &variants,
+                               bool writeFull = true, QString *errorMessage = nullptr);
+
+    // fileName 与重复的 existingFile 相同时，把 existingFile 的缩小版本也链接过来。
+    // size 为原图尺寸；不存在、尺寸与当前配置不符或链接失败的版本返回给调用方重新生成
+    QVector<Variant> linkVariants(const QString &existingFile, const QString &fileName, const QSize &size,
+                                  const QVector<Variant> &variants);
+
+    // fileName 解码后与 image 的尺寸和每个像素都相同（比较前统一到 image 的格式）。
+    // 有损格式的文件几乎不可能相同，用于确认感知哈希找到的候选确实是同一张截图。需要解码整张图，应在工作线程中调用
+    bool samePixels(const QString &fileName, const QImage &image);
+
+    // 不重新编码，让 fileName 指向重复的 existingFile：Unix 上创建相对路径的符号链接，
+    // Windows 上复制一份（那里的链接是 .lnk 快捷方式）。
+    // 先以临时名字创建再替换 fileName，失败时原有的 fileName 不变
+    bool linkDuplicate(const QString &existingFile, const QString &fileName, QString *errorMessage = nullptr);
+
+    // 保存截图：duplicates 为感知哈希找到的候选，其中与 image 像素相同的同格式文件直接链接，
+    // 缩小版本也尽量链接，其余照常编码。会解码候选和编码所有文件，应在工作线程中调用
+    bool exportImage(const QImage &image, const QString &fileName, const QVector<Variant> &variants,
+                     const QStringList &duplicates, QString *errorMessage = nullptr);
+
+    // 把 .ssrv 录屏转换为 GIF 动画。每帧只比较录屏中变化过的图块所在区域，
+    // 帧间隔取相邻两帧时间戳之差
+    bool exportRecordingToGif(const QString &recordingFile, const QString &gifFile,
+                              bool dithering, QString *errorMessage = nullptr);
+}
+
+#endif // IMAGEEXPORTER_H
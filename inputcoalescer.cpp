@@ -0,0 +1,46 @@
+#include "inputcoalescer.h"
+#include <QWidget>
+#include <QTimer>
+#include <QScreen>
+#include <QMouseEvent>
+#include <cmath>
+
+InputCoalescer::InputCoalescer(QWidget *target)
+    : QObject(target),
+      target(target),
+      timer(new QTimer(this))
+{
+    timer->setSingleShot(true);
+    timer->setTimerType(Qt::PreciseTimer);
+    connect(timer, &QTimer::timeout, target, [this]()
+            { this->target->update(); });
+    sinceFrame.start();
+}
+
+void InputCoalescer::addSample(const QMouseEvent *event)
+{
+    samples.append({event->pos(), qint64(event->timestamp()), event->modifiers()});
+
+    // 已经安排了重绘就只缓存；否则在距上一帧满一个刷新周期时重绘，空闲后的第一个事件立即重绘
+    if (!timer->isActive())
+    {
+        timer->start(int(qMax<qint64>(0, frameInterval() - sinceFrame.elapsed())));
+    }
+}
+
+QVector<InputCoalescer::Sample> InputCoalescer::takeSamples()
+{
+    QVector<Sample> taken;
+    taken.swap(samples);
+    // 复用上一帧的容量，避免每帧重新分配
+    samples.reserve(taken.capacity());
+    sinceFrame.restart();
+    return taken;
+}
+
+int InputCoalescer::frameInterval() const
+{
+    const QScreen *screen = target->screen();
+    const qreal rate = screen ? screen->refreshRate() : 60.0;
+    return qMax(1, int(std::floor(1000.0 / (rate > 0 ? rate : 60.0))));
+}
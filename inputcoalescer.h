@@ -0,0 +1,47 @@
+#ifndef INPUTCOALESCER_H
+#define INPUTCOALESCER_H
+
+#include <QObject>
+#include <QPoint>
+#include <QVector>
+#include <QElapsedTimer>
+
+class QWidget;
+class QTimer;
+class QMouseEvent;
+
+// 鼠标输入合帧
+// 高回报率鼠标每秒会产生上千个移动事件，每个事件都重绘会占满绘制路径。
+// 这里把每个事件作为样本（位置、时间戳、修饰键）原样缓存，只在距上一帧满一个刷新周期时
+// 请求一次重绘；绘制前由控件取出这段时间内的全部样本：画笔逐个使用，
+// 选区、拖动只用最后一个。重绘频率不超过屏幕刷新率，画笔也不丢点。
+class InputCoalescer : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Sample
+    {
+        QPoint pos;
+        qint64 timestamp;               // 事件的时间戳（毫秒）
+        Qt::KeyboardModifiers modifiers;
+    };
+
+    explicit InputCoalescer(QWidget *target);
+
+    // 缓存样本并安排一次重绘
+    void addSample(const QMouseEvent *event);
+    bool hasSamples() const { return !samples.isEmpty(); }
+    // 取出上次以来的全部样本，在绘制前调用，同时记为新的一帧
+    QVector<Sample> takeSamples();
+
+private:
+    int frameInterval() const;          // 目标控件所在屏幕的刷新周期（毫秒）
+
+    QWidget *target;
+    QTimer *timer;
+    QElapsedTimer sinceFrame;
+    QVector<Sample> samples;
+};
+
+#endif // INPUTCOALESCER_H
@@ -0,0 +1,190 @@
+#include "inputsession.h"
+#include <QWidget>
+#include <QMouseEvent>
+#include <QWheelEvent>
+#include <QKeyEvent>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QFile>
+#include <QDir>
+#include <QDateTime>
+#include <QSettings>
+#include <QDebug>
+
+namespace
+{
+    const quint32 Magic = 0x5353534e; // "SSSN"
+    const quint32 Version = 1;
+}
+
+namespace InputSession
+{
+    bool save(const QString &fileName, const Session &session)
+    {
+        QSaveFile file(fileName);
+        if (!file.open(QIODevice::WriteOnly))
+        {
+            return false;
+        }
+        QDataStream stream(&file);
+        stream.setVersion(QDataStream::Qt_5_15);
+        stream << Magic << Version;
+
+        // 截图以 PNG 形式写入（QDataStream 对 QImage 的默认格式），无损
+        stream << qint32(session.screens.size());
+        for (const ScreenMapper::Screen &screen : session.screens)
+        {
+            stream << screen.logical << screen.native << double(screen.scale)
+                   << screen.image.copy(screen.image.rect());
+        }
+
+        stream << qint32(session.events.size());
+        for (const Event &event : session.events)
+        {
+            stream << event.timeUs << event.type << event.pos << event.button << event.buttons
+                   << event.modifiers << event.key << event.text << event.autoRepeat << event.angleDelta;
+        }
+        return stream.status() == QDataStream::Ok && file.commit();
+    }
+
+    bool load(const QString &fileName, Session *session)
+    {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            return false;
+        }
+        QDataStream stream(&file);
+        stream.setVersion(QDataStream::Qt_5_15);
+        quint32 magic = 0, version = 0;
+        stream >> magic >> version;
+        if (magic != Magic || version != Version)
+        {
+            return false;
+        }
+
+        qint32 screenCount = 0;
+        stream >> screenCount;
+        session->screens.clear();
+        for (qint32 i = 0; i < screenCount && stream.status() == QDataStream::Ok; ++i)
+        {
+            ScreenMapper::Screen screen;
+            double scale = 1.0;
+            QImage image;
+            stream >> screen.logical >> screen.native >> scale >> image;
+            screen.scale = scale;
+            screen.image = TiledImage::fromImage(image.convertToFormat(QImage::Format_RGB32));
+            session->screens.append(screen);
+        }
+
+        qint32 eventCount = 0;
+        stream >> eventCount;
+        session->events.clear();
+        session->events.reserve(qMax(0, eventCount));
+        for (qint32 i = 0; i < eventCount && stream.status() == QDataStream::Ok; ++i)
+        {
+            Event event;
+            stream >> event.timeUs >> event.type >> event.pos >> event.button >> event.buttons
+                   >> event.modifiers >> event.key >> event.text >> event.autoRepeat >> event.angleDelta;
+            session->events.append(event);
+        }
+        return stream.status() == QDataStream::Ok;
+    }
+
+    QString recordDirectory()
+    {
+        const QString fromEnvironment = qEnvironmentVariable("SCREENSNIPER_RECORD_SESSION");
+        return fromEnvironment.isEmpty() ? QSettings().value("debug/sessionDir").toString() : fromEnvironment;
+    }
+
+    bool fromEvent(const QEvent *event, qint64 timeUs, Event *recorded)
+    {
+        recorded->timeUs = timeUs;
+        recorded->type = quint16(event->type());
+        switch (event->type())
+        {
+        case QEvent::MouseButtonPress:
+        case QEvent::MouseButtonRelease:
+        case QEvent::MouseButtonDblClick:
+        case QEvent::MouseMove:
+        {
+            const QMouseEvent *mouse = static_cast<const QMouseEvent *>(event);
+            recorded->pos = mouse->localPos();
+            recorded->button = quint32(mouse->button());
+            recorded->buttons = quint32(mouse->buttons());
+            recorded->modifiers = quint32(mouse->modifiers());
+            return true;
+        }
+        case QEvent::Wheel:
+        {
+            const QWheelEvent *wheel = static_cast<const QWheelEvent *>(event);
+            recorded->pos = wheel->position();
+            recorded->buttons = quint32(wheel->buttons());
+            recorded->modifiers = quint32(wheel->modifiers());
+            recorded->angleDelta = wheel->angleDelta();
+            return true;
+        }
+        case QEvent::KeyPress:
+        case QEvent::KeyRelease:
+        {
+            const QKeyEvent *key = static_cast<const QKeyEvent *>(event);
+            recorded->key = key->key();
+            recorded->modifiers = quint32(key->modifiers());
+            recorded->text = key->text();
+            recorded->autoRepeat = key->isAutoRepeat();
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+}
+
+InputRecorder::InputRecorder(QWidget *target, const QVector<ScreenMapper::Screen> &screens, const QString &directory)
+    : QObject(target),
+      target(target),
+      directory(directory)
+{
+    // 回放时没有对应的 QScreen，只保留几何信息和截图
+    for (ScreenMapper::Screen screen : screens)
+    {
+        screen.screen = nullptr;
+        session.screens.append(screen);
+    }
+    target->installEventFilter(this);
+    clock.start();
+}
+
+bool InputRecorder::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == target)
+    {
+        InputSession::Event recorded;
+        if (InputSession::fromEvent(event, clock.nsecsElapsed() / 1000, &recorded))
+        {
+            session.events.append(recorded);
+        }
+        else if (event->type() == QEvent::Hide)
+        {
+            finish();
+        }
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+void InputRecorder::finish()
+{
+    target->removeEventFilter(this);
+    if (session.events.isEmpty() || !QDir().mkpath(directory))
+    {
+        return;
+    }
+    const QString fileName = QDir(directory).filePath(
+        "session_" + QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss_zzz") + ".sssn");
+    if (!InputSession::save(fileName, session))
+    {
+        qWarning() << "Cannot write input session" << fileName;
+    }
+    // 截图已经写入文件，不再占用内存
+    session = InputSession::Session();
+}
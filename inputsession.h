@@ -0,0 +1,73 @@
+#ifndef INPUTSESSION_H
+#define INPUTSESSION_H
+
+#include <QObject>
+#include <QPointF>
+#include <QString>
+#include <QVector>
+#include <QElapsedTimer>
+#include "screenmapper.h"
+
+class QWidget;
+class QInputEvent;
+
+// 截图窗口的输入会话
+// 录制截图遮罩收到的鼠标、滚轮和键盘事件（带时间），连同当时的各屏幕截图一起保存为 .sssn 文件，
+// 之后可以用 --replay 在 offscreen 平台上按原来的节奏回放，测量每个事件的处理时间和绘制时间，
+// 用真实操作（长距离拖动、放大镜扫过、拖动文字）发现性能回退。
+// 只录制发给截图遮罩本身的事件，工具栏按钮和文字输入框中的操作不在其中。
+namespace InputSession
+{
+    struct Event
+    {
+        qint64 timeUs = 0;          // 距截图遮罩显示的时间
+        quint16 type = 0;           // QEvent::Type
+        QPointF pos;                // 鼠标、滚轮：窗口坐标
+        quint32 button = 0;         // 鼠标：Qt::MouseButton
+        quint32 buttons = 0;        // 鼠标、滚轮：Qt::MouseButtons
+        quint32 modifiers = 0;      // Qt::KeyboardModifiers
+        qint32 key = 0;             // 键盘：Qt::Key
+        QString text;               // 键盘：输入的文字
+        bool autoRepeat = false;
+        QPoint angleDelta;          // 滚轮
+    };
+
+    struct Session
+    {
+        QVector<ScreenMapper::Screen> screens; // 录制时的截图，Screen::screen 为 nullptr
+        QVector<Event> events;
+    };
+
+    bool save(const QString &fileName, const Session &session);
+    bool load(const QString &fileName, Session *session);
+
+    // 录制目录：环境变量 SCREENSNIPER_RECORD_SESSION 或设置项 debug/sessionDir，都没有时为空
+    QString recordDirectory();
+
+    // 把事件转换为录制格式；不是要录制的事件类型时返回 false
+    bool fromEvent(const QEvent *event, qint64 timeUs, Event *recorded);
+}
+
+// 录制一个截图窗口的输入
+// 作为事件过滤器装在截图遮罩上，遮罩隐藏（完成、取消或进入滚动截图等模式）时
+// 把会话写入录制目录并停止录制。
+class InputRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    InputRecorder(QWidget *target, const QVector<ScreenMapper::Screen> &screens, const QString &directory);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    void finish();
+
+    QWidget *target;
+    QString directory;
+    InputSession::Session session;
+    QElapsedTimer clock;
+};
+
+#endif // INPUTSESSION_H
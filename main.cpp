@@ -1,17 +1,51 @@
 #include "mainwindow.h"
+#include "x11capture.h"
+#include "commandline.h"
+#include "startupprofiler.h"
 #include <QApplication>
 
 int main(int argc, char *argv[])
 {
+    StartupProfiler::mark("main");
+
+    // 命令行模式（如 --diff）不需要图形界面，可以在没有显示器的环境下运行
+    if (CommandLine::isCommandLineMode(argc, argv))
+    {
+        QCoreApplication app(argc, argv);
+        app.setApplicationName("ScreenSniper");
+        return CommandLine::run();
+    }
+
+    // 回放录制的输入会话：需要创建截图窗口，默认使用 offscreen 平台，不需要显示器
+    if (CommandLine::isReplayMode(argc, argv))
+    {
+        if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+        {
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        }
+        QApplication app(argc, argv);
+        app.setApplicationName("ScreenSniper");
+        app.setOrganizationName("ScreenSniper");
+        return CommandLine::runReplay();
+    }
+
+    // 全局快捷键线程使用独立的 X 连接，需要在任何 Xlib 调用之前初始化线程支持
+    X11Capture::initThreads();
+
     QApplication a(argc, argv);
 
     // 设置应用程序名称
     a.setApplicationName("ScreenSniper");
     a.setApplicationDisplayName("屏幕截图工具");
     a.setOrganizationName("ScreenSniper");
+    StartupProfiler::mark("QApplication ready");
+
+    // 常驻托盘，保留最近截图；只有托盘菜单的“退出”才结束程序
+    a.setQuitOnLastWindowClosed(false);
 
     MainWindow w;
     w.show();
+    StartupProfiler::mark("main window shown");
 
     return a.exec();
 }
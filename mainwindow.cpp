@@ -1,5 +1,10 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "historydialog.h"
+#include "captureserver.h"
+#include "uploadsink.h"
+#include "startupprofiler.h"
+#include "mipmappyramid.h"
 #include <QMessageBox>
 #include <QScreen>
 #include <QGuiApplication>
@@ -10,25 +15,76 @@
 #include <QPushButton>
 #include <QTimer>
 #include <QDateTime>
+#include <QStatusBar>
+#include <QSettings>
+#include <QFileInfo>
+#include <QElapsedTimer>
 
 MainWindow::MainWindow(QWidget *parent)
-    : QMainWindow(parent), ui(new Ui::MainWindow), trayIcon(nullptr), trayMenu(nullptr)
+    : QMainWindow(parent), ui(new Ui::MainWindow), trayIcon(nullptr), trayMenu(nullptr), recentMenu(nullptr), hotkeyThread(nullptr),
+      captureHistory(new CaptureHistory(this)), historyDialog(nullptr), captureServer(nullptr),
+      uploadSink(nullptr), openOverlays(0), compressEvents(true)
 {
+    // 最近截图环的内存预算和数量上限
+    QSettings settings;
+    recentCaptures.setBudget(settings.value("recentCaptures/budgetMB", 256).toLongLong() * 1024 * 1024,
+                             settings.value("recentCaptures/maxCount", 10).toInt());
+    MipmapPyramid::setBudget(settings.value("pin/budgetMB", 256).toLongLong() * 1024 * 1024);
+
+    // 先显示托盘图标，其余不影响第一次截图的初始化放到事件循环开始之后
+    setupTrayIcon();
+    StartupProfiler::mark("tray visible");
+
     ui->setupUi(this);
     setWindowTitle("ScreenSniper - 截图工具");
     resize(400, 300);
-
     setupUI();
-    setupTrayIcon();
-    setupConnections();
+    QTimer::singleShot(0, this, &MainWindow::finishStartup);
 }
 
 MainWindow::~MainWindow()
 {
+    if (hotkeyThread)
+    {
+        hotkeyThread->stop();
+    }
     delete ui;
     // screenshotWidget会通过deleteLater()自动删除
 }
 
+void MainWindow::finishStartup()
+{
+    populateTrayMenu();
+    captureHistory->open();
+
+    // 供自动化客户端通过共享内存取截图，默认关闭
+    QSettings settings;
+    if (settings.value("captureServer/enabled", false).toBool())
+    {
+        captureServer = new CaptureServer(this);
+        captureServer->listen();
+    }
+
+    // 保存的截图同时上传，边编码边发送，服务不可用时进入磁盘上的重试队列
+    if (UploadSink::isConfigured())
+    {
+        uploadSink = new UploadSink(this);
+        connect(uploadSink, &UploadSink::queued, this, [this](const QString &fileName, const QString &error)
+                { trayIcon->showMessage("上传失败", QFileInfo(fileName).fileName() + "：" + error + "，稍后自动重试",
+                                        QSystemTrayIcon::Warning, 3000); });
+        connect(uploadSink, &UploadSink::dropped, this, [this](const QString &fileName, const QString &error)
+                { trayIcon->showMessage("上传失败", QFileInfo(fileName).fileName() + "：" + error + "，不再重试",
+                                        QSystemTrayIcon::Warning, 3000); });
+    }
+
+    setupConnections();
+    StartupProfiler::mark("first capture possible");
+    if (StartupProfiler::isRequested())
+    {
+        qInfo().noquote() << StartupProfiler::report();
+    }
+}
+
 void MainWindow::setupUI()
 {
     // 创建中心部件
@@ -39,16 +95,19 @@ void MainWindow::setupUI()
     QPushButton *btnFullScreen = new QPushButton("截取全屏 (Ctrl+Shift+F)", this);
     QPushButton *btnArea = new QPushButton("截取区域 (Ctrl+Shift+A)", this);
     QPushButton *btnWindow = new QPushButton("截取窗口 (Ctrl+Shift+W)", this);
+    QPushButton *btnHistory = new QPushButton("截图历史", this);
     QPushButton *btnSettings = new QPushButton("设置", this);
 
     btnFullScreen->setMinimumHeight(40);
     btnArea->setMinimumHeight(40);
     btnWindow->setMinimumHeight(40);
+    btnHistory->setMinimumHeight(40);
     btnSettings->setMinimumHeight(40);
 
     layout->addWidget(btnFullScreen);
     layout->addWidget(btnArea);
     layout->addWidget(btnWindow);
+    layout->addWidget(btnHistory);
     layout->addWidget(btnSettings);
     layout->addStretch();
 
@@ -58,6 +117,7 @@ void MainWindow::setupUI()
     connect(btnFullScreen, &QPushButton::clicked, this, &MainWindow::onCaptureScreen);
     connect(btnArea, &QPushButton::clicked, this, &MainWindow::onCaptureArea);
     connect(btnWindow, &QPushButton::clicked, this, &MainWindow::onCaptureWindow);
+    connect(btnHistory, &QPushButton::clicked, this, &MainWindow::onShowHistory);
     connect(btnSettings, &QPushButton::clicked, this, &MainWindow::onSettings);
 }
 
@@ -68,12 +128,21 @@ void MainWindow::setupTrayIcon()
     trayIcon->setIcon(QIcon(":/icons/app_icon.png"));
     trayIcon->setToolTip("ScreenSniper - 截图工具");
 
-    // 创建托盘菜单
+    // 菜单项在 finishStartup 中填充，托盘图标先显示出来
     trayMenu = new QMenu(this);
+    trayIcon->setContextMenu(trayMenu);
+    trayIcon->show();
+
+    connect(trayIcon, &QSystemTrayIcon::activated, this, &MainWindow::onTrayIconActivated);
+}
 
+void MainWindow::populateTrayMenu()
+{
     QAction *actionFullScreen = new QAction("截取全屏", this);
     QAction *actionArea = new QAction("截取区域", this);
     QAction *actionWindow = new QAction("截取窗口", this);
+    recentMenu = new QMenu("最近截图", this);
+    QAction *actionHistory = new QAction("截图历史", this);
     QAction *actionShow = new QAction("显示主窗口", this);
     QAction *actionAbout = new QAction("关于", this);
     QAction *actionQuit = new QAction("退出", this);
@@ -81,47 +150,175 @@ void MainWindow::setupTrayIcon()
     trayMenu->addAction(actionFullScreen);
     trayMenu->addAction(actionArea);
     trayMenu->addAction(actionWindow);
+    trayMenu->addMenu(recentMenu);
+    trayMenu->addAction(actionHistory);
     trayMenu->addSeparator();
     trayMenu->addAction(actionShow);
     trayMenu->addAction(actionAbout);
     trayMenu->addSeparator();
     trayMenu->addAction(actionQuit);
 
-    trayIcon->setContextMenu(trayMenu);
-    trayIcon->show();
-
     // 连接托盘信号
     connect(actionFullScreen, &QAction::triggered, this, &MainWindow::onCaptureScreen);
     connect(actionArea, &QAction::triggered, this, &MainWindow::onCaptureArea);
     connect(actionWindow, &QAction::triggered, this, &MainWindow::onCaptureWindow);
+    connect(actionHistory, &QAction::triggered, this, &MainWindow::onShowHistory);
     connect(actionShow, &QAction::triggered, this, &MainWindow::show);
     connect(actionAbout, &QAction::triggered, this, &MainWindow::onAbout);
     connect(actionQuit, &QAction::triggered, qApp, &QApplication::quit);
-    connect(trayIcon, &QSystemTrayIcon::activated, this, &MainWindow::onTrayIconActivated);
+    connect(recentMenu, &QMenu::aboutToShow, this, &MainWindow::updateRecentMenu);
 }
 
 void MainWindow::setupConnections()
 {
     // 设置全局快捷键
-    // 注意：需要使用平台相关的API或第三方库实现全局快捷键
+    // 目前只支持 X11：由独立线程通过 XGrabKey 注册，按键时在该线程内直接截图
+    if (!GlobalHotkeyThread::isSupported())
+    {
+        return;
+    }
+
+    hotkeyThread = new GlobalHotkeyThread(this);
+    connect(hotkeyThread, &GlobalHotkeyThread::hotkeyTriggered, this, &MainWindow::onHotkeyTriggered);
+    connect(hotkeyThread, &GlobalHotkeyThread::registrationFailed, this, [this](const QString &reason)
+            { trayIcon->showMessage("全局快捷键", reason, QSystemTrayIcon::Warning, 3000); });
+    hotkeyThread->start();
 }
 
-void MainWindow::onCaptureScreen()
+ScreenshotWidget *MainWindow::createScreenshotWidget(const QString &successMessage)
 {
-    // 隐藏主窗口和托盘图标提示
-    hide();
-
-    // 每次都重新创建截图窗口
     ScreenshotWidget *widget = new ScreenshotWidget();
+    widget->setCaptureHistory(captureHistory);
+
+    // 遮罩存在期间不合并鼠标移动事件，画笔要用到每一个样本，重绘频率由遮罩自己的 InputCoalescer 控制。
+    // 这个属性是全局的（平台插件每收到一个事件都重新读取），所以只在这里按遮罩数量计数：
+    // 第一个遮罩创建时关掉，最后一个释放时恢复，与遮罩释放的先后顺序无关
+    if (openOverlays++ == 0)
+    {
+        compressEvents = QCoreApplication::testAttribute(Qt::AA_CompressHighFrequencyEvents);
+        QCoreApplication::setAttribute(Qt::AA_CompressHighFrequencyEvents, false);
+    }
+    connect(widget, &QObject::destroyed, this, [this]()
+            {
+        if (--openOverlays == 0)
+        {
+            QCoreApplication::setAttribute(Qt::AA_CompressHighFrequencyEvents, compressEvents);
+        } });
 
-    connect(widget, &ScreenshotWidget::screenshotTaken, this, [this]()
+    connect(widget, &ScreenshotWidget::screenshotTaken, this, [this, widget, successMessage]()
             {
+        // 截图窗口随后会被释放，先把截图和标注存入最近截图环。
+        // 滚动截图和录屏结束时遮罩上留下的只是第一帧，不是保存的内容，不放入
+        if (widget->isStillCapture())
+        {
+            recentCaptures.add(widget->captureState());
+        }
         show();
-        trayIcon->showMessage("截图成功", "全屏截图已保存", QSystemTrayIcon::Information, 2000); });
+        trayIcon->showMessage("截图成功", successMessage, QSystemTrayIcon::Information, 2000); });
 
     connect(widget, &ScreenshotWidget::screenshotCancelled, this, [this]()
             { show(); });
 
+    // 写入文件的截图记入历史索引，缩略图在后台生成
+    connect(widget, &ScreenshotWidget::screenshotSaved, captureHistory, &CaptureHistory::add);
+    if (uploadSink)
+    {
+        connect(widget, &ScreenshotWidget::screenshotSaved, uploadSink, &UploadSink::upload);
+    }
+
+    return widget;
+}
+
+void MainWindow::onReopenRecent(int index)
+{
+    recentCaptures.waitForPending();
+    if (index < 0 || index >= recentCaptures.count())
+    {
+        trayIcon->showMessage("最近截图", "还没有保存过截图", QSystemTrayIcon::Information, 2000);
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    CaptureState state;
+    if (!recentCaptures.restore(index, state))
+    {
+        return;
+    }
+
+    hide();
+    ScreenshotWidget *widget = createScreenshotWidget("截图已保存");
+    widget->startCaptureFromState(state);
+    statusBar()->showMessage(QString("重新打开截图耗时：%1 ms").arg(timer.elapsed()), 5000);
+}
+
+void MainWindow::updateRecentMenu()
+{
+    recentCaptures.waitForPending();
+    recentMenu->clear();
+    if (recentCaptures.count() == 0)
+    {
+        recentMenu->addAction("（空）")->setEnabled(false);
+        return;
+    }
+    for (int i = 0; i < recentCaptures.count(); ++i)
+    {
+        const QRect selection = recentCaptures.selection(i);
+        QAction *action = recentMenu->addAction(QString("%1  %2 x %3")
+                                                    .arg(recentCaptures.timestamp(i).toString("hh:mm:ss"))
+                                                    .arg(selection.width())
+                                                    .arg(selection.height()));
+        if (i == 0)
+        {
+            action->setShortcut(QKeySequence("Ctrl+Shift+R"));
+        }
+        connect(action, &QAction::triggered, this, [this, i]()
+                { onReopenRecent(i); });
+    }
+    recentMenu->addSeparator();
+    recentMenu->addAction(QString("占用 %1 MB（%2）")
+                              .arg(recentCaptures.bytesUsed() / (1024.0 * 1024.0), 0, 'f', 1)
+                              .arg(RecentCaptures::codecName()))
+        ->setEnabled(false);
+}
+
+void MainWindow::onHotkeyTriggered(GlobalHotkeyThread::Action action, const QImage &frame,
+                                   const QPoint &cursorPos, qint64 latencyUs)
+{
+    if (action == GlobalHotkeyThread::ReopenRecent)
+    {
+        onReopenRecent(0);
+        return;
+    }
+
+    statusBar()->showMessage(QString("快捷键截图耗时：%1 ms").arg(latencyUs / 1000.0, 0, 'f', 2), 5000);
+
+    // 画面已经在快捷键线程中截好，这里不需要等待窗口隐藏
+    hide();
+
+    ScreenshotWidget *widget = createScreenshotWidget("截图已保存");
+
+    ScreenshotWidget::CaptureMode mode = ScreenshotWidget::CaptureArea;
+    if (action == GlobalHotkeyThread::CaptureFullScreen)
+    {
+        mode = ScreenshotWidget::CaptureFullScreen;
+    }
+    else if (action == GlobalHotkeyThread::CaptureWindow)
+    {
+        mode = ScreenshotWidget::CaptureWindow;
+    }
+    widget->startCaptureFromFrame(frame, cursorPos, mode);
+}
+
+void MainWindow::onCaptureScreen()
+{
+    // 隐藏主窗口和托盘图标提示
+    hide();
+
+    // 每次都重新创建截图窗口
+    ScreenshotWidget *widget = createScreenshotWidget("全屏截图已保存");
+
     // 延迟让窗口完全隐藏后再截图
     QTimer::singleShot(300, widget, [widget]()
                        { widget->startCaptureFullScreen(); });
@@ -133,15 +330,7 @@ void MainWindow::onCaptureArea()
     hide();
 
     // 每次都重新创建截图窗口
-    ScreenshotWidget *widget = new ScreenshotWidget();
-
-    connect(widget, &ScreenshotWidget::screenshotTaken, this, [this]()
-            {
-        show();
-        trayIcon->showMessage("截图成功", "区域截图已保存到剪赴板", QSystemTrayIcon::Information, 2000); });
-
-    connect(widget, &ScreenshotWidget::screenshotCancelled, this, [this]()
-            { show(); });
+    ScreenshotWidget *widget = createScreenshotWidget("区域截图已保存到剪赴板");
 
     // 延迟让窗口完全隐藏后再截图
     QTimer::singleShot(300, widget, &ScreenshotWidget::startCapture);
@@ -149,7 +338,14 @@ void MainWindow::onCaptureArea()
 
 void MainWindow::onCaptureWindow()
 {
-    QMessageBox::information(this, "提示", "窗口截图功能开发中...");
+    // 隐藏主窗口和托盘图标提示
+    hide();
+
+    // 每次都重新创建截图窗口
+    ScreenshotWidget *widget = createScreenshotWidget("窗口截图已保存");
+
+    // 延迟让窗口完全隐藏后再截图
+    QTimer::singleShot(300, widget, &ScreenshotWidget::startCaptureWindow);
 }
 
 void MainWindow::onSettings()
@@ -172,6 +368,18 @@ void MainWindow::onAbout()
                        "</ul>");
 }
 
+void MainWindow::onShowHistory()
+{
+    // 第一次打开时才创建，之后复用同一个窗口
+    if (!historyDialog)
+    {
+        historyDialog = new HistoryDialog(captureHistory, this);
+    }
+    historyDialog->show();
+    historyDialog->raise();
+    historyDialog->activateWindow();
+}
+
 void MainWindow::onTrayIconActivated(QSystemTrayIcon::ActivationReason reason)
 {
     if (reason == QSystemTrayIcon::DoubleClick)
@@ -6,6 +6,13 @@
 #include <QMenu>
 #include <QAction>
 #include "screenshotwidget.h"
+#include "globalhotkey.h"
+#include "recentcaptures.h"
+#include "capturehistory.h"
+
+class HistoryDialog;
+class CaptureServer;
+class UploadSink;
 
 QT_BEGIN_NAMESPACE
 namespace Ui
@@ -28,16 +35,34 @@ private slots:
     void onCaptureWindow();
     void onSettings();
     void onAbout();
+    void onShowHistory();
     void onTrayIconActivated(QSystemTrayIcon::ActivationReason reason);
+    void onHotkeyTriggered(GlobalHotkeyThread::Action action, const QImage &frame,
+                           const QPoint &cursorPos, qint64 latencyUs);
+    void onReopenRecent(int index = 0); // 重新打开最近截图环中的第 index 个截图
+    void updateRecentMenu();
+    void populateTrayMenu();            // 创建托盘菜单项，在托盘图标显示之后进行
+    void finishStartup();               // 托盘显示之后、事件循环开始时完成其余初始化
 
 private:
     void setupUI();
     void setupTrayIcon();
     void setupConnections();
+    // 创建截图窗口，保存成功后把截图放入最近截图环
+    ScreenshotWidget *createScreenshotWidget(const QString &successMessage);
 
     Ui::MainWindow *ui;
     QSystemTrayIcon *trayIcon;
     QMenu *trayMenu;
+    QMenu *recentMenu;
+    GlobalHotkeyThread *hotkeyThread;
+    RecentCaptures recentCaptures;
+    CaptureHistory *captureHistory;
+    HistoryDialog *historyDialog;
+    CaptureServer *captureServer;       // 本地截图服务，设置项 captureServer/enabled 打开时创建
+    UploadSink *uploadSink;             // 设置了上传地址 upload/url 时创建
+    int openOverlays;                   // 尚未释放的截图遮罩数量
+    bool compressEvents;                // 第一个遮罩创建前 AA_CompressHighFrequencyEvents 的值
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,81 @@
+#include "memoryusage.h"
+#include <QFile>
+#include <QByteArray>
+
+#if defined(Q_OS_UNIX)
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+#if defined(Q_OS_LINUX)
+    // 从 /proc/self/status 中读取形如 "VmHWM:   123456 kB" 的字段
+    qint64 statusField(const char *name)
+    {
+        QFile file("/proc/self/status");
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        {
+            return -1;
+        }
+        const QByteArray prefix = QByteArray(name) + ':';
+        while (!file.atEnd())
+        {
+            const QByteArray line = file.readLine();
+            if (line.startsWith(prefix))
+            {
+                const QList<QByteArray> parts = line.mid(prefix.size()).simplified().split(' ');
+                bool ok = false;
+                const qint64 kilobytes = parts.value(0).toLongLong(&ok);
+                return ok ? kilobytes * 1024 : -1;
+            }
+        }
+        return -1;
+    }
+#endif
+}
+
+namespace MemoryUsage
+{
+    qint64 currentRss()
+    {
+#if defined(Q_OS_LINUX)
+        return statusField("VmRSS");
+#else
+        return -1;
+#endif
+    }
+
+    qint64 peakRss()
+    {
+#if defined(Q_OS_LINUX)
+        const qint64 peak = statusField("VmHWM");
+        if (peak >= 0)
+        {
+            return peak;
+        }
+#endif
+#if defined(Q_OS_UNIX)
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) == 0)
+        {
+#if defined(Q_OS_MACOS)
+            return qint64(usage.ru_maxrss); // macOS 以字节为单位
+#else
+            return qint64(usage.ru_maxrss) * 1024;
+#endif
+        }
+#endif
+        return -1;
+    }
+
+    bool resetPeak()
+    {
+#if defined(Q_OS_LINUX)
+        // 向 clear_refs 写入 5 会把 VmHWM 重置为当前的 VmRSS
+        QFile file("/proc/self/clear_refs");
+        return file.open(QIODevice::WriteOnly) && file.write("5") == 1;
+#else
+        return false;
+#endif
+    }
+}
@@ -0,0 +1,20 @@
+#ifndef MEMORYUSAGE_H
+#define MEMORYUSAGE_H
+
+#include <QtGlobal>
+
+// 进程内存占用统计，用于报告每次截图的内存峰值
+namespace MemoryUsage
+{
+    // 当前常驻内存（字节），无法获取时返回 -1
+    qint64 currentRss();
+
+    // 常驻内存峰值（字节），无法获取时返回 -1
+    qint64 peakRss();
+
+    // 把峰值重置为当前值（Linux 4.0+ 支持），返回是否成功。
+    // 不支持时 peakRss() 是整个进程生命周期内的峰值
+    bool resetPeak();
+}
+
+#endif // MEMORYUSAGE_H
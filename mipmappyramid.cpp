@@ -0,0 +1,264 @@
+#include "mipmappyramid.h"
+#include "recentcaptures.h"
+#include <QtConcurrent>
+#include <QDebug>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+    // 压缩和生成下一级时按这么多行分成条带并行
+    const int StripHeight = 128;
+
+    inline quint32 average(quint32 a, quint32 b)
+    {
+        // 每个通道 (a + b + 1) >> 1，与 _mm_avg_epu8 / vrhaddq_u8 相同
+        return (a | b) - (((a ^ b) >> 1) & 0x7f7f7f7f);
+    }
+
+    // out[x] 为 r0、r1 两行中 2x、2x + 1 两列共 4 个像素的平均：先纵向平均，再横向平均
+    void downsampleRow(const quint32 *r0, const quint32 *r1, quint32 *out, int width)
+    {
+        int x = 0;
+
+#if defined(__SSE2__)
+        for (; x + 4 <= width; x += 4)
+        {
+            const __m128i a = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(r0 + 2 * x)),
+                                           _mm_loadu_si128(reinterpret_cast<const __m128i *>(r1 + 2 * x)));
+            const __m128i b = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(r0 + 2 * x + 4)),
+                                           _mm_loadu_si128(reinterpret_cast<const __m128i *>(r1 + 2 * x + 4)));
+            const __m128i even = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(2, 0, 2, 0)));
+            const __m128i odd = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(3, 1, 3, 1)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x), _mm_avg_epu8(even, odd));
+        }
+#elif defined(__ARM_NEON)
+        for (; x + 4 <= width; x += 4)
+        {
+            // vld2q 把偶数列和奇数列的像素分开
+            const uint32x4x2_t p0 = vld2q_u32(r0 + 2 * x);
+            const uint32x4x2_t p1 = vld2q_u32(r1 + 2 * x);
+            const uint8x16_t even = vrhaddq_u8(vreinterpretq_u8_u32(p0.val[0]), vreinterpretq_u8_u32(p1.val[0]));
+            const uint8x16_t odd = vrhaddq_u8(vreinterpretq_u8_u32(p0.val[1]), vreinterpretq_u8_u32(p1.val[1]));
+            vst1q_u32(out + x, vreinterpretq_u32_u8(vrhaddq_u8(even, odd)));
+        }
+#endif
+
+        for (; x < width; ++x)
+        {
+            out[x] = average(average(r0[2 * x], r1[2 * x]), average(r0[2 * x + 1], r1[2 * x + 1]));
+        }
+    }
+
+    QVector<int> stripIndexes(int height)
+    {
+        QVector<int> strips((height + StripHeight - 1) / StripHeight);
+        for (int i = 0; i < strips.size(); ++i)
+        {
+            strips[i] = i;
+        }
+        return strips;
+    }
+}
+
+QList<MipmapPyramid *> MipmapPyramid::pyramids;
+qint64 MipmapPyramid::budget = 256 * 1024 * 1024;
+quint64 MipmapPyramid::useCounter = 0;
+
+MipmapPyramid::MipmapPyramid(const QImage &image, qreal scale)
+    : pixelScale(scale),
+      lastUse(++useCounter)
+{
+    // 截图合成的结果已经是 32 位格式，这时直接共享像素。
+    // 未预乘的 ARGB 直接平均颜色会偏，先转成预乘格式
+    QImage source = image;
+    if (source.format() != QImage::Format_RGB32 && source.format() != QImage::Format_ARGB32_Premultiplied)
+    {
+        source = image.convertToFormat(image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied
+                                                               : QImage::Format_RGB32);
+    }
+    format = source.format();
+
+    QSize size = source.size();
+    sizes.append(size);
+    while (size.width() / 2 >= MinLevelSize && size.height() / 2 >= MinLevelSize)
+    {
+        size /= 2;
+        sizes.append(size);
+    }
+
+    levels.resize(sizes.size());
+    levels[0] = source;
+    for (int i = 1; i < levels.size(); ++i)
+    {
+        levels[i] = downsample(levels.at(i - 1));
+    }
+
+    pyramids.append(this);
+    enforceBudget(this);
+}
+
+MipmapPyramid::~MipmapPyramid()
+{
+    pyramids.removeOne(this);
+}
+
+int MipmapPyramid::levelFor(const QSize &target) const
+{
+    int index = 0;
+    while (index + 1 < sizes.size() && sizes.at(index + 1).width() >= target.width() &&
+           sizes.at(index + 1).height() >= target.height())
+    {
+        ++index;
+    }
+    return index;
+}
+
+QImage MipmapPyramid::level(int index)
+{
+    index = qBound(0, index, sizes.size() - 1);
+    lastUse = ++useCounter;
+
+    if (levels.at(index).isNull())
+    {
+        // 已解码的级别总是从某一级到最粗一级连续的一段，从离 index 最近的较精细一级生成
+        int from = index;
+        while (from > 0 && levels.at(from).isNull())
+        {
+            --from;
+        }
+        if (levels.at(from).isNull())
+        {
+            QImage full(sizes.first(), format);
+            const int rows = full.height();
+            QVector<int> strips = stripIndexes(rows);
+            QVector<QImage> decoded(strips.size());
+            QtConcurrent::blockingMap(strips, [&](int &strip)
+                                      {
+                const int height = qMin(StripHeight, rows - strip * StripHeight);
+                decoded[strip] = RecentCaptures::decompressImage(compressed.at(strip), QSize(full.width(), height), format); });
+            for (int strip = 0; strip < decoded.size(); ++strip)
+            {
+                if (decoded.at(strip).isNull())
+                {
+                    qWarning() << "Cannot decompress pinned image";
+                    return levels.last();
+                }
+                std::memcpy(full.scanLine(strip * StripHeight), decoded.at(strip).constBits(), size_t(decoded.at(strip).sizeInBytes()));
+            }
+            levels[0] = full;
+        }
+        for (int i = from + 1; i <= index; ++i)
+        {
+            levels[i] = downsample(levels.at(i - 1));
+        }
+    }
+
+    const QImage image = levels.at(index);
+    enforceBudget(this);
+    return image;
+}
+
+qint64 MipmapPyramid::residentBytes()
+{
+    qint64 total = 0;
+    for (const MipmapPyramid *pyramid : pyramids)
+    {
+        total += pyramid->levelBytes();
+    }
+    return total;
+}
+
+void MipmapPyramid::setBudget(qint64 budgetBytes)
+{
+    budget = budgetBytes;
+    enforceBudget(nullptr);
+}
+
+QImage MipmapPyramid::downsample(const QImage &image)
+{
+    QImage result(image.width() / 2, image.height() / 2, image.format());
+    if (result.isNull())
+    {
+        return result;
+    }
+
+    uchar *bits = result.bits();
+    const qsizetype stride = result.bytesPerLine();
+    const int width = result.width();
+    const int height = result.height();
+    QVector<int> strips = stripIndexes(height);
+    QtConcurrent::blockingMap(strips, [&](int &strip)
+                              {
+        for (int y = strip * StripHeight; y < qMin(height, (strip + 1) * StripHeight); ++y)
+        {
+            downsampleRow(reinterpret_cast<const quint32 *>(image.constScanLine(2 * y)),
+                          reinterpret_cast<const quint32 *>(image.constScanLine(2 * y + 1)),
+                          reinterpret_cast<quint32 *>(bits + y * stride), width);
+        } });
+    return result;
+}
+
+qint64 MipmapPyramid::levelBytes() const
+{
+    qint64 total = 0;
+    for (const QImage &image : levels)
+    {
+        total += image.sizeInBytes();
+    }
+    return total;
+}
+
+bool MipmapPyramid::dropFinestLevel()
+{
+    int index = 0;
+    while (index < levels.size() - 1 && levels.at(index).isNull())
+    {
+        ++index;
+    }
+    if (index == levels.size() - 1)
+    {
+        return false;
+    }
+
+    if (index == 0 && compressed.isEmpty())
+    {
+        // 第 0 级无法从其他级别恢复，压缩后保留。压缩数据不计入预算
+        const QImage &image = levels.first();
+        QVector<int> strips = stripIndexes(image.height());
+        compressed.resize(strips.size());
+        QtConcurrent::blockingMap(strips, [&](int &strip)
+                                  {
+            const int y = strip * StripHeight;
+            const int height = qMin(StripHeight, image.height() - y);
+            compressed[strip] = RecentCaptures::compressImage(
+                QImage(image.constScanLine(y), image.width(), height, image.bytesPerLine(), format)); });
+    }
+    levels[index] = QImage();
+    return true;
+}
+
+void MipmapPyramid::enforceBudget(MipmapPyramid *keep)
+{
+    while (residentBytes() > budget)
+    {
+        // 最久没有使用的对象先淘汰，正在使用的对象不淘汰
+        MipmapPyramid *victim = nullptr;
+        for (MipmapPyramid *pyramid : pyramids)
+        {
+            if (pyramid != keep && (!victim || pyramid->lastUse < victim->lastUse) && pyramid->levelBytes() > pyramid->levels.last().sizeInBytes())
+            {
+                victim = pyramid;
+            }
+        }
+        if (!victim || !victim->dropFinestLevel())
+        {
+            break;
+        }
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef MIPMAPPYRAMID_H
+#define MIPMAPPYRAMID_H
+
+#include <QImage>
+#include <QList>
+#include <QSize>
+#include <QVector>
+#include <QByteArray>
+
+// 钉图用的多级缩小图像
+// 第 0 级就是截图本身（与传入的 QImage 共享像素，不复制），之后每一级是上一级的 1/2，
+// 由 2x2 像素平均得到（SSE2/NEON 一次 4 个像素，与标量版本结果一致），按条带并行生成。
+// 钉图缩放时从尺寸不小于显示尺寸的最小一级平滑缩放，缩放比例始终在 2 倍以内。
+// 同一张截图的多个钉图共享一个对象。
+//
+// 所有对象已解码的像素共用一个内存预算。超出时从最久没有绘制过的对象开始，
+// 从最精细的一级往下淘汰（第 0 级压缩后保留，需要时再解压，其他级别从上一级重新生成），
+// 最粗的一级始终保留。屏幕外、最小化的钉图不绘制，自然会先被淘汰。
+// 只在 GUI 线程中使用。
+class MipmapPyramid
+{
+public:
+    // 最粗一级的宽高都不小于这个值
+    static const int MinLevelSize = 64;
+
+    // scale 为截图的缩放比例（物理像素 / 逻辑像素）
+    MipmapPyramid(const QImage &image, qreal scale);
+    ~MipmapPyramid();
+
+    QSize size() const { return sizes.first(); }
+    qreal scale() const { return pixelScale; }
+    int levelCount() const { return sizes.size(); }
+
+    // 显示为 target 物理像素时应使用的级别：尺寸不小于 target 的最小一级
+    int levelFor(const QSize &target) const;
+
+    // 第 index 级图像，已被淘汰时重新生成。会把本对象标记为最近使用，并按预算淘汰其他对象
+    QImage level(int index);
+
+    // 所有对象已解码的像素总量和预算
+    static qint64 residentBytes();
+    static void setBudget(qint64 budgetBytes);
+
+    // 2x2 平均缩小一半（奇数的宽高舍去最后一行/列）
+    static QImage downsample(const QImage &image);
+
+private:
+    Q_DISABLE_COPY(MipmapPyramid)
+
+    qint64 levelBytes() const;              // 本对象已解码的像素量
+    bool dropFinestLevel();                 // 淘汰最精细的已解码级别，没有可淘汰的返回 false
+    static void enforceBudget(MipmapPyramid *keep);
+
+    qreal pixelScale;
+    QImage::Format format;
+    QVector<QSize> sizes;
+    QVector<QImage> levels;                 // 被淘汰的级别为空
+    QVector<QByteArray> compressed;         // 第 0 级被淘汰后按条带压缩的数据
+    quint64 lastUse;
+
+    static QList<MipmapPyramid *> pyramids;
+    static qint64 budget;
+    static quint64 useCounter;
+};
+
+#endif // MIPMAPPYRAMID_H
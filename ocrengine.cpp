@@ -0,0 +1,429 @@
+#include "ocrengine.h"
+#include "edgemap.h"
+#include <QtConcurrent>
+#include <QFutureWatcher>
+#include <QProcess>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QFileInfo>
+#include <QThread>
+#include <QDebug>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+    // 每个条带上下留出的空白（处理后的像素），tesseract 对贴边的文字识别率较低
+    const int TilePadding = 10;
+    // 单个 tesseract 进程的超时
+    const int TileTimeoutMs = 60000;
+
+    // Otsu 阈值：使前景、背景两类的类间方差最大的灰度
+    int otsuThreshold(const QVector<qint64> &histogram, qint64 total)
+    {
+        qint64 sum = 0;
+        for (int i = 0; i < 256; ++i)
+        {
+            sum += i * histogram.at(i);
+        }
+
+        qint64 backgroundCount = 0;
+        qint64 backgroundSum = 0;
+        double bestVariance = -1.0;
+        int best = 127;
+        for (int t = 0; t < 255; ++t)
+        {
+            backgroundCount += histogram.at(t);
+            if (backgroundCount == 0)
+            {
+                continue;
+            }
+            const qint64 foregroundCount = total - backgroundCount;
+            if (foregroundCount == 0)
+            {
+                break;
+            }
+            backgroundSum += t * histogram.at(t);
+            const double meanBackground = double(backgroundSum) / backgroundCount;
+            const double meanForeground = double(sum - backgroundSum) / foregroundCount;
+            const double variance = double(backgroundCount) * foregroundCount *
+                                    (meanBackground - meanForeground) * (meanBackground - meanForeground);
+            if (variance > bestVariance)
+            {
+                bestVariance = variance;
+                best = t;
+            }
+        }
+        return best;
+    }
+
+    // 二值化一行：灰度大于 threshold 为白（255），否则为黑（0），invert 时黑白互换。
+    // upscale 时每个像素横向重复一次（纵向由调用方复制整行）。返回这一行黑色像素的个数
+    int binarizeRow(const uchar *gray, uchar *out, int width, int threshold, bool invert, bool upscale)
+    {
+        int x = 0;
+        int ink = 0;
+
+#if defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i limit = _mm_set1_epi8(char(threshold));
+        const __m128i flip = invert ? zero : _mm_set1_epi8(char(0xff));
+        for (; x + 16 <= width; x += 16)
+        {
+            const __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i *>(gray + x));
+            // 饱和减法为 0 即 g <= threshold
+            const __m128i dark = _mm_cmpeq_epi8(_mm_subs_epu8(g, limit), zero);
+            const __m128i v = _mm_xor_si128(dark, flip);
+            ink += qPopulationCount(quint32(_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero))));
+            if (upscale)
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * x), _mm_unpacklo_epi8(v, v));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * x + 16), _mm_unpackhi_epi8(v, v));
+            }
+            else
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x), v);
+            }
+        }
+#elif defined(__ARM_NEON)
+        const uint8x16_t limit = vdupq_n_u8(uint8_t(threshold));
+        const uint8x16_t flip = vdupq_n_u8(invert ? 0 : 0xff);
+        for (; x + 16 <= width; x += 16)
+        {
+            const uint8x16_t g = vld1q_u8(gray + x);
+            const uint8x16_t v = veorq_u8(vcleq_u8(g, limit), flip);
+            const uint64x2_t black = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(vshrq_n_u8(vceqq_u8(v, vdupq_n_u8(0)), 7))));
+            ink += int(vgetq_lane_u64(black, 0) + vgetq_lane_u64(black, 1));
+            if (upscale)
+            {
+                uint8x16x2_t pair;
+                pair.val[0] = v;
+                pair.val[1] = v;
+                vst2q_u8(out + 2 * x, pair);
+            }
+            else
+            {
+                vst1q_u8(out + x, v);
+            }
+        }
+#endif
+
+        for (; x < width; ++x)
+        {
+            const bool white = (gray[x] > threshold) != invert;
+            const uchar v = white ? 255 : 0;
+            ink += white ? 0 : 1;
+            if (upscale)
+            {
+                out[2 * x] = v;
+                out[2 * x + 1] = v;
+            }
+            else
+            {
+                out[x] = v;
+            }
+        }
+        return ink;
+    }
+
+    // 灰度化、二值化、按需放大，再按空白行切成大约与线程数相同的若干条带
+    QVector<QImage> prepareTiles(const QImage &image, qreal scale)
+    {
+        QVector<QImage> tiles;
+        const QImage gray = EdgeMap::grayscale(image);
+        const int width = gray.width();
+        const int height = gray.height();
+        if (width == 0 || height == 0)
+        {
+            return tiles;
+        }
+
+        QVector<qint64> histogram(256, 0);
+        for (int y = 0; y < height; ++y)
+        {
+            const uchar *row = gray.constScanLine(y);
+            for (int x = 0; x < width; ++x)
+            {
+                ++histogram[row[x]];
+            }
+        }
+        const qint64 total = qint64(width) * height;
+        const int threshold = otsuThreshold(histogram, total);
+        qint64 bright = 0;
+        for (int i = threshold + 1; i < 256; ++i)
+        {
+            bright += histogram.at(i);
+        }
+        // 亮像素占少数说明是深色背景上的浅色文字，反相成白底黑字
+        const bool invert = bright * 2 < total;
+
+        // tesseract 对字高 20 像素以上的文字效果较好，缩放比例低的屏幕上字太小，放大 2 倍
+        const bool upscale = scale < 1.5;
+        const int factor = upscale ? 2 : 1;
+        QImage binary(width * factor, height * factor, QImage::Format_Grayscale8);
+        QVector<int> ink(height);
+
+        QVector<int> bands((height + EdgeMap::BandSize - 1) / EdgeMap::BandSize);
+        for (int i = 0; i < bands.size(); ++i)
+        {
+            bands[i] = i;
+        }
+        uchar *binaryBits = binary.bits();
+        const qsizetype stride = binary.bytesPerLine();
+        int *inkCounts = ink.data();
+        QtConcurrent::blockingMap(bands, [&](int &band)
+                                  {
+            for (int y = band * EdgeMap::BandSize; y < qMin(height, (band + 1) * EdgeMap::BandSize); ++y)
+            {
+                uchar *out = binaryBits + y * factor * stride;
+                inkCounts[y] = binarizeRow(gray.constScanLine(y), out, width, threshold, invert, upscale);
+                if (upscale)
+                {
+                    std::memcpy(out + stride, out, size_t(width * factor));
+                }
+            } });
+
+        // 连续的有墨迹的行构成一行文字
+        QVector<QPair<int, int>> lines;
+        for (int y = 0; y < height;)
+        {
+            if (ink.at(y) == 0)
+            {
+                ++y;
+                continue;
+            }
+            const int start = y;
+            while (y < height && ink.at(y) > 0)
+            {
+                ++y;
+            }
+            lines.append(qMakePair(start, y));
+        }
+        if (lines.isEmpty())
+        {
+            return tiles;
+        }
+
+        // 把相邻的文字行合并成高度大致相同的条带，只在行间的空白处切开
+        const int tileCount = qBound(1, QThread::idealThreadCount(), lines.size());
+        const int targetHeight = (lines.last().second - lines.first().first + tileCount - 1) / tileCount;
+        auto addTile = [&](int start, int end)
+        {
+            const int tileHeight = (end - start) * factor;
+            QImage tile(binary.width(), tileHeight + 2 * TilePadding, QImage::Format_Grayscale8);
+            tile.fill(255);
+            for (int y = 0; y < tileHeight; ++y)
+            {
+                std::memcpy(tile.scanLine(TilePadding + y), binary.constScanLine(start * factor + y), size_t(binary.width()));
+            }
+            tiles.append(tile);
+        };
+        int tileStart = lines.first().first;
+        for (int i = 0; i < lines.size(); ++i)
+        {
+            const int end = lines.at(i).second;
+            if (i + 1 == lines.size() || end - tileStart >= targetHeight)
+            {
+                addTile(tileStart, end);
+                if (i + 1 < lines.size())
+                {
+                    tileStart = lines.at(i + 1).first;
+                }
+            }
+        }
+        return tiles;
+    }
+
+    // 识别语言：优先使用设置 ocr/language，否则装有简体中文语言包时识别中英文，没有时只识别英文
+    QString ocrLanguage(const QString &program)
+    {
+        const QString configured = QSettings().value("ocr/language").toString();
+        if (!configured.isEmpty())
+        {
+            return configured;
+        }
+
+        QProcess process;
+        process.start(program, {"--list-langs"});
+        if (!process.waitForFinished(5000))
+        {
+            process.kill();
+            return "eng";
+        }
+        // 第一行是标题，其余每行一个语言
+        const QStringList languages = QString::fromUtf8(process.readAllStandardOutput())
+                                          .split('\n', Qt::SkipEmptyParts)
+                                          .mid(1);
+        bool hasEnglish = false;
+        bool hasChinese = false;
+        for (const QString &language : languages)
+        {
+            hasEnglish = hasEnglish || language.trimmed() == "eng";
+            hasChinese = hasChinese || language.trimmed() == "chi_sim";
+        }
+        if (hasChinese)
+        {
+            return hasEnglish ? "chi_sim+eng" : "chi_sim";
+        }
+        return "eng";
+    }
+
+    // 用一个 tesseract 进程识别一个条带，图像以 PGM 格式经标准输入传入
+    struct TileRecognizer
+    {
+        typedef QString result_type;
+
+        QString program;
+        QString language;
+
+        QString operator()(const QImage &tile) const
+        {
+            QByteArray pgm = QString("P5\n%1 %2\n255\n").arg(tile.width()).arg(tile.height()).toLatin1();
+            pgm.reserve(pgm.size() + tile.width() * tile.height());
+            for (int y = 0; y < tile.height(); ++y)
+            {
+                pgm.append(reinterpret_cast<const char *>(tile.constScanLine(y)), tile.width());
+            }
+
+            QProcess process;
+            // 条带之间已经并行，tesseract 内部再开多线程只会互相争抢
+            QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+            environment.insert("OMP_THREAD_LIMIT", "1");
+            process.setProcessEnvironment(environment);
+            process.start(program, {"stdin", "stdout", "-l", language, "--psm", "6"});
+            if (!process.waitForStarted())
+            {
+                qWarning() << "Cannot start" << program;
+                return QString();
+            }
+            process.write(pgm);
+            process.closeWriteChannel();
+            if (!process.waitForFinished(TileTimeoutMs))
+            {
+                qWarning() << "OCR tile timed out";
+                process.kill();
+                process.waitForFinished();
+                return QString();
+            }
+            return QString::fromUtf8(process.readAllStandardOutput()).trimmed();
+        }
+    };
+}
+
+OcrEngine::OcrEngine(QObject *parent)
+    : QObject(parent),
+      prepareWatcher(new QFutureWatcher<Prepared>(this)),
+      tileWatcher(new QFutureWatcher<QString>(this)),
+      running(false),
+      emitted(0),
+      done(0)
+{
+    connect(prepareWatcher, &QFutureWatcher<Prepared>::finished, this, &OcrEngine::onPrepared);
+    connect(tileWatcher, &QFutureWatcher<QString>::resultReadyAt, this, &OcrEngine::onTileReady);
+    connect(tileWatcher, &QFutureWatcher<QString>::finished, this, &OcrEngine::onAllTilesDone);
+}
+
+OcrEngine::~OcrEngine()
+{
+    // 不等待：已经开始的 tesseract 进程在线程池中自行结束，不再访问本对象
+    prepareWatcher->disconnect(this);
+    tileWatcher->disconnect(this);
+    prepareWatcher->cancel();
+    tileWatcher->cancel();
+}
+
+QString OcrEngine::executable()
+{
+    const QString configured = QSettings().value("ocr/tesseract").toString();
+    if (!configured.isEmpty() && QFileInfo(configured).isExecutable())
+    {
+        return configured;
+    }
+    return QStandardPaths::findExecutable("tesseract");
+}
+
+void OcrEngine::recognize(const QImage &image, qreal scale)
+{
+    if (running)
+    {
+        return;
+    }
+    running = true;
+    timer.start();
+
+    const QString program = executable();
+    prepareWatcher->setFuture(QtConcurrent::run([image, scale, program]()
+                                                {
+        Prepared prepared;
+        prepared.tiles = prepareTiles(image, scale);
+        if (!prepared.tiles.isEmpty())
+        {
+            prepared.language = ocrLanguage(program);
+        }
+        return prepared; }));
+}
+
+bool OcrEngine::isRunning() const
+{
+    return running;
+}
+
+void OcrEngine::onPrepared()
+{
+    const Prepared prepared = prepareWatcher->result();
+    const int count = prepared.tiles.size();
+    if (count == 0)
+    {
+        running = false;
+        emit finished(QString(), timer.elapsed());
+        return;
+    }
+
+    results = QVector<QString>(count);
+    ready = QVector<bool>(count, false);
+    emitted = 0;
+    done = 0;
+    text.clear();
+    emit progress(0, count);
+    tileWatcher->setFuture(QtConcurrent::mapped(prepared.tiles, TileRecognizer{executable(), prepared.language}));
+}
+
+void OcrEngine::onTileReady(int index)
+{
+    results[index] = tileWatcher->resultAt(index);
+    ready[index] = true;
+    ++done;
+    emit progress(done, results.size());
+
+    // 只输出从第一个条带开始连续完成的部分，保证文字顺序与图像一致
+    bool grew = false;
+    while (emitted < results.size() && ready.at(emitted))
+    {
+        const QString &part = results.at(emitted);
+        if (!part.isEmpty())
+        {
+            if (!text.isEmpty())
+            {
+                text += '\n';
+            }
+            text += part;
+            grew = true;
+        }
+        ++emitted;
+    }
+    if (grew)
+    {
+        emit textAvailable(text);
+    }
+}
+
+void OcrEngine::onAllTilesDone()
+{
+    running = false;
+    emit finished(text, timer.elapsed());
+}
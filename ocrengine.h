@@ -0,0 +1,61 @@
+#ifndef OCRENGINE_H
+#define OCRENGINE_H
+
+#include <QObject>
+#include <QImage>
+#include <QVector>
+#include <QElapsedTimer>
+
+template <typename T>
+class QFutureWatcher;
+
+// 本地文字识别
+// 调用本机安装的 tesseract 命令行程序，不访问网络。识别前先把图像转成灰度、
+// 二值化（Otsu 阈值，深色背景时反相成白底黑字），低缩放比例的屏幕放大 2 倍，
+// 这几步用 SSE2/NEON 处理。之后按空白行把图像切成若干条带，
+// 每个条带由一个 tesseract 进程识别，多个条带在线程池中同时进行。
+// 条带按顺序完成后立即通过 textAvailable 给出目前已经识别出的文字。
+class OcrEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit OcrEngine(QObject *parent = nullptr);
+    ~OcrEngine();
+
+    // tesseract 可执行文件的路径，没有安装时为空
+    static QString executable();
+
+    // image 为截图（物理像素），scale 为它的缩放比例，用于决定是否放大
+    void recognize(const QImage &image, qreal scale);
+    bool isRunning() const;
+
+signals:
+    void progress(int done, int total);
+    void textAvailable(const QString &text); // 按顺序拼接的、目前已识别出的全部文字
+    void finished(const QString &text, qint64 elapsedMs);
+
+private:
+    // 预处理的结果：切好的条带和识别语言（查询语言要启动一次 tesseract，放在后台线程）
+    struct Prepared
+    {
+        QVector<QImage> tiles;
+        QString language;
+    };
+
+    void onPrepared();
+    void onTileReady(int index);
+    void onAllTilesDone();
+
+    QFutureWatcher<Prepared> *prepareWatcher;
+    QFutureWatcher<QString> *tileWatcher;
+    bool running;
+    QVector<QString> results;
+    QVector<bool> ready;
+    int emitted; // 已经按顺序输出的条带数
+    int done;
+    QString text;
+    QElapsedTimer timer;
+};
+
+#endif // OCRENGINE_H
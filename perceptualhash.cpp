@@ -0,0 +1,170 @@
+#include "perceptualhash.h"
+#include <QtConcurrent>
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+    const int GridWidth = 9;
+    const int GridHeight = 8;
+
+    // 一行像素中 [x0, x1) 的 R+G+B 之和（RGB32，忽略 alpha 字节）
+    quint64 sumRgb(const quint32 *row, int x0, int x1)
+    {
+        quint64 sum = 0;
+        int x = x0;
+
+#if defined(__SSE2__)
+        const __m128i mask = _mm_set1_epi32(0x00ffffff);
+        __m128i acc = _mm_setzero_si128();
+        for (; x + 4 <= x1; x += 4)
+        {
+            // SAD 对零求差即字节求和，每 8 字节得到一个 64 位部分和
+            __m128i v = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row + x)), mask);
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(v, _mm_setzero_si128()));
+        }
+        quint64 parts[2];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(parts), acc);
+        sum = parts[0] + parts[1];
+#elif defined(__ARM_NEON)
+        const uint32x4_t mask = vdupq_n_u32(0x00ffffff);
+        uint64x2_t acc = vdupq_n_u64(0);
+        for (; x + 4 <= x1; x += 4)
+        {
+            uint8x16_t v = vreinterpretq_u8_u32(vandq_u32(vld1q_u32(row + x), mask));
+            acc = vpadalq_u32(acc, vpaddlq_u16(vpaddlq_u8(v)));
+        }
+        sum = vgetq_lane_u64(acc, 0) + vgetq_lane_u64(acc, 1);
+#endif
+
+        for (; x < x1; ++x)
+        {
+            const quint32 p = row[x];
+            sum += (p & 0xff) + ((p >> 8) & 0xff) + ((p >> 16) & 0xff);
+        }
+        return sum;
+    }
+}
+
+namespace PerceptualHash
+{
+
+quint64 dHash(const QImage &image)
+{
+    if (image.isNull())
+    {
+        return 0;
+    }
+
+    QImage source = image.convertToFormat(QImage::Format_RGB32);
+    if (source.width() < GridWidth || source.height() < GridHeight)
+    {
+        source = source.scaled(qMax(source.width(), GridWidth), qMax(source.height(), GridHeight));
+    }
+
+    const int width = source.width();
+    const int height = source.height();
+    int columns[GridWidth + 1];
+    for (int c = 0; c <= GridWidth; ++c)
+    {
+        columns[c] = c * width / GridWidth;
+    }
+
+    // 每个网格行独立累加，8 行并行
+    quint64 sums[GridHeight][GridWidth] = {};
+    QVector<int> gridRows(GridHeight);
+    for (int r = 0; r < GridHeight; ++r)
+    {
+        gridRows[r] = r;
+    }
+    const uchar *bits = source.constBits();
+    const qsizetype stride = source.bytesPerLine();
+    QtConcurrent::blockingMap(gridRows, [&](int &r)
+                              {
+        const int y0 = r * height / GridHeight;
+        const int y1 = (r + 1) * height / GridHeight;
+        for (int y = y0; y < y1; ++y)
+        {
+            const quint32 *row = reinterpret_cast<const quint32 *>(bits + y * stride);
+            for (int c = 0; c < GridWidth; ++c)
+            {
+                sums[r][c] += sumRgb(row, columns[c], columns[c + 1]);
+            }
+        } });
+
+    // 相邻两格按面积归一化后比较：左边更亮记 1。交叉相乘避免除法
+    quint64 hash = 0;
+    int bit = 0;
+    for (int r = 0; r < GridHeight; ++r)
+    {
+        for (int c = 0; c < GridWidth - 1; ++c, ++bit)
+        {
+            const quint64 leftArea = quint64(columns[c + 1] - columns[c]);
+            const quint64 rightArea = quint64(columns[c + 2] - columns[c + 1]);
+            if (sums[r][c] * rightArea > sums[r][c + 1] * leftArea)
+            {
+                hash |= quint64(1) << bit;
+            }
+        }
+    }
+    return hash;
+}
+
+}
+
+void PerceptualHashIndex::clear()
+{
+    hashes.clear();
+    ids.clear();
+    for (QMultiHash<quint16, int> &table : tables)
+    {
+        table.clear();
+    }
+}
+
+void PerceptualHashIndex::insert(quint64 hash, int id)
+{
+    const int position = hashes.size();
+    hashes.append(hash);
+    ids.append(id);
+    for (int i = 0; i < Chunks; ++i)
+    {
+        tables[i].insert(chunk(hash, i), position);
+    }
+}
+
+QVector<int> PerceptualHashIndex::find(quint64 hash, int maxDistance) const
+{
+    maxDistance = qBound(0, maxDistance, int(MaxDistance));
+
+    // 候选去重：同一个哈希可能在多段上都命中
+    QVector<QPair<int, int>> matches; // (距离, -位置)
+    for (int i = 0; i < Chunks; ++i)
+    {
+        const auto range = tables[i].equal_range(chunk(hash, i));
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            const int position = it.value();
+            const int d = PerceptualHash::distance(hash, hashes.at(position));
+            if (d <= maxDistance)
+            {
+                matches.append(qMakePair(d, -position));
+            }
+        }
+    }
+    std::sort(matches.begin(), matches.end());
+    matches.erase(std::unique(matches.begin(), matches.end()), matches.end());
+
+    QVector<int> result;
+    result.reserve(matches.size());
+    for (const QPair<int, int> &match : matches)
+    {
+        result.append(ids.at(-match.second));
+    }
+    return result;
+}
@@ -0,0 +1,47 @@
+#ifndef PERCEPTUALHASH_H
+#define PERCEPTUALHASH_H
+
+#include <QImage>
+#include <QMultiHash>
+#include <QtAlgorithms>
+#include <QVector>
+
+// 感知哈希（dHash）
+// 把图像按面积平均缩小到 9x8 的亮度网格，每行相邻两格比较亮度得到 64 位。
+// 内容相近的图片（光标移动、时钟跳动）哈希只差几位，用汉明距离判断是否近似重复。
+// 缩小时 x86 使用 SSE2 的 SAD 指令一次累加 4 个像素，ARM 使用 NEON，结果与标量版本一致。
+namespace PerceptualHash
+{
+    quint64 dHash(const QImage &image);
+
+    inline int distance(quint64 a, quint64 b)
+    {
+        return int(qPopulationCount(a ^ b));
+    }
+}
+
+// 感知哈希的多索引表
+// 64 位哈希拆成 4 段 16 位，每段一张哈希表。汉明距离不超过 3 的两个哈希至少有一段
+// 完全相同，所以查询只需检查 4 个桶里的候选，与已存哈希的数量基本无关。
+class PerceptualHashIndex
+{
+public:
+    static const int Chunks = 4;
+    static const int MaxDistance = Chunks - 1; // 查询支持的最大汉明距离
+
+    void clear();
+    void insert(quint64 hash, int id);
+    int size() const { return hashes.size(); }
+
+    // 返回与 hash 距离不超过 maxDistance 的所有 id，按距离从近到远、同距离时新插入的在前
+    QVector<int> find(quint64 hash, int maxDistance) const;
+
+private:
+    static quint16 chunk(quint64 hash, int index) { return quint16(hash >> (index * 16)); }
+
+    QVector<quint64> hashes;              // 按插入顺序
+    QVector<int> ids;
+    QMultiHash<quint16, int> tables[Chunks]; // 段值 -> hashes 中的位置
+};
+
+#endif // PERCEPTUALHASH_H
@@ -0,0 +1,159 @@
+#include "pinwidget.h"
+#include "imageexporter.h"
+#include <QPainter>
+#include <QMouseEvent>
+#include <QWheelEvent>
+#include <QKeyEvent>
+#include <QContextMenuEvent>
+#include <QMenu>
+#include <QGuiApplication>
+#include <QClipboard>
+#include <QFileDialog>
+#include <QStandardPaths>
+#include <QDateTime>
+#include <QDebug>
+
+namespace
+{
+    const qreal MinZoom = 0.1;
+    const qreal MaxZoom = 4.0;
+    const qreal ZoomStep = 1.1;
+}
+
+PinWidget::PinWidget(const QSharedPointer<MipmapPyramid> &pyramid, QWidget *parent)
+    : QWidget(parent),
+      pyramid(pyramid),
+      zoom(1.0),
+      dragging(false)
+{
+    // 与截图遮罩相同的窗口属性：无边框、置顶、不在任务栏中显示
+    setWindowFlags(Qt::FramelessWindowHint | Qt::WindowStaysOnTopHint | Qt::Tool);
+    setAttribute(Qt::WA_DeleteOnClose);
+    setCursor(Qt::SizeAllCursor);
+    setFocusPolicy(Qt::StrongFocus);
+    setZoom(1.0);
+}
+
+void PinWidget::setZoom(qreal value, const QPoint &anchor)
+{
+    const qreal previous = zoom;
+    zoom = qBound(MinZoom, value, MaxZoom);
+
+    // 截图按逻辑尺寸显示，在原来的屏幕上与截图时一样大
+    const QSize logicalSize = (QSizeF(pyramid->size()) / pyramid->scale() * zoom).toSize().expandedTo(QSize(1, 1));
+    const QPoint offset = anchor - anchor * (zoom / previous);
+    setGeometry(QRect(pos() + offset, logicalSize));
+    update();
+}
+
+void PinWidget::paintEvent(QPaintEvent *)
+{
+    // 直接从不小于显示尺寸的最小一级绘制，缩放比例在 2 倍以内，平滑缩放的开销与显示尺寸相当。
+    // 不另外缓存缩放好的图像，显示用到的像素全部在 MipmapPyramid 的预算之内
+    const QSize target = (QSizeF(size()) * devicePixelRatioF()).toSize();
+    const QImage level = pyramid->level(pyramid->levelFor(target));
+
+    QPainter painter(this);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    painter.drawImage(rect(), level);
+    painter.setPen(QPen(QColor(0, 150, 255), 1));
+    painter.drawRect(rect().adjusted(0, 0, -1, -1));
+}
+
+void PinWidget::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton)
+    {
+        dragging = true;
+        dragOffset = event->pos();
+    }
+}
+
+void PinWidget::mouseMoveEvent(QMouseEvent *event)
+{
+    if (dragging)
+    {
+        move(event->globalPos() - dragOffset);
+    }
+}
+
+void PinWidget::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton)
+    {
+        dragging = false;
+    }
+}
+
+void PinWidget::mouseDoubleClickEvent(QMouseEvent *)
+{
+    close();
+}
+
+void PinWidget::wheelEvent(QWheelEvent *event)
+{
+    const int delta = event->angleDelta().y();
+    if (delta == 0)
+    {
+        return;
+    }
+    setZoom(delta > 0 ? zoom * ZoomStep : zoom / ZoomStep, event->position().toPoint());
+}
+
+void PinWidget::keyPressEvent(QKeyEvent *event)
+{
+    if (event->key() == Qt::Key_Escape)
+    {
+        close();
+    }
+    else if (event->matches(QKeySequence::Copy))
+    {
+        copyImage();
+    }
+    else
+    {
+        QWidget::keyPressEvent(event);
+    }
+}
+
+void PinWidget::contextMenuEvent(QContextMenuEvent *event)
+{
+    QMenu menu(this);
+    menu.addAction("复制", this, &PinWidget::copyImage);
+    menu.addAction("另存为...", this, &PinWidget::saveImage);
+    menu.addAction("再钉一张", this, &PinWidget::duplicate);
+    menu.addAction(QString("原始大小（当前 %1%）").arg(qRound(zoom * 100)), this, [this]()
+                   { setZoom(1.0); });
+    menu.addSeparator();
+    menu.addAction("关闭", this, &QWidget::close);
+    menu.exec(event->globalPos());
+}
+
+void PinWidget::copyImage()
+{
+    QGuiApplication::clipboard()->setImage(pyramid->level(0));
+}
+
+void PinWidget::saveImage()
+{
+    const QString defaultFileName = QStandardPaths::writableLocation(QStandardPaths::PicturesLocation) + "/screenshot_" +
+                                    QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss") + ".png";
+    const QString fileName = QFileDialog::getSaveFileName(this, "保存截图", defaultFileName, ImageExporter::imageFilters());
+    if (fileName.isEmpty())
+    {
+        return;
+    }
+    QString error;
+    if (!ImageExporter::saveImage(pyramid->level(0), fileName, &error))
+    {
+        qWarning() << "Cannot save pinned image:" << error;
+    }
+}
+
+void PinWidget::duplicate()
+{
+    PinWidget *pin = new PinWidget(pyramid);
+    pin->setZoom(zoom);
+    pin->move(pos() + QPoint(20, 20));
+    pin->show();
+}
@@ -0,0 +1,43 @@
+#ifndef PINWIDGET_H
+#define PINWIDGET_H
+
+#include <QWidget>
+#include <QSharedPointer>
+#include "mipmappyramid.h"
+
+// 钉在屏幕上的截图
+// 无边框、置顶的浮动窗口，可以同时打开很多个。拖动移动，滚轮缩放，双击或 Esc 关闭，
+// 右键菜单可以复制、另存为、再钉一张（与原来的钉图共享同一份图像）。
+// 绘制时直接从 MipmapPyramid 中合适的一级缩放，不另外缓存，
+// 显示用到的像素全部由 MipmapPyramid 按内存预算管理。
+class PinWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit PinWidget(const QSharedPointer<MipmapPyramid> &pyramid, QWidget *parent = nullptr);
+
+    void setZoom(qreal zoom, const QPoint &anchor = QPoint()); // anchor 为保持不动的窗口坐标
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+    void mouseDoubleClickEvent(QMouseEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
+    void contextMenuEvent(QContextMenuEvent *event) override;
+
+private:
+    void copyImage();
+    void saveImage();
+    void duplicate();
+
+    QSharedPointer<MipmapPyramid> pyramid;
+    qreal zoom;
+    bool dragging;
+    QPoint dragOffset;     // 按下时鼠标相对窗口左上角的位置
+};
+
+#endif // PINWIDGET_H
@@ -0,0 +1,175 @@
+#ifndef PIXELFORMAT_H
+#define PIXELFORMAT_H
+
+#include <QImage>
+#include <QRect>
+#include <cstring>
+#include <type_traits>
+
+// 按像素格式特化的像素读写
+// 每种格式是一个只有静态成员的结构体：load() 把一个像素读成预乘的 QRgb，store() 写回。
+// 处理像素的函数写成以格式为模板参数的模板，用 dispatch() 按 QImage::format() 选出实例，
+// 截图（grabWindow 在不同平台上返回不同的格式）不需要先整张转换成中间格式再处理、再转换回去。
+// 对 32 位格式 load()/store() 只是一次读写，编译后与直接操作 QRgb 相同。
+namespace PixelFormat
+{
+    // QImage::Format_RGB32：内存中为 B G R X（小端），读出时 alpha 固定为 0xff
+    struct Rgb32
+    {
+        static constexpr QImage::Format format = QImage::Format_RGB32;
+        static constexpr int bytesPerPixel = 4;
+
+        static QRgb load(const uchar *pixel)
+        {
+            return *reinterpret_cast<const QRgb *>(pixel) | 0xff000000u;
+        }
+        static void store(uchar *pixel, QRgb value)
+        {
+            *reinterpret_cast<QRgb *>(pixel) = value | 0xff000000u;
+        }
+    };
+
+    // QImage::Format_ARGB32_Premultiplied：本身就是预乘值，原样读写
+    struct Argb32Premultiplied
+    {
+        static constexpr QImage::Format format = QImage::Format_ARGB32_Premultiplied;
+        static constexpr int bytesPerPixel = 4;
+
+        static QRgb load(const uchar *pixel)
+        {
+            return *reinterpret_cast<const QRgb *>(pixel);
+        }
+        static void store(uchar *pixel, QRgb value)
+        {
+            *reinterpret_cast<QRgb *>(pixel) = value;
+        }
+    };
+
+    // QImage::Format_ARGB32：内存中为 B G R A（小端），未预乘，读写时换算
+    struct Argb32
+    {
+        static constexpr QImage::Format format = QImage::Format_ARGB32;
+        static constexpr int bytesPerPixel = 4;
+
+        static QRgb load(const uchar *pixel)
+        {
+            return qPremultiply(*reinterpret_cast<const QRgb *>(pixel));
+        }
+        static void store(uchar *pixel, QRgb value)
+        {
+            *reinterpret_cast<QRgb *>(pixel) = qUnpremultiply(value);
+        }
+    };
+
+    // QImage::Format_RGB888：每像素 3 字节，内存中为 R G B
+    struct Rgb888
+    {
+        static constexpr QImage::Format format = QImage::Format_RGB888;
+        static constexpr int bytesPerPixel = 3;
+
+        static QRgb load(const uchar *pixel)
+        {
+            return qRgb(pixel[0], pixel[1], pixel[2]);
+        }
+        static void store(uchar *pixel, QRgb value)
+        {
+            pixel[0] = uchar(qRed(value));
+            pixel[1] = uchar(qGreen(value));
+            pixel[2] = uchar(qBlue(value));
+        }
+    };
+
+    // 按 format 调用 function(格式结构体())，function 通常是 [&](auto format) { ... } 形式的泛型 lambda。
+    // 不支持的格式不调用 function，返回 false，由调用方转换格式后再处理
+    template <typename Function>
+    bool dispatch(QImage::Format format, Function &&function)
+    {
+        switch (format)
+        {
+        case QImage::Format_RGB32:
+            function(Rgb32());
+            return true;
+        case QImage::Format_ARGB32_Premultiplied:
+            function(Argb32Premultiplied());
+            return true;
+        case QImage::Format_ARGB32:
+            function(Argb32());
+            return true;
+        case QImage::Format_RGB888:
+            function(Rgb888());
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // 把 count 个像素从 Source 格式转换为 Target 格式；格式相同时直接拷贝
+    template <typename Source, typename Target>
+    void convertRow(const uchar *source, uchar *target, int count)
+    {
+        if constexpr (std::is_same<Source, Target>::value)
+        {
+            std::memcpy(target, source, size_t(count) * Source::bytesPerPixel);
+        }
+        else
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                Target::store(target + i * Target::bytesPerPixel, Source::load(source + i * Source::bytesPerPixel));
+            }
+        }
+    }
+
+    // 把 source 中 area 区域的像素逐行转换写入 target 的 offset 处，target 必须是 Target 格式。
+    // 超出 target 的部分被裁掉；source 的格式不支持时返回 false
+    template <typename Target>
+    bool convertInto(const QImage &source, const QRect &area, QImage &target, const QPoint &offset = QPoint())
+    {
+        const QRect clipped = area.intersected(source.rect())
+                                  .intersected(target.rect().translated(area.topLeft() - offset));
+        if (clipped.isEmpty())
+        {
+            return true;
+        }
+        return dispatch(source.format(), [&](auto format)
+        {
+            using Source = decltype(format);
+            const QPoint to = clipped.topLeft() - area.topLeft() + offset;
+            for (int y = 0; y < clipped.height(); ++y)
+            {
+                convertRow<Source, Target>(source.constScanLine(clipped.y() + y) + clipped.x() * Source::bytesPerPixel,
+                                           target.scanLine(to.y() + y) + to.x() * Target::bytesPerPixel,
+                                           clipped.width());
+            }
+        });
+    }
+
+    // 统一成 size 大小的 Format_RGB32 图像，供按 32 位整行比较、哈希的逐帧处理使用（录屏、长截图、GIF）。
+    // 已经是这个格式和尺寸时原样返回，不复制；否则转换和裁剪在同一遍中完成，
+    // 代替 convertToFormat() 之后再 copy() 的两次整帧拷贝。超出 image 的部分为黑色，image 为空时返回空图像
+    inline QImage toRgb32(const QImage &image, const QSize &size)
+    {
+        if (image.isNull() || (image.format() == QImage::Format_RGB32 && image.size() == size))
+        {
+            return image;
+        }
+        QImage result(size, QImage::Format_RGB32);
+        if (result.isNull())
+        {
+            return result;
+        }
+        if (image.width() < size.width() || image.height() < size.height())
+        {
+            result.fill(Qt::black);
+        }
+        if (!convertInto<Rgb32>(image, image.rect(), result))
+        {
+            // dispatch 不支持的格式（索引色、16 位等）只能先让 Qt 转换
+            const QImage converted = image.convertToFormat(QImage::Format_RGB32);
+            convertInto<Rgb32>(converted, converted.rect(), result);
+        }
+        return result;
+    }
+}
+
+#endif // PIXELFORMAT_H
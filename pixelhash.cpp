@@ -0,0 +1,124 @@
+#include "pixelhash.h"
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+    const quint32 LaneSeeds[4] = {0x9747b28cu, 0x85ebca6bu, 0xc2b2ae35u, 0x27d4eb2fu};
+    const quint32 LaneAdd = 0xe6546b64u;
+
+    inline quint32 mixLane(quint32 h, quint32 v)
+    {
+        h ^= v;
+        h = (h << 13) | (h >> 19);
+        return h * 5 + LaneAdd;
+    }
+
+    inline quint64 finalize64(quint64 k)
+    {
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdULL;
+        k ^= k >> 33;
+        k *= 0xc4ceb9fe1a85ec53ULL;
+        k ^= k >> 33;
+        return k;
+    }
+
+    inline void mixBlock(quint32 lanes[4], const uchar *block)
+    {
+        quint32 words[4];
+        std::memcpy(words, block, sizeof(words));
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            lanes[lane] = mixLane(lanes[lane], words[lane]);
+        }
+    }
+}
+
+namespace PixelHash
+{
+
+quint64 hashBytes(const uchar *data, int byteCount)
+{
+    quint32 lanes[4] = {LaneSeeds[0], LaneSeeds[1], LaneSeeds[2], LaneSeeds[3]};
+    const int blockBytes = byteCount & ~15;
+    int offset = 0;
+
+#if defined(__SSE2__)
+    __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lanes));
+    const __m128i add = _mm_set1_epi32(int(LaneAdd));
+    for (; offset < blockBytes; offset += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + offset));
+        h = _mm_xor_si128(h, v);
+        h = _mm_or_si128(_mm_slli_epi32(h, 13), _mm_srli_epi32(h, 19));
+        h = _mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(h, 2), h), add);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), h);
+#elif defined(__ARM_NEON)
+    uint32x4_t h = vld1q_u32(lanes);
+    const uint32x4_t add = vdupq_n_u32(LaneAdd);
+    for (; offset < blockBytes; offset += 16)
+    {
+        uint32x4_t v = vreinterpretq_u32_u8(vld1q_u8(data + offset));
+        h = veorq_u32(h, v);
+        h = vsriq_n_u32(vshlq_n_u32(h, 13), h, 19);
+        h = vaddq_u32(vaddq_u32(vshlq_n_u32(h, 2), h), add);
+    }
+    vst1q_u32(lanes, h);
+#endif
+
+    for (; offset < blockBytes; offset += 16)
+    {
+        mixBlock(lanes, data + offset);
+    }
+
+    // 不足 16 字节的尾部补零后按同样的规则处理
+    if (offset < byteCount)
+    {
+        uchar tail[16] = {0};
+        std::memcpy(tail, data + offset, size_t(byteCount - offset));
+        mixBlock(lanes, tail);
+    }
+
+    const quint64 high = (quint64(lanes[0]) << 32) | lanes[1];
+    const quint64 low = (quint64(lanes[2]) << 32) | lanes[3];
+    return finalize64(high ^ finalize64(low ^ quint64(byteCount)));
+}
+
+QVector<quint64> rowHashes(const QImage &image)
+{
+    QVector<quint64> hashes(image.height());
+    const int rowBytes = image.width() * image.depth() / 8;
+    for (int y = 0; y < image.height(); ++y)
+    {
+        hashes[y] = hashBytes(image.constScanLine(y), rowBytes);
+    }
+    return hashes;
+}
+
+quint64 hashRect(const QImage &image, const QRect &rect)
+{
+    const QRect area = rect.intersected(image.rect());
+    if (area.isEmpty())
+    {
+        return 0;
+    }
+
+    const int bytesPerPixel = image.depth() / 8;
+    const int rowBytes = area.width() * bytesPerPixel;
+    quint64 hash = finalize64(quint64(area.width()) << 32 | quint64(area.height()));
+    for (int y = area.top(); y <= area.bottom(); ++y)
+    {
+        const uchar *row = image.constScanLine(y) + area.left() * bytesPerPixel;
+        hash = finalize64(hash ^ hashBytes(row, rowBytes));
+    }
+    return hash;
+}
+
+} // namespace PixelHash
@@ -0,0 +1,24 @@
+#ifndef PIXELHASH_H
+#define PIXELHASH_H
+
+#include <QImage>
+#include <QRect>
+#include <QVector>
+
+// 像素哈希工具
+// 用四路 32 位并行的混合函数对像素数据求哈希，x86 下使用 SSE2 一次处理 4 个像素，
+// 标量版本按同样的分路规则计算，两者结果完全一致。
+// 哈希只用于快速判断“是否相同”，命中后需要时再做逐像素确认。
+namespace PixelHash
+{
+    // 对一段连续内存求 64 位哈希
+    quint64 hashBytes(const uchar *data, int byteCount);
+
+    // 计算图像每一行的哈希（只计算有效像素，不包含行尾填充）
+    QVector<quint64> rowHashes(const QImage &image);
+
+    // 计算图像中指定矩形区域的哈希
+    quint64 hashRect(const QImage &image, const QRect &rect);
+}
+
+#endif // PIXELHASH_H
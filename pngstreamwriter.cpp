@@ -0,0 +1,250 @@
+#include "pngstreamwriter.h"
+#include <QImageWriter>
+#include <QtEndian>
+#include <cstring>
+
+namespace
+{
+    // 每个 IDAT 块的数据量
+    const int IdatBytes = 64 * 1024;
+
+    const uchar Signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+    struct CrcTable
+    {
+        quint32 entries[256];
+
+        CrcTable()
+        {
+            for (quint32 n = 0; n < 256; ++n)
+            {
+                quint32 c = n;
+                for (int k = 0; k < 8; ++k)
+                {
+                    c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                }
+                entries[n] = c;
+            }
+        }
+    };
+
+    quint32 chunkCrc(quint32 crc, const uchar *data, int size)
+    {
+        // 局部静态变量的初始化是线程安全的，多个线程同时写 PNG 时只构造一次
+        static const CrcTable table;
+        crc = ~crc;
+        for (int i = 0; i < size; ++i)
+        {
+            crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    void appendBe32(QByteArray &out, quint32 value)
+    {
+        uchar bytes[4];
+        qToBigEndian(value, bytes);
+        out.append(reinterpret_cast<const char *>(bytes), 4);
+    }
+}
+
+PngStreamWriter::PngStreamWriter()
+    : rowsWritten(0)
+#ifdef SCREENSNIPER_ZLIB
+      ,
+      streamOpen(false)
+#endif
+{
+}
+
+PngStreamWriter::~PngStreamWriter()
+{
+#ifdef SCREENSNIPER_ZLIB
+    if (streamOpen)
+    {
+        deflateEnd(&stream);
+    }
+#endif
+}
+
+bool PngStreamWriter::open(const QString &fileName, const QSize &size)
+{
+    if (size.isEmpty())
+    {
+        error = "图片为空";
+        return false;
+    }
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        error = file.errorString();
+        return false;
+    }
+
+    imageSize = size;
+    rowsWritten = 0;
+    error.clear();
+
+#ifdef SCREENSNIPER_ZLIB
+    previousRow = QByteArray(size.width() * 3, '\0');
+    filteredRow = QByteArray(1 + size.width() * 3, '\0');
+    idat.clear();
+
+    file.write(reinterpret_cast<const char *>(Signature), sizeof(Signature));
+    QByteArray header;
+    appendBe32(header, quint32(size.width()));
+    appendBe32(header, quint32(size.height()));
+    header.append(char(8));  // 每通道 8 位
+    header.append(char(2));  // RGB
+    header.append(char(0));  // deflate
+    header.append(char(0));  // 标准过滤
+    header.append(char(0));  // 不交错
+    writeChunk("IHDR", header);
+
+    std::memset(&stream, 0, sizeof(stream));
+    // 截图中大片相同的颜色很多，默认压缩级别已经足够，更高级别只会更慢
+    if (deflateInit(&stream, Z_DEFAULT_COMPRESSION) != Z_OK)
+    {
+        fail("无法初始化压缩");
+        return false;
+    }
+    streamOpen = true;
+#else
+    image = QImage(size, QImage::Format_RGB32);
+    if (image.isNull())
+    {
+        fail("内存不足，无法保存这么大的图片");
+        return false;
+    }
+#endif
+    return error.isEmpty();
+}
+
+bool PngStreamWriter::writeRow(const uchar *rgb32)
+{
+    if (!file.isOpen() || !error.isEmpty() || rowsWritten >= imageSize.height())
+    {
+        return false;
+    }
+
+#ifndef SCREENSNIPER_ZLIB
+    std::memcpy(image.scanLine(rowsWritten), rgb32, size_t(imageSize.width()) * 4);
+    ++rowsWritten;
+    return true;
+#else
+    // Up 过滤：与上一行逐字节相减，滚动截图中上下相同的区域全部变成 0
+    const QRgb *pixels = reinterpret_cast<const QRgb *>(rgb32);
+    uchar *previous = reinterpret_cast<uchar *>(previousRow.data());
+    uchar *out = reinterpret_cast<uchar *>(filteredRow.data());
+    out[0] = 2;
+    for (int x = 0; x < imageSize.width(); ++x)
+    {
+        const uchar rgb[3] = {uchar(qRed(pixels[x])), uchar(qGreen(pixels[x])), uchar(qBlue(pixels[x]))};
+        for (int c = 0; c < 3; ++c)
+        {
+            out[1 + x * 3 + c] = uchar(rgb[c] - previous[x * 3 + c]);
+            previous[x * 3 + c] = rgb[c];
+        }
+    }
+
+    ++rowsWritten;
+    deflateData(out, filteredRow.size(), rowsWritten == imageSize.height());
+    flushIdat(false);
+    return error.isEmpty();
+#endif
+}
+
+bool PngStreamWriter::close()
+{
+    if (!file.isOpen())
+    {
+        return false;
+    }
+    if (rowsWritten != imageSize.height() && error.isEmpty())
+    {
+        fail(QString("只写入了 %1 / %2 行").arg(rowsWritten).arg(imageSize.height()));
+    }
+    if (!error.isEmpty())
+    {
+        file.cancelWriting();
+        file.commit();
+#ifndef SCREENSNIPER_ZLIB
+        image = QImage();
+#endif
+        return false;
+    }
+
+#ifdef SCREENSNIPER_ZLIB
+    flushIdat(true);
+    writeChunk("IEND", QByteArray());
+#else
+    QImageWriter imageWriter(&file, "png");
+    const bool written = imageWriter.write(image);
+    image = QImage();
+    if (!written)
+    {
+        error = imageWriter.errorString();
+        file.cancelWriting();
+        file.commit();
+        return false;
+    }
+#endif
+    if (!file.commit())
+    {
+        error = file.errorString();
+        return false;
+    }
+    return true;
+}
+
+#ifdef SCREENSNIPER_ZLIB
+void PngStreamWriter::deflateData(const uchar *data, int size, bool finish)
+{
+    uchar out[IdatBytes];
+    stream.next_in = const_cast<Bytef *>(data);
+    stream.avail_in = uInt(size);
+    do
+    {
+        stream.next_out = out;
+        stream.avail_out = sizeof(out);
+        if (deflate(&stream, finish ? Z_FINISH : Z_NO_FLUSH) == Z_STREAM_ERROR)
+        {
+            fail("压缩失败");
+            return;
+        }
+        idat.append(reinterpret_cast<const char *>(out), int(sizeof(out) - stream.avail_out));
+    } while (stream.avail_out == 0);
+}
+#endif
+
+void PngStreamWriter::flushIdat(bool all)
+{
+    while (idat.size() >= IdatBytes || (all && !idat.isEmpty()))
+    {
+        const int length = qMin(idat.size(), IdatBytes);
+        writeChunk("IDAT", idat.left(length));
+        idat.remove(0, length);
+    }
+}
+
+void PngStreamWriter::writeChunk(const char *type, const QByteArray &data)
+{
+    QByteArray chunk;
+    chunk.reserve(12 + data.size());
+    appendBe32(chunk, quint32(data.size()));
+    chunk.append(type, 4);
+    chunk.append(data);
+    appendBe32(chunk, chunkCrc(0, reinterpret_cast<const uchar *>(chunk.constData()) + 4, 4 + data.size()));
+    if (file.write(chunk) != chunk.size())
+    {
+        fail(file.errorString());
+    }
+}
+
+void PngStreamWriter::fail(const QString &message)
+{
+    if (error.isEmpty())
+    {
+        error = message;
+    }
+}
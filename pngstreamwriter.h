@@ -0,0 +1,59 @@
+#ifndef PNGSTREAMWRITER_H
+#define PNGSTREAMWRITER_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QSaveFile>
+#include <QSize>
+#include <QString>
+
+#ifdef SCREENSNIPER_ZLIB
+#include <zlib.h>
+#endif
+
+// 逐行写出 PNG，不需要整张图像在内存中
+// 用于滚动截图这类高度不受限制的图像：调用方按从上到下的顺序每次交给一行 Format_RGB32 像素，
+// 写入器只保留上一行（用于 Up 过滤）和一个 IDAT 块的缓冲。
+// 需要 zlib（SCREENSNIPER_ZLIB）；没有时退回到在内存中拼出整张图，close() 时交给 QImageWriter 编码。
+// 写入先进入临时文件，close() 成功后才替换目标文件，中途失败不会留下残缺的图片。
+class PngStreamWriter
+{
+public:
+    PngStreamWriter();
+    ~PngStreamWriter();
+
+    bool open(const QString &fileName, const QSize &size);
+
+    // 写入一行，rgb32 为 size.width() 个 Format_RGB32 像素
+    bool writeRow(const uchar *rgb32);
+
+    // 写完所有行后调用；行数不足或写入出错时返回 false 并丢弃临时文件
+    bool close();
+
+    QString errorString() const { return error; }
+
+private:
+#ifdef SCREENSNIPER_ZLIB
+    void deflateData(const uchar *data, int size, bool finish);
+#endif
+    void writeChunk(const char *type, const QByteArray &data);
+    void flushIdat(bool all);
+    void fail(const QString &message);
+
+    QSaveFile file;
+    QSize imageSize;
+    int rowsWritten;
+    QByteArray previousRow;   // 上一行的 RGB 字节
+    QByteArray filteredRow;   // 过滤类型字节 + 本行差值
+    QByteArray idat;          // 待写入 IDAT 块的压缩数据
+    QString error;
+
+#ifdef SCREENSNIPER_ZLIB
+    z_stream stream;
+    bool streamOpen;
+#else
+    QImage image;             // 没有 zlib 时在这里拼出整张图
+#endif
+};
+
+#endif // PNGSTREAMWRITER_H
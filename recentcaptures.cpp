@@ -0,0 +1,207 @@
+#include "recentcaptures.h"
+#include <QtConcurrent>
+#include <cstring>
+
+#ifdef SCREENSNIPER_LZ4
+#include <lz4.h>
+#endif
+
+namespace
+{
+    // 把所有屏幕的图块展开成 (屏幕, 图块) 列表，供线程池并行处理
+    QVector<QPair<int, int>> tileJobs(const QVector<ScreenMapper::Screen> &screens)
+    {
+        QVector<QPair<int, int>> jobs;
+        for (int s = 0; s < screens.size(); ++s)
+        {
+            for (int t = 0; t < screens[s].image.tileCount(); ++t)
+            {
+                jobs.append(qMakePair(s, t));
+            }
+        }
+        return jobs;
+    }
+}
+
+RecentCaptures::RecentCaptures()
+    : budget(256 * 1024 * 1024),
+      maxEntries(10),
+      totalBytes(0),
+      nextId(1)
+{
+    pool.setMaxThreadCount(1);
+}
+
+QString RecentCaptures::codecName()
+{
+#ifdef SCREENSNIPER_LZ4
+    return "LZ4";
+#else
+    return "zlib";
+#endif
+}
+
+QByteArray RecentCaptures::compressImage(const QImage &image)
+{
+    if (image.isNull())
+    {
+        return QByteArray();
+    }
+    const char *raw = reinterpret_cast<const char *>(image.constBits());
+    const int rawSize = int(image.sizeInBytes());
+#ifdef SCREENSNIPER_LZ4
+    QByteArray compressed(LZ4_compressBound(rawSize), Qt::Uninitialized);
+    const int size = LZ4_compress_default(raw, compressed.data(), rawSize, compressed.size());
+    compressed.resize(qMax(0, size));
+    return compressed;
+#else
+    return qCompress(reinterpret_cast<const uchar *>(raw), rawSize, 1);
+#endif
+}
+
+QImage RecentCaptures::decompressImage(const QByteArray &data, const QSize &size, QImage::Format format)
+{
+    if (data.isEmpty())
+    {
+        return QImage();
+    }
+    QImage image(size, format);
+#ifdef SCREENSNIPER_LZ4
+    const int rawSize = int(image.sizeInBytes());
+    if (LZ4_decompress_safe(data.constData(), reinterpret_cast<char *>(image.bits()), data.size(), rawSize) != rawSize)
+    {
+        return QImage();
+    }
+#else
+    const QByteArray raw = qUncompress(data);
+    if (raw.size() != image.sizeInBytes())
+    {
+        return QImage();
+    }
+    std::memcpy(image.bits(), raw.constData(), size_t(raw.size()));
+#endif
+    return image;
+}
+
+void RecentCaptures::setBudget(qint64 budgetBytes, int maxCount)
+{
+    budget = budgetBytes;
+    maxEntries = qMax(1, maxCount);
+    evict();
+}
+
+void RecentCaptures::add(const CaptureState &state)
+{
+    if (state.screens.isEmpty())
+    {
+        return;
+    }
+    collect(false);
+
+    // 图块是隐式共享的，复制状态不复制像素；编号在这里分配，后台任务只负责压缩
+    const qint64 id = state.id != 0 ? state.id : nextId++;
+    pending.append(QtConcurrent::run(&pool, [state, id]()
+                                     { return compress(state, id); }));
+}
+
+void RecentCaptures::waitForPending()
+{
+    collect(true);
+}
+
+RecentCaptures::Entry RecentCaptures::compress(const CaptureState &state, qint64 id)
+{
+    Entry entry;
+    entry.time = QDateTime::currentDateTime();
+    entry.state = state;
+    entry.state.id = id;
+    entry.tiles.resize(state.screens.size());
+    for (int s = 0; s < state.screens.size(); ++s)
+    {
+        entry.tiles[s].resize(state.screens[s].image.tileCount());
+    }
+
+    QVector<QPair<int, int>> jobs = tileJobs(state.screens);
+    QtConcurrent::blockingMap(jobs, [&](QPair<int, int> &job)
+                              { entry.tiles[job.first][job.second] = compressImage(state.screens.at(job.first).image.tile(job.second)); });
+
+    for (int s = 0; s < state.screens.size(); ++s)
+    {
+        // 像素已经压缩保存，只保留图像的尺寸信息
+        entry.state.screens[s].image = TiledImage(state.screens[s].image.size(), state.screens[s].image.format());
+        for (const QByteArray &data : entry.tiles[s])
+        {
+            entry.bytes += data.size();
+        }
+    }
+    return entry;
+}
+
+void RecentCaptures::collect(bool wait)
+{
+    while (!pending.isEmpty() && (wait || pending.first().isFinished()))
+    {
+        insert(pending.takeFirst().result());
+    }
+}
+
+void RecentCaptures::insert(const Entry &entry)
+{
+    // 重新打开过的截图再次保存时替换原来的记录
+    for (int i = 0; i < entries.size(); ++i)
+    {
+        if (entries[i].state.id == entry.state.id)
+        {
+            totalBytes -= entries[i].bytes;
+            entries.removeAt(i);
+            break;
+        }
+    }
+    totalBytes += entry.bytes;
+    entries.prepend(entry);
+    evict();
+}
+
+bool RecentCaptures::restore(int index, CaptureState &state)
+{
+    if (index < 0 || index >= entries.size())
+    {
+        return false;
+    }
+
+    // 最近使用的移到最前面
+    entries.move(index, 0);
+    const Entry &entry = entries.first();
+
+    state = entry.state;
+    QVector<QPair<int, int>> jobs = tileJobs(state.screens);
+    QVector<QImage> decoded(jobs.size());
+    QVector<int> order(jobs.size());
+    for (int i = 0; i < order.size(); ++i)
+    {
+        order[i] = i;
+    }
+    QtConcurrent::blockingMap(order, [&](int &i)
+                              {
+        const QPair<int, int> &job = jobs.at(i);
+        const TiledImage &image = state.screens.at(job.first).image;
+        decoded[i] = decompressImage(entry.tiles.at(job.first).at(job.second),
+                                     image.tileRect(job.second).size(), image.format()); });
+
+    for (int i = 0; i < jobs.size(); ++i)
+    {
+        state.screens[jobs[i].first].image.setTile(jobs[i].second, decoded[i]);
+    }
+
+    return true;
+}
+
+void RecentCaptures::evict()
+{
+    // 至少保留最新的一个，即使它本身就超出预算
+    while (entries.size() > 1 && (entries.size() > maxEntries || totalBytes > budget))
+    {
+        totalBytes -= entries.last().bytes;
+        entries.removeLast();
+    }
+}
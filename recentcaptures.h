@@ -0,0 +1,79 @@
+#ifndef RECENTCAPTURES_H
+#define RECENTCAPTURES_H
+
+#include <QDateTime>
+#include <QFuture>
+#include <QList>
+#include <QThreadPool>
+#include <QVector>
+#include "screenmapper.h"
+#include "annotationstore.h"
+
+// 一次截图的完整状态：各屏幕截图、选区和标注
+struct CaptureState
+{
+    qint64 id = 0;     // 最近截图环中的编号，新截图为 0
+    QVector<ScreenMapper::Screen> screens;
+    QRect selection;   // 虚拟桌面逻辑坐标
+    QPoint origin;     // 截图遮罩的原点，标注坐标相对于它
+    AnnotationStore annotations;
+};
+
+// 最近截图环
+// 保存或复制后的截图按图块压缩后留在内存里，可以随时重新打开继续裁剪和标注，
+// 不需要重新截屏。有 liblz4 时用 LZ4，否则用 zlib 的最快档。
+// 按最近使用顺序排列，超过数量或内存预算时淘汰最久没用过的。
+// 压缩在后台线程中按加入的顺序进行，完成后下次调用 add() 或 waitForPending() 时并入环中。
+class RecentCaptures
+{
+public:
+    RecentCaptures();
+
+    // budgetBytes 为压缩后数据的总预算，maxCount 为最多保留的截图数
+    void setBudget(qint64 budgetBytes, int maxCount);
+
+    // 在后台压缩后放到最前面；state.id 与已有的截图相同时替换它（重新打开后再次保存）
+    void add(const CaptureState &state);
+
+    // 等待后台压缩全部完成并入环中，读取列表或重新打开之前调用
+    void waitForPending();
+
+    int count() const { return entries.size(); }
+    qint64 bytesUsed() const { return totalBytes; }
+    QDateTime timestamp(int index) const { return entries.at(index).time; }
+    QRect selection(int index) const { return entries.at(index).state.selection; }
+
+    // 解压第 index 个截图，并把它移到最前面
+    bool restore(int index, CaptureState &state);
+
+    // 当前使用的压缩算法名称
+    static QString codecName();
+
+    // 用上面的算法压缩/解压一块图像的原始像素，钉图淘汰的全分辨率图像也用它
+    static QByteArray compressImage(const QImage &image);
+    static QImage decompressImage(const QByteArray &data, const QSize &size, QImage::Format format);
+
+private:
+    struct Entry
+    {
+        QDateTime time;
+        CaptureState state;                  // 其中的截图为空，像素在 tiles 中
+        QVector<QVector<QByteArray>> tiles;  // 每个屏幕每个图块压缩后的数据，未分配的图块为空
+        qint64 bytes = 0;
+    };
+
+    static Entry compress(const CaptureState &state, qint64 id);
+    void collect(bool wait);   // 把已完成的后台压缩按顺序并入环中
+    void insert(const Entry &entry);
+    void evict();
+
+    QList<Entry> entries; // 最近使用的在前
+    qint64 budget;
+    int maxEntries;
+    qint64 totalBytes;
+    qint64 nextId;
+    QList<QFuture<Entry>> pending;
+    QThreadPool pool;     // 单线程，保持加入的顺序；最后析构，先等待后台任务结束
+};
+
+#endif // RECENTCAPTURES_H
@@ -0,0 +1,283 @@
+#include "recordingformat.h"
+#include <QtConcurrent>
+#include <QDebug>
+#include <cstring>
+
+namespace
+{
+    const quint32 FileMagic = 0x53535256;  // "SSRV"
+    const quint32 FileVersion = 1;
+    const quint32 FrameMagic = 0x46524d45; // "FRME"
+
+    // 把图块的像素按行紧密排列取出
+    QByteArray extractTile(const QImage &image, const QRect &rect)
+    {
+        const int rowBytes = rect.width() * 4;
+        QByteArray data(rowBytes * rect.height(), Qt::Uninitialized);
+        char *out = data.data();
+        for (int y = 0; y < rect.height(); ++y)
+        {
+            std::memcpy(out + y * rowBytes, image.constScanLine(rect.y() + y) + rect.x() * 4, size_t(rowBytes));
+        }
+        return data;
+    }
+
+    // data ^= image 中同位置的图块，编码和解码共用
+    void xorTile(uchar *data, const QImage &image, const QRect &rect)
+    {
+        const int width = rect.width();
+        for (int y = 0; y < rect.height(); ++y)
+        {
+            quint32 *out = reinterpret_cast<quint32 *>(data) + y * width;
+            const quint32 *in = reinterpret_cast<const quint32 *>(image.constScanLine(rect.y() + y)) + rect.x();
+            for (int x = 0; x < width; ++x)
+            {
+                out[x] ^= in[x];
+            }
+        }
+    }
+
+    void storeTile(QImage &image, const QRect &rect, const uchar *data)
+    {
+        const int rowBytes = rect.width() * 4;
+        for (int y = 0; y < rect.height(); ++y)
+        {
+            std::memcpy(image.scanLine(rect.y() + y) + rect.x() * 4, data + y * rowBytes, size_t(rowBytes));
+        }
+    }
+}
+
+RecordingWriter::RecordingWriter()
+    : tileSize(64),
+      columns(0),
+      rows(0)
+{
+}
+
+RecordingWriter::~RecordingWriter()
+{
+    close();
+}
+
+bool RecordingWriter::open(const QString &fileName, const QSize &size, int tile, int fps)
+{
+    close();
+
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qWarning() << "RecordingWriter: cannot open" << fileName << file.errorString();
+        return false;
+    }
+
+    frameSize = size;
+    tileSize = tile;
+    columns = (size.width() + tileSize - 1) / tileSize;
+    rows = (size.height() + tileSize - 1) / tileSize;
+    previous = QImage();
+
+    stream.setDevice(&file);
+    stream.setVersion(QDataStream::Qt_5_12);
+    stream << FileMagic << FileVersion
+           << qint32(size.width()) << qint32(size.height()) << qint32(tileSize) << qint32(fps);
+    return stream.status() == QDataStream::Ok;
+}
+
+void RecordingWriter::close()
+{
+    if (file.isOpen())
+    {
+        stream.setDevice(nullptr);
+        file.close();
+    }
+    previous = QImage();
+}
+
+QRect RecordingWriter::tileRect(int index) const
+{
+    const int column = index % columns;
+    const int row = index / columns;
+    return QRect(column * tileSize, row * tileSize, tileSize, tileSize)
+        .intersected(QRect(QPoint(0, 0), frameSize));
+}
+
+bool RecordingWriter::writeFrame(const QImage &frame, const QVector<int> &changedTiles, qint64 timestampMs, bool keyFrame)
+{
+    if (!file.isOpen() || frame.size() != frameSize || frame.format() != QImage::Format_RGB32)
+    {
+        return false;
+    }
+
+    // 第一帧没有可参考的上一帧，只能作为关键帧
+    if (previous.isNull())
+    {
+        keyFrame = true;
+    }
+
+    QVector<int> tiles;
+    if (keyFrame)
+    {
+        tiles.reserve(tileCount());
+        for (int i = 0; i < tileCount(); ++i)
+        {
+            tiles.append(i);
+        }
+    }
+    else
+    {
+        tiles = changedTiles;
+    }
+
+    // 各图块的差分和压缩互不相关，分摊到线程池并行处理
+    QVector<QByteArray> encoded(tiles.size());
+    QVector<int> jobs(tiles.size());
+    for (int i = 0; i < jobs.size(); ++i)
+    {
+        jobs[i] = i;
+    }
+    QtConcurrent::blockingMap(jobs, [&](int &job)
+                              {
+        const QRect rect = tileRect(tiles.at(job));
+        QByteArray raw = extractTile(frame, rect);
+        if (!keyFrame)
+        {
+            xorTile(reinterpret_cast<uchar *>(raw.data()), previous, rect);
+        }
+        encoded[job] = qCompress(raw, 1); });
+
+    stream << FrameMagic << quint8(keyFrame ? 1 : 0) << timestampMs << qint32(tiles.size());
+    for (int i = 0; i < tiles.size(); ++i)
+    {
+        stream << qint32(tiles[i]) << encoded[i];
+    }
+
+    // 只更新变化过的图块，避免每帧整帧拷贝
+    if (keyFrame)
+    {
+        previous = frame.copy();
+    }
+    else
+    {
+        for (int index : tiles)
+        {
+            const QRect rect = tileRect(index);
+            const int rowBytes = rect.width() * 4;
+            for (int y = rect.top(); y <= rect.bottom(); ++y)
+            {
+                std::memcpy(previous.scanLine(y) + rect.x() * 4, frame.constScanLine(y) + rect.x() * 4, size_t(rowBytes));
+            }
+        }
+    }
+
+    return stream.status() == QDataStream::Ok;
+}
+
+RecordingReader::RecordingReader()
+    : tileSize(64),
+      columns(0),
+      rows(0),
+      framesPerSecond(0)
+{
+}
+
+bool RecordingReader::open(const QString &fileName)
+{
+    close();
+
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+    stream.setDevice(&file);
+    stream.setVersion(QDataStream::Qt_5_12);
+
+    quint32 magic = 0, version = 0;
+    qint32 width = 0, height = 0, tile = 0, fps = 0;
+    stream >> magic >> version >> width >> height >> tile >> fps;
+    if (stream.status() != QDataStream::Ok || magic != FileMagic || version != FileVersion ||
+        width <= 0 || height <= 0 || tile <= 0)
+    {
+        close();
+        return false;
+    }
+
+    tileSize = tile;
+    framesPerSecond = fps;
+    columns = (width + tileSize - 1) / tileSize;
+    rows = (height + tileSize - 1) / tileSize;
+    canvas = QImage(width, height, QImage::Format_RGB32);
+    canvas.fill(Qt::black);
+    return true;
+}
+
+void RecordingReader::close()
+{
+    if (file.isOpen())
+    {
+        stream.setDevice(nullptr);
+        file.close();
+    }
+    canvas = QImage();
+}
+
+bool RecordingReader::atEnd() const
+{
+    return !file.isOpen() || file.atEnd();
+}
+
+QRect RecordingReader::tileRect(int index) const
+{
+    const int column = index % columns;
+    const int row = index / columns;
+    return QRect(column * tileSize, row * tileSize, tileSize, tileSize).intersected(canvas.rect());
+}
+
+bool RecordingReader::readFrame(QImage &frame, qint64 &timestampMs, QRect *changedRect)
+{
+    if (atEnd())
+    {
+        return false;
+    }
+
+    quint32 magic = 0;
+    quint8 keyFrame = 0;
+    qint32 tileCount = 0;
+    stream >> magic >> keyFrame >> timestampMs >> tileCount;
+    if (stream.status() != QDataStream::Ok || magic != FrameMagic || tileCount < 0)
+    {
+        return false;
+    }
+
+    QRect changed;
+    for (int i = 0; i < tileCount; ++i)
+    {
+        qint32 index = 0;
+        QByteArray data;
+        stream >> index >> data;
+        if (stream.status() != QDataStream::Ok || index < 0 || index >= columns * rows)
+        {
+            return false;
+        }
+
+        const QRect rect = tileRect(index);
+        QByteArray raw = qUncompress(data);
+        if (raw.size() != rect.width() * rect.height() * 4)
+        {
+            return false;
+        }
+        if (!keyFrame)
+        {
+            xorTile(reinterpret_cast<uchar *>(raw.data()), canvas, rect);
+        }
+        storeTile(canvas, rect, reinterpret_cast<const uchar *>(raw.constData()));
+        changed |= rect;
+    }
+
+    frame = canvas;
+    if (changedRect)
+    {
+        *changedRect = changed;
+    }
+    return true;
+}
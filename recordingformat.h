@@ -0,0 +1,69 @@
+#ifndef RECORDINGFORMAT_H
+#define RECORDINGFORMAT_H
+
+#include <QImage>
+#include <QFile>
+#include <QDataStream>
+#include <QVector>
+
+// ScreenSniper 录屏文件（.ssrv）
+// 文件头之后是一串帧，每帧只包含发生变化的图块：
+//   关键帧中的图块直接存放像素；
+//   差分帧中的图块存放与上一帧同位置图块的异或结果，未变化的像素为 0，压缩率很高。
+// 图块数据用 zlib 压缩，整个格式是无损的。
+class RecordingWriter
+{
+public:
+    RecordingWriter();
+    ~RecordingWriter();
+
+    bool open(const QString &fileName, const QSize &frameSize, int tileSize, int fps);
+    void close();
+    bool isOpen() const { return file.isOpen(); }
+
+    // 写入一帧，frame 必须是 Format_RGB32。
+    // changedTiles 为发生变化的图块下标；关键帧会忽略它并写入全部图块
+    bool writeFrame(const QImage &frame, const QVector<int> &changedTiles, qint64 timestampMs, bool keyFrame);
+
+    int tileCount() const { return columns * rows; }
+    QRect tileRect(int index) const;
+    qint64 bytesWritten() const { return file.pos(); }
+
+private:
+    QFile file;
+    QDataStream stream;
+    QImage previous;  // 上一帧，用于计算差分
+    QSize frameSize;
+    int tileSize;
+    int columns;
+    int rows;
+};
+
+class RecordingReader
+{
+public:
+    RecordingReader();
+
+    bool open(const QString &fileName);
+    void close();
+
+    QSize frameSize() const { return canvas.size(); }
+    int fps() const { return framesPerSecond; }
+    bool atEnd() const;
+
+    // 读取下一帧，frame 为重建后的完整画面，changedRect 为本帧变化区域的外接矩形
+    bool readFrame(QImage &frame, qint64 &timestampMs, QRect *changedRect = nullptr);
+
+private:
+    QRect tileRect(int index) const;
+
+    QFile file;
+    QDataStream stream;
+    QImage canvas;
+    int tileSize;
+    int columns;
+    int rows;
+    int framesPerSecond;
+};
+
+#endif // RECORDINGFORMAT_H
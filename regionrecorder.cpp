@@ -0,0 +1,216 @@
+#include "regionrecorder.h"
+#include "pixelformat.h"
+#include "pixelhash.h"
+#include <QScreen>
+#include <QPixmap>
+#include <QTimer>
+#include <QtConcurrent>
+#include <cstring>
+
+RegionRecorder::RegionRecorder(QScreen *screen, const QRect &logicalRect, const QRect &nativeRect, QObject *parent)
+    : QObject(parent),
+      screen(screen),
+      logicalRect(logicalRect),
+      nativeRect(nativeRect),
+      timer(new QTimer(this)),
+      lastKeyFrameMs(0),
+      frames(0),
+      changedTileTotal(0)
+{
+    timer->setTimerType(Qt::PreciseTimer);
+    connect(timer, &QTimer::timeout, this, &RegionRecorder::captureFrame);
+}
+
+RegionRecorder::~RegionRecorder()
+{
+    stop();
+}
+
+bool RegionRecorder::start(const QString &fileName, int fps)
+{
+    // 先开始跟踪变化再截第一帧，避免漏掉两者之间的修改
+    damage.start();
+
+    current = grabRegion();
+    if (current.isNull())
+    {
+        error = "无法截取录制区域";
+        return false;
+    }
+    if (!writer.open(fileName, current.size(), TileSize, fps))
+    {
+        error = "无法写入录屏文件 " + fileName;
+        return false;
+    }
+
+    tileHashes.fill(0, writer.tileCount());
+    QVector<int> allTiles(writer.tileCount());
+    for (int i = 0; i < allTiles.size(); ++i)
+    {
+        allTiles[i] = i;
+    }
+    QVector<int> changed;
+    hashChangedTiles(allTiles, changed);
+
+    writer.writeFrame(current, changed, 0, true);
+    frames = 1;
+    changedTileTotal = writer.tileCount();
+    lastKeyFrameMs = 0;
+
+    clock.start();
+    timer->start(1000 / qMax(1, fps));
+    return true;
+}
+
+void RegionRecorder::stop()
+{
+    timer->stop();
+    writer.close();
+}
+
+bool RegionRecorder::isRecording() const
+{
+    return timer->isActive();
+}
+
+qint64 RegionRecorder::durationMs() const
+{
+    return clock.isValid() ? clock.elapsed() : 0;
+}
+
+double RegionRecorder::averageChangedRatio() const
+{
+    if (frames == 0 || writer.tileCount() == 0)
+    {
+        return 0.0;
+    }
+    return double(changedTileTotal) / (double(frames) * writer.tileCount());
+}
+
+QImage RegionRecorder::grabRegion() const
+{
+    QImage image;
+    if (damage.isActive())
+    {
+        image = X11Capture::grabRootRect(damage.display(), nativeRect);
+    }
+    else
+    {
+        image = screen->grabWindow(0, logicalRect.x(), logicalRect.y(),
+                                   logicalRect.width(), logicalRect.height())
+                    .toImage();
+    }
+
+    // DPR 换算可能有 1 像素的舍入误差，统一成固定的帧尺寸；格式和尺寸已经符合时不复制
+    return PixelFormat::toRgb32(image, nativeRect.size());
+}
+
+void RegionRecorder::captureFrame()
+{
+    const qint64 now = clock.elapsed();
+    // 定期写入关键帧，同时整帧重新截取，弥补可能漏掉的 damage 事件
+    const bool keyFrame = now - lastKeyFrameMs >= KeyFrameIntervalMs;
+
+    QVector<int> changed;
+    // damage 取出后就不会再报告，局部截取失败时这一帧退回到整帧截取，不能丢掉这些变化
+    if (!damage.isActive() || keyFrame || !grabDamaged(changed))
+    {
+        QImage frame = grabRegion();
+        if (frame.isNull())
+        {
+            return;
+        }
+        current = frame;
+
+        QVector<int> allTiles(writer.tileCount());
+        for (int i = 0; i < allTiles.size(); ++i)
+        {
+            allTiles[i] = i;
+        }
+        hashChangedTiles(allTiles, changed);
+    }
+
+    // 没有变化的帧不写入，播放时依靠时间戳保持节奏
+    if (!keyFrame && changed.isEmpty())
+    {
+        emit progress(frames, now);
+        return;
+    }
+
+    writer.writeFrame(current, changed, now, keyFrame);
+    ++frames;
+    changedTileTotal += keyFrame ? writer.tileCount() : changed.size();
+    if (keyFrame)
+    {
+        lastKeyFrameMs = now;
+    }
+    emit progress(frames, now);
+}
+
+bool RegionRecorder::grabDamaged(QVector<int> &changedTiles)
+{
+    QRect bounds;
+    for (const QRect &rect : damage.takeDamage())
+    {
+        bounds |= rect.intersected(nativeRect);
+    }
+    if (bounds.isEmpty())
+    {
+        return true;
+    }
+
+    // 扩展到图块边界后只截取被修改的这一块
+    QRect local = bounds.translated(-nativeRect.topLeft());
+    const int left = local.left() / TileSize * TileSize;
+    const int top = local.top() / TileSize * TileSize;
+    const int right = (local.right() / TileSize + 1) * TileSize - 1;
+    const int bottom = (local.bottom() / TileSize + 1) * TileSize - 1;
+    QRect aligned = QRect(QPoint(left, top), QPoint(right, bottom)).intersected(current.rect());
+
+    QImage part = X11Capture::grabRootRect(damage.display(), aligned.translated(nativeRect.topLeft()));
+    if (part.size() != aligned.size())
+    {
+        return false;
+    }
+    const int rowBytes = aligned.width() * 4;
+    for (int y = 0; y < aligned.height(); ++y)
+    {
+        std::memcpy(current.scanLine(aligned.y() + y) + aligned.x() * 4, part.constScanLine(y), size_t(rowBytes));
+    }
+
+    const int columns = (current.width() + TileSize - 1) / TileSize;
+    QVector<int> candidates;
+    for (int row = top / TileSize; row <= aligned.bottom() / TileSize; ++row)
+    {
+        for (int column = left / TileSize; column <= aligned.right() / TileSize; ++column)
+        {
+            candidates.append(row * columns + column);
+        }
+    }
+    hashChangedTiles(candidates, changedTiles);
+    return true;
+}
+
+void RegionRecorder::hashChangedTiles(const QVector<int> &candidates, QVector<int> &changedTiles)
+{
+    // 并行计算候选图块的新哈希，再串行比较
+    QVector<quint64> newHashes(candidates.size());
+    QVector<int> jobs(candidates.size());
+    for (int i = 0; i < jobs.size(); ++i)
+    {
+        jobs[i] = i;
+    }
+    const QImage &frame = current;
+    QtConcurrent::blockingMap(jobs, [&](int &job)
+                              { newHashes[job] = PixelHash::hashRect(frame, writer.tileRect(candidates.at(job))); });
+
+    for (int i = 0; i < candidates.size(); ++i)
+    {
+        const int tile = candidates.at(i);
+        if (tileHashes[tile] != newHashes[i])
+        {
+            tileHashes[tile] = newHashes[i];
+            changedTiles.append(tile);
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef REGIONRECORDER_H
+#define REGIONRECORDER_H
+
+#include <QObject>
+#include <QImage>
+#include <QRect>
+#include <QVector>
+#include <QElapsedTimer>
+#include "recordingformat.h"
+#include "x11capture.h"
+
+class QScreen;
+class QTimer;
+
+// 区域录屏
+// 定时截取选区，只把发生变化的图块写入 .ssrv 文件。
+// X11 下优先用 XDamage 得到变化区域，只重新截取被修改的部分；
+// 其他情况每帧截取整个选区，再用图块哈希与上一帧比较找出变化的图块。
+class RegionRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    // logicalRect 为选区在屏幕内的逻辑坐标，nativeRect 为同一区域在虚拟桌面中的物理像素坐标
+    RegionRecorder(QScreen *screen, const QRect &logicalRect, const QRect &nativeRect, QObject *parent = nullptr);
+    ~RegionRecorder();
+
+    // 截取第一帧并开始写入，失败时返回 false，原因见 errorString()
+    bool start(const QString &fileName, int fps = 30);
+    void stop();
+    QString errorString() const { return error; }
+    bool isRecording() const;
+
+    int frameCount() const { return frames; }
+    qint64 durationMs() const;
+    qint64 bytesWritten() const { return writer.bytesWritten(); }
+    // 平均每帧变化的图块比例
+    double averageChangedRatio() const;
+    // 是否在使用 XDamage
+    bool usesDamage() const { return damage.isActive(); }
+
+signals:
+    void progress(int frames, qint64 durationMs);
+
+private slots:
+    void captureFrame();
+
+private:
+    QImage grabRegion() const;
+    // 只截取 damage 覆盖的图块，截取失败时返回 false，changedTiles 不变
+    bool grabDamaged(QVector<int> &changedTiles);
+    void hashChangedTiles(const QVector<int> &candidates, QVector<int> &changedTiles);
+
+    static const int TileSize = 64;
+    static const int KeyFrameIntervalMs = 2000;
+
+    QScreen *screen;
+    QRect logicalRect;
+    QRect nativeRect;
+
+    QTimer *timer;
+    QElapsedTimer clock;
+    qint64 lastKeyFrameMs;
+
+    RecordingWriter writer;
+    X11Capture::DamageTracker damage;
+
+    QImage current;               // 当前完整画面
+    QVector<quint64> tileHashes;  // 每个图块上一次写入时的哈希
+    int frames;
+    qint64 changedTileTotal;
+    QString error;
+};
+
+#endif // REGIONRECORDER_H
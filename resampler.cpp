@@ -0,0 +1,268 @@
+#include "resampler.h"
+#include <QtConcurrent>
+#include <QVector>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+    const int TileRows = 64;
+
+    // 一维卷积核：第 i 个目标像素由 first[i] 起的 count[i] 个源像素加权得到，
+    // 权重连续存放在 weights[i * stride] 起
+    struct Kernel
+    {
+        QVector<int> first;
+        QVector<int> count;
+        QVector<float> weights;
+        int stride = 0;
+    };
+
+    double filterRadius(Resampler::Filter filter)
+    {
+        return filter == Resampler::Lanczos3 ? 3.0 : 1.0;
+    }
+
+    double filterWeight(Resampler::Filter filter, double x)
+    {
+        x = std::fabs(x);
+        if (filter == Resampler::Bilinear)
+        {
+            return x < 1.0 ? 1.0 - x : 0.0;
+        }
+        if (x < 1e-8)
+        {
+            return 1.0;
+        }
+        if (x >= 3.0)
+        {
+            return 0.0;
+        }
+        const double px = M_PI * x;
+        return 3.0 * std::sin(px) * std::sin(px / 3.0) / (px * px);
+    }
+
+    // 源区间 [start, start + length) 映射到 dstLength 个目标像素，
+    // 卷积只取 [0, limit) 内的源像素，边缘处重新归一化权重
+    Kernel buildKernel(double start, double length, int limit, int dstLength, Resampler::Filter filter)
+    {
+        Kernel kernel;
+        const double scale = length / dstLength;
+        // 缩小时把核拉宽，避免混叠
+        const double filterScale = qMax(1.0, scale);
+        const double support = filterRadius(filter) * filterScale;
+
+        kernel.stride = int(std::ceil(support)) * 2 + 1;
+        kernel.first.resize(dstLength);
+        kernel.count.resize(dstLength);
+        kernel.weights.fill(0.0f, dstLength * kernel.stride);
+
+        for (int i = 0; i < dstLength; ++i)
+        {
+            const double center = start + (i + 0.5) * scale;
+            int lo = qMax(0, int(std::floor(center - support)));
+            int hi = qMin(limit, int(std::ceil(center + support)));
+            hi = qMin(hi, lo + kernel.stride);
+
+            float *weights = kernel.weights.data() + i * kernel.stride;
+            double sum = 0.0;
+            for (int j = lo; j < hi; ++j)
+            {
+                const double w = filterWeight(filter, (j + 0.5 - center) / filterScale);
+                weights[j - lo] = float(w);
+                sum += w;
+            }
+
+            if (hi <= lo || std::fabs(sum) < 1e-8)
+            {
+                // 没有可用的源像素时退化为最近邻
+                lo = qBound(0, int(center), limit - 1);
+                hi = lo + 1;
+                weights[0] = 1.0f;
+                sum = 1.0;
+            }
+            for (int j = 0; j < hi - lo; ++j)
+            {
+                weights[j] = float(weights[j] / sum);
+            }
+            kernel.first[i] = lo;
+            kernel.count[i] = hi - lo;
+        }
+        return kernel;
+    }
+
+    // 水平方向：一行源像素 -> dstWidth 个浮点像素（每像素 4 个通道）
+    void horizontalPass(const quint32 *src, const Kernel &kernel, float *out, int dstWidth)
+    {
+        for (int x = 0; x < dstWidth; ++x)
+        {
+            const quint32 *pixels = src + kernel.first[x];
+            const float *weights = kernel.weights.constData() + x * kernel.stride;
+            const int count = kernel.count[x];
+#if defined(__SSE2__)
+            const __m128i zero = _mm_setzero_si128();
+            __m128 acc = _mm_setzero_ps();
+            for (int k = 0; k < count; ++k)
+            {
+                __m128i p = _mm_cvtsi32_si128(int(pixels[k]));
+                p = _mm_unpacklo_epi16(_mm_unpacklo_epi8(p, zero), zero);
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_cvtepi32_ps(p), _mm_set1_ps(weights[k])));
+            }
+            _mm_storeu_ps(out + x * 4, acc);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+            float32x4_t acc = vdupq_n_f32(0.0f);
+            for (int k = 0; k < count; ++k)
+            {
+                const uint16x8_t p16 = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(pixels[k])));
+                const float32x4_t p = vcvtq_f32_u32(vmovl_u16(vget_low_u16(p16)));
+                acc = vaddq_f32(acc, vmulq_f32(p, vdupq_n_f32(weights[k])));
+            }
+            vst1q_f32(out + x * 4, acc);
+#else
+            float acc[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+            for (int k = 0; k < count; ++k)
+            {
+                const quint32 p = pixels[k];
+                for (int c = 0; c < 4; ++c)
+                {
+                    const float product = float((p >> (c * 8)) & 0xff) * weights[k];
+                    acc[c] = acc[c] + product;
+                }
+            }
+            for (int c = 0; c < 4; ++c)
+            {
+                out[x * 4 + c] = acc[c];
+            }
+#endif
+        }
+    }
+
+    // 垂直方向：rows 中 count 行浮点像素加权求和，四舍五入（就近取偶）并饱和到 0..255
+    void verticalPass(const float *const *rows, const float *weights, int count, quint32 *dst, int width)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+#if defined(__SSE2__)
+            __m128 acc = _mm_setzero_ps();
+            for (int k = 0; k < count; ++k)
+            {
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(rows[k] + x * 4), _mm_set1_ps(weights[k])));
+            }
+            __m128i v = _mm_cvtps_epi32(acc);
+            v = _mm_packs_epi32(v, v);
+            v = _mm_packus_epi16(v, v);
+            dst[x] = quint32(_mm_cvtsi128_si32(v));
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+            float32x4_t acc = vdupq_n_f32(0.0f);
+            for (int k = 0; k < count; ++k)
+            {
+                acc = vaddq_f32(acc, vmulq_f32(vld1q_f32(rows[k] + x * 4), vdupq_n_f32(weights[k])));
+            }
+            const int16x4_t v16 = vqmovn_s32(vcvtnq_s32_f32(acc));
+            const uint8x8_t v8 = vqmovun_s16(vcombine_s16(v16, v16));
+            dst[x] = vget_lane_u32(vreinterpret_u32_u8(v8), 0);
+#else
+            float acc[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+            for (int k = 0; k < count; ++k)
+            {
+                for (int c = 0; c < 4; ++c)
+                {
+                    const float product = rows[k][x * 4 + c] * weights[k];
+                    acc[c] = acc[c] + product;
+                }
+            }
+            quint32 pixel = 0;
+            for (int c = 0; c < 4; ++c)
+            {
+                const int value = qBound(0, int(std::nearbyint(acc[c])), 255);
+                pixel |= quint32(value) << (c * 8);
+            }
+            dst[x] = pixel;
+#endif
+        }
+    }
+}
+
+namespace Resampler
+{
+    void resample(const QImage &source, const QRectF &sourceRect,
+                  QImage &target, const QRect &targetRect, Filter filter)
+    {
+        const QRect dstRect = targetRect.intersected(target.rect());
+        if (source.isNull() || source.depth() != 32 || target.depth() != 32 ||
+            dstRect.isEmpty() || sourceRect.isEmpty())
+        {
+            return;
+        }
+
+        // 目标区域被裁剪时，源区域按比例跟着裁剪
+        const double sx = sourceRect.width() / targetRect.width();
+        const double sy = sourceRect.height() / targetRect.height();
+        const Kernel horizontal = buildKernel(sourceRect.x() + (dstRect.x() - targetRect.x()) * sx,
+                                              dstRect.width() * sx, source.width(), dstRect.width(), filter);
+        const Kernel vertical = buildKernel(sourceRect.y() + (dstRect.y() - targetRect.y()) * sy,
+                                            dstRect.height() * sy, source.height(), dstRect.height(), filter);
+
+        // 多线程写入前先取得数据指针，避免在线程中调用 scanLine() 触发 detach 检查
+        uchar *targetBits = target.bits();
+        const int targetStride = target.bytesPerLine();
+        const int dstWidth = dstRect.width();
+
+        const int tileCount = (dstRect.height() + TileRows - 1) / TileRows;
+        QVector<int> jobs(tileCount);
+        for (int i = 0; i < tileCount; ++i)
+        {
+            jobs[i] = i;
+        }
+
+        QtConcurrent::blockingMap(jobs, [&](int &job)
+                                  {
+            const int rowBegin = job * TileRows;
+            const int rowEnd = qMin(dstRect.height(), rowBegin + TileRows);
+
+            // 本块需要的源行范围
+            int srcFirst = vertical.first[rowBegin];
+            int srcLast = srcFirst;
+            for (int y = rowBegin; y < rowEnd; ++y)
+            {
+                srcFirst = qMin(srcFirst, vertical.first[y]);
+                srcLast = qMax(srcLast, vertical.first[y] + vertical.count[y]);
+            }
+
+            QVector<float> buffer((srcLast - srcFirst) * dstWidth * 4);
+            for (int y = srcFirst; y < srcLast; ++y)
+            {
+                horizontalPass(reinterpret_cast<const quint32 *>(source.constScanLine(y)), horizontal,
+                               buffer.data() + (y - srcFirst) * dstWidth * 4, dstWidth);
+            }
+
+            QVector<const float *> rows(vertical.stride);
+            for (int y = rowBegin; y < rowEnd; ++y)
+            {
+                const int count = vertical.count[y];
+                for (int k = 0; k < count; ++k)
+                {
+                    rows[k] = buffer.constData() + (vertical.first[y] + k - srcFirst) * dstWidth * 4;
+                }
+                quint32 *dst = reinterpret_cast<quint32 *>(targetBits + (dstRect.y() + y) * targetStride) + dstRect.x();
+                verticalPass(rows.constData(), vertical.weights.constData() + y * vertical.stride, count, dst, dstWidth);
+            } });
+    }
+
+    QImage scaled(const QImage &source, const QSize &size, Filter filter)
+    {
+        if (source.isNull() || size.isEmpty())
+        {
+            return QImage();
+        }
+        const QImage input = source.depth() == 32 ? source : source.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        QImage result(size, input.format());
+        resample(input, QRectF(input.rect()), result, result.rect(), filter);
+        return result;
+    }
+}
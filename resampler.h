@@ -0,0 +1,29 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <QImage>
+#include <QRect>
+#include <QRectF>
+
+// 图像缩放
+// 可分离卷积：先逐行水平缩放到浮点中间缓冲，再逐列垂直缩放。
+// 按目标图像的行分块，块之间互不依赖，在线程池中并行处理；
+// 每个像素的 4 个通道用一条 SIMD 指令同时计算。
+namespace Resampler
+{
+    enum Filter
+    {
+        Bilinear, // 三角形核，半径 1
+        Lanczos3  // Lanczos 核，半径 3，放大和缩小都更锐利
+    };
+
+    // 把 source 中的 sourceRect（可以是小数坐标）缩放到 target 的 targetRect。
+    // source 和 target 都必须是 32 位格式；sourceRect 边缘外的像素在图像范围内时也会参与卷积
+    void resample(const QImage &source, const QRectF &sourceRect,
+                  QImage &target, const QRect &targetRect, Filter filter = Lanczos3);
+
+    // 便捷函数：整幅缩放到 size
+    QImage scaled(const QImage &source, const QSize &size, Filter filter = Lanczos3);
+}
+
+#endif // RESAMPLER_H
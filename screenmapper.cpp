@@ -0,0 +1,279 @@
+#include "screenmapper.h"
+#include "x11capture.h"
+#include <QGuiApplication>
+#include <QScreen>
+#include <QPixmap>
+#include <QPainter>
+#include <QDebug>
+#include <cmath>
+
+namespace
+{
+    // Qt 在缩放屏幕几何时保留屏幕左上角的原生坐标，只缩放宽高，
+    // 所以屏幕在虚拟桌面中的物理区域为 (左上角, 尺寸 * DPR)
+    QRect nativeScreenRect(QScreen *screen)
+    {
+        QRect geometry = screen->geometry();
+        return QRect(geometry.topLeft(), geometry.size() * screen->devicePixelRatio());
+    }
+
+    ScreenMapper::Screen describe(QScreen *screen)
+    {
+        ScreenMapper::Screen info;
+        info.screen = screen;
+        info.logical = screen->geometry();
+        info.native = nativeScreenRect(screen);
+        info.scale = screen->devicePixelRatio();
+        return info;
+    }
+}
+
+void ScreenMapper::grabScreens()
+{
+    screenList.clear();
+    Display *display = X11Capture::openDisplay();
+    // 各条带分开截取，不独占服务器：XGrabServer 期间所有客户端都会停住，整屏截取时间太长。
+    // 条带之间的间隔很短，只有正在快速变化的内容可能在条带边界错开一两帧
+    for (QScreen *screen : QGuiApplication::screens())
+    {
+        Screen info = describe(screen);
+        if (display)
+        {
+            // 每次只截取一条图块高度的区域，峰值内存只多出一条而不是一整屏
+            info.image = TiledImage(info.native.size());
+            for (int y = 0; y < info.native.height(); y += TiledImage::TileSize)
+            {
+                const QRect band(info.native.x(), info.native.y() + y, info.native.width(),
+                                 qMin(int(TiledImage::TileSize), info.native.height() - y));
+                info.image.write(QPoint(0, y), X11Capture::grabRootRect(display, band));
+            }
+        }
+        else
+        {
+            info.image = TiledImage::fromImage(screen->grabWindow(0).toImage());
+            if (info.image.size() != info.native.size())
+            {
+                // 平台返回的尺寸可能有舍入差异，以截图的实际大小为准
+                info.native.setSize(info.image.size());
+            }
+        }
+        screenList.append(info);
+    }
+    X11Capture::closeDisplay(display);
+}
+
+void ScreenMapper::describeScreens()
+{
+    screenList.clear();
+    for (QScreen *screen : QGuiApplication::screens())
+    {
+        screenList.append(describe(screen));
+    }
+}
+
+void ScreenMapper::setDesktopFrame(const QImage &desktopFrame)
+{
+    screenList.clear();
+    for (QScreen *screen : QGuiApplication::screens())
+    {
+        Screen info = describe(screen);
+        info.native = info.native.intersected(desktopFrame.rect());
+        if (info.native.isEmpty())
+        {
+            continue;
+        }
+        info.image = TiledImage::fromImage(desktopFrame, info.native);
+        screenList.append(info);
+    }
+}
+
+void ScreenMapper::setScreens(const QVector<Screen> &screens)
+{
+    screenList = screens;
+    // QScreen 指针可能已经失效，按逻辑区域重新匹配当前的屏幕
+    const QList<QScreen *> current = QGuiApplication::screens();
+    for (Screen &info : screenList)
+    {
+        info.screen = nullptr;
+        for (QScreen *screen : current)
+        {
+            if (screen->geometry() == info.logical)
+            {
+                info.screen = screen;
+                break;
+            }
+        }
+    }
+}
+
+QRect ScreenMapper::logicalBounds() const
+{
+    QRect bounds;
+    for (const Screen &screen : screenList)
+    {
+        bounds |= screen.logical;
+    }
+    return bounds;
+}
+
+qint64 ScreenMapper::allocatedBytes() const
+{
+    qint64 bytes = 0;
+    for (const Screen &screen : screenList)
+    {
+        bytes += screen.image.allocatedBytes();
+    }
+    return bytes;
+}
+
+int ScreenMapper::screenAt(const QPoint &logicalPos) const
+{
+    for (int i = 0; i < screenList.size(); ++i)
+    {
+        if (screenList[i].logical.contains(logicalPos))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int ScreenMapper::screenFor(const QRect &logicalRect) const
+{
+    int best = screenList.isEmpty() ? -1 : 0;
+    qint64 bestArea = -1;
+    for (int i = 0; i < screenList.size(); ++i)
+    {
+        const QRect part = screenList[i].logical.intersected(logicalRect);
+        const qint64 area = part.isEmpty() ? 0 : qint64(part.width()) * part.height();
+        if (area > bestArea)
+        {
+            bestArea = area;
+            best = i;
+        }
+    }
+    return best;
+}
+
+qreal ScreenMapper::maxScale(const QRect &logicalRect) const
+{
+    qreal scale = 0.0;
+    for (const Screen &screen : screenList)
+    {
+        if (screen.logical.intersects(logicalRect))
+        {
+            scale = qMax(scale, screen.scale);
+        }
+    }
+    return scale > 0.0 ? scale : 1.0;
+}
+
+QRect ScreenMapper::toNative(const QRect &logicalRect) const
+{
+    const int index = screenFor(logicalRect);
+    if (index < 0)
+    {
+        return logicalRect;
+    }
+    const Screen &screen = screenList[index];
+    const QPoint offset = logicalRect.topLeft() - screen.logical.topLeft();
+    return QRect(screen.native.topLeft() + QPoint(qRound(offset.x() * screen.scale), qRound(offset.y() * screen.scale)),
+                 QSize(qRound(logicalRect.width() * screen.scale), qRound(logicalRect.height() * screen.scale)));
+}
+
+QRect ScreenMapper::toLogical(const QRect &nativeRect) const
+{
+    // 按物理区域找屏幕：与之相交面积最大的那个
+    int index = -1;
+    qint64 bestArea = 0;
+    for (int i = 0; i < screenList.size(); ++i)
+    {
+        const QRect part = screenList[i].native.intersected(nativeRect);
+        const qint64 area = part.isEmpty() ? 0 : qint64(part.width()) * part.height();
+        if (area > bestArea)
+        {
+            bestArea = area;
+            index = i;
+        }
+    }
+    if (index < 0)
+    {
+        return nativeRect;
+    }
+    const Screen &screen = screenList[index];
+    const QPointF offset = QPointF(nativeRect.topLeft() - screen.native.topLeft()) / screen.scale;
+    return QRectF(QPointF(screen.logical.topLeft()) + offset, QSizeF(nativeRect.size()) / screen.scale).toAlignedRect();
+}
+
+void ScreenMapper::draw(QPainter &painter, const QRectF &target, const QRect &source) const
+{
+    if (source.isEmpty())
+    {
+        return;
+    }
+    const qreal sx = target.width() / source.width();
+    const qreal sy = target.height() / source.height();
+
+    for (const Screen &screen : screenList)
+    {
+        const QRect part = screen.logical.intersected(source);
+        if (part.isEmpty())
+        {
+            continue;
+        }
+        const QRectF targetPart(target.x() + (part.x() - source.x()) * sx,
+                                target.y() + (part.y() - source.y()) * sy,
+                                part.width() * sx, part.height() * sy);
+        const QRectF sourcePart(QPointF(part.topLeft() - screen.logical.topLeft()) * screen.scale,
+                                QSizeF(part.size()) * screen.scale);
+        screen.image.draw(painter, targetPart, sourcePart);
+    }
+}
+
+QImage ScreenMapper::render(const QRect &logicalRect, qreal outputScale, Resampler::Filter filter) const
+{
+    if (logicalRect.isEmpty() || outputScale <= 0.0)
+    {
+        return QImage();
+    }
+
+    QImage result(qRound(logicalRect.width() * outputScale), qRound(logicalRect.height() * outputScale),
+                  QImage::Format_RGB32);
+    result.fill(Qt::black);
+
+    for (const Screen &screen : screenList)
+    {
+        const QRect part = screen.logical.intersected(logicalRect);
+        if (part.isEmpty())
+        {
+            continue;
+        }
+
+        // 目标区域按整数像素对齐，相邻屏幕的部分首尾相接
+        const QPoint dstTopLeft(qRound((part.left() - logicalRect.left()) * outputScale),
+                                qRound((part.top() - logicalRect.top()) * outputScale));
+        const QPoint dstBottomRight(qRound((part.right() + 1 - logicalRect.left()) * outputScale) - 1,
+                                    qRound((part.bottom() + 1 - logicalRect.top()) * outputScale) - 1);
+        const QRect dstRect = QRect(dstTopLeft, dstBottomRight).intersected(result.rect());
+        const QRectF srcRect(QPointF(part.topLeft() - screen.logical.topLeft()) * screen.scale,
+                             QSizeF(part.size()) * screen.scale);
+
+        const QRect srcAligned = srcRect.toRect();
+        if (qFuzzyCompare(screen.scale, outputScale) && srcAligned.size() == dstRect.size() &&
+            screen.image.rect().contains(srcAligned))
+        {
+            // 比例相同，直接从图块拷贝
+            screen.image.copyTo(srcAligned, result, dstRect.topLeft());
+        }
+        else
+        {
+            // 只取出源区域加上卷积核半径的部分参与重采样
+            const int margin = int(std::ceil(3.0 * qMax(1.0, screen.scale / outputScale))) + 1;
+            const QRect needed = srcRect.toAlignedRect().adjusted(-margin, -margin, margin, margin)
+                                     .intersected(screen.image.rect());
+            const QImage source = screen.image.copy(needed);
+            Resampler::resample(source, srcRect.translated(-needed.topLeft()), result, dstRect, filter);
+        }
+    }
+    return result;
+}
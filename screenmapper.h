@@ -0,0 +1,72 @@
+#ifndef SCREENMAPPER_H
+#define SCREENMAPPER_H
+
+#include <QImage>
+#include <QRect>
+#include <QVector>
+#include "resampler.h"
+#include "tiledimage.h"
+
+class QScreen;
+class QPainter;
+
+// 多屏幕坐标映射
+// 保存每个屏幕的逻辑区域、物理像素区域、缩放比例和截图。
+// 截图遮罩覆盖整个虚拟桌面，选区可以跨越缩放比例不同的屏幕；
+// 导出时把选区落在各屏幕上的部分分别重采样到统一的输出比例再拼起来。
+// 除特别说明外，所有逻辑坐标都是 Qt 的虚拟桌面坐标。
+class ScreenMapper
+{
+public:
+    struct Screen
+    {
+        QScreen *screen = nullptr;
+        QRect logical;   // 逻辑坐标
+        QRect native;    // 物理像素坐标（根窗口坐标系）
+        qreal scale = 1.0;
+        TiledImage image; // 该屏幕的截图，尺寸为 native.size()
+    };
+
+    void clear() { screenList.clear(); }
+    bool isEmpty() const { return screenList.isEmpty(); }
+
+    // 逐个屏幕截图。X11 下按图块高度分条截取，直接写入图块，不生成整屏的临时图像
+    void grabScreens();
+    // 只记录各屏幕的几何信息和缩放比例，不截图，用于逻辑坐标与物理坐标的换算
+    void describeScreens();
+    // 从整个根窗口的物理像素图像中切出各个屏幕
+    void setDesktopFrame(const QImage &desktopFrame);
+    // 使用之前保存的屏幕列表。屏幕已被移除时 Screen::screen 为 nullptr
+    void setScreens(const QVector<Screen> &screens);
+
+    const QVector<Screen> &screens() const { return screenList; }
+    // 所有屏幕逻辑区域的外接矩形
+    QRect logicalBounds() const;
+    // 所有屏幕截图的图块占用的字节数
+    qint64 allocatedBytes() const;
+
+    // 包含逻辑坐标点的屏幕下标，不在任何屏幕上时返回 -1
+    int screenAt(const QPoint &logicalPos) const;
+    // 与逻辑区域相交面积最大的屏幕下标
+    int screenFor(const QRect &logicalRect) const;
+
+    // 与逻辑区域相交的屏幕中最大的缩放比例，用作默认输出比例以保留所有细节
+    qreal maxScale(const QRect &logicalRect) const;
+
+    // 逻辑区域与物理区域互相换算，按 screenFor() 选出的屏幕的比例计算
+    QRect toNative(const QRect &logicalRect) const;
+    QRect toLogical(const QRect &nativeRect) const;
+
+    // 把逻辑区域 source 的截图画到 target（用于预览，由 QPainter 缩放）
+    void draw(QPainter &painter, const QRectF &target, const QRect &source) const;
+
+    // 把逻辑区域渲染为 outputScale 倍的图像：缩放比例与输出相同的屏幕直接拷贝像素，
+    // 其余屏幕的部分用 filter 重采样。不属于任何屏幕的部分填充黑色
+    QImage render(const QRect &logicalRect, qreal outputScale,
+                  Resampler::Filter filter = Resampler::Lanczos3) const;
+
+private:
+    QVector<Screen> screenList;
+};
+
+#endif // SCREENMAPPER_H
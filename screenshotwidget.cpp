@@ -15,8 +15,70 @@
 #include <QHBoxLayout>
 #include <QDesktopServices>
 #include <cmath>
-#include<QLineEdit>
+#include <QPlainTextEdit>
+#include <QTextDocument>
 #include<QFontDialog>
+#include "x11capture.h"
+#include "regionrecorder.h"
+#include "imageexporter.h"
+#include "memoryusage.h"
+#include "recentcaptures.h"
+#include "capturehistory.h"
+#include "imagediff.h"
+#include "autotrim.h"
+#include "ocrengine.h"
+#include "pinwidget.h"
+#include "inputcoalescer.h"
+#include "inputsession.h"
+#include "pixelformat.h"
+#include <QtConcurrent>
+#include <QDir>
+#include <QFile>
+#include <QSettings>
+#include <QElapsedTimer>
+#include <QToolTip>
+#include <QMessageBox>
+
+namespace
+{
+    // 截图窗口中各控件的样式，按 objectName 选择。第一次创建截图窗口时加到应用程序的样式表中，
+    // 只解析一次；之后的截图窗口和控件直接使用已解析的规则，不再各自设置、解析样式表
+    const QString OverlayStyle = QStringLiteral(
+        "QWidget#captureToolbar { background-color: rgba(40, 40, 40, 200); border-radius: 5px; }"
+        "#captureToolbar QPushButton { background-color: rgba(60, 60, 60, 255); color: white; "
+        "border: none; padding: 8px 15px; border-radius: 3px; font-size: 13px; }"
+        "#captureToolbar QPushButton:hover { background-color: rgba(80, 80, 80, 255); }"
+        "#captureToolbar QPushButton:pressed { background-color: rgba(50, 50, 50, 255); }"
+        "#captureToolbar QPushButton:checked { background-color: rgba(0, 150, 255, 255); }"
+        "QPlainTextEdit#annotationTextInput { background-color:rgba(255,255,255,240);color: black; "
+        "border: 2px solid #0096FF; border-radius: 3px;padding: 5px; }"
+        "QPlainTextEdit#annotationTextInput:focus { border-color:#FF5500; }"
+        "QLabel#selectionSizeLabel { background-color: rgba(0, 0, 0, 180); color: white; "
+        "padding: 5px; border-radius: 3px; font-size: 12px; }"
+        "QWidget#capturePanel, #capturePanel QLabel, #capturePanel QPushButton { "
+        "background-color: rgba(40, 40, 40, 230); color: white; font-size: 13px; }"
+        "#capturePanel QPushButton { background-color: rgba(60, 60, 60, 255); border: none; padding: 6px 12px; border-radius: 3px; }"
+        "#capturePanel QPushButton:hover { background-color: rgba(80, 80, 80, 255); }");
+
+    void installOverlayStyle()
+    {
+        static bool installed = false;
+        if (!installed)
+        {
+            qApp->setStyleSheet(qApp->styleSheet() + OverlayStyle);
+            installed = true;
+        }
+    }
+
+    // 启动参数带 --capture-profile 或设置了环境变量 SCREENSNIPER_CAPTURE_PROFILE 时，
+    // 每次截图输出内存峰值等统计，默认不输出
+    bool captureProfileRequested()
+    {
+        static const bool requested = qEnvironmentVariableIsSet("SCREENSNIPER_CAPTURE_PROFILE") ||
+                                      QCoreApplication::arguments().contains("--capture-profile");
+        return requested;
+    }
+}
 
 ScreenshotWidget::ScreenshotWidget(QWidget *parent)
     : QWidget(parent),
@@ -24,13 +86,25 @@ ScreenshotWidget::ScreenshotWidget(QWidget *parent)
       selected(false),
       currentDrawMode(None),
       toolbar(nullptr),
-      devicePixelRatio(1.0),
       showMagnifier(false),
       isDrawing(false),
       textInput(nullptr),
+      editingText(-1),
       isTextInputActive(false),
       isTextMoving(false),
-      movingText(nullptr)
+      movingText(-1),
+      captureScreen(nullptr),
+      captureId(0),
+      stillCapture(true),
+      captureHistory(nullptr),
+      snapRadius(QSettings().value("selection/snapRadius", 6).toInt()),
+      ocrEngine(nullptr),
+      windowPicking(false),
+      hoveredWindow(-1),
+      capturePanel(nullptr),
+      panelStatusLabel(nullptr),
+      scrollTimer(nullptr),
+      recorder(nullptr)
 {
     setWindowFlags(Qt::FramelessWindowHint | Qt::WindowStaysOnTopHint | Qt::Tool);
     setAttribute(Qt::WA_TranslucentBackground);
@@ -38,30 +112,27 @@ ScreenshotWidget::ScreenshotWidget(QWidget *parent)
     setCursor(Qt::CrossCursor);
     setFocusPolicy(Qt::StrongFocus); // 确保窗口能接收键盘事件
 
-    setupToolbar();
-    setupTextInput();
+    // 工具栏和文字输入框在第一次用到时才创建（ensureToolbar、showTextInput），
+    // 只框选后直接复制、保存的截图不需要构造这些控件
+    installOverlayStyle();
+    inputCoalescer = new InputCoalescer(this);
 
     // 创建尺寸标签
     sizeLabel = new QLabel(this);
-    sizeLabel->setStyleSheet("QLabel { background-color: rgba(0, 0, 0, 180); color: white; "
-                             "padding: 5px; border-radius: 3px; font-size: 12px; }");
+    sizeLabel->setObjectName("selectionSizeLabel");
     sizeLabel->hide();
 }
 
 ScreenshotWidget::~ScreenshotWidget()
 {
+    // 控制面板是独立的顶层窗口，需要手动释放
+    delete capturePanel;
 }
 
 void ScreenshotWidget::setupToolbar()
 {
     toolbar = new QWidget(this);
-    toolbar->setStyleSheet(
-        "QWidget { background-color: rgba(40, 40, 40, 200); border-radius: 5px; }"
-        "QPushButton { background-color: rgba(60, 60, 60, 255); color: white; "
-        "border: none; padding: 8px 15px; border-radius: 3px; font-size: 13px; }"
-        "QPushButton:hover { background-color: rgba(80, 80, 80, 255); }"
-        "QPushButton:pressed { background-color: rgba(50, 50, 50, 255); }"
-        "QPushButton:checked { background-color: rgba(0, 150, 255, 255); }");
+    toolbar->setObjectName("captureToolbar");
 
     QHBoxLayout *layout = new QHBoxLayout(toolbar);
     layout->setSpacing(5);
@@ -74,6 +145,16 @@ void ScreenshotWidget::setupToolbar()
     btnPen = new QPushButton("画笔", toolbar);
 
     // 操作按钮
+    btnScroll = new QPushButton("长截图", toolbar);
+    btnRecord = new QPushButton("录屏", toolbar);
+    btnDiff = new QPushButton("对比", toolbar);
+    btnTrim = new QPushButton("去边", toolbar);
+    btnTrim->setCheckable(true);
+    btnTrim->setChecked(QSettings().value("export/autoTrim", false).toBool());
+    btnTrim->setToolTip("保存和复制时裁掉四周的纯色边框");
+    btnOcr = new QPushButton("复制文字", toolbar);
+    btnOcr->setToolTip("用本机的 tesseract 识别选区中的文字");
+    btnPin = new QPushButton("钉图", toolbar);
     btnSave = new QPushButton("保存", toolbar);
     btnCopy = new QPushButton("复制", toolbar);
     btnCancel = new QPushButton("取消", toolbar);
@@ -83,11 +164,24 @@ void ScreenshotWidget::setupToolbar()
     layout->addWidget(btnText);
     layout->addWidget(btnPen);
     layout->addSpacing(10);
+    layout->addWidget(btnScroll);
+    layout->addWidget(btnRecord);
+    layout->addWidget(btnDiff);
+    layout->addWidget(btnTrim);
+    layout->addWidget(btnOcr);
+    layout->addWidget(btnPin);
     layout->addWidget(btnSave);
     layout->addWidget(btnCopy);
     layout->addWidget(btnCancel);
 
     // 连接信号
+    connect(btnScroll, &QPushButton::clicked, this, &ScreenshotWidget::startScrollCapture);
+    connect(btnRecord, &QPushButton::clicked, this, &ScreenshotWidget::startRecording);
+    connect(btnDiff, &QPushButton::clicked, this, &ScreenshotWidget::compareWithFile);
+    connect(btnTrim, &QPushButton::toggled, this, [](bool checked)
+            { QSettings().setValue("export/autoTrim", checked); });
+    connect(btnOcr, &QPushButton::clicked, this, &ScreenshotWidget::recognizeText);
+    connect(btnPin, &QPushButton::clicked, this, &ScreenshotWidget::pinSelection);
     connect(btnSave, &QPushButton::clicked, this, &ScreenshotWidget::saveScreenshot);
     connect(btnCopy, &QPushButton::clicked, this, &ScreenshotWidget::copyToClipboard);
     connect(btnCancel, &QPushButton::clicked, this, &ScreenshotWidget::cancelCapture);
@@ -105,60 +199,219 @@ void ScreenshotWidget::setupToolbar()
     toolbar->hide();
 }
 
+void ScreenshotWidget::ensureToolbar()
+{
+    if (!toolbar)
+    {
+        setupToolbar();
+    }
+}
+
 void ScreenshotWidget::startCapture()
 {
-    // 获取鼠标当前位置所在的屏幕
-    QPoint cursorPos = QCursor::pos();
-    QScreen *currentScreen = nullptr;
+    // 每次截图单独统计内存峰值
+    MemoryUsage::resetPeak();
+
+    // 每个屏幕按各自的缩放比例截取物理像素
+    screenMapper.grabScreens();
+    if (!screenMapper.isEmpty())
+    {
+        showOverlay();
+    }
+}
+
+void ScreenshotWidget::startCaptureWindow()
+{
+    startCapture();
+    enableWindowPicking();
+}
+
+CaptureState ScreenshotWidget::captureState() const
+{
+    CaptureState state;
+    state.id = captureId;
+    state.screens = screenMapper.screens();
+    state.selection = selectedRect.translated(virtualGeometryTopLeft);
+    state.origin = virtualGeometryTopLeft;
+    state.annotations = annotations;
+    return state;
+}
+
+void ScreenshotWidget::startCaptureFromState(const CaptureState &state)
+{
+    screenMapper.setScreens(state.screens);
+    if (screenMapper.isEmpty())
+    {
+        return;
+    }
+    showOverlay();
+    captureId = state.id;
+
+    // 标注保存的是相对于当时遮罩原点的坐标，屏幕布局相同时原点不变
+    const QPoint shift = state.origin - virtualGeometryTopLeft;
+    annotations = state.annotations;
+    annotations.translateAll(shift);
+
+    selectedRect = state.selection.translated(-virtualGeometryTopLeft);
+    showMagnifier = false;
+    QTimer::singleShot(0, this, &ScreenshotWidget::showSelectionToolbar);
+}
+
+void ScreenshotWidget::startCaptureFromScreens(const QVector<ScreenMapper::Screen> &screens)
+{
+    MemoryUsage::resetPeak();
+    screenMapper.setScreens(screens);
+    if (!screenMapper.isEmpty())
+    {
+        showOverlay();
+    }
+}
+
+void ScreenshotWidget::startCaptureFromFrame(const QImage &desktopFrame, const QPoint &nativeCursorPos, CaptureMode mode)
+{
+    MemoryUsage::resetPeak();
+
+    // desktopFrame 是根窗口坐标系下的物理像素图像
+    screenMapper.setDesktopFrame(desktopFrame);
+    if (screenMapper.isEmpty())
+    {
+        return;
+    }
+    showOverlay();
+    currentMousePos = screenMapper.toLogical(QRect(nativeCursorPos, QSize(1, 1))).topLeft() - virtualGeometryTopLeft;
+
+    if (mode == CaptureFullScreen)
+    {
+        // 截图已经完成，等窗口显示后再选中全屏即可
+        QTimer::singleShot(0, this, &ScreenshotWidget::selectWholeScreen);
+    }
+    else if (mode == CaptureWindow)
+    {
+        enableWindowPicking();
+    }
+}
+
+void ScreenshotWidget::showOverlay()
+{
+    // 遮罩覆盖整个虚拟桌面，选区可以跨越多个屏幕
+    QRect virtualGeometry = screenMapper.logicalBounds();
     
-    QList<QScreen *> screens = QGuiApplication::screens();
-    for (QScreen *scr : screens)
+    // 保存虚拟桌面的原点位置，窗口坐标加上它就是虚拟桌面的逻辑坐标
+    virtualGeometryTopLeft = virtualGeometry.topLeft();
+    
+    // 鼠标所在的屏幕，选区确定后会更新为选区所在的屏幕
+    const int cursorScreen = screenMapper.screenAt(QCursor::pos());
+    captureScreen = screenMapper.screens().at(cursorScreen >= 0 ? cursorScreen : 0).screen;
+    if (!captureScreen)
     {
-        if (scr->geometry().contains(cursorPos))
+        captureScreen = QGuiApplication::primaryScreen();
+    }
+    
+    // 设置窗口标志以绕过窗口管理器
+    setWindowFlags(Qt::FramelessWindowHint | Qt::WindowStaysOnTopHint | Qt::Tool | Qt::BypassWindowManagerHint);
+    
+    setGeometry(virtualGeometry);
+    
+    // 直接显示，不使用全屏模式
+    show();
+    
+    // 确保窗口获得焦点以接收键盘事件
+    setFocus();
+    activateWindow();
+    raise();
+    
+    selecting = false;
+    selected = false;
+    selectedRect = QRect();
+    showMagnifier = true; // 在截图开始时就启用放大镜
+
+    windowPicking = false;
+    windowLayout.clear();
+    hoveredWindow = -1;
+
+    startEdgeDetection();
+
+    // 设置了录制目录时录下这次截图的输入，之后可以用 --replay 回放
+    const QString sessionDir = InputSession::recordDirectory();
+    if (!sessionDir.isEmpty())
+    {
+        new InputRecorder(this, screenMapper.screens(), sessionDir);
+    }
+}
+
+void ScreenshotWidget::startEdgeDetection()
+{
+    if (snapRadius <= 0)
+    {
+        return;
+    }
+
+    // 图块是隐式共享的，复制屏幕列表不复制像素；拼整屏图像也在工作线程里做
+    const QVector<ScreenMapper::Screen> screens = screenMapper.screens();
+    edgeMaps = QtConcurrent::run([screens]()
+                                 {
+        QVector<EdgeMap> maps;
+        for (const ScreenMapper::Screen &screen : screens)
         {
-            currentScreen = scr;
-            break;
+            maps.append(EdgeMap::compute(screen.image.copy(screen.image.rect())));
         }
+        return maps; });
+}
+
+QPoint ScreenshotWidget::snapToEdges(const QPoint &pos, Qt::KeyboardModifiers modifiers) const
+{
+    // 还没算完时不等待，直接不吸附
+    if (snapRadius <= 0 || (modifiers & Qt::AltModifier) || !edgeMaps.isFinished() || edgeMaps.resultCount() == 0)
+    {
+        return pos;
     }
-    
-    // 如果没有找到，使用主屏幕
-    if (!currentScreen)
+
+    const QPoint logical = pos + virtualGeometryTopLeft;
+    const int index = screenMapper.screenAt(logical);
+    const QVector<EdgeMap> maps = edgeMaps.result();
+    if (index < 0 || index >= maps.size())
     {
-        currentScreen = QGuiApplication::primaryScreen();
+        return pos;
     }
-    
-    if (currentScreen)
-    {
-        devicePixelRatio = currentScreen->devicePixelRatio();
-        
-        // 获取当前屏幕的几何信息
-        QRect screenGeometry = currentScreen->geometry();
-        
-        // 保存屏幕的原点位置
-        virtualGeometryTopLeft = screenGeometry.topLeft();
-        
-        // 只截取当前屏幕
-        screenPixmap = currentScreen->grabWindow(0);
-        
-        // 设置窗口标志以绕过窗口管理器
-        setWindowFlags(Qt::FramelessWindowHint | Qt::WindowStaysOnTopHint | Qt::Tool | Qt::BypassWindowManagerHint);
-        
-        // 设置窗口大小和位置为当前屏幕
-        setGeometry(screenGeometry);
-        
-        // 直接显示，不使用全屏模式
-        show();
-        
-        // 确保窗口获得焦点以接收键盘事件
-        setFocus();
-        activateWindow();
-        raise();
-        
-        selecting = false;
-        selected = false;
-        selectedRect = QRect();
-        showMagnifier = true; // 在截图开始时就启用放大镜
+
+    // 边缘投影是物理像素，吸附半径也按该屏幕的缩放比例换算
+    const ScreenMapper::Screen &screen = screenMapper.screens().at(index);
+    const EdgeMap &map = maps.at(index);
+    const int nativeX = qRound((logical.x() - screen.logical.x()) * screen.scale);
+    const int nativeY = qRound((logical.y() - screen.logical.y()) * screen.scale);
+    const int radius = qMax(1, qRound(snapRadius * screen.scale));
+
+    QPoint snapped = pos;
+    const int edgeX = map.snapX(nativeX, nativeY, radius);
+    if (edgeX >= 0)
+    {
+        snapped.setX(screen.logical.x() + qRound(edgeX / screen.scale) - virtualGeometryTopLeft.x());
+    }
+    const int edgeY = map.snapY(nativeX, nativeY, radius);
+    if (edgeY >= 0)
+    {
+        snapped.setY(screen.logical.y() + qRound(edgeY / screen.scale) - virtualGeometryTopLeft.y());
+    }
+    return snapped;
+}
+
+void ScreenshotWidget::enableWindowPicking()
+{
+    // 只在截图开始时向 X 服务器查询一次窗口列表，之后鼠标移动只查缓存
+    const QVector<X11Capture::TopLevelWindow> windows = X11Capture::stackingWindows();
+
+    // 物理像素按窗口所在屏幕的比例转换为本窗口的逻辑坐标
+    QVector<QRect> rects;
+    rects.reserve(windows.size());
+    for (const X11Capture::TopLevelWindow &window : windows)
+    {
+        rects.append(screenMapper.toLogical(window.geometry).translated(-virtualGeometryTopLeft));
     }
+
+    windowLayout.build(rects, rect());
+    windowPicking = true;
+    hoveredWindow = windowLayout.windowAt(mapFromGlobal(QCursor::pos()));
+    update();
 }
 
 void ScreenshotWidget::startCaptureFullScreen()
@@ -167,44 +420,64 @@ void ScreenshotWidget::startCaptureFullScreen()
     startCapture();
 
     // 然后立即设置为全屏模式
-    QTimer::singleShot(150, this, [this]()
-                       {
-        selectedRect = rect();
-        selected = true;
-        selecting = false;
-        
-        toolbar->setParent(this);
-        toolbar->adjustSize();
-        updateToolbarPosition();
-        toolbar->setWindowFlags(Qt::Widget);
-        toolbar->raise();
-        toolbar->show();
-        toolbar->activateWindow();
-        
-        update(); });
+    QTimer::singleShot(150, this, &ScreenshotWidget::selectWholeScreen);
+}
+
+void ScreenshotWidget::selectWholeScreen()
+{
+    // 选中鼠标所在的整个屏幕
+    const int index = qMax(0, screenMapper.screenAt(QCursor::pos()));
+    selectedRect = screenMapper.screens().at(index).logical.translated(-virtualGeometryTopLeft);
+    showSelectionToolbar();
+}
+
+void ScreenshotWidget::showSelectionToolbar()
+{
+    selected = true;
+    selecting = false;
+    
+    ensureToolbar();
+    toolbar->setParent(this);
+    toolbar->adjustSize();
+    updateToolbarPosition();
+    toolbar->setWindowFlags(Qt::Widget);
+    toolbar->raise();
+    toolbar->show();
+    toolbar->activateWindow();
+    
+    update();
 }
 
 void ScreenshotWidget::paintEvent(QPaintEvent *event)
 {
-    Q_UNUSED(event);
+    // 用上一帧以来缓存的全部鼠标样本更新状态，绘制的总是最新的位置
+    applyInputSamples();
 
     QPainter painter(this);
 
     // 绘制背景截图
-    // screenPixmap包含物理像素，需要缩放到窗口大小（逻辑像素）
-    // 窗口坐标是相对于虚拟桌面的，所以需要考虑偏移
-    QRect windowRect = rect();
-    QRect sourceRect(0, 0, screenPixmap.width(), screenPixmap.height());
-    painter.drawPixmap(windowRect, screenPixmap, sourceRect);
+    // 各屏幕的截图是物理像素，按各自的缩放比例画到窗口的逻辑坐标上
+    screenMapper.draw(painter, rect(), rect().translated(virtualGeometryTopLeft));
 
     // 绘制半透明遮罩
     painter.fillRect(rect(), QColor(0, 0, 0, 100));
 
+    // 窗口选择模式下，还没有拖动时高亮鼠标下的窗口
+    QRect hoverRect;
+    if (windowPicking && !selected && (!selecting || (endPoint - startPoint).manhattanLength() < 4))
+    {
+        hoverRect = windowLayout.windowRect(hoveredWindow);
+    }
+
     // 如果有选中区域，显示选中区域的原始图像
-    if (selecting || selected)
+    if (selecting || selected || !hoverRect.isEmpty())
     {
         QRect currentRect;
-        if (selecting)
+        if (!hoverRect.isEmpty())
+        {
+            currentRect = hoverRect;
+        }
+        else if (selecting)
         {
             currentRect = QRect(startPoint, endPoint).normalized();
         }
@@ -216,16 +489,26 @@ void ScreenshotWidget::paintEvent(QPaintEvent *event)
         if (!currentRect.isEmpty())
         {
             // 显示选中区域的原始图像
-            // 将窗口坐标转换为截图坐标（考虑虚拟桌面偏移）
-            QPoint windowPos = geometry().topLeft();
-            QPoint offset = windowPos - virtualGeometryTopLeft;
-            
-            QRect physicalRect(
-                (currentRect.x() + offset.x()) * devicePixelRatio,
-                (currentRect.y() + offset.y()) * devicePixelRatio,
-                currentRect.width() * devicePixelRatio,
-                currentRect.height() * devicePixelRatio);
-            painter.drawPixmap(currentRect, screenPixmap, physicalRect);
+            screenMapper.draw(painter, currentRect, currentRect.translated(virtualGeometryTopLeft));
+
+            // 对比结果：热力图和变化区域从输出图像的像素坐标缩放到选区
+            if (selected && !diffHeatmap.isNull())
+            {
+                const qreal sx = qreal(currentRect.width()) / diffImageSize.width();
+                const qreal sy = qreal(currentRect.height()) / diffImageSize.height();
+                painter.drawImage(QRectF(currentRect.x(), currentRect.y(),
+                                         diffHeatmap.width() * sx, diffHeatmap.height() * sy),
+                                  diffHeatmap);
+                painter.setPen(QPen(QColor(255, 0, 0), 2));
+                painter.setBrush(Qt::NoBrush);
+                for (const QRect &region : diffRegions)
+                {
+                    painter.drawRect(QRectF(currentRect.x() + region.x() * sx, currentRect.y() + region.y() * sy,
+                                            region.width() * sx, region.height() * sy));
+                }
+                painter.setPen(Qt::white);
+                painter.drawText(currentRect.adjusted(5, 5, -5, -5), Qt::AlignLeft | Qt::AlignBottom, diffSummary);
+            }
 
             // 绘制选中框
             QPen pen(QColor(0, 150, 255), 2);
@@ -266,6 +549,10 @@ void ScreenshotWidget::paintEvent(QPaintEvent *event)
             }
         }
     }
+    else if (windowPicking)
+    {
+        sizeLabel->hide();
+    }
 
     // 绘制放大镜
     if (showMagnifier && !selected)
@@ -294,17 +581,7 @@ void ScreenshotWidget::paintEvent(QPaintEvent *event)
         // 确保源区域在窗口范围内
         logicalSourceRect = logicalSourceRect.intersected(QRect(0, 0, width(), height()));
 
-        // 转换为物理像素坐标（考虑虚拟桌面偏移）
-        QPoint windowPos = geometry().topLeft();
-        QPoint offset = windowPos - virtualGeometryTopLeft;
-        
-        QRect physicalSourceRect(
-            (logicalSourceRect.x() + offset.x()) * devicePixelRatio,
-            (logicalSourceRect.y() + offset.y()) * devicePixelRatio,
-            logicalSourceRect.width() * devicePixelRatio,
-            logicalSourceRect.height() * devicePixelRatio);
-
-        if (!physicalSourceRect.isEmpty())
+        if (!logicalSourceRect.isEmpty())
         {
             // 绘制放大镜背景
             painter.setPen(QPen(QColor(0, 150, 255), 2));
@@ -313,7 +590,7 @@ void ScreenshotWidget::paintEvent(QPaintEvent *event)
 
             // 绘制放大的图像
             QRect targetRect(magnifierX, magnifierY, magnifierSize, magnifierSize);
-            painter.drawPixmap(targetRect, screenPixmap, physicalSourceRect);
+            screenMapper.draw(painter, targetRect, logicalSourceRect.translated(virtualGeometryTopLeft));
 
             // 绘制十字准星
             painter.setPen(QPen(Qt::red, 1));
@@ -324,34 +601,15 @@ void ScreenshotWidget::paintEvent(QPaintEvent *event)
         }
     }
 
-    // 绘制已完成的箭头
-    for (const DrawnArrow &arrow : arrows)
-    {
-        drawArrow(painter, arrow.start, arrow.end, arrow.color, arrow.width);
-    }
-
-    // 绘制已完成的矩形
-    painter.setPen(QPen(Qt::red, 2));
-    painter.setBrush(Qt::NoBrush);
-    for (const DrawnRectangle &rect : rectangles)
-    {
-        painter.setPen(QPen(rect.color, rect.width));
-        painter.drawRect(rect.rect);
-    }
-
-    //绘制所有文本
-    for(const DrawnText &text : texts){
-        //绘制文字
-        drawText(painter,text.rect.topLeft() + QPoint(5,text.fontSize + 5),
-                 text.text,text.color,text.font);
-    }
+    // 按 z 序绘制已完成的标注（包括正在画的画笔），只画与需要重绘的区域相交的
+    annotations.paint(painter, event->rect());
 
     // 绘制当前正在绘制的形状
     if (isDrawing && selected)
     {
         if (currentDrawMode == Arrow)
         {
-            drawArrow(painter, drawStartPoint, drawEndPoint, QColor(255, 0, 0), 3);
+            AnnotationStore::drawArrow(painter, drawStartPoint, drawEndPoint, QColor(255, 0, 0), 3);
         }
         else if (currentDrawMode == Rectangle)
         {
@@ -364,23 +622,25 @@ void ScreenshotWidget::paintEvent(QPaintEvent *event)
 
 void ScreenshotWidget::mousePressEvent(QMouseEvent *event)
 {
+    // 先处理按下之前还没绘制的样本，它们属于上一个状态
+    applyInputSamples();
+
     if (event->button() == Qt::LeftButton)
     {
         //检查是否点击了已存在的文字
         if(selected && !isTextInputActive){
-            for(int i = texts.size() - 1; i >= 0; i--){
-                if(texts[i].rect.contains(event->pos())){
-                    //开始拖拽文字
-                    isTextMoving = true;
-                    movingText = &texts[i];
-                    dragStartOffset = event->pos() - texts[i].rect.topLeft();
-                    setCursor(Qt::ClosedHandCursor);
-
-                    currentDrawMode = None;
-                    isDrawing = false;
-                    update();
-                    return;
-                }
+            const int hit = annotations.topmostAt(event->pos(), AnnotationStore::Text);
+            if(hit >= 0){
+                //开始拖拽文字
+                isTextMoving = true;
+                movingText = hit;
+                dragStartOffset = event->pos() - annotations.bounds(hit).topLeft();
+                setCursor(Qt::ClosedHandCursor);
+
+                currentDrawMode = None;
+                isDrawing = false;
+                update();
+                return;
             }
         }
 
@@ -394,29 +654,32 @@ void ScreenshotWidget::mousePressEvent(QMouseEvent *event)
             if(currentDrawMode==Text){
                 //文本模式：显示输入框
                 textInputPosition = event->pos();
-                textInput->move(event->pos());
-                textInput->resize(200,30);
-                textInput->show();
-                textInput->setFocus();
-                isTextInputActive = true;
+                editingText = -1;
+                showTextInput(QString());
             }
             else{
                 //其他绘制模式
                 isDrawing = true;
                 drawStartPoint = event->pos();
                 drawEndPoint = event->pos();
+                if(currentDrawMode == Pen){
+                    annotations.beginStroke(event->pos(), QColor(255, 0, 0), 3);
+                }
             }
         }
         // 否则开始新的区域选择
         else if (!selected)
         {
-            startPoint = event->pos();
-            endPoint = event->pos();
+            startPoint = snapToEdges(event->pos(), event->modifiers());
+            endPoint = startPoint;
             currentMousePos = event->pos();
             selecting = true;
             selected = false;
             // showMagnifier已经在startCapture时设置为true，这里不需要重复设置
-            toolbar->hide();
+            if (toolbar)
+            {
+                toolbar->hide();
+            }
         }
         update();
     }
@@ -425,58 +688,99 @@ void ScreenshotWidget::mousePressEvent(QMouseEvent *event)
 
 void ScreenshotWidget::mouseMoveEvent(QMouseEvent *event)
 {
+    if(isTextInputActive){
+        currentMousePos = event->pos();
+        return;
+    }
+
+    // 选择、绘制、拖动文字和放大镜都要重绘：只缓存样本，在下一帧绘制前统一处理
+    if (selecting || isDrawing || !selected || (isTextMoving && movingText >= 0))
+    {
+        inputCoalescer->addSample(event);
+        return;
+    }
+
     currentMousePos = event->pos();
+    //检查鼠标是否悬停在文字上
+    if(annotations.topmostAt(event->pos(), AnnotationStore::Text) >= 0){
+        setCursor(Qt::PointingHandCursor);
+    }
+    else{
+        setCursor(Qt::CrossCursor);
+    }
+}
 
-    if(isTextInputActive){
+void ScreenshotWidget::applyInputSamples()
+{
+    if (!inputCoalescer->hasSamples())
+    {
         return;
     }
+    const QVector<InputCoalescer::Sample> samples = inputCoalescer->takeSamples();
+    const InputCoalescer::Sample &last = samples.last();
+    currentMousePos = last.pos;
+
+    // 窗口选择模式：只在缓存的窗口布局中查找，不访问 X 服务器
+    if (windowPicking && !selected)
+    {
+        hoveredWindow = windowLayout.windowAt(last.pos);
+    }
 
     if (selecting)
     {
-        endPoint = event->pos();
+        endPoint = snapToEdges(last.pos, last.modifiers);
         showMagnifier = true;
-        update();
     }
     else if (isDrawing)
     {
-        drawEndPoint = event->pos();
-        update();
-    }
-    else if (!selected)
-    {
-        // 在框选前的鼠标移动时也触发更新，以显示放大镜
-        update();
+        drawEndPoint = last.pos;
+        // 画笔需要每一个样本，否则快速移动时笔画会变成折线
+        if (currentDrawMode == Pen)
+        {
+            for (const InputCoalescer::Sample &sample : samples)
+            {
+                annotations.extendStroke(sample.pos);
+            }
+        }
     }
-    else if(isTextMoving && movingText){
-        //拖拽移动文字：实时更新位置
-        QPoint newPos = event->pos() - dragStartOffset;
+    else if(isTextMoving && movingText >= 0){
+        //拖拽移动文字：更新到最后一个样本的位置
+        const QRect bounds = annotations.bounds(movingText);
+        QPoint newPos = last.pos - dragStartOffset;
 
         //确保文字不会移出屏幕边界
-        newPos.setX(qMax(0,qMin(newPos.x(),width() - movingText->rect.width())));
-        newPos.setY(qMax(0,qMin(newPos.y(),height() - movingText->rect.height())));
+        newPos.setX(qMax(0,qMin(newPos.x(),width() - bounds.width())));
+        newPos.setY(qMax(0,qMin(newPos.y(),height() - bounds.height())));
 
-        movingText->rect.moveTopLeft(newPos);
-        movingText->position = newPos;
-        update();
+        annotations.translate(movingText, newPos - bounds.topLeft());
     }
-    else {
-        //检查鼠标是否悬停在文字上
-        bool overText = false;
-        for(const DrawnText &text : texts){
-            if(text.rect.contains(event->pos())){
-                setCursor(Qt::PointingHandCursor);
-                overText = true;
-                break;
-            }
-        }
-        if(!overText){
-            setCursor(Qt::CrossCursor);
-        }
+}
+
+void ScreenshotWidget::mouseDoubleClickEvent(QMouseEvent *event)
+{
+    //双击已有的文字重新编辑
+    if (event->button() != Qt::LeftButton || !selected || isTextInputActive)
+    {
+        return;
+    }
+    const int hit = annotations.topmostAt(event->pos(), AnnotationStore::Text);
+    if (hit < 0)
+    {
+        return;
     }
+    isTextMoving = false;
+    movingText = -1;
+    isDrawing = false;
+    editingText = hit;
+    textInputPosition = annotations.bounds(hit).topLeft() + QPoint(2, 2);
+    showTextInput(annotations.text(hit));
 }
 
 void ScreenshotWidget::mouseReleaseEvent(QMouseEvent *event)
 {
+    // 松开前的样本先全部用上，画笔的最后一段和选区的终点才完整
+    applyInputSamples();
+
     if (event->button() == Qt::LeftButton)
     {
         if (selecting)
@@ -486,9 +790,17 @@ void ScreenshotWidget::mouseReleaseEvent(QMouseEvent *event)
             showMagnifier = false;
             selectedRect = QRect(startPoint, endPoint).normalized();
 
+            // 窗口选择模式下单击（几乎没有拖动）选中鼠标下的窗口
+            if (windowPicking && (endPoint - startPoint).manhattanLength() < 4 && hoveredWindow >= 0)
+            {
+                selectedRect = windowLayout.windowRect(hoveredWindow);
+            }
+            windowPicking = false;
+
             // 显示工具栏
             if (!selectedRect.isEmpty())
             {
+                ensureToolbar();
                 updateToolbarPosition();
                 toolbar->show();
             }
@@ -503,27 +815,18 @@ void ScreenshotWidget::mouseReleaseEvent(QMouseEvent *event)
             // 保存绘制的形状
             if (currentDrawMode == Arrow)
             {
-                DrawnArrow arrow;
-                arrow.start = drawStartPoint;
-                arrow.end = drawEndPoint;
-                arrow.color = QColor(255, 0, 0);
-                arrow.width = 3;
-                arrows.append(arrow);
+                annotations.addArrow(drawStartPoint, drawEndPoint, QColor(255, 0, 0), 3);
             }
             else if (currentDrawMode == Rectangle)
             {
-                DrawnRectangle rect;
-                rect.rect = QRect(drawStartPoint, drawEndPoint).normalized();
-                rect.color = QColor(255, 0, 0);
-                rect.width = 3;
-                rectangles.append(rect);
+                annotations.addRectangle(QRect(drawStartPoint, drawEndPoint).normalized(), QColor(255, 0, 0), 3);
             }
             update();
         }
-        else if(isTextMoving && movingText){
+        else if(isTextMoving && movingText >= 0){
             //松开鼠标左键，停止拖拽移动
             isTextMoving = false;
-            movingText = nullptr;
+            movingText = -1;
             setCursor(Qt::CrossCursor);
             update();
         }
@@ -555,6 +858,7 @@ void ScreenshotWidget::keyPressEvent(QKeyEvent *event)
             qDebug() << "Window size:" << size();
 
             // 确保工具栏大小正确
+            ensureToolbar();
             toolbar->adjustSize();
             qDebug() << "Toolbar size after adjust:" << toolbar->size();
             qDebug() << "Toolbar sizeHint:" << toolbar->sizeHint();
@@ -574,24 +878,19 @@ void ScreenshotWidget::keyPressEvent(QKeyEvent *event)
 
     //可以删除选中的文字
     if((event->key() == Qt::Key_Delete || event->key() == Qt::Key_Backspace) && selected){
-        if(movingText){
-            for(int i=0; i<texts.size(); i++){
-                if(&texts[i] == movingText){
-                    texts.remove(i);
-                    isTextMoving = false;
-                    movingText = nullptr;
-                    setCursor(Qt::CrossCursor);
-                    update();
-                    break;
-                }
-            }
+        if(movingText >= 0){
+            annotations.remove(movingText);
+            isTextMoving = false;
+            movingText = -1;
+            setCursor(Qt::CrossCursor);
+            update();
         }
     }
 }
 
 void ScreenshotWidget::updateToolbarPosition()
 {
-    if (!selected || selectedRect.isEmpty())
+    if (!toolbar || !selected || selectedRect.isEmpty())
     {
         return;
     }
@@ -599,32 +898,40 @@ void ScreenshotWidget::updateToolbarPosition()
     int toolbarWidth = toolbar->sizeHint().width();
     int toolbarHeight = toolbar->sizeHint().height();
 
+    // 遮罩覆盖整个虚拟桌面，工具栏限制在选区所在的屏幕内，避免落到屏幕之间的空隙
+    const QRect globalSelection = selectedRect.translated(virtualGeometryTopLeft);
+    const int screenIndex = screenMapper.screenFor(globalSelection);
+    const QRect bounds = screenIndex >= 0
+                             ? screenMapper.screens().at(screenIndex).logical.translated(-virtualGeometryTopLeft)
+                             : rect();
+    const QRect visibleSelection = selectedRect.intersected(bounds);
+
     int x, y;
 
     // 如果是全屏截图或接近全屏，将工具栏放在屏幕底部中央偏上
-    if (selectedRect.width() >= width() - 10 && selectedRect.height() >= height() - 10)
+    if (visibleSelection.width() >= bounds.width() - 10 && visibleSelection.height() >= bounds.height() - 10)
     {
-        x = (width() - toolbarWidth) / 2;
-        y = height() - toolbarHeight - 60; // 增加底部边距，确保可见
+        x = bounds.x() + (bounds.width() - toolbarWidth) / 2;
+        y = bounds.bottom() - toolbarHeight - 60; // 增加底部边距，确保可见
     }
     else
     {
         // 尝试将工具栏放在选中区域下方
-        x = selectedRect.x() + (selectedRect.width() - toolbarWidth) / 2;
-        y = selectedRect.bottom() + 10;
+        x = visibleSelection.x() + (visibleSelection.width() - toolbarWidth) / 2;
+        y = visibleSelection.bottom() + 10;
 
         // 如果超出屏幕底部，则放在选中区域上方
-        if (y + toolbarHeight > height())
+        if (y + toolbarHeight > bounds.bottom())
         {
-            y = selectedRect.top() - toolbarHeight - 10;
+            y = visibleSelection.top() - toolbarHeight - 10;
         }
 
         // 确保不超出屏幕左右边界
-        if (x < 10)
-            x = 10;
-        if (x + toolbarWidth > width() - 10)
+        if (x < bounds.left() + 10)
+            x = bounds.left() + 10;
+        if (x + toolbarWidth > bounds.right() - 10)
         {
-            x = width() - toolbarWidth - 10;
+            x = bounds.right() - toolbarWidth - 10;
         }
     }
 
@@ -638,87 +945,186 @@ void ScreenshotWidget::saveScreenshot()
         return;
     }
 
-    // 从原始截图中裁剪选中区域
-    // screenPixmap中存储的是物理像素，需要将逻辑坐标转换为物理坐标
-    QRect physicalRect(
-        selectedRect.x() * devicePixelRatio,
-        selectedRect.y() * devicePixelRatio,
-        selectedRect.width() * devicePixelRatio,
-        selectedRect.height() * devicePixelRatio);
+    QImage result = exportSelection();
+    reportCaptureMemory();
 
-    // 从原始像素数据中裁剪，不使用DPR
-    QImage tempImage = screenPixmap.toImage();
-    QImage croppedImage = tempImage.copy(physicalRect);
-    QPixmap croppedPixmap = QPixmap::fromImage(croppedImage);
+    // 获取默认保存路径
+    QString defaultPath = QStandardPaths::writableLocation(QStandardPaths::PicturesLocation);
+    QString defaultFileName = defaultPath + "/screenshot_" +
+                              QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss") + ".png";
 
-    // 在裁剪后的图片上绘制箭头和矩形
-    QPainter painter(&croppedPixmap);
-    painter.setRenderHint(QPainter::Antialiasing);
+    // 打开保存对话框
+    QString fileName = QFileDialog::getSaveFileName(this,
+                                                    "保存截图",
+                                                    defaultFileName,
+                                                    ImageExporter::imageFilters());
 
-    // 绘制所有箭头（需要调整坐标到裁剪区域）
-    for (const DrawnArrow &arrow : arrows)
+    if (!fileName.isEmpty())
     {
-        QPoint adjustedStart = QPoint(
-            (arrow.start.x() - selectedRect.x()) * devicePixelRatio,
-            (arrow.start.y() - selectedRect.y()) * devicePixelRatio
-        );
-        QPoint adjustedEnd = QPoint(
-            (arrow.end.x() - selectedRect.x()) * devicePixelRatio,
-            (arrow.end.y() - selectedRect.y()) * devicePixelRatio
-        );
-        drawArrow(painter, adjustedStart, adjustedEnd, arrow.color, arrow.width * devicePixelRatio);
+        exportImageAsync(result, fileName);
     }
+    // 如果用户取消保存，不做任何操作，保持当前状态（工具栏仍然可见）
+}
 
-    // 绘制所有矩形
-    for (const DrawnRectangle &rect : rectangles)
+void ScreenshotWidget::compareWithFile()
+{
+    if (!selected || selectedRect.isEmpty())
+    {
+        return;
+    }
+    if (!diffHeatmap.isNull())
     {
-        QRect adjustedRect(
-            (rect.rect.x() - selectedRect.x()) * devicePixelRatio,
-            (rect.rect.y() - selectedRect.y()) * devicePixelRatio,
-            rect.rect.width() * devicePixelRatio,
-            rect.rect.height() * devicePixelRatio
-        );
-        painter.setPen(QPen(rect.color, rect.width * devicePixelRatio));
-        painter.setBrush(Qt::NoBrush);
-        painter.drawRect(adjustedRect);
+        diffHeatmap = QImage();
+        diffRegions.clear();
+        btnDiff->setText("对比");
+        update();
+        return;
     }
 
-    //绘制文本
-    for(const DrawnText &text : texts){
-        QPoint adjustedPosition(
-             (text.position.x() - selectedRect.x()) * devicePixelRatio,
-             (text.position.y() - selectedRect.y()) * devicePixelRatio
-        );
+    const QString fileName = QFileDialog::getOpenFileName(this,
+                                                          "选择要对比的截图",
+                                                          QStandardPaths::writableLocation(QStandardPaths::PicturesLocation),
+                                                          "图片 (*.png *.jpg *.jpeg *.bmp *.gif);;所有文件 (*.*)");
+    if (fileName.isEmpty())
+    {
+        return;
+    }
+    const QImage reference(fileName);
+    if (reference.isNull())
+    {
+        qWarning() << "Cannot load image for comparison:" << fileName;
+        return;
+    }
+
+    const QImage current = renderSelection();
+    QElapsedTimer timer;
+    timer.start();
+    const ImageDiff::Result result = ImageDiff::compare(reference, current, QSettings().value("diff/threshold", 0).toInt());
+    const qint64 elapsed = timer.elapsed();
 
-        //绘制文字
-        drawText(painter, adjustedPosition + QPoint(5,text.fontSize + 5),
-                 text.text, text.color, text.font);
+    diffHeatmap = result.heatmap;
+    diffRegions = result.regions;
+    diffImageSize = current.size();
+    if (result.identical())
+    {
+        diffSummary = QString("完全相同（%1 ms）").arg(elapsed);
+    }
+    else
+    {
+        diffSummary = QString("%1 处变化，%2 个像素不同%3（%4 ms）")
+                          .arg(result.regions.size())
+                          .arg(result.changedPixels)
+                          .arg(result.sizeMismatch ? QString("，尺寸不同：%1 x %2").arg(reference.width()).arg(reference.height())
+                                                   : QString())
+                          .arg(elapsed);
     }
 
+    btnDiff->setText("清除对比");
+    update();
+}
 
-    painter.end();
+void ScreenshotWidget::recognizeText()
+{
+    if (!selected || selectedRect.isEmpty() || (ocrEngine && ocrEngine->isRunning()))
+    {
+        return;
+    }
+    if (OcrEngine::executable().isEmpty())
+    {
+        QToolTip::showText(btnOcr->mapToGlobal(QPoint(0, btnOcr->height())),
+                           "未找到 tesseract，请先安装，或在设置 ocr/tesseract 中指定路径", btnOcr);
+        return;
+    }
 
-    // 获取默认保存路径
-    QString defaultPath = QStandardPaths::writableLocation(QStandardPaths::PicturesLocation);
-    QString defaultFileName = defaultPath + "/screenshot_" +
-                              QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss") + ".png";
+    if (!ocrEngine)
+    {
+        ocrEngine = new OcrEngine(this);
+        connect(ocrEngine, &OcrEngine::progress, this, [this](int done, int total)
+                { btnOcr->setText(QString("识别中 %1/%2").arg(done).arg(total)); });
+        // 每完成一段就更新剪贴板，长文本不必等全部识别完
+        connect(ocrEngine, &OcrEngine::textAvailable, this, [](const QString &text)
+                { QGuiApplication::clipboard()->setText(text); });
+        connect(ocrEngine, &OcrEngine::finished, this, [this](const QString &text, qint64 elapsedMs)
+                {
+            if (captureProfileRequested())
+            {
+                qInfo() << "OCR:" << text.size() << "characters in" << elapsedMs << "ms";
+            }
+            btnOcr->setText("复制文字");
+            toolbar->setEnabled(true);
+            if (text.isEmpty())
+            {
+                QToolTip::showText(btnOcr->mapToGlobal(QPoint(0, btnOcr->height())), "未识别到文字", btnOcr);
+                return;
+            }
+            emit screenshotTaken();
+            finishCapture(); });
+    }
 
-    // 打开保存对话框
-    QString fileName = QFileDialog::getSaveFileName(this,
-                                                    "保存截图",
-                                                    defaultFileName,
-                                                    "PNG图片 (*.png);;JPEG图片 (*.jpg);;所有文件 (*.*)");
+    // 识别不带标注的原始像素，标注的文字和线条只会干扰识别
+    const QRect logicalRect = selectedRect.translated(virtualGeometryTopLeft);
+    const qreal scale = screenMapper.maxScale(logicalRect);
+    toolbar->setEnabled(false);
+    btnOcr->setText("识别中");
+    ocrEngine->recognize(screenMapper.render(logicalRect, scale), scale);
+}
 
-    if (!fileName.isEmpty())
+void ScreenshotWidget::pinSelection()
+{
+    if (!selected || selectedRect.isEmpty())
+    {
+        return;
+    }
+
+    // 钉图直接持有合成出的图像，不再复制；窗口放在选区原来的位置
+    const QRect logicalRect = selectedRect.translated(virtualGeometryTopLeft);
+    PinWidget *pin = new PinWidget(QSharedPointer<MipmapPyramid>::create(exportSelection(), screenMapper.maxScale(logicalRect)));
+    pin->move(logicalRect.topLeft());
+    pin->show();
+    reportCaptureMemory();
+
+    emit screenshotTaken();
+    finishCapture();
+}
+
+void ScreenshotWidget::exportImageAsync(const QImage &image, const QString &fileName)
+{
+    QSettings settings;
+    // 缩略图、预览图等缩小版本与原图一起从合成好的像素生成，不需要再解码保存的文件
+    const QVector<ImageExporter::Variant> variants = ImageExporter::configuredVariants();
+    QStringList duplicates;
+    if (captureHistory && settings.value("history/linkDuplicates", true).toBool())
     {
-        if (croppedPixmap.save(fileName))
+        // 哈希只算这一次，随后 screenshotSaved 触发的 CaptureHistory::add() 直接使用
+        const quint64 hash = captureHistory->imageHash(image);
+        duplicates = captureHistory->findSimilar(hash, settings.value("history/duplicateDistance", 2).toInt());
+    }
+
+    // 解码比较重复的候选、编码原图和缩小版本都在线程池中进行，期间工具栏不可用；
+    // 保存成功后才释放截图窗口，失败时保持当前状态
+    toolbar->setEnabled(false);
+    QFutureWatcher<QString> *watcher = new QFutureWatcher<QString>(this);
+    connect(watcher, &QFutureWatcher<QString>::finished, this, [this, watcher, image, fileName]()
+            {
+        const QString error = watcher->result();
+        watcher->deleteLater();
+        toolbar->setEnabled(true);
+        if (!error.isEmpty())
         {
-            emit screenshotTaken();
-            hide();               // 立即隐藏窗口
-            QApplication::quit(); // 直接退出应用程序
+            QMessageBox::warning(this, "保存截图", "保存失败：" + error);
+            return;
         }
-    }
-    // 如果用户取消保存，不做任何操作，保持当前状态（工具栏仍然可见）
+        emit screenshotSaved(fileName, image);
+        emit screenshotTaken();
+        finishCapture(); });
+    watcher->setFuture(QtConcurrent::run([image, fileName, variants, duplicates]()
+                                         {
+        QString error;
+        if (!ImageExporter::exportImage(image, fileName, variants, duplicates, &error) && error.isEmpty())
+        {
+            error = "写入文件失败";
+        }
+        return error; }));
 }
 
 void ScreenshotWidget::copyToClipboard()
@@ -728,164 +1134,444 @@ void ScreenshotWidget::copyToClipboard()
         return;
     }
 
-    // 从原始截图中裁剪选中区域
-    // screenPixmap中存储的是物理像素，需要将逻辑坐标转换为物理坐标
-    QRect physicalRect(
-        selectedRect.x() * devicePixelRatio,
-        selectedRect.y() * devicePixelRatio,
-        selectedRect.width() * devicePixelRatio,
-        selectedRect.height() * devicePixelRatio);
+    QImage result = exportSelection();
+    reportCaptureMemory();
 
-    // 从原始像素数据中裁剪，不使用DPR
-    QImage tempImage = screenPixmap.toImage();
-    QImage croppedImage = tempImage.copy(physicalRect);
-    QPixmap croppedPixmap = QPixmap::fromImage(croppedImage);
+    // 复制到剪贴板
+    QClipboard *clipboard = QGuiApplication::clipboard();
+    clipboard->setImage(result);
+
+    emit screenshotTaken();
+    finishCapture();
+}
 
-    // 在裁剪后的图片上绘制箭头和矩形
-    QPainter painter(&croppedPixmap);
+QImage ScreenshotWidget::exportSelection()
+{
+    const QImage image = renderSelection();
+    // 工具栏还没创建时按上次保存的开关状态
+    const bool trim = toolbar ? btnTrim->isChecked() : QSettings().value("export/autoTrim", false).toBool();
+    if (!trim)
+    {
+        return image;
+    }
+
+    // 在编码之前裁掉，编码时间和文件大小都随之减少
+    return AutoTrim::trim(image, QSettings().value("export/trimTolerance", 8).toInt());
+}
+
+QImage ScreenshotWidget::renderSelection()
+{
+    // 输出比例取选区覆盖的屏幕中最大的缩放比例，低缩放比例屏幕上的部分放大到同一比例，
+    // 跨越不同缩放比例的屏幕时各部分的清晰度一致
+    const QRect logicalRect = selectedRect.translated(virtualGeometryTopLeft);
+    const qreal scale = screenMapper.maxScale(logicalRect);
+    QImage image = screenMapper.render(logicalRect, scale);
+
+    // 在裁剪后的图片上绘制标注，与屏幕上使用同一份绘制代码，由变换把窗口逻辑坐标换算到输出图像，
+    // 线宽和字号随之按输出比例放大
+    QPainter painter(&image);
     painter.setRenderHint(QPainter::Antialiasing);
+    painter.scale(scale, scale);
+    painter.translate(-selectedRect.topLeft());
+    annotations.paint(painter, selectedRect);
+    painter.end();
+    return image;
+}
 
-    // 绘制所有箭头（需要调整坐标到裁剪区域）
-    for (const DrawnArrow &arrow : arrows)
+void ScreenshotWidget::reportCaptureMemory() const
+{
+    if (!captureProfileRequested())
     {
-        QPoint adjustedStart = QPoint(
-            (arrow.start.x() - selectedRect.x()) * devicePixelRatio,
-            (arrow.start.y() - selectedRect.y()) * devicePixelRatio
-        );
-        QPoint adjustedEnd = QPoint(
-            (arrow.end.x() - selectedRect.x()) * devicePixelRatio,
-            (arrow.end.y() - selectedRect.y()) * devicePixelRatio
-        );
-        drawArrow(painter, adjustedStart, adjustedEnd, arrow.color, arrow.width * devicePixelRatio);
+        return;
     }
+    const qint64 peak = MemoryUsage::peakRss();
+    qInfo() << "Capture memory: tiles" << screenMapper.allocatedBytes() / 1024 << "KiB,"
+             << "peak RSS" << (peak >= 0 ? QString::number(peak / 1024) + " KiB" : QString("unavailable"));
+}
 
-    // 绘制所有矩形
-    for (const DrawnRectangle &rect : rectangles)
+QRect ScreenshotWidget::nativeSelectedRect() const
+{
+    return screenMapper.toNative(selectedRect.translated(virtualGeometryTopLeft));
+}
+
+bool ScreenshotWidget::clipSelectionToScreen()
+{
+    // 滚动截图和录屏逐帧截取单个屏幕，把选区限制在它占据面积最大的屏幕内
+    const int index = screenMapper.screenFor(selectedRect.translated(virtualGeometryTopLeft));
+    if (index < 0)
     {
-        QRect adjustedRect(
-            (rect.rect.x() - selectedRect.x()) * devicePixelRatio,
-            (rect.rect.y() - selectedRect.y()) * devicePixelRatio,
-            rect.rect.width() * devicePixelRatio,
-            rect.rect.height() * devicePixelRatio
-        );
-        painter.setPen(QPen(rect.color, rect.width * devicePixelRatio));
-        painter.setBrush(Qt::NoBrush);
-        painter.drawRect(adjustedRect);
+        return false;
     }
+    const ScreenMapper::Screen &screen = screenMapper.screens().at(index);
+    if (!screen.screen)
+    {
+        // 重新打开的截图所在的屏幕已经不存在
+        return false;
+    }
+    captureScreen = screen.screen;
+    selectedRect = selectedRect.intersected(screen.logical.translated(-virtualGeometryTopLeft));
+    return !selectedRect.isEmpty();
+}
 
-    //绘制文本
-    for(const DrawnText &text : texts){
-        QPoint adjustedPosition(
-             (text.position.x() - selectedRect.x()) * devicePixelRatio,
-             (text.position.y() - selectedRect.y()) * devicePixelRatio
-        );
+QRect ScreenshotWidget::screenSelectedRect() const
+{
+    return selectedRect.translated(virtualGeometryTopLeft - captureScreen->geometry().topLeft());
+}
+
+void ScreenshotWidget::showCapturePanel(const QString &status, const QString &doneText, void (ScreenshotWidget::*onDone)())
+{
+    // 隐藏遮罩，让用户可以直接操作下面的窗口
+    if (toolbar)
+    {
+        toolbar->hide();
+    }
+    sizeLabel->hide();
+    hide();
 
+    // 控制面板放在选区下方（放不下则放上方），不能和选区重叠，否则会被截进去
+    capturePanel = new QWidget(nullptr, Qt::FramelessWindowHint | Qt::WindowStaysOnTopHint | Qt::Tool);
+    capturePanel->setObjectName("capturePanel");
+    QHBoxLayout *layout = new QHBoxLayout(capturePanel);
+    layout->setContentsMargins(10, 5, 10, 5);
+    panelStatusLabel = new QLabel(status, capturePanel);
+    QPushButton *btnDone = new QPushButton(doneText, capturePanel);
+    QPushButton *btnAbort = new QPushButton("取消", capturePanel);
+    layout->addWidget(panelStatusLabel);
+    layout->addWidget(btnDone);
+    layout->addWidget(btnAbort);
+    connect(btnDone, &QPushButton::clicked, this, onDone);
+    connect(btnAbort, &QPushButton::clicked, this, &ScreenshotWidget::cancelCapture);
+
+    capturePanel->adjustSize();
+    QRect screenGeometry = captureScreen->geometry();
+    QPoint panelPos = mapToGlobal(QPoint(selectedRect.left(), selectedRect.bottom() + 10));
+    if (panelPos.y() + capturePanel->height() > screenGeometry.bottom())
+    {
+        panelPos = mapToGlobal(QPoint(selectedRect.left(), selectedRect.top() - capturePanel->height() - 10));
+    }
+    panelPos.setY(qMax(screenGeometry.top(), panelPos.y()));
+    capturePanel->move(panelPos);
+    capturePanel->show();
+}
 
-        //绘制文字
-        drawText(painter, adjustedPosition + QPoint(5,text.fontSize + 5),
-                 text.text, text.color, text.font);
+void ScreenshotWidget::startScrollCapture()
+{
+    if (!selected || selectedRect.isEmpty() || !clipSelectionToScreen())
+    {
+        return;
     }
-    painter.end();
+    stillCapture = false;
 
-    // 复制到剪贴板
-    QClipboard *clipboard = QGuiApplication::clipboard();
-    clipboard->setPixmap(croppedPixmap);
+    showCapturePanel("请滚动窗口内容...", "完成", &ScreenshotWidget::finishScrollCapture);
+
+    // 第一帧直接使用已有的截图，之后定时截取
+    const QRect logicalRect = selectedRect.translated(virtualGeometryTopLeft);
+    scrollStitcher.append(screenMapper.render(logicalRect, captureScreen->devicePixelRatio()));
 
+    scrollTimer = new QTimer(this);
+    connect(scrollTimer, &QTimer::timeout, this, &ScreenshotWidget::onScrollCaptureTick);
+    scrollTimer->start(100);
+}
+
+void ScreenshotWidget::onScrollCaptureTick()
+{
+    const QRect screenRect = screenSelectedRect();
+    QPixmap frame = captureScreen->grabWindow(0, screenRect.x(), screenRect.y(),
+                                              screenRect.width(), screenRect.height());
+    // 各平台返回的格式不同、尺寸可能有 1 像素的舍入差异，一次统一到第一帧的格式和大小
+    const QImage image = PixelFormat::toRgb32(frame.toImage(), nativeSelectedRect().size());
+
+    int added = scrollStitcher.append(image);
+    if (scrollStitcher.hasError())
+    {
+        panelStatusLabel->setText("临时文件写入失败，无法继续拼接");
+    }
+    else if (added < 0)
+    {
+        panelStatusLabel->setText(QString("滚动过快，请放慢 (已拼接 %1 像素)").arg(scrollStitcher.totalHeight()));
+    }
+    else
+    {
+        panelStatusLabel->setText(QString("已拼接 %1 像素").arg(scrollStitcher.totalHeight()));
+    }
+    capturePanel->adjustSize();
+}
+
+void ScreenshotWidget::finishScrollCapture()
+{
+    scrollTimer->stop();
+    capturePanel->hide();
+
+    // 长图逐条带直接写成 PNG，不在内存中拼出整张图，所以只能保存为 PNG
+    QString defaultPath = QStandardPaths::writableLocation(QStandardPaths::PicturesLocation);
+    QString defaultFileName = defaultPath + "/scroll_" +
+                              QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss") + ".png";
+    QString fileName = QFileDialog::getSaveFileName(nullptr,
+                                                    "保存长截图",
+                                                    defaultFileName,
+                                                    "PNG图片 (*.png)");
+    if (fileName.isEmpty())
+    {
+        scrollStitcher.reset();
+        cancelCapture();
+        return;
+    }
+    if (!fileName.endsWith(".png", Qt::CaseInsensitive))
+    {
+        fileName += ".png";
+    }
+
+    QString error;
+    if (!scrollStitcher.finish(fileName, &error))
+    {
+        QMessageBox::warning(nullptr, "长截图", "保存失败：" + error);
+        cancelCapture();
+        return;
+    }
+
+    // 没有整张图像，历史记录从文件读取缩略图
+    emit screenshotSaved(fileName, QImage());
     emit screenshotTaken();
-    hide();               // 立即隐藏窗口
-    QApplication::quit(); // 直接退出应用程序
+    finishCapture();
 }
 
-void ScreenshotWidget::cancelCapture()
+void ScreenshotWidget::startRecording()
 {
-    emit screenshotCancelled();
-    hide();               // 立即隐藏窗口
-    QApplication::quit(); // 直接退出应用程序
+    if (!selected || selectedRect.isEmpty() || !clipSelectionToScreen())
+    {
+        return;
+    }
+    stillCapture = false;
+
+    showCapturePanel("录制中 00:00", "停止", &ScreenshotWidget::stopRecording);
+
+    // 先录到临时文件，停止后再让用户选择保存位置
+    recordingFile = QDir::temp().filePath(QString("screensniper_%1.ssrv")
+                                              .arg(QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss")));
+    recorder = new RegionRecorder(captureScreen, screenSelectedRect(), nativeSelectedRect(), this);
+    connect(recorder, &RegionRecorder::progress, this, [this](int frames, qint64 durationMs)
+            {
+        panelStatusLabel->setText(QString("录制中 %1:%2  %3 帧")
+                                      .arg(durationMs / 60000, 2, 10, QChar('0'))
+                                      .arg(durationMs / 1000 % 60, 2, 10, QChar('0'))
+                                      .arg(frames));
+        capturePanel->adjustSize(); });
+
+    // 等遮罩完全隐藏后再开始录制
+    QTimer::singleShot(100, this, [this]()
+                       {
+        if (!recorder->start(recordingFile))
+        {
+            // 没有开始录制：不留下"停止"按钮，提示原因后结束截图
+            const QString reason = recorder->errorString();
+            recorder->deleteLater();
+            recorder = nullptr;
+            QFile::remove(recordingFile);
+            capturePanel->hide();
+            QMessageBox::warning(nullptr, "录屏", "无法开始录制：" + reason);
+            cancelCapture();
+        } });
 }
 
-void ScreenshotWidget::drawArrow(QPainter &painter, const QPoint &start, const QPoint &end, const QColor &color, int width)
+void ScreenshotWidget::stopRecording()
 {
-    painter.setPen(QPen(color, width));
-    painter.setBrush(color);
+    recorder->stop();
+    capturePanel->hide();
+
+    QString defaultPath = QStandardPaths::writableLocation(QStandardPaths::MoviesLocation);
+    QString defaultFileName = defaultPath + "/recording_" +
+                              QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss") + ".ssrv";
+    const QString gifFilter = "GIF 动画 (*.gif)";
+    const QString ditheredGifFilter = "GIF 动画（有序抖动） (*.gif)";
+    QString selectedFilter;
+    QString fileName = QFileDialog::getSaveFileName(nullptr,
+                                                    "保存录屏",
+                                                    defaultFileName,
+                                                    "ScreenSniper 录屏 (*.ssrv);;" + gifFilter + ";;" + ditheredGifFilter,
+                                                    &selectedFilter);
+
+    if (selectedFilter == gifFilter || selectedFilter == ditheredGifFilter)
+    {
+        // 默认文件名带的是 .ssrv 后缀，选了 GIF 时替换掉
+        if (fileName.endsWith(".ssrv", Qt::CaseInsensitive))
+        {
+            fileName.chop(5);
+        }
+        if (!fileName.isEmpty() && !fileName.endsWith(".gif", Qt::CaseInsensitive))
+        {
+            fileName += ".gif";
+        }
+        if (fileName.isEmpty())
+        {
+            QFile::remove(recordingFile);
+            cancelCapture();
+            return;
+        }
+        exportRecordingAsync(fileName, selectedFilter == ditheredGifFilter);
+        return;
+    }
 
-    // 绘制箭头线条
-    painter.drawLine(start, end);
+    bool saved = false;
+    if (!fileName.isEmpty())
+    {
+        QFile::remove(fileName);
+        // 临时目录可能在其他分区，rename 失败时退回到复制
+        saved = QFile::rename(recordingFile, fileName) ||
+                (QFile::copy(recordingFile, fileName) && QFile::remove(recordingFile));
+    }
+    if (!saved)
+    {
+        QFile::remove(recordingFile);
+        cancelCapture();
+        return;
+    }
 
-    // 计算箭头头部
-    double angle = std::atan2(end.y() - start.y(), end.x() - start.x());
-    double arrowSize = 15.0; // 箭头大小
-    double arrowAngle = M_PI / 6; // 箭头角度 (30度)
+    emit screenshotSaved(fileName, QImage());
+    emit screenshotTaken();
+    finishCapture();
+}
 
-    QPointF arrowP1 = end - QPointF(
-        arrowSize * std::cos(angle - arrowAngle),
-        arrowSize * std::sin(angle - arrowAngle)
-    );
+void ScreenshotWidget::exportRecordingAsync(const QString &fileName, bool dithering)
+{
+    // GIF 编码可能要几秒到几十秒，放到线程池中，期间面板只显示进度。
+    // 用户不能再点面板上的按钮；截图窗口在导出完成后才释放，临时文件由导出任务自己删除
+    panelStatusLabel->setText("正在导出 GIF…");
+    for (QPushButton *button : capturePanel->findChildren<QPushButton *>())
+    {
+        button->setEnabled(false);
+    }
+    capturePanel->adjustSize();
+    capturePanel->show();
 
-    QPointF arrowP2 = end - QPointF(
-        arrowSize * std::cos(angle + arrowAngle),
-        arrowSize * std::sin(angle + arrowAngle)
-    );
+    const QString source = recordingFile;
+    QFutureWatcher<QString> *watcher = new QFutureWatcher<QString>(this);
+    connect(watcher, &QFutureWatcher<QString>::finished, this, [this, watcher, fileName]()
+            {
+        const QString error = watcher->result();
+        watcher->deleteLater();
+        capturePanel->hide();
+        if (!error.isEmpty())
+        {
+            QMessageBox::warning(nullptr, "录屏", "导出 GIF 失败：" + error);
+            cancelCapture();
+            return;
+        }
+        emit screenshotSaved(fileName, QImage());
+        emit screenshotTaken();
+        finishCapture(); });
+    watcher->setFuture(QtConcurrent::run([source, fileName, dithering]()
+                                         {
+        QString error;
+        if (!ImageExporter::exportRecordingToGif(source, fileName, dithering, &error) && error.isEmpty())
+        {
+            error = "写入 GIF 失败";
+        }
+        QFile::remove(source);
+        return error; }));
+}
 
-    // 绘制箭头头部（实心三角形）
-    QPolygonF arrowHead;
-    arrowHead << end << arrowP1 << arrowP2;
-    painter.drawPolygon(arrowHead);
+void ScreenshotWidget::cancelCapture()
+{
+    emit screenshotCancelled();
+    finishCapture();
+}
+
+void ScreenshotWidget::finishCapture()
+{
+    // 程序常驻托盘，截图窗口用完即释放，截图本身由最近截图环保存
+    if (capturePanel)
+    {
+        capturePanel->hide();
+    }
+    hide();
+    deleteLater();
 }
 
 void ScreenshotWidget::setupTextInput(){
-    //添加文本输入框设置
-    textInput = new QLineEdit(this);
-    textInput->setStyleSheet(
-                "QLineEdit{ background-color:rgba(255,255,255,240);color: black; "
-                "border: 2px solid #0096FF; border-radius: 3px;padding: 5px;font-size: 14px; }"
-                "QLineEdit:focus{border-color:#FF5500;}");
-    textInput->setPlaceholderText("输入文字...");
+    //添加文本输入框设置：多行输入，按输入框宽度换行，与标注使用同一种字体
+    textInput = new QPlainTextEdit(this);
+    textInput->setObjectName("annotationTextInput");
+    textInput->setFont(QFont("Arial",14));
+    textInput->setPlaceholderText("输入文字，Ctrl+Enter 完成，Esc 取消");
+    textInput->setLineWrapMode(QPlainTextEdit::WidgetWidth);
+    textInput->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
     textInput->hide();
 
-    //连接信号
-    connect(textInput,&QLineEdit::editingFinished,this,&ScreenshotWidget::onTextInputFinished);
-    connect(textInput,&QLineEdit::returnPressed,this,&ScreenshotWidget::onTextInputFinished);
+    //失去焦点时完成输入，Ctrl+Enter、Esc 在 eventFilter 中处理
+    textInput->installEventFilter(this);
+    //输入框随行数增高
+    connect(textInput,&QPlainTextEdit::textChanged,this,[this](){
+        const int lines = qMax(1, int(textInput->document()->size().height()));
+        textInput->resize(textInput->width(), lines * textInput->fontMetrics().lineSpacing() + 24);
+    });
 }
 
-void ScreenshotWidget::onTextInputFinished(){
-    if(!textInput || textInput->text().isEmpty()){
-        if(textInput){
-            textInput->hide();
-            textInput->clear();
+void ScreenshotWidget::showTextInput(const QString &text){
+    //第一次输入文字时才创建输入框
+    if(!textInput){
+        setupTextInput();
+    }
+    //输入框从 textInputPosition 延伸到选区右边缘，标注按同样的宽度换行
+    textInput->move(textInputPosition);
+    textInput->resize(qMax(120, selectedRect.right() - textInputPosition.x()), 40);
+    textInput->setPlainText(text);
+    textInput->moveCursor(QTextCursor::End);
+    textInput->show();
+    textInput->setFocus();
+    isTextInputActive = true;
+}
+
+bool ScreenshotWidget::eventFilter(QObject *watched, QEvent *event){
+    if(watched == textInput && isTextInputActive){
+        if(event->type() == QEvent::FocusOut){
+            onTextInputFinished();
+        }
+        else if(event->type() == QEvent::KeyPress){
+            QKeyEvent *keyEvent = static_cast<QKeyEvent *>(event);
+            if(keyEvent->key() == Qt::Key_Escape){
+                //放弃这次输入，编辑中的文字保持原样
+                textInput->clear();
+                editingText = -1;
+                onTextInputFinished();
+                return true;
+            }
+            if((keyEvent->key() == Qt::Key_Return || keyEvent->key() == Qt::Key_Enter) &&
+               (keyEvent->modifiers() & Qt::ControlModifier)){
+                onTextInputFinished();
+                return true;
+            }
         }
-        isTextInputActive = false;
-        currentDrawMode = None;
-        return;
     }
-    //保存文本
-    DrawnText drawnText;
-    drawnText.position = textInputPosition;
-    drawnText.text = textInput->text();
-    drawnText.color = QColor(255,0,0);
-    drawnText.fontSize = 14;
-    drawnText.font = QFont("Arial",drawnText.fontSize);
+    return QWidget::eventFilter(watched, event);
+}
 
-    //计算文字矩形大小
-    QFontMetrics metrics(drawnText.font);
-    QRect textRect = metrics.boundingRect(drawnText.text);
-    textRect.moveTopLeft(textInputPosition);
-    textRect.adjust(-2,-2,2,2);
-    drawnText.rect = textRect;
+void ScreenshotWidget::onTextInputFinished(){
+    //隐藏输入框时还会收到一次失去焦点，只处理第一次
+    if(!isTextInputActive){
+        return;
+    }
+    isTextInputActive = false;
 
-    texts.append(drawnText);
+    const QString text = textInput->toPlainText();
+    const bool empty = text.trimmed().isEmpty();
+    if(editingText >= 0){
+        //修改已有的文字，清空即删除
+        if(empty){
+            annotations.remove(editingText);
+        }
+        else{
+            annotations.setText(editingText, text);
+        }
+    }
+    else if(!empty){
+        //保存文本，文字放在输入框所在的位置，换行宽度与输入框的文字区域相同
+        const int wrapWidth = textInput->viewport()->width() - 2 * int(textInput->document()->documentMargin());
+        annotations.addText(textInputPosition, text, QColor(255,0,0), textInput->font(), wrapWidth);
+    }
+    editingText = -1;
 
     textInput->hide();
     textInput->clear();
-    isTextInputActive = false;
     currentDrawMode = None;
     update();
 }
-
-
-//文本绘制函数
-void ScreenshotWidget::drawText(QPainter &painter, const QPoint &position, const QString &text, const QColor &color, const QFont &font){
-    painter.setPen(color);
-    painter.setFont(font);
-    painter.drawText(position,text);
-}
-
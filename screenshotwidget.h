@@ -10,68 +10,76 @@
 #include <QPoint>
 #include <QColor>
 #include<QTextEdit>
-#include<QLineEdit>
-
-// 绘制形状数据结构
-struct DrawnArrow
-{
-    QPoint start;
-    QPoint end;
-    QColor color;
-    int width;
-};
-
-struct DrawnRectangle
-{
-    QRect rect;
-    QColor color;
-    int width;
-};
-
-//绘制文本数据结构
-struct DrawnText
-{
-    QString text;
-    QRect rect;
-    QPoint position;
-    QColor color;
-    int fontSize;
-    QFont font;
-};
-
-//画笔数据结构
-struct DrawnPenStroke
-{
-    QVector<QPoint> point;
-    QColor color;
-    int width;
-};
-
+#include <QPlainTextEdit>
+#include <QFuture>
+#include "windowlayout.h"
+#include "edgemap.h"
+#include "scrollstitcher.h"
+#include "screenmapper.h"
+#include "annotationstore.h"
+
+class QScreen;
+class QTimer;
+class RegionRecorder;
+class CaptureHistory;
+class OcrEngine;
+class InputCoalescer;
+struct CaptureState;
 
 class ScreenshotWidget : public QWidget
 {
     Q_OBJECT
 
 public:
+    enum CaptureMode
+    {
+        CaptureArea,
+        CaptureFullScreen,
+        CaptureWindow
+    };
+
     explicit ScreenshotWidget(QWidget *parent = nullptr);
     ~ScreenshotWidget();
 
     void startCapture();
     void startCaptureFullScreen(); // 直接截取全屏并显示工具栏
+    void startCaptureWindow();     // 截图后高亮鼠标下的窗口，单击选中
+    // 使用已经截好的整个虚拟桌面图像（物理像素）开始截图，不再重新截屏
+    void startCaptureFromFrame(const QImage &desktopFrame, const QPoint &nativeCursorPos,
+                               CaptureMode mode = CaptureArea);
+    // 重新打开保存过的截图，恢复选区和标注，不重新截屏
+    void startCaptureFromState(const CaptureState &state);
+    // 使用给定的各屏幕截图开始截图，用于回放录制的输入会话
+    void startCaptureFromScreens(const QVector<ScreenMapper::Screen> &screens);
+    // 当前截图、选区和标注，用于放入最近截图环
+    CaptureState captureState() const;
+    // 是否是静态截图（不是滚动截图或录屏），只有静态截图的状态放入最近截图环
+    bool isStillCapture() const { return stillCapture; }
+    // 保存时在截图历史中查找近似重复的截图
+    void setCaptureHistory(CaptureHistory *history) { captureHistory = history; }
 
 signals:
     void screenshotTaken();
     void screenshotCancelled();
+    // 截图写入文件后发出，image 为写入的图像，录屏时为空
+    void screenshotSaved(const QString &fileName, const QImage &image);
 
 protected:
     void paintEvent(QPaintEvent *event) override;
     void mousePressEvent(QMouseEvent *event) override;
     void mouseMoveEvent(QMouseEvent *event) override;
     void mouseReleaseEvent(QMouseEvent *event) override;
+    void mouseDoubleClickEvent(QMouseEvent *event) override;
     void keyPressEvent(QKeyEvent *event) override;
+    bool eventFilter(QObject *watched, QEvent *event) override;
 
 private slots:
     void onTextInputFinished();
+    void startScrollCapture();   // 以当前选区开始滚动截图
+    void onScrollCaptureTick();  // 定时截取选区并拼接
+    void finishScrollCapture();
+    void startRecording();       // 录制选区
+    void stopRecording();
 
 private:
 
@@ -95,24 +103,43 @@ private:
     void increaseEffectStrength();
     void decreaseEffectStrength();
     void setupEffectToolbar(); // 新增工具栏设置
-    QPixmap applyEffect(const QPixmap &source, const QRect &area, int strength, DrawMode mode);//模糊应用函数
-    QPixmap applyBlur(const QPixmap &source, const QRect &area, int radius);//高斯模糊应用
-    QPixmap applyMosaic(const QPixmap &source, const QRect &area, int strength);//马赛克应用
     void setupToolbar();
     void updateToolbarPosition();
+    void showOverlay();                // 显示覆盖整个虚拟桌面的截图遮罩
+    void selectWholeScreen();          // 选中鼠标所在的整个屏幕并显示工具栏
+    void showSelectionToolbar();       // 进入已选中状态并显示工具栏
+    void enableWindowPicking();        // 枚举顶层窗口，进入窗口选择模式
+    QImage renderSelection();          // 按输出比例合成选区并画上标注
+    QImage exportSelection();          // 保存、复制用的图像：合成后按设置裁掉纯色边框
+    void reportCaptureMemory() const;  // 带 --capture-profile 时输出本次截图的图块内存和进程内存峰值
+    QRect nativeSelectedRect() const;  // 选区在虚拟桌面中的物理像素区域
+    bool clipSelectionToScreen();      // 把选区限制在单个屏幕内并设为 captureScreen
+    QRect screenSelectedRect() const;  // 选区在 captureScreen 内的逻辑坐标
+    // 隐藏遮罩并在选区外显示带状态文字和“完成/取消”按钮的控制面板
+    void showCapturePanel(const QString &status, const QString &doneText, void (ScreenshotWidget::*onDone)());
+    void exportRecordingAsync(const QString &fileName, bool dithering); // 在后台把录屏导出为 GIF，完成后结束截图
 
     void saveScreenshot();
+    void compareWithFile();            // 选区与打开的图片逐像素对比，再次点击清除对比结果
+    void recognizeText();              // 识别选区中的文字并复制到剪贴板
+    void pinSelection();               // 把选区钉在屏幕上
+    void startEdgeDetection();         // 在线程池中为每个屏幕计算边缘投影
+    // 把窗口坐标吸附到附近明显的界面边缘，按住 Alt 时不吸附
+    QPoint snapToEdges(const QPoint &pos, Qt::KeyboardModifiers modifiers) const;
+    void applyInputSamples();          // 取出合帧缓存的鼠标样本，更新选区、绘制和拖动状态
+    // 在线程池中写入图片文件，成功后发出 screenshotSaved；与历史中像素相同且格式相同的截图改为链接
+    void exportImageAsync(const QImage &image, const QString &fileName);
     void copyToClipboard();
     void cancelCapture();
-    void drawArrow(QPainter &painter, const QPoint &start, const QPoint &end, const QColor &color, int width);
+    void finishCapture();              // 隐藏并释放截图窗口
     void setupTextInput();
-    void drawText(QPainter &painter, const QPoint &position, const QString &text, const QColor &color, const QFont &font);
-    void drawArrow(QPainter &painter, const QPointF &start, const QPointF &end, const QColor &color, int width, double scale = 1.0);
+    void ensureToolbar();              // 工具栏在第一次显示时才创建
+    void showTextInput(const QString &text); // 在 textInputPosition 处显示输入框
     void updateEffectToolbarPosition();
     void updateStrengthLabel();
 
 
-    QPixmap screenPixmap; // 屏幕截图
+    ScreenMapper screenMapper; // 各屏幕的截图和坐标映射
     QPoint startPoint;    // 选择起始点
     QPoint endPoint;      // 选择结束点
     bool selecting;       // 是否正在选择
@@ -130,6 +157,12 @@ private:
     QPushButton *btnPen;   // 画笔工具
     QPushButton *btnMosaic;  // 马赛克按钮
     QPushButton *btnBlur;//高斯模糊按钮
+    QPushButton *btnScroll;  // 滚动截图
+    QPushButton *btnRecord;  // 录屏
+    QPushButton *btnDiff;    // 与保存的截图对比
+    QPushButton *btnTrim;    // 导出时裁掉纯色边框（可切换）
+    QPushButton *btnOcr;     // 识别文字并复制
+    QPushButton *btnPin;     // 钉在屏幕上
     // 尺寸显示标签
     QLabel *sizeLabel;
 
@@ -164,11 +197,45 @@ private:
     QPoint blurStartPoint;
     QPoint blurEndPoint;
     bool drawingBlur;
-    // 屏幕设备像素比
-    qreal devicePixelRatio;
-    
     // 虚拟桌面原点（用于多屏幕支持）
     QPoint virtualGeometryTopLeft;
+    // 滚动截图、录屏所在的屏幕
+    QScreen *captureScreen;
+    // 从最近截图环重新打开时的编号，新截图为 0
+    qint64 captureId;
+    // 开始滚动截图或录屏后为 false
+    bool stillCapture;
+    CaptureHistory *captureHistory;
+
+    // 窗口截图相关
+    bool windowPicking;         // 是否处于窗口选择模式
+    WindowLayout windowLayout;  // 截图开始时缓存的窗口布局（窗口逻辑坐标）
+    int hoveredWindow;          // 鼠标下的窗口下标，-1 表示没有
+
+    // 滚动截图、录屏时显示在选区外的控制面板
+    QWidget *capturePanel;
+    QLabel *panelStatusLabel;
+
+    // 滚动截图相关
+    ScrollStitcher scrollStitcher;
+    QTimer *scrollTimer;
+
+    // 选区吸附：各屏幕的边缘投影，与 screenMapper.screens() 一一对应
+    QFuture<QVector<EdgeMap>> edgeMaps;
+    int snapRadius;             // 吸附半径（逻辑像素），0 表示不吸附
+
+    // 对比相关：热力图和变化区域都是选区输出图像的像素坐标
+    QImage diffHeatmap;
+    QVector<QRect> diffRegions;
+    QSize diffImageSize;
+    QString diffSummary;
+
+    // 文字识别，第一次使用时创建
+    OcrEngine *ocrEngine;
+
+    // 录屏相关
+    RegionRecorder *recorder;
+    QString recordingFile;      // 录制中的临时文件
 
     // 放大镜相关
     QPoint currentMousePos;
@@ -176,29 +243,28 @@ private:
     int magnifiserSize;
 
     //文本输入相关
-    QLineEdit *textInput;
+    QPlainTextEdit *textInput;
     bool isTextInputActive;
     QPoint textInputPosition;
+    int editingText;            // 正在重新编辑的文字标注的下标，-1 表示新建
 
     //文字移动相关
     bool isTextMoving;
-    DrawnText* movingText;
+    int movingText;             // 正在拖动的文字标注的下标，-1 表示没有
     QPoint dragStartOffset;
 
     // 绘制相关
 
-    // 存储绘制的形状
-    QVector<DrawnArrow> arrows;
-    QVector<DrawnRectangle> rectangles;
-    QVector<DrawnText> texts;
-    QVector<DrawnPenStroke> penStrokes;
+    // 所有已完成的标注，画笔在绘制过程中就直接追加到这里
+    AnnotationStore annotations;
 
+    // 鼠标移动按屏幕刷新率合帧，样本在绘制前由 applyInputSamples 处理
+    InputCoalescer *inputCoalescer;
 
     // 当前绘制的临时数据
     bool isDrawing;
     QPoint drawStartPoint;
     QPoint drawEndPoint;
-    QVector<QPoint> currentPenStroke;
 
 
 };
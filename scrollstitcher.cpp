@@ -0,0 +1,297 @@
+#include "scrollstitcher.h"
+#include "pixelformat.h"
+#include "pixelhash.h"
+#include "pngstreamwriter.h"
+#include <QHash>
+#include <QDebug>
+#include <cstring>
+
+namespace
+{
+    // 重叠区域中允许有少量行不一致（闪烁的光标、动画等）
+    const int MinMatchPercent = 95;
+    // 重叠区域至少需要的行数，太少时匹配不可靠
+    const int MinOverlapRows = 8;
+    // 每帧最多尝试的锚点行数
+    const int MaxAnchorTries = 16;
+}
+
+ScrollStitcher::ScrollStitcher(int stripRows)
+    : stripRows(qMax(1, stripRows)),
+      frames(0),
+      lastFooterRows(0),
+      stripUsed(0),
+      committedRows(0)
+{
+}
+
+int ScrollStitcher::append(const QImage &frame)
+{
+    const QImage current = PixelFormat::toRgb32(frame, frame.size());
+    QVector<quint64> hashes = PixelHash::rowHashes(current);
+
+    if (frames == 0)
+    {
+        lastFrame = current;
+        lastHashes = hashes;
+        lastFooterRows = 0;
+        strip = QImage(current.width(), stripRows, QImage::Format_RGB32);
+        frames = 1;
+        return current.height();
+    }
+
+    if (current.size() != lastFrame.size())
+    {
+        qWarning() << "ScrollStitcher: frame size changed" << lastFrame.size() << "->" << current.size();
+        return -1;
+    }
+
+    Overlap overlap;
+    if (!findOverlap(lastHashes, hashes, overlap))
+    {
+        return -1;
+    }
+    if (overlap.scroll == 0)
+    {
+        // 画面没有滚动
+        return 0;
+    }
+
+    const int height = current.height();
+    if (committedRows == 0)
+    {
+        // 第一帧除底部固定区域外全部保留
+        commitRows(lastFrame, 0, height - overlap.footerRows);
+    }
+    commitRows(current, height - overlap.footerRows - overlap.scroll, overlap.scroll);
+
+    lastFrame = current;
+    lastHashes = hashes;
+    lastFooterRows = overlap.footerRows;
+    ++frames;
+    return overlap.scroll;
+}
+
+bool ScrollStitcher::findOverlap(const QVector<quint64> &previous, const QVector<quint64> &current, Overlap &result) const
+{
+    const int height = current.size();
+
+    // 顶部和底部位置不变的行视为固定区域，不参与匹配
+    int header = 0;
+    while (header < height && previous[header] == current[header])
+    {
+        ++header;
+    }
+    if (header == height)
+    {
+        result = {0, header, 0};
+        return true;
+    }
+
+    int footer = 0;
+    while (footer < height - header && previous[height - 1 - footer] == current[height - 1 - footer])
+    {
+        ++footer;
+    }
+    const int bandEnd = height - footer;
+
+    // 上一帧中只出现一次的行才适合作为锚点，空白行之类重复的行会产生歧义
+    QHash<quint64, int> uniqueRows;
+    uniqueRows.reserve(bandEnd - header);
+    for (int row = header; row < bandEnd; ++row)
+    {
+        auto it = uniqueRows.find(previous[row]);
+        if (it == uniqueRows.end())
+        {
+            uniqueRows.insert(previous[row], row);
+        }
+        else
+        {
+            it.value() = -1;
+        }
+    }
+
+    int tries = 0;
+    for (int row = header; row < bandEnd && tries < MaxAnchorTries; ++row)
+    {
+        const int match = uniqueRows.value(current[row], -1);
+        if (match <= row)
+        {
+            continue;
+        }
+        ++tries;
+
+        // 候选滚动距离：当前帧第 k 行应等于上一帧第 k + scroll 行
+        const int scroll = match - row;
+        const int overlapRows = bandEnd - scroll - header;
+        if (overlapRows < MinOverlapRows)
+        {
+            continue;
+        }
+
+        int matched = 0;
+        for (int k = header; k < bandEnd - scroll; ++k)
+        {
+            matched += previous[k + scroll] == current[k];
+        }
+        if (matched * 100 >= overlapRows * MinMatchPercent)
+        {
+            result = {scroll, header, footer};
+            return true;
+        }
+    }
+    return false;
+}
+
+void ScrollStitcher::commitRows(const QImage &frame, int firstRow, int rowCount)
+{
+    const int rowBytes = frame.width() * 4;
+    for (int i = 0; i < rowCount; ++i)
+    {
+        if (stripUsed == stripRows)
+        {
+            // 写入失败时 flushStrip 也会清空条带，这里总有空间
+            flushStrip();
+        }
+        std::memcpy(strip.scanLine(stripUsed), frame.constScanLine(firstRow + i), size_t(rowBytes));
+        ++stripUsed;
+    }
+    committedRows += rowCount;
+}
+
+void ScrollStitcher::flushStrip()
+{
+    if (stripUsed == 0)
+    {
+        return;
+    }
+    if (error.isEmpty() && !spool.isOpen() && !spool.open())
+    {
+        error = "无法创建临时文件：" + spool.errorString();
+        qWarning() << "ScrollStitcher:" << error;
+    }
+    // Format_RGB32 的每行没有填充，整个条带是连续内存
+    const qint64 bytes = qint64(stripUsed) * strip.bytesPerLine();
+    if (error.isEmpty() && spool.write(reinterpret_cast<const char *>(strip.constBits()), bytes) != bytes)
+    {
+        error = "写入临时文件失败：" + spool.errorString();
+        qWarning() << "ScrollStitcher:" << error;
+    }
+    stripUsed = 0;
+}
+
+int ScrollStitcher::totalHeight() const
+{
+    if (frames == 0)
+    {
+        return 0;
+    }
+    if (committedRows == 0)
+    {
+        return lastFrame.height();
+    }
+    return committedRows + lastFooterRows;
+}
+
+bool ScrollStitcher::finish(const QString &fileName, QString *errorMessage)
+{
+    auto failed = [&](const QString &message)
+    {
+        if (errorMessage)
+        {
+            *errorMessage = message;
+        }
+        reset();
+        return false;
+    };
+
+    if (frames == 0)
+    {
+        return failed("没有截取到画面");
+    }
+
+    PngStreamWriter writer;
+    if (committedRows == 0)
+    {
+        // 只有一帧或画面没有滚动过
+        if (!writer.open(fileName, lastFrame.size()))
+        {
+            return failed(writer.errorString());
+        }
+        for (int y = 0; y < lastFrame.height(); ++y)
+        {
+            writer.writeRow(lastFrame.constScanLine(y));
+        }
+        if (!writer.close())
+        {
+            return failed(writer.errorString());
+        }
+        reset();
+        return true;
+    }
+
+    // 最后一帧的底部固定区域
+    commitRows(lastFrame, lastFrame.height() - lastFooterRows, lastFooterRows);
+    if (!error.isEmpty())
+    {
+        return failed(error);
+    }
+
+    if (!writer.open(fileName, QSize(lastFrame.width(), committedRows)))
+    {
+        return failed(writer.errorString());
+    }
+
+    // 先写临时文件中的行，每次读一个条带，复用条带的内存
+    const qint64 rowBytes = strip.bytesPerLine();
+    const int pending = stripUsed;
+    QImage buffer(strip.width(), stripRows, QImage::Format_RGB32);
+    int diskRows = committedRows - pending;
+    if (diskRows > 0)
+    {
+        spool.seek(0);
+    }
+    while (diskRows > 0)
+    {
+        const int rows = qMin(diskRows, stripRows);
+        if (spool.read(reinterpret_cast<char *>(buffer.bits()), rows * rowBytes) != rows * rowBytes)
+        {
+            writer.close();
+            return failed("读取临时文件失败：" + spool.errorString());
+        }
+        for (int y = 0; y < rows; ++y)
+        {
+            writer.writeRow(buffer.constScanLine(y));
+        }
+        diskRows -= rows;
+    }
+    for (int y = 0; y < pending; ++y)
+    {
+        writer.writeRow(strip.constScanLine(y));
+    }
+
+    if (!writer.close())
+    {
+        return failed(writer.errorString());
+    }
+    reset();
+    return true;
+}
+
+void ScrollStitcher::reset()
+{
+    frames = 0;
+    lastFrame = QImage();
+    lastHashes.clear();
+    strip = QImage();
+    stripUsed = 0;
+    committedRows = 0;
+    lastFooterRows = 0;
+    if (spool.isOpen())
+    {
+        // 临时文件下次重新打开时会沿用，先清空
+        spool.resize(0);
+        spool.close();
+    }
+    error.clear();
+}
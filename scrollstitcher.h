@@ -0,0 +1,62 @@
+#ifndef SCROLLSTITCHER_H
+#define SCROLLSTITCHER_H
+
+#include <QImage>
+#include <QString>
+#include <QVector>
+#include <QTemporaryFile>
+
+// 滚动截图拼接器
+// 每收到一帧就用行哈希找出与上一帧的垂直重叠，只把新滚动出来的行追加到结果中。
+// 已经确定的行先放在内存中的条带里，条带写满后整块写入临时文件，
+// 因此截图过程中的内存只和一帧加一个条带的大小有关，与页面总高度无关。
+// 结束时也不拼出整张长图，而是从临时文件逐个条带读出，直接写成 PNG。
+class ScrollStitcher
+{
+public:
+    explicit ScrollStitcher(int stripRows = 1024);
+
+    // 追加一帧（所有帧尺寸必须相同），返回本帧新增的行数，-1 表示无法与上一帧对齐
+    int append(const QImage &frame);
+
+    // 当前拼接结果的总高度（含尚未提交的最后一帧）
+    int totalHeight() const;
+    int frameCount() const { return frames; }
+
+    // 临时文件无法打开或写入后，之后的行都会丢失，结束时报告错误
+    bool hasError() const { return !error.isEmpty(); }
+
+    // 结束拼接，把长图逐条带写成 PNG 文件。失败时返回 false，errorMessage 中给出原因。
+    // 无论成功与否都会清空状态，可以开始下一次拼接
+    bool finish(const QString &fileName, QString *errorMessage = nullptr);
+
+    // 放弃当前的拼接
+    void reset();
+
+private:
+    struct Overlap
+    {
+        int scroll;      // 内容向上滚动的行数
+        int headerRows;  // 两帧顶部位置不变的行（固定的标题栏等）
+        int footerRows;  // 两帧底部位置不变的行
+    };
+
+    bool findOverlap(const QVector<quint64> &previous, const QVector<quint64> &current, Overlap &result) const;
+    void commitRows(const QImage &frame, int firstRow, int rowCount);
+    void flushStrip();
+
+    int stripRows;
+    int frames;
+
+    QImage lastFrame;
+    QVector<quint64> lastHashes;
+    int lastFooterRows;
+
+    QImage strip;      // 已确定但尚未写入磁盘的行
+    int stripUsed;
+    int committedRows; // 已确定的总行数（磁盘 + 条带）
+    QTemporaryFile spool;
+    QString error;
+};
+
+#endif // SCROLLSTITCHER_H
@@ -0,0 +1,198 @@
+#include "sessionreplayer.h"
+#include "screenshotwidget.h"
+#include <QApplication>
+#include <QMouseEvent>
+#include <QWheelEvent>
+#include <QKeyEvent>
+#include <QEventLoop>
+#include <QTimer>
+#include <QPointer>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <memory>
+
+namespace
+{
+    // 回放结束后再运行一会儿事件循环，让最后一帧画完
+    const int SettleMs = 100;
+
+    // 在截图窗口的绘制前后计时
+    class TimedScreenshotWidget : public ScreenshotWidget
+    {
+    public:
+        explicit TimedScreenshotWidget(QVector<qint64> *paintTimes)
+            : paintTimes(paintTimes)
+        {
+        }
+
+    protected:
+        void paintEvent(QPaintEvent *event) override
+        {
+            QElapsedTimer timer;
+            timer.start();
+            ScreenshotWidget::paintEvent(event);
+            paintTimes->append(timer.nsecsElapsed() / 1000);
+        }
+
+    private:
+        QVector<qint64> *paintTimes;
+    };
+
+    QString typeName(int type)
+    {
+        switch (type)
+        {
+        case QEvent::MouseButtonPress:
+            return "mouse press";
+        case QEvent::MouseButtonRelease:
+            return "mouse release";
+        case QEvent::MouseButtonDblClick:
+            return "mouse double click";
+        case QEvent::MouseMove:
+            return "mouse move";
+        case QEvent::Wheel:
+            return "wheel";
+        case QEvent::KeyPress:
+            return "key press";
+        case QEvent::KeyRelease:
+            return "key release";
+        default:
+            return QString("event %1").arg(type);
+        }
+    }
+
+    std::unique_ptr<QEvent> makeEvent(const InputSession::Event &recorded, QWidget *widget)
+    {
+        const QEvent::Type type = QEvent::Type(recorded.type);
+        const Qt::KeyboardModifiers modifiers(recorded.modifiers);
+        const QPointF globalPos = widget->mapToGlobal(QPoint(0, 0)) + recorded.pos;
+        std::unique_ptr<QInputEvent> event;
+        switch (type)
+        {
+        case QEvent::MouseButtonPress:
+        case QEvent::MouseButtonRelease:
+        case QEvent::MouseButtonDblClick:
+        case QEvent::MouseMove:
+            event.reset(new QMouseEvent(type, recorded.pos, globalPos, Qt::MouseButton(recorded.button),
+                                        Qt::MouseButtons(recorded.buttons), modifiers));
+            break;
+        case QEvent::Wheel:
+            event.reset(new QWheelEvent(recorded.pos, globalPos, QPoint(), recorded.angleDelta,
+                                        Qt::MouseButtons(recorded.buttons), modifiers, Qt::NoScrollPhase, false));
+            break;
+        case QEvent::KeyPress:
+        case QEvent::KeyRelease:
+            event.reset(new QKeyEvent(type, recorded.key, modifiers, recorded.text, recorded.autoRepeat));
+            break;
+        default:
+            return nullptr;
+        }
+        // 合帧按事件时间戳计算，与录制时保持一致
+        event->setTimestamp(ulong(recorded.timeUs / 1000));
+        return std::unique_ptr<QEvent>(event.release());
+    }
+
+    // 运行事件循环 ms 毫秒，期间照常处理定时器和绘制
+    void runEventLoop(int ms)
+    {
+        QEventLoop loop;
+        QTimer::singleShot(ms, Qt::PreciseTimer, &loop, &QEventLoop::quit);
+        loop.exec();
+    }
+
+    SessionReplayer::Stats summarize(QVector<qint64> samples)
+    {
+        SessionReplayer::Stats stats;
+        stats.count = samples.size();
+        if (samples.isEmpty())
+        {
+            return stats;
+        }
+        std::sort(samples.begin(), samples.end());
+        qint64 total = 0;
+        for (qint64 sample : samples)
+        {
+            total += sample;
+        }
+        stats.mean = double(total) / samples.size();
+        stats.p50 = samples.at(samples.size() / 2);
+        stats.p95 = samples.at(qMin(samples.size() - 1, samples.size() * 95 / 100));
+        stats.max = samples.last();
+        return stats;
+    }
+
+    QString formatStats(const QString &name, const SessionReplayer::Stats &stats)
+    {
+        return QString("  %1 %2  mean %3  p50 %4  p95 %5  max %6 ms\n")
+            .arg(name, -20)
+            .arg(stats.count, 6)
+            .arg(stats.mean / 1000.0, 7, 'f', 3)
+            .arg(stats.p50 / 1000.0, 7, 'f', 3)
+            .arg(stats.p95 / 1000.0, 7, 'f', 3)
+            .arg(stats.max / 1000.0, 7, 'f', 3);
+    }
+}
+
+SessionReplayer::Report SessionReplayer::replay(const InputSession::Session &session)
+{
+    Report report;
+    QVector<qint64> paintTimes;
+    QMap<QString, QVector<qint64>> eventTimes;
+
+    // 截图窗口完成或取消时会 deleteLater 自己，只能在堆上创建
+    QPointer<TimedScreenshotWidget> widget = new TimedScreenshotWidget(&paintTimes);
+    widget->startCaptureFromScreens(session.screens);
+    runEventLoop(SettleMs);
+    report.firstPaintUs = paintTimes.isEmpty() ? 0 : paintTimes.first();
+    paintTimes.clear();
+
+    QElapsedTimer clock;
+    clock.start();
+    for (const InputSession::Event &recorded : session.events)
+    {
+        const qint64 waitMs = (recorded.timeUs - clock.nsecsElapsed() / 1000) / 1000;
+        if (waitMs > 0)
+        {
+            runEventLoop(int(waitMs));
+        }
+        if (!widget || !widget->isVisible())
+        {
+            break;
+        }
+
+        std::unique_ptr<QEvent> event = makeEvent(recorded, widget);
+        if (!event)
+        {
+            continue;
+        }
+        QElapsedTimer timer;
+        timer.start();
+        QApplication::sendEvent(widget, event.get());
+        eventTimes[typeName(recorded.type)].append(timer.nsecsElapsed() / 1000);
+        ++report.delivered;
+    }
+    runEventLoop(SettleMs);
+    report.elapsedMs = clock.elapsed();
+
+    for (auto it = eventTimes.constBegin(); it != eventTimes.constEnd(); ++it)
+    {
+        report.events.insert(it.key(), summarize(it.value()));
+    }
+    report.paint = summarize(paintTimes);
+    delete widget;
+    return report;
+}
+
+QString SessionReplayer::format(const Report &report)
+{
+    QString text = QString("replayed %1 events in %2 ms, first paint %3 ms\n")
+                       .arg(report.delivered)
+                       .arg(report.elapsedMs)
+                       .arg(report.firstPaintUs / 1000.0, 0, 'f', 3);
+    for (auto it = report.events.constBegin(); it != report.events.constEnd(); ++it)
+    {
+        text += formatStats(it.key(), it.value());
+    }
+    text += formatStats("paint", report.paint);
+    return text;
+}
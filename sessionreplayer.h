@@ -0,0 +1,38 @@
+#ifndef SESSIONREPLAYER_H
+#define SESSIONREPLAYER_H
+
+#include <QMap>
+#include <QString>
+#include "inputsession.h"
+
+// 在截图窗口上回放录制的输入会话，测量每个事件的处理时间和每次绘制的时间
+// 用录制时的截图开始截图，然后按录制的时间间隔依次把事件直接发给截图窗口，
+// 两个事件之间照常运行事件循环，鼠标合帧、定时器和重绘的节奏与录制时相同。
+// 需要已经创建 QApplication，通常在 offscreen 平台上运行，不需要显示器。
+class SessionReplayer
+{
+public:
+    // 一组耗时样本的统计（微秒）
+    struct Stats
+    {
+        int count = 0;
+        double mean = 0;
+        qint64 p50 = 0;
+        qint64 p95 = 0;
+        qint64 max = 0;
+    };
+
+    struct Report
+    {
+        QMap<QString, Stats> events;  // 按事件类型
+        Stats paint;
+        qint64 firstPaintUs = 0;      // 截图窗口显示后的第一次绘制
+        int delivered = 0;            // 回放的事件数，截图窗口提前关闭时少于录制的数量
+        qint64 elapsedMs = 0;
+    };
+
+    static Report replay(const InputSession::Session &session);
+    static QString format(const Report &report);
+};
+
+#endif // SESSIONREPLAYER_H
@@ -0,0 +1,105 @@
+#include "startupprofiler.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QFile>
+#include <cstring>
+
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+namespace
+{
+    struct Mark
+    {
+        const char *stage;
+        qint64 nsecs;
+    };
+
+    QElapsedTimer &clock()
+    {
+        static QElapsedTimer timer;
+        return timer;
+    }
+
+    QVector<Mark> &marks()
+    {
+        static QVector<Mark> list;
+        return list;
+    }
+
+    // 静态初始化时开始计时
+    const bool clockStarted = []()
+    {
+        clock().start();
+        return true;
+    }();
+
+    // 进程创建到开始计时之间的毫秒数，无法得到时返回 -1。
+    // /proc/self/stat 的第 22 项是进程创建时刻（开机以来的时钟滴答），精度为一个滴答（通常 10 ms）
+    double processStartOffsetMs()
+    {
+#ifdef Q_OS_LINUX
+        QFile stat("/proc/self/stat");
+        QFile uptime("/proc/uptime");
+        if (!stat.open(QIODevice::ReadOnly) || !uptime.open(QIODevice::ReadOnly))
+        {
+            return -1;
+        }
+        const double nowMs = uptime.readAll().split(' ').value(0).toDouble() * 1000.0;
+        // 进程名可能带空格，从最后一个右括号之后开始数（第 3 项起）
+        const QByteArray line = stat.readAll();
+        const QList<QByteArray> fields = line.mid(line.lastIndexOf(')') + 2).split(' ');
+        const long ticks = sysconf(_SC_CLK_TCK);
+        if (fields.size() < 20 || ticks <= 0)
+        {
+            return -1;
+        }
+        const double startMs = fields.at(19).toDouble() * 1000.0 / ticks;
+        const double sinceStart = nowMs - startMs;
+        const double sinceClock = clock().nsecsElapsed() / 1e6;
+        return qMax(0.0, sinceStart - sinceClock);
+#else
+        return -1;
+#endif
+    }
+}
+
+namespace StartupProfiler
+{
+    void mark(const char *stage)
+    {
+        Q_UNUSED(clockStarted);
+        marks().append({stage, clock().nsecsElapsed()});
+    }
+
+    bool isRequested()
+    {
+        return qEnvironmentVariableIsSet("SCREENSNIPER_STARTUP_PROFILE") ||
+               QCoreApplication::arguments().contains("--startup-profile");
+    }
+
+    QString report()
+    {
+        const double offset = processStartOffsetMs();
+        const double base = offset < 0 ? 0 : offset;
+        QString text = "Startup timeline (ms since process start";
+        text += offset < 0 ? ", loader time unknown):\n" : QString(", %1 ms before static init):\n").arg(offset, 0, 'f', 0);
+
+        double previous = 0;
+        for (const Mark &mark : marks())
+        {
+            const double at = base + mark.nsecs / 1e6;
+            text += QString("  %1  +%2  %3").arg(at, 8, 'f', 1).arg(at - previous, 7, 'f', 1).arg(mark.stage);
+            if (std::strcmp(mark.stage, "tray visible") == 0)
+            {
+                text += at <= TrayReadyTargetMs ? QString("  (target %1 ms met)").arg(TrayReadyTargetMs)
+                                                : QString("  (over the %1 ms target)").arg(TrayReadyTargetMs);
+            }
+            text += '\n';
+            previous = at;
+        }
+        return text;
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef STARTUPPROFILER_H
+#define STARTUPPROFILER_H
+
+#include <QString>
+
+// 启动耗时的时间线
+// 计时从本模块静态初始化时开始（早于 main），Linux 下再从 /proc 补上进程创建到静态初始化之间
+// 动态链接等耗时。各阶段用 mark() 记下，启动参数带 --startup-profile 或设置了环境变量
+// SCREENSNIPER_STARTUP_PROFILE 时，启动完成后输出时间线。只在 GUI 线程调用。
+namespace StartupProfiler
+{
+    // 记录一个阶段完成的时间，stage 应为字符串字面量
+    void mark(const char *stage);
+
+    // 是否要求输出时间线（需要已经创建 QCoreApplication）
+    bool isRequested();
+
+    // 各阶段距进程启动的时间和相邻阶段的间隔
+    QString report();
+
+    // 从进程启动到托盘可见的目标时间（毫秒），report() 中标出是否达到
+    const int TrayReadyTargetMs = 100;
+}
+
+#endif // STARTUPPROFILER_H
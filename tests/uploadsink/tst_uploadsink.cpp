@@ -0,0 +1,315 @@
+#include "uploadsink.h"
+#include <QtTest>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QSettings>
+#include <QRandomGenerator>
+#include <QDir>
+#include <QPointer>
+
+// 本地 HTTP 服务：解析分块传输编码的 POST 请求，按 statuses 依次回复状态码
+class FakeHttpServer : public QObject
+{
+public:
+    struct Request
+    {
+        QByteArray headers;
+        QByteArray body;
+        int chunks = 0;
+    };
+
+    QList<int> statuses;                // 依次使用的状态码，用完后重复最后一个，为空时回复 200
+    QList<Request> requests;
+    QByteArray stallFilename;           // X-Filename 为这个值的请求只接收不回复，模拟卡住的服务器
+
+    explicit FakeHttpServer(const QHostAddress &address = QHostAddress::LocalHost)
+    {
+        connect(&server, &QTcpServer::newConnection, this, [this]()
+                {
+            while (QTcpSocket *socket = server.nextPendingConnection())
+            {
+                connect(socket, &QTcpSocket::readyRead, this, [this, socket]()
+                        {
+                    buffers[socket] += socket->readAll();
+                    respond(socket); });
+                connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+            } });
+        server.listen(address);
+    }
+
+    bool isListening() const { return server.isListening(); }
+    quint16 port() const { return server.serverPort(); }
+
+    // 断开所有没有回复的连接，客户端随即得到错误，不必等到超时
+    void releaseStalled()
+    {
+        for (const QPointer<QTcpSocket> &socket : stalled)
+        {
+            if (socket)
+            {
+                socket->abort();
+            }
+        }
+        stalled.clear();
+    }
+
+    // 请求头中 name 的值
+    static QByteArray header(const Request &request, const QByteArray &name)
+    {
+        for (const QByteArray &line : request.headers.split('\n'))
+        {
+            if (line.startsWith(name + ":"))
+            {
+                return line.mid(name.size() + 1).trimmed();
+            }
+        }
+        return QByteArray();
+    }
+
+private:
+    // 收到完整的请求（最后一个长度为 0 的块）后才回复
+    void respond(QTcpSocket *socket)
+    {
+        const QByteArray data = buffers.value(socket);
+        const int headerEnd = data.indexOf("\r\n\r\n");
+        if (headerEnd < 0)
+        {
+            return;
+        }
+
+        Request request;
+        request.headers = data.left(headerEnd);
+        int pos = headerEnd + 4;
+        for (;;)
+        {
+            const int lineEnd = data.indexOf("\r\n", pos);
+            if (lineEnd < 0)
+            {
+                return;
+            }
+            bool ok = false;
+            const int size = data.mid(pos, lineEnd - pos).toInt(&ok, 16);
+            if (!ok)
+            {
+                socket->abort();
+                return;
+            }
+            if (data.size() < lineEnd + 2 + size + 2)
+            {
+                return;
+            }
+            if (size == 0)
+            {
+                break;
+            }
+            request.body += data.mid(lineEnd + 2, size);
+            ++request.chunks;
+            pos = lineEnd + 2 + size + 2;
+        }
+
+        buffers.remove(socket);
+        const int status = statuses.value(requests.size(), statuses.isEmpty() ? 200 : statuses.last());
+        requests.append(request);
+        if (!stallFilename.isEmpty() && header(request, "X-Filename") == stallFilename)
+        {
+            stalled.append(socket);
+            return;
+        }
+        socket->write("HTTP/1.1 " + QByteArray::number(status) + " Test\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        socket->disconnectFromHost();
+    }
+
+    QTcpServer server;
+    QHash<QTcpSocket *, QByteArray> buffers;
+    QList<QPointer<QTcpSocket>> stalled;
+};
+
+class TestUploadSink : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void chunkedUpload();
+    void retriesAfterServerError();
+    void dropsAfterClientError();
+    void retryContinuesPastRejectedFile();
+    void uploadNotBlockedByStalledRetry();
+    void hostHeaderBracketsIpv6();
+
+private:
+    // 噪声图像，PNG 编码后有几百 KB，会分成多个块发送
+    static QImage testImage();
+    int queuedFileCount() const;
+
+    QScopedPointer<FakeHttpServer> server;
+    QScopedPointer<QTemporaryDir> queueDir;
+};
+
+void TestUploadSink::initTestCase()
+{
+    // 不碰用户自己的设置
+    QCoreApplication::setOrganizationName("ScreenSniperTests");
+    QCoreApplication::setApplicationName("tst_uploadsink");
+}
+
+void TestUploadSink::init()
+{
+    server.reset(new FakeHttpServer);
+    queueDir.reset(new QTemporaryDir);
+    QVERIFY(queueDir->isValid());
+
+    QSettings settings;
+    settings.clear();
+    settings.setValue("upload/url", QString("http://127.0.0.1:%1/upload").arg(server->port()));
+    settings.setValue("upload/format", "png");
+    settings.setValue("upload/queueDir", queueDir->path());
+    settings.setValue("upload/retrySeconds", 1);
+}
+
+void TestUploadSink::cleanup()
+{
+    QSettings().clear();
+    server.reset();
+    queueDir.reset();
+}
+
+QImage TestUploadSink::testImage()
+{
+    QImage image(512, 512, QImage::Format_RGB32);
+    QRandomGenerator random(42);
+    for (int y = 0; y < image.height(); ++y)
+    {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < image.width(); ++x)
+        {
+            line[x] = random.generate() | 0xff000000u;
+        }
+    }
+    return image;
+}
+
+int TestUploadSink::queuedFileCount() const
+{
+    return QDir(queueDir->path()).entryList({"*.png"}, QDir::Files).size();
+}
+
+void TestUploadSink::chunkedUpload()
+{
+    UploadSink sink;
+    QSignalSpy uploaded(&sink, &UploadSink::uploaded);
+    const QImage image = testImage();
+    sink.upload("/tmp/shot.png", image);
+    QVERIFY(uploaded.wait(10000));
+
+    QCOMPARE(server->requests.size(), 1);
+    const FakeHttpServer::Request &request = server->requests.first();
+    QCOMPARE(FakeHttpServer::header(request, "Transfer-Encoding"), QByteArray("chunked"));
+    QCOMPARE(FakeHttpServer::header(request, "Content-Type"), QByteArray("image/png"));
+    QCOMPARE(FakeHttpServer::header(request, "X-Filename"), QByteArray("shot.png"));
+    QCOMPARE(FakeHttpServer::header(request, "Host"), "127.0.0.1:" + QByteArray::number(server->port()));
+    QVERIFY(request.chunks > 1);
+    QCOMPARE(QImage::fromData(request.body, "PNG").convertToFormat(QImage::Format_RGB32), image);
+    QCOMPARE(uploaded.first().at(1).toLongLong(), qint64(request.body.size()));
+    QCOMPARE(queuedFileCount(), 0);
+}
+
+void TestUploadSink::retriesAfterServerError()
+{
+    server->statuses = {503, 200};
+    UploadSink sink;
+    QSignalSpy queued(&sink, &UploadSink::queued);
+    QSignalSpy dropped(&sink, &UploadSink::dropped);
+    const QImage image = testImage();
+    sink.upload("shot.png", image);
+    QVERIFY(queued.wait(10000));
+    QCOMPARE(dropped.count(), 0);
+    QCOMPARE(queuedFileCount(), 1);
+
+    // 重试间隔为 1 秒，第二次请求成功后队列清空
+    QTRY_COMPARE_WITH_TIMEOUT(server->requests.size(), 2, 10000);
+    QTRY_COMPARE_WITH_TIMEOUT(queuedFileCount(), 0, 10000);
+    const FakeHttpServer::Request &retry = server->requests.last();
+    QCOMPARE(FakeHttpServer::header(retry, "X-Filename"), QByteArray("shot.png"));
+    QCOMPARE(QImage::fromData(retry.body, "PNG").convertToFormat(QImage::Format_RGB32), image);
+}
+
+void TestUploadSink::dropsAfterClientError()
+{
+    server->statuses = {400};
+    UploadSink sink;
+    QSignalSpy queued(&sink, &UploadSink::queued);
+    QSignalSpy dropped(&sink, &UploadSink::dropped);
+    sink.upload("shot.png", testImage());
+    QVERIFY(dropped.wait(10000));
+    QCOMPARE(queued.count(), 0);
+    QCOMPARE(queuedFileCount(), 0);
+
+    // 超过一个重试间隔也不会再发
+    QTest::qWait(1500);
+    QCOMPARE(server->requests.size(), 1);
+}
+
+void TestUploadSink::retryContinuesPastRejectedFile()
+{
+    // 上次退出时队列中留下的两张截图，第一张被服务器拒绝，不能挡住第二张
+    const QImage image = testImage();
+    QVERIFY(image.save(queueDir->path() + "/1000_first.png"));
+    QVERIFY(image.save(queueDir->path() + "/2000_second.png"));
+    server->statuses = {400, 200};
+
+    UploadSink sink;
+    QTRY_COMPARE_WITH_TIMEOUT(server->requests.size(), 2, 10000);
+    QTRY_COMPARE_WITH_TIMEOUT(queuedFileCount(), 0, 10000);
+    QCOMPARE(FakeHttpServer::header(server->requests.at(0), "X-Filename"), QByteArray("first.png"));
+    QCOMPARE(FakeHttpServer::header(server->requests.at(1), "X-Filename"), QByteArray("second.png"));
+}
+
+void TestUploadSink::uploadNotBlockedByStalledRetry()
+{
+    // 队列中的截图遇到收下请求却不回复的服务器，重试要等一个 30 秒的超时周期；
+    // 这期间新截图仍然要立即上传
+    QVERIFY(testImage().save(queueDir->path() + "/1000_stalled.png"));
+    server->stallFilename = "stalled.png";
+
+    UploadSink sink;
+    QSignalSpy uploaded(&sink, &UploadSink::uploaded);
+    QTRY_COMPARE_WITH_TIMEOUT(server->requests.size(), 1, 10000);
+
+    // 等待时间比重试的超时短得多，排在重试后面就会超时
+    sink.upload("fresh.png", testImage());
+    QVERIFY(uploaded.wait(10000));
+    QCOMPARE(uploaded.first().at(0).toString(), QString("fresh.png"));
+    QCOMPARE(server->requests.size(), 2);
+    QCOMPARE(FakeHttpServer::header(server->requests.last(), "X-Filename"), QByteArray("fresh.png"));
+
+    // 卡住的文件还在队列中，服务器恢复后下一次重试上传成功
+    QCOMPARE(queuedFileCount(), 1);
+    server->stallFilename.clear();
+    server->releaseStalled();
+    QTRY_COMPARE_WITH_TIMEOUT(queuedFileCount(), 0, 10000);
+}
+
+void TestUploadSink::hostHeaderBracketsIpv6()
+{
+    server.reset(new FakeHttpServer(QHostAddress::LocalHostIPv6));
+    if (!server->isListening())
+    {
+        QSKIP("IPv6 loopback is not available");
+    }
+    QSettings().setValue("upload/url", QString("http://[::1]:%1/upload").arg(server->port()));
+
+    UploadSink sink;
+    QSignalSpy uploaded(&sink, &UploadSink::uploaded);
+    sink.upload("shot.png", testImage());
+    QVERIFY(uploaded.wait(10000));
+    QCOMPARE(FakeHttpServer::header(server->requests.first(), "Host"), "[::1]:" + QByteArray::number(server->port()));
+}
+
+QTEST_GUILESS_MAIN(TestUploadSink)
+
+#include "tst_uploadsink.moc"
@@ -0,0 +1,16 @@
+QT += testlib network concurrent gui
+QT -= widgets
+
+CONFIG += c++17 testcase console
+CONFIG -= app_bundle
+
+TARGET = tst_uploadsink
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    ../../uploadsink.cpp \
+    tst_uploadsink.cpp
+
+HEADERS += \
+    ../../uploadsink.h
@@ -0,0 +1,191 @@
+#include "tiledimage.h"
+#include "pixelformat.h"
+#include <QPainter>
+#include <cstring>
+
+TiledImage::TiledImage()
+    : imageFormat(QImage::Format_RGB32),
+      columns(0),
+      rows(0)
+{
+}
+
+TiledImage::TiledImage(const QSize &size, QImage::Format format)
+    : imageSize(size),
+      imageFormat(format),
+      columns(size.isEmpty() ? 0 : (size.width() + TileSize - 1) / TileSize),
+      rows(size.isEmpty() ? 0 : (size.height() + TileSize - 1) / TileSize),
+      tiles(columns * rows)
+{
+}
+
+TiledImage TiledImage::fromImage(const QImage &image, const QRect &rect)
+{
+    const QRect area = rect.isEmpty() ? image.rect() : rect.intersected(image.rect());
+    if (area.isEmpty())
+    {
+        return TiledImage();
+    }
+
+    if (image.depth() == 32)
+    {
+        TiledImage result(area.size(), image.format());
+        for (int index = 0; index < result.tileCount(); ++index)
+        {
+            const QRect tile = result.tileRect(index);
+            result.tiles[index] = image.copy(tile.translated(area.topLeft()));
+        }
+        return result;
+    }
+
+    // 其它格式（如部分平台截图返回的 RGB888）逐个图块直接转换，不生成整张的中间图像
+    TiledImage result(area.size(), QImage::Format_RGB32);
+    for (int index = 0; index < result.tileCount(); ++index)
+    {
+        const QRect tile = result.tileRect(index);
+        QImage converted(tile.size(), QImage::Format_RGB32);
+        if (!PixelFormat::convertInto<PixelFormat::Rgb32>(image, tile.translated(area.topLeft()), converted))
+        {
+            converted = image.copy(tile.translated(area.topLeft())).convertToFormat(QImage::Format_RGB32);
+        }
+        result.tiles[index] = converted;
+    }
+    return result;
+}
+
+QRect TiledImage::tileRect(int index) const
+{
+    const int column = index % columns;
+    const int row = index / columns;
+    return QRect(column * TileSize, row * TileSize, TileSize, TileSize).intersected(rect());
+}
+
+QVector<int> TiledImage::tilesIn(const QRect &area) const
+{
+    QVector<int> result;
+    const QRect clipped = area.intersected(rect());
+    if (clipped.isEmpty())
+    {
+        return result;
+    }
+    for (int row = clipped.top() / TileSize; row <= clipped.bottom() / TileSize; ++row)
+    {
+        for (int column = clipped.left() / TileSize; column <= clipped.right() / TileSize; ++column)
+        {
+            result.append(row * columns + column);
+        }
+    }
+    return result;
+}
+
+void TiledImage::write(const QPoint &pos, const QImage &image)
+{
+    // RGB32 图块可以直接从其它格式逐行转换写入，不需要先转换整张图像
+    const bool direct = image.format() == imageFormat ||
+                        (imageFormat == QImage::Format_RGB32 &&
+                         PixelFormat::dispatch(image.format(), [](auto) {}));
+    const QImage source = direct ? image : image.convertToFormat(imageFormat);
+    const QRect area(pos, source.size());
+
+    for (int index : tilesIn(area))
+    {
+        const QRect tile = tileRect(index);
+        QImage &target = tiles[index];
+        if (target.isNull())
+        {
+            target = QImage(tile.size(), imageFormat);
+            target.fill(Qt::black);
+        }
+
+        // scanLine() 会在图块被共享时先复制一份，其它 TiledImage 看到的内容不变
+        const QRect part = tile.intersected(area);
+        if (source.format() != imageFormat)
+        {
+            PixelFormat::convertInto<PixelFormat::Rgb32>(source, part.translated(-area.topLeft()), target,
+                                                         part.topLeft() - tile.topLeft());
+            continue;
+        }
+        const int rowBytes = part.width() * 4;
+        for (int y = part.top(); y <= part.bottom(); ++y)
+        {
+            std::memcpy(target.scanLine(y - tile.top()) + (part.left() - tile.left()) * 4,
+                        source.constScanLine(y - area.top()) + (part.left() - area.left()) * 4, size_t(rowBytes));
+        }
+    }
+}
+
+QImage TiledImage::copy(const QRect &area) const
+{
+    const QRect clipped = area.intersected(rect());
+    if (clipped.isEmpty())
+    {
+        return QImage();
+    }
+    QImage result(clipped.size(), imageFormat);
+    copyTo(clipped, result, QPoint(0, 0));
+    return result;
+}
+
+void TiledImage::copyTo(const QRect &source, QImage &target, const QPoint &targetPos) const
+{
+    const QRect area = source.intersected(rect());
+    for (int index : tilesIn(area))
+    {
+        const QRect tile = tileRect(index);
+        const QRect part = tile.intersected(area);
+        const int rowBytes = part.width() * 4;
+        const QImage &image = tiles.at(index);
+
+        for (int y = part.top(); y <= part.bottom(); ++y)
+        {
+            uchar *out = target.scanLine(targetPos.y() + y - source.top()) + (targetPos.x() + part.left() - source.left()) * 4;
+            if (image.isNull())
+            {
+                std::memset(out, 0, size_t(rowBytes));
+            }
+            else
+            {
+                std::memcpy(out, image.constScanLine(y - tile.top()) + (part.left() - tile.left()) * 4, size_t(rowBytes));
+            }
+        }
+    }
+}
+
+void TiledImage::draw(QPainter &painter, const QRectF &target, const QRectF &source) const
+{
+    if (source.isEmpty())
+    {
+        return;
+    }
+    const qreal sx = target.width() / source.width();
+    const qreal sy = target.height() / source.height();
+
+    for (int index : tilesIn(source.toAlignedRect()))
+    {
+        const QImage &image = tiles.at(index);
+        if (image.isNull())
+        {
+            continue;
+        }
+        const QRectF tile = tileRect(index);
+        const QRectF part = tile.intersected(source);
+        if (part.isEmpty())
+        {
+            continue;
+        }
+        const QRectF targetPart(target.x() + (part.x() - source.x()) * sx,
+                                target.y() + (part.y() - source.y()) * sy,
+                                part.width() * sx, part.height() * sy);
+        painter.drawImage(targetPart, image, part.translated(-tile.topLeft()));
+    }
+}
+
+qint64 TiledImage::allocatedBytes() const
+{
+    qint64 bytes = 0;
+    for (const QImage &image : tiles)
+    {
+        bytes += image.sizeInBytes();
+    }
+    return bytes;
+}
@@ -0,0 +1,66 @@
+#ifndef TILEDIMAGE_H
+#define TILEDIMAGE_H
+
+#include <QImage>
+#include <QRect>
+#include <QRectF>
+#include <QVector>
+
+class QPainter;
+
+// 分块存放的 32 位图像
+// 图像按 TileSize x TileSize 切成图块，每个图块是一个隐式共享的 QImage：
+// 复制 TiledImage 只增加引用计数，写入时只复制（分离）被修改的图块。
+// 裁剪、绘制和导出都只访问与目标区域相交的图块，不会为整幅截图生成临时副本。
+class TiledImage
+{
+public:
+    static const int TileSize = 256;
+
+    TiledImage();
+    // 创建空图像，图块在第一次写入时才分配
+    explicit TiledImage(const QSize &size, QImage::Format format = QImage::Format_RGB32);
+
+    // 把 image 中的 rect 区域切成图块（rect 为空时取整幅图像）
+    static TiledImage fromImage(const QImage &image, const QRect &rect = QRect());
+
+    bool isNull() const { return imageSize.isEmpty(); }
+    QSize size() const { return imageSize; }
+    int width() const { return imageSize.width(); }
+    int height() const { return imageSize.height(); }
+    QRect rect() const { return QRect(QPoint(0, 0), imageSize); }
+    QImage::Format format() const { return imageFormat; }
+
+    int tileCount() const { return tiles.size(); }
+    QRect tileRect(int index) const;
+    // 未写入过的图块为空图像
+    const QImage &tile(int index) const { return tiles.at(index); }
+    // 直接替换整个图块，tile 的尺寸必须与 tileRect(index) 一致
+    void setTile(int index, const QImage &tile) { tiles[index] = tile; }
+
+    // 把 image 写到 pos 处；只有被覆盖的图块会被分配或分离
+    void write(const QPoint &pos, const QImage &image);
+
+    // 拼出 rect 区域的连续图像
+    QImage copy(const QRect &rect) const;
+    // 把 source 区域拷贝到 target 的 targetPos 处，target 必须是 32 位格式
+    void copyTo(const QRect &source, QImage &target, const QPoint &targetPos) const;
+
+    // 把 source 区域（像素坐标，可以是小数）画到 target，由 QPainter 缩放
+    void draw(QPainter &painter, const QRectF &target, const QRectF &source) const;
+
+    // 已分配图块占用的字节数（共享的图块也计算在内）
+    qint64 allocatedBytes() const;
+
+private:
+    // 与 rect 相交的图块下标
+    QVector<int> tilesIn(const QRect &rect) const;
+
+    QSize imageSize;
+    QImage::Format imageFormat;
+    int columns;
+    int rows;
+    QVector<QImage> tiles;
+};
+
+#endif // TILEDIMAGE_H
@@ -0,0 +1,456 @@
+#include "uploadsink.h"
+#include <QtConcurrent>
+#include <QFutureWatcher>
+#include <QTcpSocket>
+#include <QSslSocket>
+#include <QImageWriter>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QFile>
+#include <QSaveFile>
+#include <QDir>
+#include <QTimer>
+#include <QUrl>
+#include <QScopedPointer>
+#include <QDebug>
+#include <functional>
+
+namespace
+{
+    // 每块的大小，PNG 编码器每次只写几 KB，攒够再发，减少分块头和系统调用
+    const int ChunkSize = 64 * 1024;
+    // socket 中尚未发出的数据超过这个值时编码等待
+    const qint64 MaxInFlight = 1024 * 1024;
+    const int TimeoutMs = 30000;
+    // post() 的返回值：连接不上服务器、连接后没有收到回复。其余为 HTTP 状态码
+    const int NotConnected = -1;
+    const int NoResponse = 0;
+
+    // 在后台线程中使用的配置，在 GUI 线程读取后按值传入
+    struct Endpoint
+    {
+        QUrl url;
+        QByteArray format;
+        QByteArray authorization;
+        QString queueDir;
+        qint64 queueBudget = 0;
+    };
+
+    Endpoint readEndpoint()
+    {
+        QSettings settings;
+        Endpoint endpoint;
+        endpoint.url = QUrl(settings.value("upload/url").toString());
+        endpoint.format = settings.value("upload/format", "png").toString().toLower().toLatin1();
+        endpoint.authorization = settings.value("upload/authorization").toString().toUtf8();
+        endpoint.queueDir = settings.value("upload/queueDir",
+                                           QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/upload-queue")
+                                .toString();
+        endpoint.queueBudget = settings.value("upload/queueMaxMB", 64).toLongLong() * 1024 * 1024;
+        return endpoint;
+    }
+
+    QByteArray contentType(const QByteArray &format)
+    {
+        return "image/" + (format == "jpg" ? QByteArray("jpeg") : format);
+    }
+
+    // 把写入的数据按 HTTP 分块传输编码发到 socket
+    // 编码器写进来的数据先攒到 ChunkSize 再作为一块发出；socket 积压过多时阻塞等待，
+    // 形成背压。只能在没有事件循环的后台线程中使用（依赖 waitForBytesWritten）
+    class ChunkedBodyDevice : public QIODevice
+    {
+    public:
+        explicit ChunkedBodyDevice(QTcpSocket *socket)
+            : socket(socket),
+              total(0)
+        {
+            buffer.reserve(ChunkSize);
+            open(QIODevice::WriteOnly);
+        }
+
+        bool isSequential() const override { return true; }
+
+        // 发出剩余数据和结束块
+        bool finish()
+        {
+            if (!flushChunk())
+            {
+                return false;
+            }
+            socket->write("0\r\n\r\n");
+            return drain(0);
+        }
+
+        qint64 bodyBytes() const { return total; }
+
+    protected:
+        qint64 readData(char *, qint64) override { return -1; }
+
+        qint64 writeData(const char *data, qint64 length) override
+        {
+            buffer.append(data, int(length));
+            total += length;
+            if (buffer.size() >= ChunkSize && !flushChunk())
+            {
+                return -1;
+            }
+            return length;
+        }
+
+    private:
+        bool flushChunk()
+        {
+            if (buffer.isEmpty())
+            {
+                return true;
+            }
+            socket->write(QByteArray::number(buffer.size(), 16) + "\r\n");
+            socket->write(buffer);
+            socket->write("\r\n");
+            buffer.clear();
+            return drain(MaxInFlight);
+        }
+
+        bool drain(qint64 limit)
+        {
+            while (socket->bytesToWrite() > limit)
+            {
+                if (!socket->waitForBytesWritten(TimeoutMs))
+                {
+                    setErrorString(socket->errorString());
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        QTcpSocket *socket;
+        QByteArray buffer;
+        qint64 total;
+    };
+
+    // 发送一个分块的 POST 请求，writeBody 向设备写入请求体，失败时可以给出原因。
+    // 返回服务器回复的 HTTP 状态码，没有回复时返回 NotConnected 或 NoResponse；不是 2xx 时 error 中给出原因
+    int post(const Endpoint &endpoint, const QString &fileName,
+             const std::function<bool(QIODevice *, QString *)> &writeBody, qint64 *bytes, QString *error)
+    {
+        error->clear();
+        const QUrl &url = endpoint.url;
+        const bool secure = url.scheme() == "https";
+        if (!url.isValid() || (url.scheme() != "http" && !secure))
+        {
+            *error = "上传地址必须是 http 或 https";
+            return NotConnected;
+        }
+
+        QScopedPointer<QTcpSocket> socket(secure ? new QSslSocket : new QTcpSocket);
+        const quint16 port = quint16(url.port(secure ? 443 : 80));
+        if (secure)
+        {
+            static_cast<QSslSocket *>(socket.data())->connectToHostEncrypted(url.host(), port);
+        }
+        else
+        {
+            socket->connectToHost(url.host(), port);
+        }
+        const bool connected = secure ? static_cast<QSslSocket *>(socket.data())->waitForEncrypted(TimeoutMs)
+                                      : socket->waitForConnected(TimeoutMs);
+        if (!connected)
+        {
+            *error = socket->errorString();
+            return NotConnected;
+        }
+
+        QByteArray target = url.toEncoded(QUrl::RemoveScheme | QUrl::RemoveAuthority | QUrl::RemoveFragment);
+        if (!target.startsWith('/'))
+        {
+            target.prepend('/');
+        }
+        QByteArray header = "POST " + target + " HTTP/1.1\r\n";
+        // authority 中 IPv6 地址带方括号，端口只在地址中写明时出现；用户名和密码不能出现在 Host 中
+        header += "Host: " + url.adjusted(QUrl::RemoveUserInfo).authority(QUrl::FullyEncoded).toLatin1() + "\r\n";
+        header += "Content-Type: " + contentType(endpoint.format) + "\r\n";
+        header += "Transfer-Encoding: chunked\r\n";
+        header += "X-Filename: " + QUrl::toPercentEncoding(QFileInfo(fileName).fileName()) + "\r\n";
+        if (!endpoint.authorization.isEmpty())
+        {
+            header += "Authorization: " + endpoint.authorization + "\r\n";
+        }
+        header += "Connection: close\r\n\r\n";
+        socket->write(header);
+
+        ChunkedBodyDevice body(socket.data());
+        if (!writeBody(&body, error) || !body.finish())
+        {
+            if (error->isEmpty())
+            {
+                *error = body.errorString().isEmpty() ? socket->errorString() : body.errorString();
+            }
+            return NoResponse;
+        }
+        *bytes = body.bodyBytes();
+
+        // 只需要状态行
+        while (!socket->canReadLine())
+        {
+            if (!socket->waitForReadyRead(TimeoutMs))
+            {
+                *error = "服务器没有响应";
+                return NoResponse;
+            }
+        }
+        const QList<QByteArray> status = socket->readLine().trimmed().split(' ');
+        const int code = status.value(1).toInt();
+        socket->disconnectFromHost();
+        if (code < 200 || code >= 300)
+        {
+            *error = QString("服务器返回 %1").arg(QString::fromLatin1(status.mid(1).join(' ')));
+        }
+        return code;
+    }
+
+    bool succeeded(int status)
+    {
+        return status >= 200 && status < 300;
+    }
+
+    // 只有网络错误和服务器错误（5xx）值得重试；其他状态（4xx 等）说明请求本身被拒绝，
+    // 原样重试只会一直失败，直接丢弃
+    bool retryable(int status)
+    {
+        return status <= NoResponse || status >= 500;
+    }
+
+    // 队列中的文件按名字（时间戳开头）排序就是提交顺序。
+    // 只列出当前格式的文件，中途退出时 QSaveFile 留下的临时文件（扩展名后带随机后缀）不算
+    QFileInfoList queuedFiles(const Endpoint &endpoint)
+    {
+        return QDir(endpoint.queueDir).entryInfoList({"*." + QString::fromLatin1(endpoint.format)}, QDir::Files, QDir::Name);
+    }
+
+    // 总大小超过上限时从最早的开始删除
+    void trimQueue(const Endpoint &endpoint)
+    {
+        QFileInfoList files = queuedFiles(endpoint);
+        qint64 total = 0;
+        for (const QFileInfo &info : files)
+        {
+            total += info.size();
+        }
+        while (total > endpoint.queueBudget && !files.isEmpty())
+        {
+            const QFileInfo oldest = files.takeFirst();
+            qWarning() << "Upload queue over budget, dropping" << oldest.fileName();
+            total -= oldest.size();
+            QFile::remove(oldest.absoluteFilePath());
+        }
+    }
+
+    bool enqueue(const Endpoint &endpoint, const QImage &image, const QString &fileName)
+    {
+        if (!QDir().mkpath(endpoint.queueDir))
+        {
+            return false;
+        }
+        const QString path = endpoint.queueDir + "/" + QString::number(QDateTime::currentMSecsSinceEpoch()) + "_" +
+                             QFileInfo(fileName).completeBaseName() + "." + QString::fromLatin1(endpoint.format);
+        // 先写临时文件，写完才以最终的名字出现在队列里，中途退出不会留下只有一半的图片被当作截图上传
+        QSaveFile file(path);
+        if (!file.open(QIODevice::WriteOnly))
+        {
+            return false;
+        }
+        QImageWriter writer(&file, endpoint.format);
+        if (!writer.write(image) || !file.commit())
+        {
+            return false;
+        }
+        trimQueue(endpoint);
+        return true;
+    }
+
+    // 队列文件名去掉开头的时间戳就是原来的文件名
+    QString originalName(const QFileInfo &info)
+    {
+        return info.fileName().section('_', 1);
+    }
+}
+
+UploadSink::UploadSink(QObject *parent)
+    : QObject(parent),
+      retryTimer(new QTimer(this)),
+      retrying(false)
+{
+    pool.setMaxThreadCount(1);
+    pool.setExpiryTimeout(-1);
+    retryPool.setMaxThreadCount(1);
+
+    retryTimer->setInterval(qMax(1, QSettings().value("upload/retrySeconds", 30).toInt()) * 1000);
+    connect(retryTimer, &QTimer::timeout, this, &UploadSink::retryQueued);
+    // 上次退出时队列中还有文件，启动后立即重试
+    if (!queuedFiles(readEndpoint()).isEmpty())
+    {
+        QTimer::singleShot(0, this, &UploadSink::retryQueued);
+    }
+}
+
+UploadSink::~UploadSink()
+{
+    // 正在进行的上传最多等待一个超时周期；失败的会留在队列里下次启动再传
+    pool.waitForDone();
+    retryPool.waitForDone();
+}
+
+bool UploadSink::isConfigured()
+{
+    return !QSettings().value("upload/url").toString().isEmpty();
+}
+
+void UploadSink::upload(const QString &fileName, const QImage &image)
+{
+    if (image.isNull())
+    {
+        return;
+    }
+    const Endpoint endpoint = readEndpoint();
+    QFutureWatcher<Result> *watcher = new QFutureWatcher<Result>(this);
+    watch(watcher);
+    watcher->setFuture(QtConcurrent::run(&pool, [endpoint, image, fileName]()
+                                         {
+        Result result;
+        result.fileName = fileName;
+        QElapsedTimer timer;
+        timer.start();
+        // 不等重试队列：队列中的文件由 retryQueued 另外上传，新截图不受之前失败的影响
+        const int status = post(endpoint, fileName, [&](QIODevice *body, QString *error)
+                                {
+            QImageWriter writer(body, endpoint.format);
+            if (!writer.write(image))
+            {
+                *error = writer.errorString();
+                return false;
+            }
+            return true; }, &result.bytes, &result.error);
+        result.ok = succeeded(status);
+        result.elapsedMs = timer.elapsed();
+        if (!result.ok && retryable(status))
+        {
+            // 重新编码一次写入队列；成功上传时完全不碰磁盘
+            result.wasQueued = enqueue(endpoint, image, fileName);
+        }
+        return result; }));
+}
+
+void UploadSink::retryQueued()
+{
+    if (retrying)
+    {
+        return;
+    }
+    retrying = true;
+    const Endpoint endpoint = readEndpoint();
+    QFutureWatcher<Result> *watcher = new QFutureWatcher<Result>(this);
+    connect(watcher, &QFutureWatcher<Result>::finished, this, [this]()
+            { retrying = false; });
+    watch(watcher);
+    // 重试在单独的线程中进行，一批文件遇到很慢的服务器可能要等好几个超时周期，新截图的上传不受影响
+    watcher->setFuture(QtConcurrent::run(&retryPool, [endpoint]()
+                                         {
+        Result result;
+        result.ok = true;
+        QElapsedTimer timer;
+        timer.start();
+        const QFileInfoList files = queuedFiles(endpoint);
+        for (int i = 0; i < files.size(); ++i)
+        {
+            const QFileInfo &info = files.at(i);
+            QFile file(info.absoluteFilePath());
+            if (!file.open(QIODevice::ReadOnly))
+            {
+                // 读不出来的文件重试也没有用
+                QFile::remove(info.absoluteFilePath());
+                continue;
+            }
+            qint64 bytes = 0;
+            QString error;
+            const int status = post(endpoint, originalName(info), [&file](QIODevice *body, QString *)
+                                    {
+                QByteArray block;
+                while (!(block = file.read(ChunkSize)).isEmpty())
+                {
+                    if (body->write(block) != block.size())
+                    {
+                        return false;
+                    }
+                }
+                return true; }, &bytes, &error);
+            file.close();
+            if (succeeded(status))
+            {
+                QFile::remove(info.absoluteFilePath());
+                result.bytes += bytes;
+                continue;
+            }
+
+            result.ok = false;
+            result.error = error;
+            if (!retryable(status))
+            {
+                qWarning() << "Upload rejected for" << originalName(info) << ":" << error << "(dropped)";
+                QFile::remove(info.absoluteFilePath());
+                continue;
+            }
+            ++result.remaining;
+            if (status == NotConnected)
+            {
+                // 连不上服务器时后面的文件也一样，全部留到下一次
+                result.remaining += files.size() - 1 - i;
+                break;
+            }
+            // 服务器出错可能只与这一个文件有关，继续上传后面的
+        }
+        result.elapsedMs = timer.elapsed();
+        return result; }));
+}
+
+void UploadSink::watch(QFutureWatcher<Result> *watcher)
+{
+    connect(watcher, &QFutureWatcher<Result>::finished, this, [this, watcher]()
+            {
+        const Result result = watcher->result();
+        watcher->deleteLater();
+
+        // 重试队列的结果只体现在队列中剩余的文件数上
+        if (!result.fileName.isEmpty() && result.ok)
+        {
+            emit uploaded(result.fileName, result.bytes, result.elapsedMs);
+        }
+        else if (!result.fileName.isEmpty())
+        {
+            qWarning() << "Upload failed for" << result.fileName << ":" << result.error
+                       << (result.wasQueued ? "(queued for retry)" : "(dropped)");
+            if (result.wasQueued)
+            {
+                emit queued(result.fileName, result.error);
+            }
+            else
+            {
+                emit dropped(result.fileName, result.error);
+            }
+        }
+
+        // 队列中还有文件时定时重试，清空后停下
+        const bool pending = result.fileName.isEmpty() ? result.remaining > 0 : result.wasQueued;
+        if (pending && !retryTimer->isActive())
+        {
+            retryTimer->start();
+        }
+        else if (result.fileName.isEmpty() && result.remaining == 0)
+        {
+            retryTimer->stop();
+        } });
+}
@@ -0,0 +1,66 @@
+#ifndef UPLOADSINK_H
+#define UPLOADSINK_H
+
+#include <QObject>
+#include <QImage>
+#include <QString>
+#include <QThreadPool>
+
+class QTimer;
+template <typename T>
+class QFutureWatcher;
+
+// 把保存的截图上传到 HTTP 服务（设置项 upload/url，为空时不上传）
+// 上传在后台线程中进行：图片边编码边以分块传输编码（Transfer-Encoding: chunked）POST 出去，
+// 不先写文件再上传，编码和网络传输同时进行。socket 的发送缓冲超过上限时编码等待，
+// 内存占用与图片大小无关。
+// 网络错误或服务器错误（5xx）时把编码后的图片放进磁盘上的重试队列（设置项 upload/queueDir，
+// 总大小上限 upload/queueMaxMB），按 upload/retrySeconds 的间隔重试，超出上限时丢弃最早的。
+// 服务器拒绝（4xx 等）的截图重试也不会成功，直接丢弃。新截图不排在队列后面，照常立即上传。
+// 新截图和重试队列各用一个线程，各自按提交顺序进行。两个线程共用队列目录但不需要加锁：
+// 文件用 QSaveFile 写完后才以最终的名字出现，删除已经被另一个线程删掉的文件没有影响。
+class UploadSink : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit UploadSink(QObject *parent = nullptr);
+    ~UploadSink();
+
+    // 是否配置了上传地址
+    static bool isConfigured();
+
+    // fileName 只用作服务端看到的文件名（X-Filename 头），图片从内存编码。
+    // 参数顺序与 ScreenshotWidget::screenshotSaved 相同，可以直接连接
+    void upload(const QString &fileName, const QImage &image);
+
+signals:
+    void uploaded(const QString &fileName, qint64 bytes, qint64 elapsedMs);
+    void queued(const QString &fileName, const QString &error);
+    // 被服务器拒绝或无法放进队列，不会再重试
+    void dropped(const QString &fileName, const QString &error);
+
+private slots:
+    void retryQueued();
+
+private:
+    struct Result
+    {
+        QString fileName;
+        bool ok = false;
+        bool wasQueued = false;         // 失败后放进了重试队列，为 false 时已丢弃
+        QString error;
+        qint64 bytes = 0;
+        qint64 elapsedMs = 0;
+        int remaining = 0;              // 重试后队列中剩余的文件数
+    };
+
+    void watch(QFutureWatcher<Result> *watcher);
+
+    QThreadPool pool;                   // 新截图的上传，只有一个线程
+    QThreadPool retryPool;              // 重试队列，只有一个线程
+    QTimer *retryTimer;
+    bool retrying;
+};
+
+#endif // UPLOADSINK_H
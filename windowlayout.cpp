@@ -0,0 +1,112 @@
+#include "windowlayout.h"
+
+WindowLayout::WindowLayout()
+    : columns(0),
+      rows(0)
+{
+}
+
+void WindowLayout::clear()
+{
+    rects.clear();
+    bounds = QRect();
+    columns = 0;
+    rows = 0;
+    cellStart.clear();
+    cellItems.clear();
+}
+
+void WindowLayout::build(const QVector<QRect> &rectsBottomToTop, const QRect &area)
+{
+    clear();
+    bounds = area;
+    if (bounds.isEmpty())
+    {
+        return;
+    }
+
+    // 反转为从上到下，同时丢掉完全不在范围内的窗口
+    rects.reserve(rectsBottomToTop.size());
+    for (int i = rectsBottomToTop.size() - 1; i >= 0; --i)
+    {
+        QRect clipped = rectsBottomToTop[i].intersected(bounds);
+        if (!clipped.isEmpty())
+        {
+            rects.append(clipped);
+        }
+    }
+
+    columns = (bounds.width() + CellSize - 1) / CellSize;
+    rows = (bounds.height() + CellSize - 1) / CellSize;
+    const int cellCount = columns * rows;
+
+    auto cellRange = [this](const QRect &r, int &c0, int &c1, int &r0, int &r1)
+    {
+        c0 = (r.left() - bounds.left()) / CellSize;
+        c1 = (r.right() - bounds.left()) / CellSize;
+        r0 = (r.top() - bounds.top()) / CellSize;
+        r1 = (r.bottom() - bounds.top()) / CellSize;
+    };
+
+    // 第一遍统计每个格子的窗口数，第二遍填充
+    cellStart.fill(0, cellCount + 1);
+    for (const QRect &r : rects)
+    {
+        int c0, c1, r0, r1;
+        cellRange(r, c0, c1, r0, r1);
+        for (int cy = r0; cy <= r1; ++cy)
+        {
+            for (int cx = c0; cx <= c1; ++cx)
+            {
+                ++cellStart[cy * columns + cx + 1];
+            }
+        }
+    }
+    for (int c = 0; c < cellCount; ++c)
+    {
+        cellStart[c + 1] += cellStart[c];
+    }
+
+    cellItems.resize(cellStart[cellCount]);
+    QVector<int> fill = cellStart;
+    for (int i = 0; i < rects.size(); ++i)
+    {
+        int c0, c1, r0, r1;
+        cellRange(rects[i], c0, c1, r0, r1);
+        for (int cy = r0; cy <= r1; ++cy)
+        {
+            for (int cx = c0; cx <= c1; ++cx)
+            {
+                cellItems[fill[cy * columns + cx]++] = i;
+            }
+        }
+    }
+}
+
+int WindowLayout::windowAt(const QPoint &pos) const
+{
+    if (rects.isEmpty() || !bounds.contains(pos))
+    {
+        return -1;
+    }
+
+    const int cell = ((pos.y() - bounds.top()) / CellSize) * columns + (pos.x() - bounds.left()) / CellSize;
+    for (int i = cellStart[cell]; i < cellStart[cell + 1]; ++i)
+    {
+        const int index = cellItems[i];
+        if (rects[index].contains(pos))
+        {
+            return index;
+        }
+    }
+    return -1;
+}
+
+QRect WindowLayout::windowRect(int index) const
+{
+    if (index < 0 || index >= rects.size())
+    {
+        return QRect();
+    }
+    return rects[index];
+}
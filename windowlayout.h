@@ -0,0 +1,41 @@
+#ifndef WINDOWLAYOUT_H
+#define WINDOWLAYOUT_H
+
+#include <QRect>
+#include <QPoint>
+#include <QVector>
+
+// 截图开始时缓存的窗口布局
+// 窗口矩形按 z 序从上到下存放在一个连续数组中，另外建立均匀网格索引，
+// 鼠标移动时只在所在格子的少量候选窗口里查找，不需要访问 X 服务器
+class WindowLayout
+{
+public:
+    WindowLayout();
+
+    // rectsBottomToTop 为按 z 序从下到上排列的窗口矩形（与 _NET_CLIENT_LIST_STACKING 一致），
+    // 坐标会被裁剪到 bounds 范围内
+    void build(const QVector<QRect> &rectsBottomToTop, const QRect &bounds);
+    void clear();
+
+    bool isEmpty() const { return rects.isEmpty(); }
+    int count() const { return rects.size(); }
+
+    // 返回包含 pos 的最上层窗口的下标，没有则返回 -1
+    int windowAt(const QPoint &pos) const;
+    QRect windowRect(int index) const;
+
+private:
+    static const int CellSize = 64;
+
+    QVector<QRect> rects;    // 0 为最上层窗口
+    QRect bounds;
+    int columns;
+    int rows;
+    // CSR 形式的网格：格子 c 中的窗口下标为 cellItems[cellStart[c] .. cellStart[c + 1])，
+    // 每个格子中的下标按升序排列，第一个命中的就是最上层窗口
+    QVector<int> cellStart;
+    QVector<int> cellItems;
+};
+
+#endif // WINDOWLAYOUT_H
@@ -0,0 +1,601 @@
+#include "x11capture.h"
+#include <QGuiApplication>
+#include <QMutex>
+#include <QDebug>
+#include <cstdlib>
+#include <cstring>
+
+// Xlib 的宏（None、Bool、Status 等）会污染 Qt 的命名，所以必须放在所有 Qt 头文件之后
+#ifdef SCREENSNIPER_X11
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/Xatom.h>
+#ifdef SCREENSNIPER_XDAMAGE
+#include <X11/extensions/Xdamage.h>
+#endif
+#ifdef SCREENSNIPER_XSHM
+#include <X11/Xlib-xcb.h>
+#include <xcb/shm.h>
+#include <unistd.h>
+#endif
+#endif
+
+#ifdef SCREENSNIPER_X11
+namespace
+{
+    // Xlib 的错误处理函数是进程全局的，ErrorTrap 共用这一个处理函数：
+    // 安装和恢复在 errorTrapMutex 下按引用计数进行，错误记在发生错误的线程自己的槽里
+    QMutex errorTrapMutex;
+    int errorTrapCount = 0;
+    XErrorHandler previousErrorHandler = nullptr;
+    thread_local int errorTrapDepth = 0;
+    thread_local int trappedError = 0;
+
+    int trapErrorHandler(Display *display, XErrorEvent *event)
+    {
+        // Xlib 在收到错误的线程上调用处理函数；没有拦截的线程交给原来的处理函数
+        if (!errorTrapDepth)
+        {
+            return previousErrorHandler ? previousErrorHandler(display, event) : 0;
+        }
+        trappedError = event->error_code;
+        return 0;
+    }
+
+    // 读取窗口上的 32 位属性数组（Xlib 中以 long 存放）
+    QVector<unsigned long> windowProperty(Display *display, Window window, Atom property, Atom type)
+    {
+        QVector<unsigned long> values;
+        Atom actualType = 0;
+        int actualFormat = 0;
+        unsigned long itemCount = 0, bytesAfter = 0;
+        unsigned char *data = nullptr;
+
+        if (XGetWindowProperty(display, window, property, 0, 1 << 16, False, type,
+                               &actualType, &actualFormat, &itemCount, &bytesAfter, &data) == Success)
+        {
+            if (data && actualType == type && actualFormat == 32)
+            {
+                const unsigned long *items = reinterpret_cast<const unsigned long *>(data);
+                values.reserve(int(itemCount));
+                for (unsigned long i = 0; i < itemCount; ++i)
+                {
+                    values.append(items[i]);
+                }
+            }
+            if (data)
+            {
+                XFree(data);
+            }
+        }
+        return values;
+    }
+
+    // 根窗口的像素格式是否与 Format_RGB32 的内存布局相同（32 位、小端、BGRX）
+    bool rootIsRgb32(Display *display)
+    {
+        const Visual *visual = DefaultVisual(display, DefaultScreen(display));
+        if (ImageByteOrder(display) != LSBFirst || visual->red_mask != 0xff0000 ||
+            visual->green_mask != 0x00ff00 || visual->blue_mask != 0x0000ff)
+        {
+            return false;
+        }
+        int count = 0;
+        XPixmapFormatValues *formats = XListPixmapFormats(display, &count);
+        bool matches = false;
+        for (int i = 0; i < count; ++i)
+        {
+            if (formats[i].depth == DefaultDepth(display, DefaultScreen(display)))
+            {
+                matches = formats[i].bits_per_pixel == 32;
+            }
+        }
+        if (formats)
+        {
+            XFree(formats);
+        }
+        return matches;
+    }
+}
+#endif
+
+namespace X11Capture
+{
+
+void initThreads()
+{
+#ifdef SCREENSNIPER_X11
+    XInitThreads();
+#endif
+}
+
+bool isAvailable()
+{
+#ifdef SCREENSNIPER_X11
+    return QGuiApplication::platformName() == QLatin1String("xcb");
+#else
+    return false;
+#endif
+}
+
+Display *openDisplay()
+{
+#ifdef SCREENSNIPER_X11
+    return isAvailable() ? XOpenDisplay(nullptr) : nullptr;
+#else
+    return nullptr;
+#endif
+}
+
+void closeDisplay(Display *display)
+{
+#ifdef SCREENSNIPER_X11
+    if (display)
+    {
+        XCloseDisplay(display);
+    }
+#else
+    Q_UNUSED(display);
+#endif
+}
+
+QRect rootGeometry(Display *display)
+{
+#ifdef SCREENSNIPER_X11
+    if (!display)
+    {
+        return QRect();
+    }
+    Screen *screen = DefaultScreenOfDisplay(display);
+    return QRect(0, 0, WidthOfScreen(screen), HeightOfScreen(screen));
+#else
+    Q_UNUSED(display);
+    return QRect();
+#endif
+}
+
+QPoint cursorPosition(Display *display)
+{
+#ifdef SCREENSNIPER_X11
+    if (!display)
+    {
+        return QPoint();
+    }
+    Window rootReturn, childReturn;
+    int rootX = 0, rootY = 0, winX = 0, winY = 0;
+    unsigned int mask = 0;
+    XQueryPointer(display, DefaultRootWindow(display), &rootReturn, &childReturn,
+                  &rootX, &rootY, &winX, &winY, &mask);
+    return QPoint(rootX, rootY);
+#else
+    Q_UNUSED(display);
+    return QPoint();
+#endif
+}
+
+QImage grabRootRect(Display *display, const QRect &physicalRect)
+{
+#ifdef SCREENSNIPER_X11
+    if (!display)
+    {
+        return QImage();
+    }
+
+    // 超出根窗口范围时 XGetImage 会产生 BadMatch，默认错误处理会直接退出进程
+    const QRect rect = physicalRect.intersected(rootGeometry(display));
+    if (rect.isEmpty())
+    {
+        return QImage();
+    }
+
+    QImage image(rect.width(), rect.height(), QImage::Format_RGB32);
+    if (!grabRootRectInto(display, rect, image))
+    {
+        return QImage();
+    }
+    return image;
+#else
+    Q_UNUSED(display);
+    Q_UNUSED(physicalRect);
+    return QImage();
+#endif
+}
+
+bool grabRootRectInto(Display *display, const QRect &physicalRect, QImage &image)
+{
+#ifdef SCREENSNIPER_X11
+    if (!display)
+    {
+        return false;
+    }
+    const QRect rect = physicalRect.intersected(rootGeometry(display));
+    if (rect.isEmpty() || rect != physicalRect || image.format() != QImage::Format_RGB32 ||
+        image.width() < rect.width() || image.height() < rect.height())
+    {
+        return false;
+    }
+
+    XImage *ximage = XGetImage(display, DefaultRootWindow(display),
+                               rect.x(), rect.y(), rect.width(), rect.height(),
+                               AllPlanes, ZPixmap);
+    if (!ximage)
+    {
+        qWarning() << "XGetImage failed for" << rect;
+        return false;
+    }
+
+    // 常见的 24/32 位 TrueColor（BGRX 排列）与 Format_RGB32 内存布局一致，逐行拷贝即可
+    if (ximage->bits_per_pixel == 32 && ximage->byte_order == LSBFirst &&
+        ximage->red_mask == 0xff0000 && ximage->green_mask == 0x00ff00 && ximage->blue_mask == 0x0000ff)
+    {
+        const int rowBytes = rect.width() * 4;
+        for (int y = 0; y < rect.height(); ++y)
+        {
+            std::memcpy(image.scanLine(y), ximage->data + y * ximage->bytes_per_line, rowBytes);
+        }
+    }
+    else
+    {
+        // 其它视觉类型较少见，逐像素转换
+        auto channel = [](unsigned long pixel, unsigned long mask) -> int
+        {
+            if (!mask)
+                return 0;
+            int shift = 0;
+            while (!(mask & 1))
+            {
+                mask >>= 1;
+                ++shift;
+            }
+            return int(((pixel >> shift) & mask) * 255 / mask);
+        };
+        for (int y = 0; y < rect.height(); ++y)
+        {
+            QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+            for (int x = 0; x < rect.width(); ++x)
+            {
+                unsigned long pixel = XGetPixel(ximage, x, y);
+                line[x] = qRgb(channel(pixel, ximage->red_mask),
+                               channel(pixel, ximage->green_mask),
+                               channel(pixel, ximage->blue_mask));
+            }
+        }
+    }
+
+    XDestroyImage(ximage);
+    return true;
+#else
+    Q_UNUSED(display);
+    Q_UNUSED(physicalRect);
+    Q_UNUSED(image);
+    return false;
+#endif
+}
+
+quint32 attachSharedMemory(Display *display, int fd)
+{
+#if defined(SCREENSNIPER_X11) && defined(SCREENSNIPER_XSHM)
+    if (!display || fd < 0)
+    {
+        return 0;
+    }
+    xcb_connection_t *connection = XGetXCBConnection(display);
+    const xcb_query_extension_reply_t *extension = xcb_get_extension_data(connection, &xcb_shm_id);
+    if (!extension || !extension->present)
+    {
+        return 0;
+    }
+    // 传递文件描述符需要 MIT-SHM 1.2
+    xcb_shm_query_version_reply_t *version =
+        xcb_shm_query_version_reply(connection, xcb_shm_query_version(connection), nullptr);
+    const bool supported = version && (version->major_version > 1 ||
+                                       (version->major_version == 1 && version->minor_version >= 2));
+    std::free(version);
+    if (!supported)
+    {
+        return 0;
+    }
+
+    // xcb 发送后会关闭传入的描述符，调用方的描述符还要继续使用，传一个副本
+    const int copy = dup(fd);
+    if (copy < 0)
+    {
+        return 0;
+    }
+    const xcb_shm_seg_t segment = xcb_generate_id(connection);
+    xcb_generic_error_t *error = xcb_request_check(connection, xcb_shm_attach_fd_checked(connection, segment, copy, 0));
+    if (error)
+    {
+        qWarning() << "MIT-SHM attach failed, error" << error->error_code;
+        std::free(error);
+        return 0;
+    }
+    return segment;
+#else
+    Q_UNUSED(display);
+    Q_UNUSED(fd);
+    return 0;
+#endif
+}
+
+void detachSharedMemory(Display *display, quint32 segment)
+{
+#if defined(SCREENSNIPER_X11) && defined(SCREENSNIPER_XSHM)
+    if (display && segment)
+    {
+        xcb_connection_t *connection = XGetXCBConnection(display);
+        xcb_shm_detach(connection, segment);
+        xcb_flush(connection);
+    }
+#else
+    Q_UNUSED(display);
+    Q_UNUSED(segment);
+#endif
+}
+
+bool grabRootRectToSharedMemory(Display *display, const QRect &physicalRect, quint32 segment, int stride)
+{
+#if defined(SCREENSNIPER_X11) && defined(SCREENSNIPER_XSHM)
+    if (!display || !segment)
+    {
+        return false;
+    }
+    const QRect rect = physicalRect.intersected(rootGeometry(display));
+    if (rect.isEmpty() || rect != physicalRect || stride != rect.width() * 4 || !rootIsRgb32(display))
+    {
+        return false;
+    }
+
+    xcb_connection_t *connection = XGetXCBConnection(display);
+    xcb_shm_get_image_reply_t *reply = xcb_shm_get_image_reply(
+        connection,
+        xcb_shm_get_image(connection, DefaultRootWindow(display), qint16(rect.x()), qint16(rect.y()),
+                          quint16(rect.width()), quint16(rect.height()), ~0u, XCB_IMAGE_FORMAT_Z_PIXMAP,
+                          segment, 0),
+        nullptr);
+    const bool ok = reply && reply->size == quint32(stride) * quint32(rect.height());
+    std::free(reply);
+    return ok;
+#else
+    Q_UNUSED(display);
+    Q_UNUSED(physicalRect);
+    Q_UNUSED(segment);
+    Q_UNUSED(stride);
+    return false;
+#endif
+}
+
+ErrorTrap::ErrorTrap(Display *display)
+    : display(display)
+{
+#ifdef SCREENSNIPER_X11
+    if (!display)
+    {
+        return;
+    }
+    // 之前的请求产生的错误不算在这里
+    XSync(display, False);
+
+    QMutexLocker locker(&errorTrapMutex);
+    if (errorTrapCount++ == 0)
+    {
+        previousErrorHandler = XSetErrorHandler(trapErrorHandler);
+    }
+    ++errorTrapDepth;
+    trappedError = 0;
+#endif
+}
+
+ErrorTrap::~ErrorTrap()
+{
+#ifdef SCREENSNIPER_X11
+    if (!display)
+    {
+        return;
+    }
+    // 让作用域内请求的错误都在拦截期间到达
+    XSync(display, False);
+
+    QMutexLocker locker(&errorTrapMutex);
+    --errorTrapDepth;
+    if (--errorTrapCount == 0)
+    {
+        XSetErrorHandler(previousErrorHandler);
+    }
+#endif
+}
+
+void ErrorTrap::clear()
+{
+#ifdef SCREENSNIPER_X11
+    trappedError = 0;
+#endif
+}
+
+int ErrorTrap::error() const
+{
+#ifdef SCREENSNIPER_X11
+    return trappedError;
+#else
+    return 0;
+#endif
+}
+
+int ErrorTrap::sync()
+{
+#ifdef SCREENSNIPER_X11
+    if (display)
+    {
+        XSync(display, False);
+    }
+#endif
+    return error();
+}
+
+QVector<TopLevelWindow> stackingWindows(Display *display)
+{
+    QVector<TopLevelWindow> windows;
+#ifdef SCREENSNIPER_X11
+    if (!display)
+    {
+        return windows;
+    }
+
+    Window root = DefaultRootWindow(display);
+    Atom stackingAtom = XInternAtom(display, "_NET_CLIENT_LIST_STACKING", False);
+    Atom frameExtentsAtom = XInternAtom(display, "_NET_FRAME_EXTENTS", False);
+
+    const QVector<unsigned long> clients = windowProperty(display, root, stackingAtom, XA_WINDOW);
+    windows.reserve(clients.size());
+
+    // 枚举过程中窗口随时可能被销毁，查询会产生 BadWindow，这里只记录不退出
+    ErrorTrap trap(display);
+
+    for (unsigned long client : clients)
+    {
+        trap.clear();
+
+        XWindowAttributes attributes;
+        if (!XGetWindowAttributes(display, client, &attributes) || trap.error())
+        {
+            continue;
+        }
+        if (attributes.map_state != IsViewable)
+        {
+            continue;
+        }
+
+        int rootX = 0, rootY = 0;
+        Window child;
+        XTranslateCoordinates(display, client, root, 0, 0, &rootX, &rootY, &child);
+        if (trap.error())
+        {
+            continue;
+        }
+
+        QRect geometry(rootX, rootY, attributes.width, attributes.height);
+
+        // _NET_FRAME_EXTENTS 依次为左、右、上、下边框宽度，把标题栏也算进窗口
+        const QVector<unsigned long> extents = windowProperty(display, client, frameExtentsAtom, XA_CARDINAL);
+        if (extents.size() == 4)
+        {
+            geometry.adjust(-int(extents[0]), -int(extents[2]), int(extents[1]), int(extents[3]));
+        }
+
+        windows.append({quint64(client), geometry});
+    }
+#else
+    Q_UNUSED(display);
+#endif
+    return windows;
+}
+
+QVector<TopLevelWindow> stackingWindows()
+{
+    Display *display = openDisplay();
+    if (!display)
+    {
+        return QVector<TopLevelWindow>();
+    }
+    QVector<TopLevelWindow> windows = stackingWindows(display);
+    closeDisplay(display);
+    return windows;
+}
+
+struct DamageTracker::Private
+{
+    Display *display = nullptr;
+#ifdef SCREENSNIPER_XDAMAGE
+    Damage damage = 0;
+    int eventBase = 0;
+#endif
+};
+
+DamageTracker::DamageTracker()
+    : d(new Private)
+{
+}
+
+DamageTracker::~DamageTracker()
+{
+#ifdef SCREENSNIPER_XDAMAGE
+    if (d->damage)
+    {
+        XDamageDestroy(d->display, d->damage);
+    }
+#endif
+#ifdef SCREENSNIPER_X11
+    if (d->display)
+    {
+        XCloseDisplay(d->display);
+    }
+#endif
+    delete d;
+}
+
+bool DamageTracker::start()
+{
+#ifdef SCREENSNIPER_XDAMAGE
+    if (!isAvailable())
+    {
+        return false;
+    }
+    d->display = XOpenDisplay(nullptr);
+    if (!d->display)
+    {
+        return false;
+    }
+
+    int errorBase = 0;
+    if (!XDamageQueryExtension(d->display, &d->eventBase, &errorBase))
+    {
+        return false;
+    }
+
+    // 每个被修改的矩形都单独上报，不需要再向服务器查询损坏区域
+    d->damage = XDamageCreate(d->display, DefaultRootWindow(d->display), XDamageReportRawRectangles);
+    XSync(d->display, False);
+    return d->damage != 0;
+#else
+    return false;
+#endif
+}
+
+bool DamageTracker::isActive() const
+{
+#ifdef SCREENSNIPER_XDAMAGE
+    return d->damage != 0;
+#else
+    return false;
+#endif
+}
+
+QVector<QRect> DamageTracker::takeDamage()
+{
+    QVector<QRect> rects;
+#ifdef SCREENSNIPER_XDAMAGE
+    if (!d->damage)
+    {
+        return rects;
+    }
+    while (XPending(d->display))
+    {
+        XEvent event;
+        XNextEvent(d->display, &event);
+        if (event.type == d->eventBase + XDamageNotify)
+        {
+            const XDamageNotifyEvent *notify = reinterpret_cast<const XDamageNotifyEvent *>(&event);
+            rects.append(QRect(notify->area.x, notify->area.y, notify->area.width, notify->area.height));
+        }
+    }
+    XDamageSubtract(d->display, d->damage, None, None);
+#endif
+    return rects;
+}
+
+Display *DamageTracker::display() const
+{
+    return d->display;
+}
+
+} // namespace X11Capture
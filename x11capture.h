@@ -0,0 +1,107 @@
+#ifndef X11CAPTURE_H
+#define X11CAPTURE_H
+
+#include <QImage>
+#include <QRect>
+#include <QPoint>
+#include <QVector>
+
+// 与 Xlib 中的声明一致，避免在头文件里引入 Xlib.h（其中的宏会和 Qt 冲突）
+typedef struct _XDisplay Display;
+
+// X11 原生截图辅助函数
+// 只有在定义了 SCREENSNIPER_X11 且运行在 xcb 平台时才可用，其余情况返回空结果
+namespace X11Capture
+{
+    // 必须在创建 QApplication 之前调用，允许多个线程各自持有 Display 连接
+    void initThreads();
+
+    // 当前进程是否可以使用 X11 原生截图
+    bool isAvailable();
+
+    // 打开一个新的 X 连接，不可用时返回 nullptr；用完后用 closeDisplay() 关闭
+    Display *openDisplay();
+    void closeDisplay(Display *display);
+
+    // 根窗口（整个虚拟桌面）的几何信息，单位为物理像素
+    QRect rootGeometry(Display *display);
+
+    // 当前鼠标在根窗口中的位置（物理像素）
+    QPoint cursorPosition(Display *display);
+
+    // 截取根窗口上的指定区域（物理像素坐标），返回 Format_RGB32 图像
+    QImage grabRootRect(Display *display, const QRect &physicalRect);
+    // 同上，但写入调用方提供的 Format_RGB32 图像的左上角（可以是包装外部内存的 QImage），
+    // 不分配新图像。physicalRect 必须在根窗口范围内，image 不小于它，否则返回 false
+    bool grabRootRectInto(Display *display, const QRect &physicalRect, QImage &image);
+
+    // 通过 MIT-SHM 让 X 服务器直接把像素写进调用方的共享内存，像素不经过 X 连接，也不拷贝。
+    // 需要编译时找到 xcb-shm 和 x11-xcb（SCREENSNIPER_XSHM）、服务器支持 MIT-SHM 1.2（传递文件描述符），
+    // 否则 attachSharedMemory() 返回 0，调用方应退回到 grabRootRectInto()。
+    // attachSharedMemory 把 fd 指向的共享内存（按附加时的大小）附加到服务器，返回段号；
+    // 共享内存扩大后要先 detachSharedMemory 再重新附加
+    quint32 attachSharedMemory(Display *display, int fd);
+    void detachSharedMemory(Display *display, quint32 segment);
+    // 截取 physicalRect 写到段的开头，每行 stride 字节。服务器按紧密排列写入，
+    // stride 必须等于宽 × 4，根窗口也必须是与 Format_RGB32 相同的布局，否则返回 false
+    bool grabRootRectToSharedMemory(Display *display, const QRect &physicalRect, quint32 segment, int stride);
+
+    // 在作用域内拦截本线程发出的请求产生的 X 协议错误（BadWindow、BadAccess 等），只记录不退出。
+    // 可以在多个线程中同时使用：Xlib 的错误处理函数是进程全局的，由第一个 ErrorTrap 安装、
+    // 最后一个恢复，错误按线程分别记录。Xlib 的查询函数会等待回复，之后 error() 即可看到错误；
+    // 不等回复的请求要用 sync() 等服务器处理完再检查
+    class ErrorTrap
+    {
+    public:
+        explicit ErrorTrap(Display *display);
+        ~ErrorTrap();
+
+        void clear();
+        // 上次 clear() 以来记录到的错误码，没有错误时为 0
+        int error() const;
+        int sync();
+
+    private:
+        Q_DISABLE_COPY(ErrorTrap)
+        Display *display;
+    };
+
+    // 顶层窗口信息，geometry 为根窗口中的物理像素区域（含窗口管理器边框）
+    struct TopLevelWindow
+    {
+        quint64 id;
+        QRect geometry;
+    };
+
+    // 通过 _NET_CLIENT_LIST_STACKING 一次性枚举所有可见的顶层窗口，按 z 序从下到上排列。
+    // 窗口管理器不支持 EWMH 时返回空列表
+    QVector<TopLevelWindow> stackingWindows(Display *display);
+    // 同上，临时打开一个 X 连接完成枚举，供 GUI 线程在截图开始时调用
+    QVector<TopLevelWindow> stackingWindows();
+
+    // 基于 XDamage 的屏幕变化跟踪
+    // 持有独立的 X 连接，只能在创建它的线程中使用。编译时未启用 XDamage 或
+    // 服务器不支持该扩展时 start() 返回 false，调用方应退回到逐帧比较
+    class DamageTracker
+    {
+    public:
+        DamageTracker();
+        ~DamageTracker();
+
+        bool start();
+        bool isActive() const;
+
+        // 取出上次调用以来根窗口上被修改的区域（物理像素）
+        QVector<QRect> takeDamage();
+
+        // 跟踪器自己的连接，可用于 grabRootRect
+        Display *display() const;
+
+    private:
+        Q_DISABLE_COPY(DamageTracker)
+        struct Private;
+        Private *d;
+    };
+}
+
+#endif // X11CAPTURE_H